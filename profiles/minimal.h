@@ -0,0 +1,64 @@
+/*
+    File: minimal.h
+    Config profile for low RAM single board computers with one PSU. Build with
+    cmake -DCONFIG_PROFILE=profiles/minimal.h . (static binary, no config file)
+
+    Only the values that differ from default-conf.h are overridden here.
+    Features that are compiled in but disabled here cost no runtime checks
+
+    written by Elias Geiger
+*/
+
+#pragma once
+
+// one PSU, meter readings on the default port
+#undef CAN_INTERFACE_NAME
+#define CAN_INTERFACE_NAME "can0"
+#undef UDP_PORT
+#define UDP_PORT 2000
+
+// regulator
+#undef TARGET_GRID_POWER
+#define TARGET_GRID_POWER 0
+#undef REGULATOR_IDLE_TIME
+#define REGULATOR_IDLE_TIME 1200
+#undef REGULATOR_GAIN
+#define REGULATOR_GAIN 1.0f
+#undef MAX_CHARGE_POWER
+#define MAX_CHARGE_POWER 700
+#undef MIN_CHARGE_POWER
+#define MIN_CHARGE_POWER 50
+
+// battery
+#undef CHARGER_ABSORPTION_VOLTAGE
+#define CHARGER_ABSORPTION_VOLTAGE 52.5f
+#undef BATTERY_CAPACITY
+#define BATTERY_CAPACITY 100.0f
+
+// no recordings on the (sd card) file system
+#undef ENERGY_LEDGER_ENABLED
+#define ENERGY_LEDGER_ENABLED false
+#undef LOAD_PROFILE_ENABLED
+#define LOAD_PROFILE_ENABLED false
+#undef METER_LOG_ENABLED
+#define METER_LOG_ENABLED false
+#undef TRACE_ENABLED
+#define TRACE_ENABLED false
+
+// self profile only on SIGUSR2 (busy threads are still reported)
+#undef SELF_PROFILE_ENABLED
+#define SELF_PROFILE_ENABLED true
+#undef SELF_PROFILE_REPORT_INTERVAL
+#define SELF_PROFILE_REPORT_INTERVAL 0
+
+// upgrades by restarting the service
+#undef HOT_RESTART_ENABLED
+#define HOT_RESTART_ENABLED false
+
+// slot detect relay on GPIO 17 (only with TARGET_RASPI)
+#undef SD_CONTROL_ENABLED
+#define SD_CONTROL_ENABLED true
+#undef SD_KEEP_ALIVE_TIME
+#define SD_KEEP_ALIVE_TIME 60
+#undef SD_PREDICTIVE_WAKE_ENABLED
+#define SD_PREDICTIVE_WAKE_ENABLED true
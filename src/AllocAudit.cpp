@@ -0,0 +1,117 @@
+/*
+    File: AllocAudit.cpp
+    written by Elias Geiger
+*/
+
+#include "AllocAudit.h"
+
+#ifdef _ALLOC_AUDIT
+
+#include <atomic>
+#include <cstdlib>
+#include <cstdio>
+#include <new>
+
+#include <unistd.h>
+#include <execinfo.h>
+
+// glibc internals the malloc hooks forward to
+extern "C" void* __libc_malloc(size_t);
+extern "C" void* __libc_calloc(size_t, size_t);
+extern "C" void* __libc_realloc(void*, size_t);
+
+static std::atomic<bool> auditArmed(false);
+static std::atomic<long> auditCount(0);
+
+// counts an allocation and prints the backtrace of the first ones (without allocating)
+static void recordAllocation(size_t size) {
+    if(!auditArmed.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    long count = auditCount.fetch_add(1) + 1;
+    if(count <= ALLOC_AUDIT_TRACES) {
+        char line[64];
+        int length = snprintf(line, sizeof(line), "[AllocAudit] allocation #%ld of %zu bytes:\n", count, size);
+        if(write(STDERR_FILENO, line, length) < 0) {
+            return;
+        }
+        void* frames[16];
+        int depth = backtrace(frames, 16);
+        backtrace_symbols_fd(frames, depth, STDERR_FILENO);
+    }
+}
+
+// starts counting. everything allocated so far belongs to the startup
+void armAllocAudit() {
+    // the first backtrace loads the unwinder (allocates) --> do it before arming
+    void* frames[4];
+    backtrace(frames, 4);
+    auditArmed = true;
+}
+
+// stops counting (shutdown allocates)
+void disarmAllocAudit() {
+    auditArmed = false;
+}
+
+long getAllocAuditCount() {
+    return auditCount;
+}
+
+// allocation hooks //
+extern "C" void* malloc(size_t size) {
+    recordAllocation(size);
+    return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t count, size_t size) {
+    recordAllocation(count * size);
+    return __libc_calloc(count, size);
+}
+
+extern "C" void* realloc(void* ptr, size_t size) {
+    recordAllocation(size);
+    return __libc_realloc(ptr, size);
+}
+
+// operator new ends up in malloc anyway, but is hooked directly in case the C++ runtime bypasses it
+void* operator new(size_t size) {
+    void* ptr = malloc(size);
+    if(ptr == NULL) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept {
+    free(ptr);
+}
+
+#else
+
+void armAllocAudit() {}
+
+void disarmAllocAudit() {}
+
+long getAllocAuditCount() {
+    return 0;
+}
+
+#endif
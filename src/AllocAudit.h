@@ -0,0 +1,18 @@
+/*
+    File: AllocAudit.h
+    Allocation audit for the steady state of the application (build with -DALLOC_AUDIT=ON).
+    All heap allocations after arming are counted, the first ones are reported with a backtrace.
+    Without the build option the functions are empty
+
+    written by Elias Geiger
+*/
+
+#pragma once
+
+// number of allocations reported with a backtrace
+#define ALLOC_AUDIT_TRACES 5
+
+// function prototypes
+void armAllocAudit();
+void disarmAllocAudit();
+long getAllocAuditCount();
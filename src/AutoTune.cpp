@@ -0,0 +1,267 @@
+/*
+    File: AutoTune.cpp
+    written by Elias Geiger
+*/
+
+#include "AutoTune.h"
+
+// constructor
+AutoTune::AutoTune(Regulator& regulator, bool (*abortRequested)())
+    : m_cfg(regulator.getConfig()), m_psu(regulator.getPsu()), m_battery(regulator.getBattery()),
+      m_watchdog(regulator.getWatchdog()), m_cmdQueue(regulator.getQueue()) {
+    m_abortRequested = abortRequested;
+}
+
+// runs the whole identification. returns false if it was aborted or no usable model could be fitted
+bool AutoTune::run() {
+    std::cout << "[AutoTune] Starting system identification ..." << std::endl;
+    if(!checkConditions()) {
+        return false;
+    }
+
+    // steps stay small and within the allowed charge power
+    float basePower = m_cfg.getMinChargePower();
+    float stepPower = std::min(static_cast<float>(AUTOTUNE_STEP_POWER), m_battery.getChargePowerLimit() - basePower);
+    if(stepPower < AUTOTUNE_STEP_POWER / 2.0f) {
+        std::cerr << "[AutoTune] Charge power limit too low for a test step (battery full?)" << std::endl;
+        return false;
+    }
+
+    // settle at the base power
+    std::cout << "[AutoTune] Settle at " << basePower << "W ..." << std::endl;
+    if(!applyPower(basePower) || !waitFor(AUTOTUNE_SETTLE_TIME * 1000)) {
+        applyPower(0.0f);
+        return false;
+    }
+
+    // alternate up and down steps
+    for(int i = 0; i < 2 * AUTOTUNE_REPETITIONS; i++) {
+        float from = (i % 2 == 0) ? basePower : basePower + stepPower;
+        float to = (i % 2 == 0) ? basePower + stepPower : basePower;
+
+        std::vector<TuneSample> meterSamples, psuSamples;
+        float meterBaseline = 0.0f, psuBaseline = 0.0f;
+        std::cout << "[AutoTune] Step " << i + 1 << "/" << 2 * AUTOTUNE_REPETITIONS << ": " << from << "W --> " << to << "W" << std::endl;
+        if(!recordStep(to, meterSamples, psuSamples, meterBaseline, psuBaseline)) {
+            applyPower(0.0f);
+            return false;
+        }
+
+        // steps disturbed by load changes in the household don't fit and are dropped
+        FopdtModel model;
+        if(fitStepResponse(meterSamples, meterBaseline, to - from, model)) {
+            m_meterModels.push_back(model);
+        } else {
+            std::cout << "[AutoTune] Meter response of step " << i + 1 << " not usable (disturbance?)" << std::endl;
+        }
+        if(fitStepResponse(psuSamples, psuBaseline, to - from, model)) {
+            m_psuModels.push_back(model);
+        }
+    }
+    applyPower(0.0f);
+
+    if(m_meterModels.size() < AUTOTUNE_REPETITIONS) {
+        std::cerr << "[AutoTune] Too few usable step responses (" << m_meterModels.size() << ") --> repeat at a quieter time" << std::endl;
+        return false;
+    }
+
+    FopdtModel meterModel = medianModel(m_meterModels);
+    FopdtModel psuModel = medianModel(m_psuModels);
+    printf("\n[AutoTune] %-16s %8s %12s %12s %12s\n", "response", "gain", "dead-ms", "tau-ms", "rise-ms");
+    printf("[AutoTune] %-16s %8.2f %12.0f %12.0f %12.0f\n", "meter (grid)", meterModel.gain, meterModel.deadTime, meterModel.timeConstant, meterModel.riseTime);
+    if(!m_psuModels.empty()) {
+        printf("[AutoTune] %-16s %8.2f %12.0f %12.0f %12.0f\n", "psu (ac input)", psuModel.gain, psuModel.deadTime, psuModel.timeConstant, psuModel.riseTime);
+    }
+    std::cout << std::endl;
+
+    storeRecommendation(meterModel, psuModel);
+    return true;
+}
+
+// records the response to a step of the charge power. The baselines are averaged right before the step
+bool AutoTune::recordStep(float to, std::vector<TuneSample>& meterSamples, std::vector<TuneSample>& psuSamples,
+                            float& meterBaseline, float& psuBaseline) {
+    PowerState state;
+    float meterSum = 0.0f;
+    int meterCount = 0;
+
+    // baseline of the meter
+    m_cmdQueue.clear();
+    auto startTime = steady_clock::now();
+    while(duration_cast<milliseconds>(steady_clock::now() - startTime).count() < AUTOTUNE_BASELINE_TIME * 1000) {
+        if(!checkConditions()) {
+            return false;
+        }
+        if(m_cmdQueue.tryPop(state)) {
+            meterSum += state.tasmotaPowerCmd;
+            meterCount++;
+        }
+        std::this_thread::sleep_for(milliseconds(AUTOTUNE_SAMPLE_TIME));
+    }
+    if(meterCount == 0) {
+        std::cerr << "[AutoTune] No meter readings received!" << std::endl;
+        return false;
+    }
+    meterBaseline = meterSum / meterCount;
+    psuBaseline = m_psu.getCurrentInputPower();
+
+    // apply the step and record both responses (telemetry only on changes, it is updated every second)
+    if(!applyPower(to)) {
+        return false;
+    }
+    auto stepTime = steady_clock::now();
+    float lastPsuPower = psuBaseline;
+    long elapsed = 0;
+    while(elapsed < AUTOTUNE_RECORD_TIME * 1000) {
+        if(!checkConditions()) {
+            return false;
+        }
+
+        elapsed = duration_cast<milliseconds>(steady_clock::now() - stepTime).count();
+        if(m_cmdQueue.tryPop(state)) {
+            meterSamples.push_back({elapsed, static_cast<float>(state.tasmotaPowerCmd)});
+        }
+        float psuPower = m_psu.getCurrentInputPower();
+        if(psuPower != lastPsuPower) {
+            psuSamples.push_back({elapsed, psuPower});
+            lastPsuPower = psuPower;
+        }
+        std::this_thread::sleep_for(milliseconds(AUTOTUNE_SAMPLE_TIME));
+    }
+
+    return true;
+}
+
+// sends the current command for an AC charge power
+bool AutoTune::applyPower(float power) {
+    float current = calculateCurrentBasedOnPower(power, m_psu.getCurrentOutputVoltage());
+    return m_psu.setMaxCurrent(current, false);
+}
+
+// idles while supervising the conditions
+bool AutoTune::waitFor(long duration) {
+    auto startTime = steady_clock::now();
+    while(duration_cast<milliseconds>(steady_clock::now() - startTime).count() < duration) {
+        if(!checkConditions()) {
+            return false;
+        }
+        std::this_thread::sleep_for(milliseconds(AUTOTUNE_SAMPLE_TIME));
+    }
+    return true;
+}
+
+// the identification is only safe with live meter readings and PSU telemetry
+bool AutoTune::checkConditions() {
+    if(m_abortRequested()) {
+        std::cout << "[AutoTune] Aborted" << std::endl;
+        return false;
+    }
+    if(m_watchdog.getStage() != WD_STAGE_OK) {
+        std::cerr << "[AutoTune] Meter readings missing --> abort" << std::endl;
+        return false;
+    }
+    if(m_psu.getCurrentOutputVoltage() <= 0.0f) {
+        std::cerr << "[AutoTune] No PSU telemetry --> abort" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// derives the regulator parameters from the fitted meter response and writes them into the config file
+void AutoTune::storeRecommendation(const FopdtModel& meterModel, const FopdtModel& psuModel) {
+    // wait until the previous command has settled to 86% in the meter reading (dead time + 2 tau)
+    int idleTime = static_cast<int>(std::lround((meterModel.deadTime + 2.0f * meterModel.timeConstant) / 100.0f) * 100);
+    idleTime = std::max(AUTOTUNE_MIN_IDLE_TIME, std::min(AUTOTUNE_MAX_IDLE_TIME, idleTime));
+
+    // compensate the static gain of the loop (e.g. efficiency mismatch of the current calculation)
+    float gain = 1.0f / meterModel.gain;
+    gain = std::max(AUTOTUNE_MIN_GAIN, std::min(AUTOTUNE_MAX_GAIN, gain));
+
+    std::cout << "[AutoTune] Recommendation: regulator-idle-time " << idleTime << " msec (was " << m_cfg.getRegulatorIdleTime()
+                << "), regulator-gain " << gain << " (was " << m_cfg.getRegulatorGain() << ")" << std::endl;
+    if(psuModel.deadTime > 0.0f) {
+        std::cout << "[AutoTune] Meter latency on top of the PSU response: "
+                    << std::lround(meterModel.deadTime - psuModel.deadTime) << " msec" << std::endl;
+    }
+
+    char gainText[16];
+    snprintf(gainText, sizeof(gainText), "%.2f", gain);
+    if(!m_cfg.storeValue("regulator-idle-time", std::to_string(idleTime)) || !m_cfg.storeValue("regulator-gain", gainText)) {
+        std::cerr << "[AutoTune] Failed to write the recommendation into the config file!" << std::endl;
+        return;
+    }
+    std::cout << "[AutoTune] Recommendation written to the config file" << std::endl;
+}
+
+// fits a first order plus dead time model to a step response with the two point method (28% and 63%)
+bool fitStepResponse(const std::vector<TuneSample>& samples, float baseline, float commandStep, FopdtModel& model) {
+    if(samples.size() < 2 || commandStep == 0.0f) {
+        return false;
+    }
+
+    // final value averaged over the end of the recording
+    long endTime = samples.back().timeMs;
+    float finalSum = 0.0f;
+    int finalCount = 0;
+    for(const TuneSample& sample : samples) {
+        if(sample.timeMs >= endTime - AUTOTUNE_FINAL_TIME * 1000) {
+            finalSum += sample.value;
+            finalCount++;
+        }
+    }
+    float delta = finalSum / finalCount - baseline;
+    if(std::fabs(delta) < AUTOTUNE_MIN_RESPONSE * std::fabs(commandStep)) {
+        return false;
+    }
+
+    // first crossing times of the normalized response (interpolated between the samples)
+    const float levels[4] = {0.1f, 0.283f, 0.632f, 0.9f};
+    float crossing[4] = {-1.0f, -1.0f, -1.0f, -1.0f};
+    float lastTime = 0.0f, lastResponse = 0.0f;
+    for(const TuneSample& sample : samples) {
+        float response = (sample.value - baseline) / delta;
+        for(int l = 0; l < 4; l++) {
+            if(crossing[l] < 0.0f && response >= levels[l]) {
+                float fraction = response > lastResponse ? (levels[l] - lastResponse) / (response - lastResponse) : 1.0f;
+                crossing[l] = lastTime + fraction * (sample.timeMs - lastTime);
+            }
+        }
+        lastTime = static_cast<float>(sample.timeMs);
+        lastResponse = response;
+    }
+    for(int l = 0; l < 4; l++) {
+        if(crossing[l] < 0.0f) {
+            return false;
+        }
+    }
+
+    model.gain = delta / commandStep;
+    model.timeConstant = 1.5f * (crossing[2] - crossing[1]);
+    model.deadTime = std::max(0.0f, crossing[2] - model.timeConstant);
+    model.riseTime = crossing[3] - crossing[0];
+    return true;
+}
+
+// median of every model parameter (robust against single disturbed steps)
+FopdtModel medianModel(const std::vector<FopdtModel>& models) {
+    FopdtModel result = {0.0f, 0.0f, 0.0f, 0.0f};
+    if(models.empty()) {
+        return result;
+    }
+
+    auto median = [&models] (float FopdtModel::* field) {
+        std::vector<float> values;
+        for(const FopdtModel& model : models) {
+            values.push_back(model.*field);
+        }
+        std::sort(values.begin(), values.end());
+        size_t mid = values.size() / 2;
+        return values.size() % 2 ? values[mid] : (values[mid - 1] + values[mid]) / 2.0f;
+    };
+
+    result.gain = median(&FopdtModel::gain);
+    result.deadTime = median(&FopdtModel::deadTime);
+    result.timeConstant = median(&FopdtModel::timeConstant);
+    result.riseTime = median(&FopdtModel::riseTime);
+    return result;
+}
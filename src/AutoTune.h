@@ -0,0 +1,70 @@
+/*
+    File: AutoTune.h
+    System identification of the control loop (PSU + energy meter). Small current steps are injected,
+    the responses of the meter and the PSU telemetry are recorded and a first order plus dead time
+    model is fitted. The recommended regulator parameters are written into the config file
+
+    written by Elias Geiger
+*/
+
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <cmath>
+#include <cstdio>
+#include <algorithm>
+
+#include "Regulator.h"
+
+using std::chrono::steady_clock;
+using std::chrono::milliseconds;
+using std::chrono::duration_cast;
+
+// one recorded value of a step response
+struct TuneSample
+{
+    long timeMs;            // since the step command
+    float value;
+};
+
+// first order plus dead time model: y(t) = K * u * (1 - exp(-(t - deadTime) / tau)) for t > deadTime
+struct FopdtModel
+{
+    float gain;
+    float deadTime;         // in ms
+    float timeConstant;     // in ms
+    float riseTime;         // 10% to 90% in ms
+};
+
+class AutoTune
+{
+    ConfigFile& m_cfg;
+    PsuInterface& m_psu;
+    BatteryMonitor& m_battery;
+    MeterWatchdog& m_watchdog;
+    Queue<PowerState>& m_cmdQueue;
+    bool (*m_abortRequested)();
+
+    // step responses of the grid power (meter) and of the AC input power (PSU telemetry)
+    std::vector<FopdtModel> m_meterModels, m_psuModels;
+
+public:
+    AutoTune(Regulator&, bool (*)());
+
+    bool run();
+
+private:
+    bool recordStep(float, std::vector<TuneSample>&, std::vector<TuneSample>&, float&, float&);
+    bool applyPower(float);
+    bool waitFor(long);
+    bool checkConditions();
+    void storeRecommendation(const FopdtModel&, const FopdtModel&);
+};
+
+// function prototypes
+bool fitStepResponse(const std::vector<TuneSample>&, float, float, FopdtModel&);
+FopdtModel medianModel(const std::vector<FopdtModel>&);
@@ -0,0 +1,192 @@
+/*
+    File: BatteryMonitor.cpp
+
+    written by Elias Geiger
+*/
+
+#include "BatteryMonitor.h"
+
+BatteryMonitor::BatteryMonitor(const ConfigFile& cfg, std::string filename) : m_cfg(cfg) {
+    m_stateFileName = filename;
+    m_chargedAmpHours = 0.0;
+    m_chargedWattHours = 0.0;
+    m_stateOfCharge = 0.0f;
+    m_socValid = false;
+    m_lastFullTime = 0;
+    m_restSince = 0;
+    m_lastUpdateTime = 0;
+}
+
+BatteryMonitor::~BatteryMonitor() {}
+
+// restores the persisted counters. returns false if there is no state file
+bool BatteryMonitor::loadState() {
+    std::ifstream fileIn(m_stateFileName.c_str(), std::ifstream::in);
+    if(!fileIn.is_open()) {
+        return false;
+    }
+
+    const std::lock_guard<std::mutex> lock(m_mutex);
+    std::string key;
+    time_t savedTime = 0;
+    float savedSoc = 0.0f;
+    while(fileIn >> key) {
+        if(key == "charged-ah:") {
+            fileIn >> m_chargedAmpHours;
+        } else if(key == "charged-wh:") {
+            fileIn >> m_chargedWattHours;
+        } else if(key == "soc:") {
+            fileIn >> savedSoc;
+        } else if(key == "last-full:") {
+            fileIn >> m_lastFullTime;
+        } else if(key == "saved:") {
+            fileIn >> savedTime;
+        }
+    }
+    fileIn.close();
+
+    // the battery may have been discharged by the loads while we were not running.
+    // only trust the stored state of charge if it is recent, otherwise resync on the voltage
+    if(savedTime > 0 && difftime(time(NULL), savedTime) < SOC_MAX_STATE_AGE) {
+        m_stateOfCharge = savedSoc;
+        m_socValid = true;
+    }
+
+    return true;
+}
+
+// writes the counters to the state file. returns false on failure
+// (formatted on the stack, called periodically by the CAN worker --> no heap allocation)
+bool BatteryMonitor::storeState() const {
+    char content[256];
+    int length = 0;
+    {
+        const std::lock_guard<std::mutex> lock(m_mutex);
+        length = snprintf(content, sizeof(content), "charged-ah: %g\ncharged-wh: %g\nsoc: %g\nlast-full: %ld\nsaved: %ld\n",
+                            m_chargedAmpHours, m_chargedWattHours, m_stateOfCharge, static_cast<long>(m_lastFullTime),
+                            static_cast<long>(time(NULL)));
+    }
+
+    int fd = open(m_stateFileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0) {
+        return false;
+    }
+    bool success = write(fd, content, length) == length;
+    close(fd);
+
+    return success;
+}
+
+void BatteryMonitor::printState() const {
+    const std::lock_guard<std::mutex> lock(m_mutex);
+    std::cout << "[Battery] charged total " << m_chargedAmpHours << " Ah / " << m_chargedWattHours << " Wh, SOC ";
+    if(m_socValid) {
+        std::cout << m_stateOfCharge << " %" << std::endl;
+    } else {
+        std::cout << "unknown" << std::endl;
+    }
+}
+
+// adds the charge delivered since the last status report (coulomb counting)
+void BatteryMonitor::addCharge(float ampHours, float wattHours) {
+    const std::lock_guard<std::mutex> lock(m_mutex);
+    m_chargedAmpHours += ampHours;
+    m_chargedWattHours += wattHours;
+
+    if(!m_socValid) {
+        return;
+    }
+
+    m_stateOfCharge += ampHours / m_cfg.getBatteryCapacity() * 100.0f;
+    if(m_stateOfCharge > 100.0f) {
+        m_stateOfCharge = 100.0f;
+    }
+}
+
+// resyncs the state of charge estimation on the measured battery voltage and charge current
+void BatteryMonitor::updateState(float voltage, float current) {
+    const std::lock_guard<std::mutex> lock(m_mutex);
+    time_t now = time(NULL);
+
+    // no status reports for a while (PSUs in standby) --> the battery rested or was discharged meanwhile
+    if(m_lastUpdateTime > 0 && difftime(now, m_lastUpdateTime) >= SOC_REST_TIME) {
+        m_restSince = m_lastUpdateTime;
+    }
+    m_lastUpdateTime = now;
+
+    // absorption voltage reached and current tailed off --> battery is full
+    if(voltage >= m_cfg.getChargerAbsorptionVoltage() - SOC_FULL_VOLTAGE_MARGIN && current <= m_cfg.getBatteryTailCurrent()) {
+        if(!m_socValid || m_stateOfCharge < 100.0f) {
+            std::cout << "[Battery] absorption reached --> state of charge resynced to 100%" << std::endl;
+        }
+        m_stateOfCharge = 100.0f;
+        m_socValid = true;
+        m_lastFullTime = time(NULL);
+        return;
+    }
+
+    // only the resting voltage (no charge current) is meaningful for the remaining estimations
+    if(current > SOC_REST_CURRENT) {
+        m_restSince = 0;
+        return;
+    }
+    if(m_restSince == 0) {
+        m_restSince = now;
+    }
+
+    // empty voltage reached --> battery is empty
+    if(voltage <= m_cfg.getBatteryEmptyVoltage()) {
+        m_stateOfCharge = 0.0f;
+        m_socValid = true;
+        return;
+    }
+
+    // no valid estimation yet or the voltage settled after a rest --> interpolate linear between empty and
+    // absorption voltage. Otherwise the taper would stick at a full battery that was discharged meanwhile
+    if(!m_socValid || difftime(now, m_restSince) >= SOC_REST_TIME) {
+        float range = m_cfg.getChargerAbsorptionVoltage() - m_cfg.getBatteryEmptyVoltage();
+        float estimation = (voltage - m_cfg.getBatteryEmptyVoltage()) / range * 100.0f;
+        if(estimation > 100.0f) {
+            estimation = 100.0f;
+        }
+        if(!m_socValid || fabsf(estimation - m_stateOfCharge) >= 1.0f) {
+            std::cout << "[Battery] state of charge estimated from resting voltage: " << estimation << "%" << std::endl;
+        }
+        m_stateOfCharge = estimation;
+        m_socValid = true;
+    }
+}
+
+// Getters //
+float BatteryMonitor::getStateOfCharge() const {
+    const std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stateOfCharge;
+}
+
+bool BatteryMonitor::isStateOfChargeValid() const {
+    const std::lock_guard<std::mutex> lock(m_mutex);
+    return m_socValid;
+}
+
+double BatteryMonitor::getChargedAmpHours() const {
+    const std::lock_guard<std::mutex> lock(m_mutex);
+    return m_chargedAmpHours;
+}
+
+double BatteryMonitor::getChargedWattHours() const {
+    const std::lock_guard<std::mutex> lock(m_mutex);
+    return m_chargedWattHours;
+}
+
+// returns the max charge power tapered down linear towards min charge power as the battery approaches full
+short BatteryMonitor::getChargePowerLimit() const {
+    const std::lock_guard<std::mutex> lock(m_mutex);
+    float taperStart = static_cast<float>(m_cfg.getSocTaperStart());
+    if(!m_socValid || m_stateOfCharge <= taperStart || taperStart >= 100.0f) {
+        return m_cfg.getMaxChargePower();
+    }
+
+    float ratio = (100.0f - m_stateOfCharge) / (100.0f - taperStart);
+    float range = static_cast<float>(m_cfg.getMaxChargePower() - m_cfg.getMinChargePower());
+    return static_cast<short>(m_cfg.getMinChargePower() + ratio * range);
+}
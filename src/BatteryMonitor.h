@@ -0,0 +1,53 @@
+/*
+    File: BatteryMonitor.h
+    The battery monitor integrates the charge current delivered by the PSU (coulomb counting)
+    and estimates the state of charge of the battery. Counters are persisted across restarts
+
+    written by Elias Geiger
+*/
+
+#pragma once
+
+#include <iostream>
+#include <fstream>
+#include <mutex>
+#include <ctime>
+#include <cstdio>
+#include <cmath>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "ConfigFile.h"
+
+class BatteryMonitor
+{
+    const ConfigFile& m_cfg;
+    std::string m_stateFileName;
+    mutable std::mutex m_mutex;
+
+    // counters
+    double m_chargedAmpHours, m_chargedWattHours;
+    float m_stateOfCharge;                  // in percent (0 - 100)
+    bool m_socValid;                        // false until first resync or restored state
+    time_t m_lastFullTime;
+    time_t m_restSince, m_lastUpdateTime;   // start of the current rest period (0 = charging)
+
+public:
+    BatteryMonitor(const ConfigFile&, std::string);
+    ~BatteryMonitor();
+
+    bool loadState();
+    bool storeState() const;
+    void printState() const;
+
+    void addCharge(float, float);
+    void updateState(float, float);
+
+    // Getters //
+    float getStateOfCharge() const;
+    bool isStateOfChargeValid() const;
+    double getChargedAmpHours() const;
+    double getChargedWattHours() const;
+    short getChargePowerLimit() const;
+};
@@ -0,0 +1,923 @@
+/*
+	File: CanBus.cpp
+	Edited by Elias Geiger
+*/
+
+#include "CanBus.h"
+#include "PsuController.h"
+
+// Constructor
+CanBus::CanBus(const std::string& interfaceName, PsuController* owner) {
+	m_interfaceName = interfaceName;
+	m_owner = owner;
+	m_canSocket = -1;
+	m_wakeUpFd = -1;
+	m_threadRunning = false;
+	memset(&m_rectifierParams, 0, sizeof(m_rectifierParams));
+	m_lastOutputCurrentTime = steady_clock::now();
+	m_voltageCmd = 0.0f;
+	m_currentCmd = 0.0f;
+	m_voltageNonvolatile = false;
+	m_currentNonvolatile = false;
+	m_voltagePending = false;
+	m_currentPending = false;
+	m_lastCurrentCmd = 0.0f;
+	m_lastVoltageCmd = 0.0f;
+	m_cmdAckFlag = false;
+	m_socketFailed = false;
+	m_secondPsuWarned = false;
+	m_faultTime = steady_clock::now();
+	memset(m_ringRxFrames, 0, sizeof(m_ringRxFrames));
+	memset(m_ringTxFrames, 0, sizeof(m_ringTxFrames));
+	m_ringTxBusy = 0;
+	m_ringWakeUpValue = 0;
+	m_ringRecvArmed = false;
+	m_ringSocketGeneration = 0;
+	memset(&m_metrics, 0, sizeof(m_metrics));
+	m_metrics.state = CAN_STATE_ACTIVE;
+	m_rxFrames = 0;
+	m_txFrames = 0;
+}
+
+// Destructor
+CanBus::~CanBus() {}
+
+// public methods //
+// creates and binds a new CAN socket or uses an existing one (socket handed over by hot restart)
+bool CanBus::setup(int existingSocket, bool useIoRing) {
+	if(existingSocket >= 0) {
+		m_canSocket = existingSocket;
+		subscribeErrorFrames();
+	} else if(!openSocket()) {
+		return false;
+	}
+
+	// event for waking up the worker when new setpoints are pending
+	m_wakeUpFd = eventfd(0, EFD_NONBLOCK);
+	if(m_wakeUpFd < 0) {
+		std::cerr << "Failed to create wake up event for " << m_interfaceName << "!" << std::endl;
+		return false;
+	}
+
+	// optional io_uring backend, the classic poll/read/write path is the fallback
+	if(useIoRing) {
+		setupRing();
+	}
+
+	// spawn worker thread
+	m_threadRunning = true;
+	m_workerTh = std::thread([] (CanBus* ptr) {
+		// Timing variables
+		auto currentTime = steady_clock::now();
+		auto lastStatusRequestTime = currentTime, lastCurrentCommandRepeatTime = currentTime;
+		milliseconds timeElapsed;
+
+		std::cout << "[CAN-thread " << ptr->m_interfaceName << "] worker thread running ..." << std::endl;
+		setTraceThreadName(ptr->m_interfaceName.c_str());
+		registerProfileThread(ptr->m_interfaceName.c_str());
+
+		// send first request for status report
+		ptr->requestStatusData();
+
+		// wait for frames on the bus and for new setpoints
+		struct pollfd pfds[2];
+		pfds[0].events = POLLIN;
+		pfds[1].fd = ptr->m_wakeUpFd;
+		pfds[1].events = POLLIN;
+
+		// repeat until external stop signal
+		while(ptr->m_threadRunning == true) {
+			// socket broken (interface down, bus-off without restart) --> reopen it with backoff
+			if(ptr->m_socketFailed) {
+				ptr->recoverSocket();
+				continue;
+			}
+
+			// no automatic controller restart after bus-off --> wait for the interface to come back
+			if(ptr->m_metrics.state == CAN_STATE_BUS_OFF &&
+					duration_cast<milliseconds>(steady_clock::now() - ptr->m_faultTime).count() > CAN_BUSOFF_RESTART_TIMEOUT) {
+				ptr->checkSocketError(ENETDOWN);
+				continue;
+			}
+
+			// wait for frames and new setpoints (io_uring or poll). false if the socket failed
+			bool socketUsable = ptr->m_ring.isActive() ? ptr->processRingEvents() : ptr->processSocketEvents(pfds);
+			if(!socketUsable) {
+				continue;
+			}
+
+			// every second request status update
+			currentTime = steady_clock::now();
+			timeElapsed = duration_cast<milliseconds>(currentTime - lastStatusRequestTime);
+			if(timeElapsed.count() > 1000) {
+				ptr->requestStatusData();
+				lastStatusRequestTime = steady_clock::now();
+			}
+
+			// every 5 sec repeat last current command to ensure PSU stays in online mode
+			currentTime = steady_clock::now();
+			timeElapsed = duration_cast<milliseconds>(currentTime - lastCurrentCommandRepeatTime);
+			if(timeElapsed.count() > 5000) {
+				ptr->sendCurrentFrame(ptr->m_lastCurrentCmd, false);
+				ptr->m_owner->periodicTasks();
+				lastCurrentCommandRepeatTime = steady_clock::now();
+			}
+		}
+
+		// frames queued in the last cycle (e.g. the final setpoint) still go out
+		if(ptr->m_ring.isActive()) {
+			ptr->m_ring.submitAndWait(0);
+		}
+
+		unregisterProfileThread();
+		std::cout << "[CAN-thread " << ptr->m_interfaceName << "] closeup --> finish thread now" << std::endl;
+	}, this);
+
+	return true;
+}
+
+void CanBus::shutdown() {
+	// wait for worker thread
+	if(m_workerTh.joinable()) {
+		m_threadRunning = false;
+		eventfd_write(m_wakeUpFd, 1);
+		m_workerTh.join();
+	}
+	m_ring.closeUp();
+
+	// close the CAN socket
+	if(m_canSocket < 0 || close(m_canSocket) < 0) {
+		std::cerr << "Could not close CAN socket! Not created at all?" << std::endl;
+	}
+	if(m_wakeUpFd >= 0) {
+		close(m_wakeUpFd);
+	}
+}
+
+void CanBus::printParams() const {
+	RectifierParameters params = getParams();
+
+	std::cout << std::endl << "[" << m_interfaceName << "]" << std::endl;
+	printf("Input Voltage %.02fV @ %.02fHz\n", params.input_voltage, params.input_frequency);
+	printf("Input Current %.02fA\n", params.input_current);
+	printf("Input Power %.02fW\n", params.input_power);
+
+	std::cout << std::endl;
+	printf("Output Voltage %.02fV\n", params.output_voltage);
+	printf("Output Current %.02fA\n", params.output_current);
+	printf("Output Power %.02fW\n", params.output_power);
+	printf("Charged %.02fAh\n", params.amp_hour);
+
+	std::cout << std::endl;
+	printf("Input Temperature %.01f DegC\n", params.input_temp);
+	printf("Output Temperature %.01f DegC\n", params.output_temp);
+	printf("Efficiency %.01f%%\n", params.efficiency * 100);
+
+	CanBusMetrics metrics = getMetrics();
+	std::cout << std::endl;
+	printf("Bus State %s (tx errors %u, rx errors %u)\n", getBusStateName(metrics.state), metrics.txErrorCounter, metrics.rxErrorCounter);
+	printf("Error Frames %u, Bus-Off %u, Socket Failures %u\n", metrics.errorFrames, metrics.busOffCount, metrics.socketFailures);
+	printf("Recoveries %u (last %ldms, max %ldms)\n", metrics.recoveries, metrics.lastRecoveryTime, metrics.maxRecoveryTime);
+	printf("Frames received %lu, sent %lu\n", metrics.rxFrames, metrics.txFrames);
+}
+
+// Does not block. The worker thread sends the frame
+void CanBus::setMaxVoltage(float voltage, bool nonvolatile) {
+	{
+		const std::lock_guard<std::mutex> lock(m_cmdMutex);
+		m_voltageCmd = voltage;
+		m_voltageNonvolatile = nonvolatile;
+		m_voltagePending = true;
+	}
+	eventfd_write(m_wakeUpFd, 1);
+	countSyscalls();
+}
+
+// Does not block. The worker thread sends the frame
+void CanBus::setMaxCurrent(float current, bool nonvolatile) {
+	{
+		const std::lock_guard<std::mutex> lock(m_cmdMutex);
+		m_currentCmd = current;
+		m_currentNonvolatile = nonvolatile;
+		m_currentPending = true;
+	}
+	eventfd_write(m_wakeUpFd, 1);
+	countSyscalls();
+}
+
+// takes over the telemetry snapshot of the previous process (hot restart)
+void CanBus::restoreParams(const RectifierParameters& params) {
+	const std::lock_guard<std::mutex> lock(m_paramsMutex);
+	m_rectifierParams = params;
+}
+
+const char* CanBus::getInterfaceName() const {
+	return m_interfaceName.c_str();
+}
+
+int CanBus::getSocket() const {
+	return m_canSocket;
+}
+
+RectifierParameters CanBus::getParams() const {
+	const std::lock_guard<std::mutex> lock(m_paramsMutex);
+	return m_rectifierParams;
+}
+
+CanBusMetrics CanBus::getMetrics() const {
+	const std::lock_guard<std::mutex> lock(m_paramsMutex);
+	CanBusMetrics metrics = m_metrics;
+	metrics.rxFrames = m_rxFrames.load(std::memory_order_relaxed);
+	metrics.txFrames = m_txFrames.load(std::memory_order_relaxed);
+	return metrics;
+}
+
+// true if the PSU reported recently and the bus is usable. the telemetry of other buses is stale
+bool CanBus::isReporting() const {
+	const std::lock_guard<std::mutex> lock(m_paramsMutex);
+	if(m_metrics.state == CAN_STATE_BUS_OFF || m_metrics.state == CAN_STATE_DOWN) {
+		return false;
+	}
+	return duration_cast<milliseconds>(steady_clock::now() - m_lastOutputCurrentTime).count() < CAN_TELEMETRY_TIMEOUT;
+}
+
+// creates a new CAN socket and binds it to the interface. fails as long as the interface is not up and running
+bool CanBus::openSocket() {
+	// create can socket
+	int canSocket = socket(PF_CAN, SOCK_RAW, CAN_RAW);
+	if(canSocket < 0) {
+		std::cerr << "Failed to create CAN socket for " << m_interfaceName << "!" << std::endl;
+		return false;
+	}
+
+	// use the specified interface (index may change if the interface was recreated)
+	strncpy(m_ifr.ifr_name, m_interfaceName.c_str(), IFNAMSIZ - 1);
+	m_ifr.ifr_name[IFNAMSIZ - 1] = '\0';
+	if(ioctl(canSocket, SIOCGIFINDEX, &m_ifr) < 0) {
+		std::cerr << "CAN interface " << m_interfaceName << " not found!" << std::endl;
+		close(canSocket);
+		return false;
+	}
+
+	// prepare CAN adress
+	memset(&m_addr, 0, sizeof(m_addr));
+	m_addr.can_family = AF_CAN;
+	m_addr.can_ifindex = m_ifr.ifr_ifindex;
+
+	// bind address to interface
+	if(bind(canSocket, (struct sockaddr*)&m_addr, sizeof(m_addr)) < 0) {
+		std::cerr << "Failed to bind CAN Socket to " << m_interfaceName << "!" << std::endl;
+		close(canSocket);
+		return false;
+	}
+
+	// binding also works on an interface that is down --> check its state
+	if(ioctl(canSocket, SIOCGIFFLAGS, &m_ifr) < 0 || !(m_ifr.ifr_flags & IFF_UP) || !(m_ifr.ifr_flags & IFF_RUNNING)) {
+		std::cerr << "CAN interface " << m_interfaceName << " is not up!" << std::endl;
+		close(canSocket);
+		return false;
+	}
+
+	m_canSocket = canSocket;
+	subscribeErrorFrames();
+	return true;
+}
+
+// sets up the io_uring backend: receive buffers provided to the kernel, write slots registered (pinned) once
+bool CanBus::setupRing() {
+	if(!m_ring.setup(CAN_RING_ENTRIES)) {
+		std::cerr << "[CAN " << m_interfaceName << "] io_uring not available --> classic I/O" << std::endl;
+		return false;
+	}
+
+	struct iovec txBuffers;
+	txBuffers.iov_base = m_ringTxFrames;
+	txBuffers.iov_len = sizeof(m_ringTxFrames);
+	if(!m_ring.registerBuffers(&txBuffers, 1)) {
+		std::cerr << "[CAN " << m_interfaceName << "] io_uring not available --> classic I/O" << std::endl;
+		m_ring.closeUp();
+		return false;
+	}
+	m_ring.provideBuffers(m_ringRxFrames, sizeof(struct can_frame), CAN_RING_RX_BUFFERS, CAN_RING_BUFFER_GROUP, 0, CAN_RING_BUFFERS);
+	m_ring.read(m_wakeUpFd, &m_ringWakeUpValue, sizeof(m_ringWakeUpValue), CAN_RING_WAKE_UP);
+	m_ringRecvArmed = false;
+
+	std::cout << "[CAN " << m_interfaceName << "] Using io_uring I/O" << std::endl;
+	return true;
+}
+
+// classic path: waits with poll, then reads one frame (worker thread only). false if the socket failed
+bool CanBus::processSocketEvents(struct pollfd* pfds) {
+	pfds[0].fd = m_canSocket;
+	int ready = poll(pfds, 2, CAN_POLL_TIMEOUT);
+	countSyscalls();
+
+	// clear the wake up event
+	if(ready > 0 && (pfds[1].revents & POLLIN)) {
+		eventfd_t eventValue;
+		eventfd_read(m_wakeUpFd, &eventValue);
+		countSyscalls();
+	}
+
+	// new setpoints are sent before processing any received frame
+	deliverPendingCommands();
+
+	// pending socket error (e.g. network down) or socket no longer usable
+	if(ready > 0 && (pfds[0].revents & (POLLERR | POLLHUP | POLLNVAL))) {
+		int socketError = 0;
+		socklen_t errorLength = sizeof(socketError);
+		if((pfds[0].revents & POLLNVAL) || getsockopt(m_canSocket, SOL_SOCKET, SO_ERROR, &socketError, &errorLength) < 0) {
+			socketError = EBADF;
+		}
+		checkSocketError(socketError);
+		return false;
+	}
+
+	if(ready > 0 && (pfds[0].revents & POLLIN)) {
+		struct can_frame receivedCanFrame;
+
+		// read in message from CAN bus
+		int nbytes = read(m_canSocket, &receivedCanFrame, sizeof(can_frame));
+		countSyscalls();
+		if (nbytes < 0) {
+			checkSocketError(errno);
+			return false;
+		}
+		processFrame(receivedCanFrame);
+	}
+	return true;
+}
+
+// io_uring path: one syscall submits the queued frames and waits for completions. all received
+// frames are processed afterwards (worker thread only). false if the socket failed
+bool CanBus::processRingEvents() {
+	// multishot receive, re-armed after the socket was reopened or the buffers ran out
+	if(!m_ringRecvArmed) {
+		m_ring.recvMultishot(m_canSocket, CAN_RING_BUFFER_GROUP, CAN_RING_RECV | (static_cast<uint64_t>(m_ringSocketGeneration) << 8));
+		m_ringRecvArmed = true;
+	}
+
+	int ready = m_ring.submitAndWait(CAN_POLL_TIMEOUT);
+	if(ready < 0) {
+		std::cerr << "[CAN-thread " << m_interfaceName << "] io_uring failed: " << strerror(-ready) << " --> classic I/O" << std::endl;
+		m_ring.closeUp();
+		return true;
+	}
+
+	// new setpoints are queued before processing any received frame (sent with the next wait)
+	deliverPendingCommands();
+
+	struct io_uring_cqe cqe;
+	while(m_ring.popCompletion(cqe)) {
+		uint64_t slot = cqe.user_data >> 8;
+		switch(cqe.user_data & 0xFF) {
+			// wake up event consumed --> wait for the next one
+			case CAN_RING_WAKE_UP:
+				m_ring.read(m_wakeUpFd, &m_ringWakeUpValue, sizeof(m_ringWakeUpValue), CAN_RING_WAKE_UP);
+				break;
+
+			case CAN_RING_WRITE:
+				m_ringTxBusy &= ~(1u << slot);
+				if(cqe.res < 0) {
+					checkSocketError(-cqe.res);
+				}
+				break;
+
+			case CAN_RING_RECV:
+			{
+				// completions of the receive on a closed socket only return their buffer
+				bool current = slot == m_ringSocketGeneration;
+				if(current && !(cqe.flags & IORING_CQE_F_MORE)) {
+					m_ringRecvArmed = false;
+				}
+				if(cqe.flags & IORING_CQE_F_BUFFER) {
+					unsigned bufferId = cqe.flags >> IORING_CQE_BUFFER_SHIFT;
+					struct can_frame receivedCanFrame = m_ringRxFrames[bufferId];
+					m_ring.provideBuffers(&m_ringRxFrames[bufferId], sizeof(struct can_frame), 1, CAN_RING_BUFFER_GROUP, bufferId, CAN_RING_BUFFERS);
+					if(current && cqe.res == sizeof(struct can_frame)) {
+						processFrame(receivedCanFrame);
+					}
+				}
+
+				// multishot receive not supported (kernel < 6.0)
+				if(current && cqe.res == -EINVAL) {
+					std::cerr << "[CAN-thread " << m_interfaceName << "] io_uring multishot receive not supported --> classic I/O" << std::endl;
+					m_ring.closeUp();
+					return true;
+				}
+				if(current && cqe.res < 0 && cqe.res != -ENOBUFS && cqe.res != -ECANCELED) {
+					checkSocketError(-cqe.res);
+				}
+				break;
+			}
+
+			default:
+				break;
+		}
+	}
+	return !m_socketFailed;
+}
+
+// dispatches a received frame by its type (worker thread only)
+void CanBus::processFrame(const struct can_frame& receivedCanFrame) {
+	m_rxFrames.fetch_add(1, std::memory_order_relaxed);
+
+	// error frames are delivered with the error flag set in the id
+	if(receivedCanFrame.can_id & CAN_ERR_FLAG) {
+		processErrorFrame(receivedCanFrame);
+		return;
+	}
+
+	// Detect message type
+	switch (receivedCanFrame.can_id & 0x1FFFFFFF) {
+		// status report message
+		case 0x1081407F:
+			traceInstant("can_status", receivedCanFrame.data[1]);
+			updateLocalParams((uint8_t*)&receivedCanFrame.data);
+			m_owner->notifyStatusFrame();
+			break;
+
+		// ...
+		case 0x1081D27F:
+			// r4850_description((uint8_t *)&frame.data);
+			// ...
+			break;
+
+		// command acknowledge message
+		case 0x1081807E:
+			traceInstant("can_ack", receivedCanFrame.data[1]);
+			// Acknowledgement //
+			processAckFrame((uint8_t*)&receivedCanFrame.data);
+			break;
+
+		// unknown message type
+		default:
+			// status report of a PSU with another address. only one PSU per interface is supported
+			if(((receivedCanFrame.can_id & 0x1FFFFFFF) & 0xFF80FFFF) == 0x1080407F && !m_secondPsuWarned) {
+				std::cerr << "[CAN-thread " << m_interfaceName << "] Second PSU (address " << ((receivedCanFrame.can_id >> 16) & 0x7F)
+							<< ") on this interface --> not supported, use one interface per PSU" << std::endl;
+				m_secondPsuWarned = true;
+			}
+			// printf("Unknown frame 0x%03X [%d] ", (recvFrame.can_id & 0x1FFFFFFF), recvFrame.can_dlc);
+			break;
+	}
+}
+
+// let the kernel deliver error frames for controller state changes and bus-off
+bool CanBus::subscribeErrorFrames() {
+	can_err_mask_t errorMask = CAN_ERR_TX_TIMEOUT | CAN_ERR_CRTL | CAN_ERR_BUSOFF | CAN_ERR_BUSERROR | CAN_ERR_RESTARTED;
+	if(setsockopt(m_canSocket, SOL_CAN_RAW, CAN_RAW_ERR_FILTER, &errorMask, sizeof(errorMask)) < 0) {
+		std::cerr << "Failed to subscribe to error frames on " << m_interfaceName << "!" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// decides whether a read/write error is fatal for the socket (worker thread only)
+void CanBus::checkSocketError(int error) {
+	switch(error) {
+		// transient errors, e.g. TX queue full while no PSU acknowledges frames (slot detect off)
+		case 0:
+		case EAGAIN:
+		case EINTR:
+		case ENOBUFS:
+			return;
+
+		// the interface went down or was removed --> reopen the socket
+		case ENETDOWN:
+		case ENODEV:
+		case ENXIO:
+		case EBADF:
+		default:
+			break;
+	}
+
+	if(!m_socketFailed) {
+		std::cerr << "[CAN-thread " << m_interfaceName << "] Socket failed: " << strerror(error) << " --> reopen" << std::endl;
+		if(m_metrics.state != CAN_STATE_BUS_OFF) {
+			m_faultTime = steady_clock::now();
+		}
+		m_socketFailed = true;
+		setBusState(CAN_STATE_DOWN);
+
+		const std::lock_guard<std::mutex> lock(m_paramsMutex);
+		m_metrics.socketFailures++;
+	}
+}
+
+// reopens the failed socket with bounded backoff. Returns after success or on stop signal (worker thread only)
+void CanBus::recoverSocket() {
+	// the ring holds a reference to the socket --> stop the receive before closing it
+	if(m_ring.isActive() && m_ringRecvArmed) {
+		m_ring.cancel(CAN_RING_RECV | (static_cast<uint64_t>(m_ringSocketGeneration) << 8));
+		m_ring.submitAndWait(0);
+		m_ringRecvArmed = false;
+	}
+	m_ringSocketGeneration++;
+
+	if(m_canSocket >= 0) {
+		close(m_canSocket);
+		m_canSocket = -1;
+	}
+
+	long backoff = CAN_RECOVERY_MIN_BACKOFF;
+	while(m_threadRunning) {
+		if(openSocket()) {
+			m_socketFailed = false;
+			finishRecovery();
+			return;
+		}
+
+		// wait in short steps to stay responsive to the stop signal
+		auto retryTime = steady_clock::now() + milliseconds(backoff);
+		while(m_threadRunning && steady_clock::now() < retryTime) {
+			std::this_thread::sleep_for(milliseconds(CAN_POLL_TIMEOUT));
+		}
+		backoff = std::min(backoff * 2, static_cast<long>(CAN_RECOVERY_MAX_BACKOFF));
+	}
+}
+
+// evaluates a received error frame (worker thread only)
+void CanBus::processErrorFrame(const struct can_frame& frame) {
+	{
+		const std::lock_guard<std::mutex> lock(m_paramsMutex);
+		m_metrics.errorFrames++;
+		if(frame.can_id & CAN_ERR_CNT) {
+			m_metrics.txErrorCounter = frame.data[6];
+			m_metrics.rxErrorCounter = frame.data[7];
+		}
+	}
+
+	if(frame.can_id & CAN_ERR_BUSOFF) {
+		if(m_metrics.state != CAN_STATE_BUS_OFF) {
+			std::cerr << "[CAN-thread " << m_interfaceName << "] Controller is bus-off (auto restart requires restart-ms on the interface)" << std::endl;
+			m_faultTime = steady_clock::now();
+			setBusState(CAN_STATE_BUS_OFF);
+
+			const std::lock_guard<std::mutex> lock(m_paramsMutex);
+			m_metrics.busOffCount++;
+		}
+		return;
+	}
+
+	// controller restarted after bus-off --> usable again, setpoints need to be resent
+	if(frame.can_id & CAN_ERR_RESTARTED) {
+		setBusState(CAN_STATE_ACTIVE);
+		finishRecovery();
+		return;
+	}
+
+	if(frame.can_id & CAN_ERR_CRTL) {
+		if(frame.data[1] & (CAN_ERR_CRTL_RX_PASSIVE | CAN_ERR_CRTL_TX_PASSIVE)) {
+			setBusState(CAN_STATE_PASSIVE);
+		} else if(frame.data[1] & (CAN_ERR_CRTL_RX_WARNING | CAN_ERR_CRTL_TX_WARNING)) {
+			setBusState(CAN_STATE_WARNING);
+		} else if(frame.data[1] & CAN_ERR_CRTL_ACTIVE) {
+			setBusState(CAN_STATE_ACTIVE);
+		}
+	}
+}
+
+const char* getBusStateName(CanBusState state) {
+	switch(state) {
+		case CAN_STATE_ACTIVE:	return "error-active";
+		case CAN_STATE_WARNING:	return "error-warning";
+		case CAN_STATE_PASSIVE:	return "error-passive";
+		case CAN_STATE_BUS_OFF:	return "bus-off";
+		case CAN_STATE_DOWN:	return "down";
+	}
+	return "unknown";
+}
+
+void CanBus::setBusState(CanBusState state) {
+	const std::lock_guard<std::mutex> lock(m_paramsMutex);
+	if(m_metrics.state != state) {
+		std::cout << "[CAN-thread " << m_interfaceName << "] Bus state " << getBusStateName(m_metrics.state) << " --> " << getBusStateName(state) << std::endl;
+		m_metrics.state = state;
+	}
+}
+
+// bus usable again --> record the time to recover and resend the last setpoints (worker thread only)
+void CanBus::finishRecovery() {
+	long recoveryTime = duration_cast<milliseconds>(steady_clock::now() - m_faultTime).count();
+	setBusState(CAN_STATE_ACTIVE);
+	{
+		const std::lock_guard<std::mutex> lock(m_paramsMutex);
+		m_metrics.recoveries++;
+		m_metrics.lastRecoveryTime = recoveryTime;
+		m_metrics.maxRecoveryTime = std::max(m_metrics.maxRecoveryTime, recoveryTime);
+	}
+	std::cout << "[CAN-thread " << m_interfaceName << "] Recovered after " << recoveryTime << "ms --> resend last setpoints" << std::endl;
+
+	if(m_lastVoltageCmd > 0.0f) {
+		sendVoltageFrame(m_lastVoltageCmd, false);
+	}
+	sendCurrentFrame(m_lastCurrentCmd, false);
+	requestStatusData();
+}
+
+// sends the setpoints handed over by the controller (worker thread only)
+void CanBus::deliverPendingCommands() {
+	float voltage = 0.0f, current = 0.0f;
+	bool voltageNonvolatile = false, currentNonvolatile = false;
+	bool voltagePending = false, currentPending = false;
+	{
+		const std::lock_guard<std::mutex> lock(m_cmdMutex);
+		voltage = m_voltageCmd;
+		current = m_currentCmd;
+		voltageNonvolatile = m_voltageNonvolatile;
+		currentNonvolatile = m_currentNonvolatile;
+		voltagePending = m_voltagePending;
+		currentPending = m_currentPending;
+		m_voltagePending = false;
+		m_currentPending = false;
+	}
+
+	if(voltagePending) {
+		sendVoltageFrame(voltage, voltageNonvolatile);
+		m_lastVoltageCmd = voltage;
+	}
+
+	if(currentPending) {
+		// reset command acknowledgement flag if target current has changed
+		if(current != m_lastCurrentCmd) {
+			m_cmdAckFlag = false;
+		}
+		sendCurrentFrame(current, currentNonvolatile);
+		m_lastCurrentCmd = current;
+	}
+}
+
+bool CanBus::sendVoltageFrame(float voltage, bool nonvolatile) {
+	struct can_frame dataFrameToSend;
+	uint16_t value = voltage * 1024;
+	uint8_t volatilityFlag;
+
+	// set volatility flag
+	if (nonvolatile) volatilityFlag = 0x01;	// Off-line mode
+	else		 volatilityFlag = 0x00;	// On-line mode
+
+	// construct CAN message frame
+	dataFrameToSend.can_id = 0x108180FE | CAN_EFF_FLAG;
+	dataFrameToSend.can_dlc = 8;
+	dataFrameToSend.data[0] = 0x01;
+	dataFrameToSend.data[1] = volatilityFlag;
+	dataFrameToSend.data[2] = 0x00;
+	dataFrameToSend.data[3] = 0x00;
+	dataFrameToSend.data[4] = 0x00;
+	dataFrameToSend.data[5] = 0x00;
+	dataFrameToSend.data[6] = (value & 0xFF00) >> 8;		// first the higher byte
+	dataFrameToSend.data[7] = value & 0xFF;				// then the lower one
+
+	// send the message frame
+	if(!sendCanFrame(dataFrameToSend)) {
+		std::cerr << "Failed to send voltage command on " << m_interfaceName << "!" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool CanBus::sendCurrentFrame(float current, bool nonvolatile) {
+	struct can_frame dataFrameToSend;
+	uint16_t value = current * MAX_CURRENT_MULTIPLIER;
+	uint8_t volatilityFlag;
+
+	// set volatility flag
+	if (nonvolatile) volatilityFlag = 0x04;					// Off-line mode
+	else		 volatilityFlag = 0x03;						// On-line mode
+
+	// construct CAN message frame
+	dataFrameToSend.can_id = 0x108180FE | CAN_EFF_FLAG;
+	dataFrameToSend.can_dlc = 8;
+	dataFrameToSend.data[0] = 0x01;
+	dataFrameToSend.data[1] = volatilityFlag;
+	dataFrameToSend.data[2] = 0x00;
+	dataFrameToSend.data[3] = 0x00;
+	dataFrameToSend.data[4] = 0x00;
+	dataFrameToSend.data[5] = 0x00;
+	dataFrameToSend.data[6] = (value & 0xFF00) >> 8;		// first the higher bytes
+	dataFrameToSend.data[7] = value & 0xFF;					// then the lower one
+
+	// send the message frame
+	if(!sendCanFrame(dataFrameToSend)) {
+		std::cerr << "Failed to send current command on " << m_interfaceName << "!" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool CanBus::requestStatusData() {
+	struct can_frame requestFrame;
+
+	// construct CAN message frame
+	requestFrame.can_id = 0x108040FE | CAN_EFF_FLAG;
+	// 0x108140FE also works
+	requestFrame.can_dlc = 8;
+	requestFrame.data[0] = 0;
+	requestFrame.data[1] = 0;
+	requestFrame.data[2] = 0;
+	requestFrame.data[3] = 0;
+	requestFrame.data[4] = 0;
+	requestFrame.data[5] = 0;
+	requestFrame.data[6] = 0;
+	requestFrame.data[7] = 0;
+
+	// send the message frame
+	if(!sendCanFrame(requestFrame)) {
+		std::cerr << "Failed to send status request command on " << m_interfaceName << "!" << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+// generic helper method for sending out CAN frames
+bool CanBus::sendCanFrame(struct can_frame frame) {
+	TraceScope span("can_write");
+
+	// io_uring: copy into a free registered slot, sent in a batch with the next wait of the worker
+	if(m_ring.isActive() && m_ringTxBusy != (1u << CAN_RING_TX_SLOTS) - 1) {
+		unsigned slot = __builtin_ctz(~m_ringTxBusy);
+		m_ringTxFrames[slot] = frame;
+		if(m_ring.writeFixed(m_canSocket, &m_ringTxFrames[slot], sizeof(can_frame), 0, CAN_RING_WRITE | (slot << 8))) {
+			m_ringTxBusy |= 1u << slot;
+			m_txFrames.fetch_add(1, std::memory_order_relaxed);
+			span.end(frame.data[1]);
+			return true;
+		}
+	}
+
+	// write out frame to the can bus
+	countSyscalls();
+	if (write(m_canSocket, &frame, sizeof(can_frame)) != sizeof(can_frame)) {
+		checkSocketError(errno);
+		return false;
+	}
+	m_txFrames.fetch_add(1, std::memory_order_relaxed);
+	span.end(frame.data[1]);
+	return true;
+}
+
+// processes a received status frame from the PSU
+void CanBus::updateLocalParams(uint8_t *frame) {
+	// decode and store value in payload of message frame
+	uint32_t value = __builtin_bswap32(*(uint32_t *)&frame[4]);
+	bool statusComplete = false;
+	float ampHours = 0.0f, outputVoltage = 0.0f;
+
+	// decode message frame and update local rectifier parameters accordingly
+	{
+		const std::lock_guard<std::mutex> lock(m_paramsMutex);
+		switch (frame[1]) {
+
+			// input related //
+			case R48xx_DATA_INPUT_POWER:
+			{
+				m_rectifierParams.input_power = value / 1024.0f;
+				break;
+			}
+
+			case R48xx_DATA_INPUT_FREQ:
+			{
+				m_rectifierParams.input_frequency = value / 1024.0f;
+				break;
+			}
+
+			case R48xx_DATA_INPUT_VOLTAGE:
+			{
+				m_rectifierParams.input_voltage = value / 1024.0f;
+				break;
+			}
+
+			case R48xx_DATA_INPUT_CURRENT:
+			{
+				m_rectifierParams.input_current = value / 1024.0f;
+				break;
+			}
+
+			case R48xx_DATA_INPUT_TEMPERATURE:
+			{
+				m_rectifierParams.input_temp = value / 1024.0f;
+				break;
+			}
+
+			// output related //
+			case R48xx_DATA_OUTPUT_POWER:
+			{
+				m_rectifierParams.output_power = value / 1024.0f;
+				break;
+			}
+
+			case R48xx_DATA_EFFICIENCY:
+			{
+				m_rectifierParams.efficiency = value / 1024.0f;
+				break;
+			}
+
+			case R48xx_DATA_OUTPUT_VOLTAGE:
+			{
+				m_rectifierParams.output_voltage = value / 1024.0f;
+				break;
+			}
+
+			case R48xx_DATA_OUTPUT_CURRENT1:		// --> alternative current measurement
+			{
+				// printf("Output Current(1) %.02fA\r\n", value / 1024.0);
+				// rp->output_current = value / 1024.0;
+				break;
+			}
+
+			case R48xx_DATA_OUTPUT_CURRENT:			// --> usually received at last
+			{
+				m_rectifierParams.output_current = value / 1024.0f;
+
+				// integrate the output current over the time since the last status report (coulomb counting)
+				auto currentTime = steady_clock::now();
+				float hoursElapsed = duration_cast<milliseconds>(currentTime - m_lastOutputCurrentTime).count() / 3600000.0f;
+				m_lastOutputCurrentTime = currentTime;
+				if(hoursElapsed * 3600.0f < MAX_INTEGRATION_GAP) {
+					ampHours = m_rectifierParams.output_current * hoursElapsed;
+					m_rectifierParams.amp_hour += ampHours;
+				}
+				outputVoltage = m_rectifierParams.output_voltage;
+				statusComplete = true;
+				break;
+			}
+
+			case R48xx_DATA_OUTPUT_CURRENT_MAX:
+			{
+				m_rectifierParams.max_output_current = value / static_cast<float>(MAX_CURRENT_MULTIPLIER);
+				break;
+			}
+
+			case R48xx_DATA_OUTPUT_TEMPERATURE:
+			{
+				m_rectifierParams.output_temp = value / 1024.0f;
+				break;
+			}
+
+			default:
+			{
+				// printf("Unknown parameter 0x%02X, 0x%04X\r\n",frame[1], value);
+				break;
+			}
+
+		}
+	}
+
+	// full status report received --> update the battery state (without holding the params lock)
+	if(statusComplete) {
+		m_owner->updateBatteryState(ampHours, ampHours * outputVoltage);
+		#ifdef _VERBOSE_OUTPUT
+			this->printParams();
+		#endif
+	}
+}
+
+// process an acknowledge frame from the PSU
+void CanBus::processAckFrame(uint8_t *frame) {
+	// decode error flag and
+	bool error = frame[0] & 0x20;
+	uint32_t value = __builtin_bswap32(*(uint32_t*)&frame[4]);
+
+	switch (frame[1]) {
+		case 0x00:
+		{
+			printf("[%s] %s setting online voltage to %.02fV\n", m_interfaceName.c_str(), error ? "Error" : "Success", value / 1024.0);
+			break;
+		}
+
+		case 0x01:
+		{
+			printf("[%s] %s setting non-volatile (offline) voltage to %.02fV\n", m_interfaceName.c_str(), error ? "Error" : "Success", value / 1024.0);
+			break;
+		}
+
+		case 0x02:
+		{
+			printf("[%s] %s setting overvoltage protection to %.02fV\n", m_interfaceName.c_str(), error ? "Error" : "Success", value / 1024.0);
+			break;
+		}
+
+		case 0x03:
+		{
+			float currentAck = static_cast<float>(value) / MAX_CURRENT_MULTIPLIER;
+			if(m_cmdAckFlag == false && currentAck == m_lastCurrentCmd) {
+				printf("[%s] %s setting online current to %.02fA\n", m_interfaceName.c_str(), error ? "Error" : "Success", currentAck);
+				m_cmdAckFlag = true;
+			}
+			break;
+		}
+
+		case 0x04:
+		{
+			printf("[%s] %s setting non-volatile (offline) current to %.02fA\n", m_interfaceName.c_str(), error ? "Error" : "Success", static_cast<float>(value) / MAX_CURRENT_MULTIPLIER);
+			break;
+		}
+
+		default:
+		{
+			printf("[%s] %s setting unknown parameter (0x%02X)\n", m_interfaceName.c_str(), error ? "Error" : "Success", frame[1]);
+		}
+	}
+}
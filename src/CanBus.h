@@ -0,0 +1,217 @@
+/*
+	File: CanBus.h
+	A CanBus handles the CAN communication with the rectifier(s) on one CAN interface.
+	Every bus owns its socket, worker thread and telemetry, so a busy or erroring bus
+	never stalls the command delivery on another one
+
+	Code from original repository: https://github.com/craigpeacock/Huawei_R4850G2_CAN
+	Edited by Elias Geiger
+*/
+
+#pragma once
+
+// Includes
+#include <iostream>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <chrono>
+
+#include <unistd.h>
+#include <poll.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/eventfd.h>
+
+#include <linux/can.h>
+#include <linux/can/raw.h>
+#include <linux/can/error.h>
+
+#include "Trace.h"
+#include "SelfProfile.h"
+#include "IoRing.h"
+
+using std::chrono::steady_clock;
+using std::chrono::milliseconds;
+using std::chrono::duration_cast;
+
+// config variables ---------------------
+#define MAX_CURRENT_MULTIPLIER		20
+#define R48xx_DATA_INPUT_POWER		0x70
+#define R48xx_DATA_INPUT_FREQ		0x71
+#define R48xx_DATA_INPUT_CURRENT	0x72
+#define R48xx_DATA_OUTPUT_POWER		0x73
+#define R48xx_DATA_EFFICIENCY		0x74
+#define R48xx_DATA_OUTPUT_VOLTAGE	0x75
+#define R48xx_DATA_OUTPUT_CURRENT_MAX	0x76
+#define R48xx_DATA_INPUT_VOLTAGE	0x78
+#define R48xx_DATA_OUTPUT_TEMPERATURE	0x7F
+#define R48xx_DATA_INPUT_TEMPERATURE	0x80
+#define R48xx_DATA_OUTPUT_CURRENT	0x81
+#define R48xx_DATA_OUTPUT_CURRENT1	0x82
+
+// telemetry of a bus without a complete status report for this long is ignored (PSU off or bus failed)
+#define CAN_TELEMETRY_TIMEOUT		5000	// in milliseconds
+
+// max time the worker waits for frames before it checks for pending commands and timers
+#define CAN_POLL_TIMEOUT			100		// in milliseconds
+
+// backoff between the attempts to reopen a failed CAN socket (doubled after every attempt)
+#define CAN_RECOVERY_MIN_BACKOFF	100		// in milliseconds
+#define CAN_RECOVERY_MAX_BACKOFF	5000	// in milliseconds
+
+// time the kernel gets for restarting the controller after bus-off (restart-ms) before the socket is reopened
+#define CAN_BUSOFF_RESTART_TIMEOUT	2000	// in milliseconds
+
+// io_uring backend: queue size, receive buffers provided to the kernel and registered write slots (max 32)
+#define CAN_RING_ENTRIES			64
+#define CAN_RING_RX_BUFFERS			16
+#define CAN_RING_TX_SLOTS			16
+#define CAN_RING_BUFFER_GROUP		1
+// ---------------------------------------
+
+// struct represents a state including all parameters of the PSU
+struct RectifierParameters
+{
+	float input_voltage;
+	float input_frequency;
+	float input_current;
+	float input_power;
+	float input_temp;
+	float efficiency;
+	float output_voltage;
+	float output_current;
+	float max_output_current;
+	float output_power;
+	float output_temp;
+	float amp_hour;
+};
+
+// error state of the CAN controller, reported by error frames
+enum CanBusState
+{
+	CAN_STATE_ACTIVE,
+	CAN_STATE_WARNING,
+	CAN_STATE_PASSIVE,
+	CAN_STATE_BUS_OFF,
+	CAN_STATE_DOWN			// socket failed (e.g. interface down) --> reopen pending
+};
+
+// error counters and recovery statistics of one bus
+struct CanBusMetrics
+{
+	CanBusState state;
+	unsigned int errorFrames;
+	unsigned int busOffCount;
+	unsigned int socketFailures;
+	unsigned int recoveries;
+	uint8_t txErrorCounter;
+	uint8_t rxErrorCounter;
+	long lastRecoveryTime;		// time to recover in ms
+	long maxRecoveryTime;		// in ms
+	unsigned long rxFrames;
+	unsigned long txFrames;
+};
+
+const char* getBusStateName(CanBusState);
+
+// request types of the io_uring backend (lowest byte of the user data, the rest is a slot or socket generation)
+enum CanRingRequest
+{
+	CAN_RING_RECV = 1,
+	CAN_RING_WAKE_UP,
+	CAN_RING_WRITE,
+	CAN_RING_BUFFERS
+};
+
+class PsuController;
+
+class CanBus
+{
+	std::string m_interfaceName;
+	PsuController* m_owner;
+
+	// CAN related
+	struct sockaddr_can m_addr;
+	std::atomic<int> m_canSocket;
+	struct ifreq m_ifr;
+
+	std::thread m_workerTh;
+	std::atomic<bool> m_threadRunning;
+	int m_wakeUpFd;
+
+	// stores latest state of the PSU params
+	mutable std::mutex m_paramsMutex;
+	struct RectifierParameters m_rectifierParams;
+	steady_clock::time_point m_lastOutputCurrentTime;
+	struct CanBusMetrics m_metrics;
+	std::atomic<unsigned long> m_rxFrames, m_txFrames;		// counted without the lock (every frame)
+
+	// setpoints handed over to the worker thread (only the latest one counts)
+	std::mutex m_cmdMutex;
+	float m_voltageCmd, m_currentCmd;
+	bool m_voltageNonvolatile, m_currentNonvolatile;
+	bool m_voltagePending, m_currentPending;
+
+	// worker thread only
+	float m_lastCurrentCmd;
+	float m_lastVoltageCmd;
+	bool m_cmdAckFlag;
+	bool m_socketFailed;
+	bool m_secondPsuWarned;
+	steady_clock::time_point m_faultTime;
+
+	// optional io_uring backend (worker thread only)
+	IoRing m_ring;
+	struct can_frame m_ringRxFrames[CAN_RING_RX_BUFFERS];
+	struct can_frame m_ringTxFrames[CAN_RING_TX_SLOTS];
+	uint32_t m_ringTxBusy;
+	eventfd_t m_ringWakeUpValue;
+	bool m_ringRecvArmed;
+	uint32_t m_ringSocketGeneration;
+
+public:
+	CanBus(const std::string&, PsuController*);
+	~CanBus();
+
+	bool setup(int, bool);
+	void shutdown();
+	void restoreParams(const RectifierParameters&);
+	void printParams() const;
+	void setMaxVoltage(float, bool);
+	void setMaxCurrent(float, bool);
+
+	// getters //
+	const char* getInterfaceName() const;
+	int getSocket() const;
+	RectifierParameters getParams() const;
+	CanBusMetrics getMetrics() const;
+	bool isReporting() const;
+
+private:
+	// helper methods //
+	bool openSocket();
+	bool setupRing();
+	bool processSocketEvents(struct pollfd*);
+	bool processRingEvents();
+	void processFrame(const struct can_frame&);
+	bool subscribeErrorFrames();
+	void recoverSocket();
+	void checkSocketError(int);
+	void processErrorFrame(const struct can_frame&);
+	void setBusState(CanBusState);
+	void finishRecovery();
+	void deliverPendingCommands();
+	bool sendVoltageFrame(float, bool);
+	bool sendCurrentFrame(float, bool);
+	bool requestStatusData();
+	bool sendCanFrame(struct can_frame);
+	void updateLocalParams(uint8_t*);
+	void processAckFrame(uint8_t*);
+};
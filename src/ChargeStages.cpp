@@ -0,0 +1,178 @@
+/*
+    File: ChargeStages.cpp
+    written by Elias Geiger
+*/
+
+#include "ChargeStages.h"
+
+// constructor
+ChargeStages::ChargeStages(const ChargeStageSettings& settings) {
+    m_settings = settings;
+    m_stage = CHARGE_STAGE_BULK;
+    m_initialized = false;
+    m_lastUpdateTime = 0;
+    m_holdSeconds = 0.0f;
+    m_stageSeconds = 0.0f;
+    m_tailSeconds = 0.0f;
+    m_lowSeconds = 0.0f;
+    m_temperature = NAN;
+    m_lastEqualizeTime = time(NULL);        // not known yet --> first equalisation after one interval
+}
+
+// takes the latest PSU telemetry (output voltage and current, last current command) and the battery
+// temperature (NAN = unknown) and moves on to the next stage when the current one is completed
+void ChargeStages::update(float outputVoltage, float outputCurrent, float currentCmd, float temperature, long long timeMs) {
+    float seconds = m_initialized ? (timeMs - m_lastUpdateTime) / 1000.0f : 0.0f;
+    if(seconds < 0.0f || seconds > CHARGE_MAX_UPDATE_GAP) {
+        seconds = 0.0f;
+    }
+    m_lastUpdateTime = timeMs;
+    m_initialized = true;
+    m_temperature = temperature;
+
+    // no status report yet
+    if(outputVoltage <= 0.0f) {
+        return;
+    }
+
+    float target = getTargetVoltage();
+    bool atVoltage = outputVoltage >= target - CHARGE_VOLTAGE_MARGIN;
+    if(currentCmd > 0.0f) {
+        m_stageSeconds += seconds;
+    }
+    if(atVoltage) {
+        m_holdSeconds += seconds;
+    }
+
+    switch(m_stage) {
+        case CHARGE_STAGE_BULK:
+            if(atVoltage) {
+                enterStage(CHARGE_STAGE_ABSORPTION, "absorption voltage reached");
+            }
+            break;
+
+        case CHARGE_STAGE_ABSORPTION:
+        {
+            // a low current only tells the battery is full if the PSU limits it (not the regulator)
+            bool tail = atVoltage && outputCurrent <= m_settings.tailCurrent
+                        && currentCmd >= outputCurrent + CHARGE_TAIL_COMMAND_MARGIN;
+            m_tailSeconds = tail ? m_tailSeconds + seconds : 0.0f;
+
+            const char* reason = NULL;
+            if(m_tailSeconds >= CHARGE_TAIL_TIME) {
+                reason = "current tailed off";
+            } else if(m_holdSeconds >= m_settings.absorptionTime) {
+                reason = "absorption time elapsed";
+            }
+            if(reason != NULL) {
+                if(isEqualizeDue()) {
+                    enterStage(CHARGE_STAGE_EQUALIZE, reason);
+                } else {
+                    enterStage(CHARGE_STAGE_FLOAT, reason);
+                }
+            }
+            break;
+        }
+
+        case CHARGE_STAGE_EQUALIZE:
+            if(m_holdSeconds >= m_settings.equalizeTime || m_stageSeconds >= m_settings.equalizeTime * CHARGE_EQUALIZE_TIMEOUT_FACTOR) {
+                m_lastEqualizeTime = time(NULL);
+                enterStage(CHARGE_STAGE_FLOAT, m_holdSeconds >= m_settings.equalizeTime ? "equalize time elapsed" : "equalize voltage not reached");
+            }
+            break;
+
+        case CHARGE_STAGE_FLOAT:
+            m_lowSeconds = outputVoltage < target - CHARGE_REBULK_OFFSET ? m_lowSeconds + seconds : 0.0f;
+            if(m_lowSeconds >= CHARGE_REBULK_TIME) {
+                enterStage(CHARGE_STAGE_BULK, "battery discharged");
+            }
+            break;
+    }
+}
+
+// voltage for the PSU in the current stage, temperature compensated and within the PSU range
+float ChargeStages::getTargetVoltage() const {
+    float voltage = m_settings.absorptionVoltage;
+    if(m_stage == CHARGE_STAGE_FLOAT) {
+        voltage = m_settings.floatVoltage;
+    } else if(m_stage == CHARGE_STAGE_EQUALIZE) {
+        voltage = m_settings.equalizeVoltage;
+    }
+
+    if(!std::isnan(m_temperature) && m_settings.temperatureCompensation != 0.0f) {
+        float temperature = m_temperature < CHARGE_TEMP_MIN ? CHARGE_TEMP_MIN : (m_temperature > CHARGE_TEMP_MAX ? CHARGE_TEMP_MAX : m_temperature);
+        voltage += m_settings.temperatureCompensation * (temperature - CHARGE_TEMP_REFERENCE);
+    }
+    return voltage < PSU_MIN_VOLTAGE ? PSU_MIN_VOLTAGE : (voltage > PSU_MAX_VOLTAGE ? PSU_MAX_VOLTAGE : voltage);
+}
+
+// max charge power with the current cap of the stage (float, equalize), never below the min charge power
+short ChargeStages::getPowerLimit(short maxChargePower, short minChargePower, float outputVoltage) const {
+    float maxCurrent = 0.0f;
+    if(m_stage == CHARGE_STAGE_FLOAT) {
+        maxCurrent = m_settings.floatMaxCurrent;
+    } else if(m_stage == CHARGE_STAGE_EQUALIZE) {
+        maxCurrent = m_settings.equalizeMaxCurrent;
+    }
+    if(maxCurrent <= 0.0f || outputVoltage <= 0.0f) {
+        return maxChargePower;
+    }
+
+    // AC input power of the capped current (inverse of calculateCurrentBasedOnPower)
+    float dcPower = maxCurrent * outputVoltage;
+    float efficiency = getExpectedEfficiency(dcPower);
+    float limit = efficiency > 0.0f ? dcPower / (0.9876f * efficiency) : 0.0f;
+    if(limit >= maxChargePower) {
+        return maxChargePower;
+    }
+    return limit > minChargePower ? static_cast<short>(limit) : minChargePower;
+}
+
+void ChargeStages::getState(ChargeStageState& state) const {
+    state.stage = m_stage;
+    state.holdSeconds = m_holdSeconds;
+    state.lastEqualizeTime = m_lastEqualizeTime;
+}
+
+// restores the time of the last equalisation, the stage only if the state is recent (warm start)
+void ChargeStages::restoreState(const ChargeStageState& state, bool resumeStage) {
+    if(state.lastEqualizeTime > 0) {
+        m_lastEqualizeTime = static_cast<time_t>(state.lastEqualizeTime);
+    }
+    if(resumeStage && state.stage >= CHARGE_STAGE_BULK && state.stage <= CHARGE_STAGE_FLOAT) {
+        m_stage = static_cast<ChargeStage>(state.stage);
+        m_holdSeconds = state.holdSeconds;
+        printf("[Charge] Resumed in %s stage\n", getChargeStageName(m_stage));
+    }
+}
+
+// getters //
+ChargeStage ChargeStages::getStage() const {
+    return m_stage;
+}
+
+// private helper methods //
+void ChargeStages::enterStage(ChargeStage stage, const char* reason) {
+    printf("[Charge] %s --> %s (%s after %.0f min, %.2fV)\n", getChargeStageName(m_stage), getChargeStageName(stage),
+            reason, m_stageSeconds / 60.0f, getTargetVoltage());
+    traceInstant("charge_stage", stage);
+    m_stage = stage;
+    m_holdSeconds = 0.0f;
+    m_stageSeconds = 0.0f;
+    m_tailSeconds = 0.0f;
+    m_lowSeconds = 0.0f;
+}
+
+bool ChargeStages::isEqualizeDue() const {
+    return m_settings.equalizeEnabled && difftime(time(NULL), m_lastEqualizeTime) >= m_settings.equalizeInterval;
+}
+
+const char* getChargeStageName(ChargeStage stage) {
+    switch(stage) {
+        case CHARGE_STAGE_BULK: return "bulk";
+        case CHARGE_STAGE_ABSORPTION: return "absorption";
+        case CHARGE_STAGE_EQUALIZE: return "equalize";
+        case CHARGE_STAGE_FLOAT: return "float";
+    }
+    return "unknown";
+}
@@ -0,0 +1,116 @@
+/*
+    File: ChargeStages.h
+    Multi-stage charging with the voltage of the PSU: bulk (max current up to the absorption voltage),
+    absorption (the voltage is held until the current tails off, at most the absorption time), float
+    (lower voltage, the current is capped) and an optional periodic equalisation at a higher voltage.
+    Without it the PSU holds the battery at the absorption voltage all afternoon, which costs conversion
+    losses and stresses the cells. The voltages are compensated with the battery temperature if known
+
+    written by Elias Geiger
+*/
+
+#pragma once
+
+#include <cstdio>
+#include <cstdint>
+#include <cmath>
+#include <ctime>
+
+#include "default-conf.h"
+#include "Regulation.h"
+#include "Trace.h"
+
+// the battery is at the stage voltage within this margin (in volts)
+#define CHARGE_VOLTAGE_MARGIN 0.2f
+
+// absorption ends when the current stays below the tail current this long while the PSU limits it
+// (commanded at least this much more than delivered, otherwise the surplus is just low)
+#define CHARGE_TAIL_TIME 60.0f                  // in seconds
+#define CHARGE_TAIL_COMMAND_MARGIN 1.0f         // in ampere
+
+// back to bulk when the battery stays this far below the float voltage this long (loads discharged it)
+#define CHARGE_REBULK_OFFSET 1.0f               // in volts
+#define CHARGE_REBULK_TIME 60.0f                // in seconds
+
+// equalisation current as share of the battery capacity (C/20), ended after this multiple of the
+// equalize time even if the voltage was not reached (e.g. too little surplus)
+#define CHARGE_EQUALIZE_CURRENT_RATE 0.05f
+#define CHARGE_EQUALIZE_TIMEOUT_FACTOR 3.0f
+
+// temperature compensation relative to this temperature, the temperature is clamped to the range
+// and a reading older than the max age is not used (in degree celsius and seconds)
+#define CHARGE_TEMP_REFERENCE 25.0f
+#define CHARGE_TEMP_MIN 0.0f
+#define CHARGE_TEMP_MAX 45.0f
+#define CHARGE_TEMP_MAX_AGE 900
+
+// a new voltage is only sent if it differs at least this much from the last one (in volts)
+#define CHARGE_VOLTAGE_STEP 0.05f
+
+// updates further apart than this are not integrated (meter downtime) in seconds
+#define CHARGE_MAX_UPDATE_GAP 10.0f
+
+enum ChargeStage
+{
+    CHARGE_STAGE_BULK,
+    CHARGE_STAGE_ABSORPTION,
+    CHARGE_STAGE_EQUALIZE,
+    CHARGE_STAGE_FLOAT
+};
+
+// parameters of the stages (voltages at the reference temperature)
+struct ChargeStageSettings
+{
+    float absorptionVoltage = CHARGER_ABSORPTION_VOLTAGE;
+    float floatVoltage = CHARGER_FLOAT_VOLTAGE;
+    float equalizeVoltage = EQUALIZE_VOLTAGE;
+    float tailCurrent = BATTERY_TAIL_CURRENT;
+    float absorptionTime = ABSORPTION_TIME * 60.0f;     // in seconds
+    float floatMaxCurrent = FLOAT_MAX_CURRENT;
+    bool equalizeEnabled = EQUALIZE_ENABLED;
+    float equalizeTime = EQUALIZE_TIME * 60.0f;         // in seconds
+    long equalizeInterval = EQUALIZE_INTERVAL * 86400L; // in seconds
+    float equalizeMaxCurrent = BATTERY_CAPACITY * CHARGE_EQUALIZE_CURRENT_RATE;
+    float temperatureCompensation = CHARGE_TEMP_COMPENSATION / 1000.0f;     // in volts per degree celsius
+};
+
+// state kept across restarts (warm start)
+struct ChargeStageState
+{
+    int32_t stage;
+    float holdSeconds;
+    int64_t lastEqualizeTime;           // unix time
+};
+
+class ChargeStages
+{
+    ChargeStageSettings m_settings;
+
+    ChargeStage m_stage;
+    bool m_initialized;
+    long long m_lastUpdateTime;
+    float m_holdSeconds;                // time at the stage voltage
+    float m_stageSeconds;               // time in the stage while charging
+    float m_tailSeconds, m_lowSeconds;
+    float m_temperature;                // battery temperature (NAN = unknown)
+    time_t m_lastEqualizeTime;
+
+public:
+    ChargeStages(const ChargeStageSettings&);
+
+    void update(float, float, float, float, long long);
+    float getTargetVoltage() const;
+    short getPowerLimit(short, short, float) const;
+    void getState(ChargeStageState&) const;
+    void restoreState(const ChargeStageState&, bool);
+
+    // getters //
+    ChargeStage getStage() const;
+
+private:
+    void enterStage(ChargeStage, const char*);
+    bool isEqualizeDue() const;
+};
+
+// function prototypes
+const char* getChargeStageName(ChargeStage);
@@ -0,0 +1,135 @@
+/*
+    File: CommandMonitor.cpp
+    written by Elias Geiger
+*/
+
+#include "CommandMonitor.h"
+
+// constructor
+CommandMonitor::CommandMonitor(float chargeVoltage) {
+    m_chargeVoltage = chargeVoltage;
+    m_initialized = false;
+    m_lastUpdateTime = 0;
+    m_gapTime = 0.0f;
+    m_deliveredPower = 0.0f;
+    m_saturationStart = 0;
+    m_metrics.reason = SATURATION_NONE;
+    m_metrics.events = 0;
+    m_metrics.saturatedSeconds = 0.0f;
+    m_metrics.deliveredShare = 1.0f;
+}
+
+// takes the last charge command (AC power) and the latest PSU telemetry (AC input power, output voltage)
+void CommandMonitor::update(short commandedPower, float deliveredPower, float outputVoltage, long long timeMs) {
+    float seconds = m_initialized ? (timeMs - m_lastUpdateTime) / 1000.0f : 0.0f;
+    if(seconds < 0.0f || seconds > SATURATION_MAX_UPDATE_GAP) {
+        seconds = 0.0f;
+    }
+    m_lastUpdateTime = timeMs;
+    m_initialized = true;
+    m_deliveredPower = deliveredPower;
+
+    // not charging --> nothing to follow
+    if(commandedPower <= 0) {
+        m_gapTime = 0.0f;
+        if(isSaturated()) {
+            endSaturation(timeMs);
+        }
+        return;
+    }
+
+    float share = deliveredPower / commandedPower;
+    share = share > 1.0f ? 1.0f : (share < 0.0f ? 0.0f : share);
+    float alpha = seconds / SATURATION_DETECT_TIME;
+    m_metrics.deliveredShare += (alpha < 1.0f ? alpha : 1.0f) * (share - m_metrics.deliveredShare);
+
+    float gap = commandedPower - deliveredPower;
+    if(isSaturated()) {
+        m_metrics.saturatedSeconds += seconds;
+        if(gap < SATURATION_EXIT_GAP) {
+            endSaturation(timeMs);
+        }
+        return;
+    }
+
+    bool tooBig = gap > SATURATION_MIN_GAP && gap > SATURATION_GAP_RATIO * commandedPower;
+    m_gapTime = tooBig ? m_gapTime + seconds : 0.0f;
+    if(m_gapTime < SATURATION_DETECT_TIME) {
+        return;
+    }
+
+    if(deliveredPower < SATURATION_NO_RESPONSE_POWER) {
+        m_metrics.reason = SATURATION_NO_RESPONSE;
+    } else if(outputVoltage >= m_chargeVoltage - SATURATION_VOLTAGE_MARGIN) {
+        m_metrics.reason = SATURATION_CONSTANT_VOLTAGE;
+    } else {
+        m_metrics.reason = SATURATION_CURRENT_LIMIT;
+    }
+    m_metrics.events++;
+    m_saturationStart = timeMs;
+    printf("[Command] PSU delivers %.0fW of %dW for %.0fs (%s) --> hold the command\n",
+            deliveredPower, commandedPower, m_gapTime, getSaturationReasonName(m_metrics.reason));
+    traceInstant("saturation", m_metrics.reason);
+}
+
+// max charge power: just above the delivered power while saturated (at least the min charge power)
+short CommandMonitor::getPowerLimit(short maxChargePower, short minChargePower) const {
+    if(!isSaturated()) {
+        return maxChargePower;
+    }
+    int limit = static_cast<int>(m_deliveredPower) + SATURATION_PROBE_STEP;
+    limit = limit < minChargePower ? minChargePower : limit;
+    return limit < maxChargePower ? static_cast<short>(limit) : maxChargePower;
+}
+
+// idle time after a command in ms, stretched while saturated
+long long CommandMonitor::getIdleTime(long long idleTime) const {
+    return isSaturated() ? idleTime * SATURATION_IDLE_FACTOR : idleTime;
+}
+
+void CommandMonitor::printReport() const {
+    printf("[Command] %lu saturations, %.0fs saturated, %.0f%% of the commanded power delivered\n",
+            m_metrics.events, m_metrics.saturatedSeconds, m_metrics.deliveredShare * 100.0f);
+}
+
+// counters of the previous run (warm start)
+void CommandMonitor::restoreMetrics(unsigned long events, float saturatedSeconds) {
+    m_metrics.events = events;
+    m_metrics.saturatedSeconds = saturatedSeconds;
+}
+
+// the PSU voltage changed (charge stages)
+void CommandMonitor::setChargeVoltage(float chargeVoltage) {
+    m_chargeVoltage = chargeVoltage;
+}
+
+// getters //
+bool CommandMonitor::isSaturated() const {
+    return m_metrics.reason != SATURATION_NONE;
+}
+
+const CommandMonitorMetrics& CommandMonitor::getMetrics() const {
+    return m_metrics;
+}
+
+// private helper methods //
+void CommandMonitor::endSaturation(long long timeMs) {
+    printf("[Command] Saturation (%s) ended after %.0fs\n", getSaturationReasonName(m_metrics.reason),
+            (timeMs - m_saturationStart) / 1000.0f);
+    traceInstant("saturation", SATURATION_NONE);
+    m_metrics.reason = SATURATION_NONE;
+    m_gapTime = 0.0f;
+}
+
+const char* getSaturationReasonName(SaturationReason reason) {
+    switch(reason) {
+        case SATURATION_NO_RESPONSE:
+            return "no response";
+        case SATURATION_CONSTANT_VOLTAGE:
+            return "constant voltage";
+        case SATURATION_CURRENT_LIMIT:
+            return "current limit";
+        default:
+            return "none";
+    }
+}
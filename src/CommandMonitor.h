@@ -0,0 +1,88 @@
+/*
+    File: CommandMonitor.h
+    Effectiveness of the charge commands. An acknowledge only tells that the PSU accepted a setpoint,
+    not that it follows it: in the constant voltage phase, when the BMS limits the charge current or
+    when the PSU doesn't respond at all, the AC input power stays below the command and the regulator
+    keeps on commanding more. The monitor compares the commanded with the delivered power and detects
+    a persistent gap (saturation). While saturated the command is held just above the delivered power
+    (no wind-up, no overshoot when the limit is lifted) and commands are sent less often
+
+    written by Elias Geiger
+*/
+
+#pragma once
+
+#include <cstdio>
+
+#include "Trace.h"
+
+// a gap above this many watts and this share of the command for this long is a saturation
+#define SATURATION_MIN_GAP 60.0f
+#define SATURATION_GAP_RATIO 0.2f
+#define SATURATION_DETECT_TIME 15.0f            // in seconds
+
+// below this AC input power the PSU doesn't respond at all (in watts)
+#define SATURATION_NO_RESPONSE_POWER 10.0f
+
+// within this margin below the charge voltage the PSU is in the constant voltage phase
+#define SATURATION_VOLTAGE_MARGIN 0.3f
+
+// while saturated the command is held this much above the delivered power, the saturation ends
+// when the delivered power comes within the exit gap of the command (in watts)
+#define SATURATION_PROBE_STEP 50
+#define SATURATION_EXIT_GAP 25.0f
+
+// the idle time between two commands is stretched by this factor while saturated
+#define SATURATION_IDLE_FACTOR 3
+
+// updates further apart than this are not integrated (meter downtime) in seconds
+#define SATURATION_MAX_UPDATE_GAP 10.0f
+
+enum SaturationReason
+{
+    SATURATION_NONE,
+    SATURATION_NO_RESPONSE,             // no AC input power at all (PSU off, booting or failed)
+    SATURATION_CONSTANT_VOLTAGE,        // battery at the charge voltage, the current tails off
+    SATURATION_CURRENT_LIMIT            // below the charge voltage (BMS or PSU limits the current)
+};
+
+// counters of the monitor
+struct CommandMonitorMetrics
+{
+    SaturationReason reason;            // current state
+    unsigned long events;
+    float saturatedSeconds;
+    float deliveredShare;               // smoothed delivered share of the commanded power
+};
+
+class CommandMonitor
+{
+    float m_chargeVoltage;              // voltage the PSU is set to (absorption or the voltage of the charge stage)
+
+    bool m_initialized;
+    long long m_lastUpdateTime;
+    float m_gapTime;                    // time the gap is persistently too big in seconds
+    float m_deliveredPower;
+    long long m_saturationStart;
+    CommandMonitorMetrics m_metrics;
+
+public:
+    CommandMonitor(float);
+
+    void update(short, float, float, long long);
+    short getPowerLimit(short, short) const;
+    long long getIdleTime(long long) const;
+    void printReport() const;
+    void restoreMetrics(unsigned long, float);
+    void setChargeVoltage(float);
+
+    // getters //
+    bool isSaturated() const;
+    const CommandMonitorMetrics& getMetrics() const;
+
+private:
+    void endSaturation(long long);
+};
+
+// function prototypes
+const char* getSaturationReasonName(SaturationReason);
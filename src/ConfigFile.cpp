@@ -6,23 +6,79 @@
 
 #include "ConfigFile.h"
 
+#ifndef _STATIC_CONFIG
+
 ConfigFile::ConfigFile(std::string filename) {
     m_fileName = filename;
     
     // set config variable to default values
     m_udpListenerPort = UDP_PORT;
-    m_canInterfaceName = CAN_INTERFACE_NAME;
+    m_canInterfaceNames.push_back(CAN_INTERFACE_NAME);
     m_minChargePower = MIN_CHARGE_POWER;
     m_maxChargePower = MAX_CHARGE_POWER;
     m_targetGridPower = TARGET_GRID_POWER;
     m_regulatorErrorThreshold = REGULATOR_ERR_THRESHOLD;
     m_regulatorIdleTime = REGULATOR_IDLE_TIME;
+    m_regulatorGain = REGULATOR_GAIN;
+    m_adaptiveDeadbandEnabled = ADAPTIVE_DEADBAND_ENABLED;
+    m_deadbandFloor = DEADBAND_FLOOR;
+    m_deadbandCeiling = DEADBAND_CEILING;
+    m_deadbandSigmaFactor = DEADBAND_SIGMA_FACTOR;
+    m_pulseModeEnabled = PULSE_MODE_ENABLED;
+    m_pulseThreshold = PULSE_THRESHOLD;
+    m_pulsePower = PULSE_POWER;
+    m_pulseWindow = PULSE_WINDOW;
+    m_inverterEnabled = INVERTER_ENABLED;
+    m_inverterAddress = INVERTER_ADDRESS;
+    m_inverterPort = INVERTER_PORT;
+    m_maxDischargePower = MAX_DISCHARGE_POWER;
+    m_minDischargePower = MIN_DISCHARGE_POWER;
+    m_modeHysteresis = MODE_HYSTERESIS;
+    m_thermalDeratingEnabled = THERMAL_DERATING_ENABLED;
+    m_thermalDerateStart = THERMAL_DERATE_START;
+    m_commandMonitorEnabled = COMMAND_MONITOR_ENABLED;
+    m_loadProfileEnabled = LOAD_PROFILE_ENABLED;
+    m_loadProfileFeedForwardEnabled = LOAD_PROFILE_FEEDFORWARD_ENABLED;
+    m_loadProfileSpikeDiscount = LOAD_PROFILE_SPIKE_DISCOUNT;
     m_chargerAbsorptionVoltage = CHARGER_ABSORPTION_VOLTAGE;
+    m_batteryCapacity = BATTERY_CAPACITY;
+    m_batteryTailCurrent = BATTERY_TAIL_CURRENT;
+    m_batteryEmptyVoltage = BATTERY_EMPTY_VOLTAGE;
+    m_socTaperStart = SOC_TAPER_START;
+    m_chargeStagesEnabled = CHARGE_STAGES_ENABLED;
+    m_chargerFloatVoltage = CHARGER_FLOAT_VOLTAGE;
+    m_absorptionTime = ABSORPTION_TIME;
+    m_floatMaxCurrent = FLOAT_MAX_CURRENT;
+    m_equalizeEnabled = EQUALIZE_ENABLED;
+    m_equalizeVoltage = EQUALIZE_VOLTAGE;
+    m_equalizeInterval = EQUALIZE_INTERVAL;
+    m_equalizeTime = EQUALIZE_TIME;
+    m_chargeTempCompensation = CHARGE_TEMP_COMPENSATION;
+    m_meterResendTime = METER_RESEND_TIME;
+    m_meterHoldTime = METER_HOLD_TIME;
+    m_meterRampDownTime = METER_RAMP_DOWN_TIME;
+    m_meterTimeout = METER_TIMEOUT;
+    m_meterStandbyTime = METER_STANDBY_TIME;
+    m_meterRampDownStep = METER_RAMP_DOWN_STEP;
+    m_meterRateControlEnabled = METER_RATE_CONTROL_ENABLED;
+    m_meterIntervalFast = METER_INTERVAL_FAST;
+    m_meterIntervalSteady = METER_INTERVAL_STEADY;
+    m_meterIntervalStandby = METER_INTERVAL_STANDBY;
+    m_energyLedgerEnabled = ENERGY_LEDGER_ENABLED;
+    m_meterLogEnabled = METER_LOG_ENABLED;
+    m_traceEnabled = TRACE_ENABLED;
+    m_selfProfileEnabled = SELF_PROFILE_ENABLED;
+    m_selfProfileReportInterval = SELF_PROFILE_REPORT_INTERVAL;
+    m_ioUringEnabled = IO_URING_ENABLED;
+    m_hotRestartEnabled = HOT_RESTART_ENABLED;
+    m_warmStartEnabled = WARM_START_ENABLED;
+    m_hotRestartSocket = HOT_RESTART_SOCKET;
     m_scheduledExitEnabled = SCHEDULED_EXIT_ENABLED;
     m_scheduledExitHour = SCHEDULED_EXIT_HOUR;
     m_scheduledExitMinute = SCHEDULED_EXIT_MINUTE;
     m_slotDetectCtlEnabled = SD_CONTROL_ENABLED;
     m_slotDetectKeepAliveTime = SD_KEEP_ALIVE_TIME;
+    m_predictiveWakeEnabled = SD_PREDICTIVE_WAKE_ENABLED;
 }
 
 ConfigFile::~ConfigFile() {}
@@ -52,25 +108,56 @@ bool ConfigFile::loadConfig() {
     // close file stream
     fileIn.close();
 
+    // validate entries that depend on each other
+    checkMeterTimeouts();
+    checkMeterIntervals();
+    checkPulseMode();
+    checkDischargePower();
+    checkChargeVoltages();
+
     return true;
 }
 
-// method for printing all config variables to the console
-void ConfigFile::printConfig() const {
-    std::cout << "\nConfig Variables:" << std::endl;
-    std::cout << "UDP Listener Port:          " << m_udpListenerPort << std::endl;
-    std::cout << "CAN interface:              " << m_canInterfaceName << std::endl;
-    std::cout << "Target grid power:          " << m_targetGridPower << " W" << std::endl;
-    std::cout << "Min charge power:           " << m_minChargePower << " W" << std::endl;
-    std::cout << "Max charge power:           " << m_maxChargePower << " W" << std::endl;
-    std::cout << "Regulator error threshold:  " << m_regulatorErrorThreshold << " W" << std::endl;
-    std::cout << "Regulator idle time:        " << m_regulatorIdleTime << " msec" << std::endl;
-    std::cout << "Charger absorption voltage: " << m_chargerAbsorptionVoltage << " V" << std::endl;
-    std::cout << "Scheduled exit enabled:     " << (m_scheduledExitEnabled ? "yes" : "no") << std::endl;
-    std::cout << "Scheduled exit time:        " << m_scheduledExitHour << ":" << m_scheduledExitMinute << std::endl;
-    std::cout << "Slot detect control:        " << (m_slotDetectCtlEnabled ? "active" : "not active") << std::endl;
-    std::cout << "Slot detect keep alive:     " << m_slotDetectKeepAliveTime << " sec" << std::endl;
-    std::cout << std::endl;
+// replaces the value of a key in the config file (appended if missing) and applies it. 
+// the file is rewritten via a temporary file so it is never left half written
+bool ConfigFile::storeValue(const std::string& key, const std::string& value) {
+    std::vector<std::string> lines;
+    bool found = false;
+
+    std::ifstream fileIn(m_fileName.c_str(), std::ifstream::in);
+    std::string line = "";
+    while(std::getline(fileIn, line)) {
+        // keep comments and all other keys as they are
+        std::string stripped = line;
+        stripped.erase(std::remove_if(stripped.begin(), stripped.end(), ::isspace), stripped.end());
+        if(!found && stripped.compare(0, key.length() + 1, key + ":") == 0) {
+            bool carriageReturn = !line.empty() && line.back() == '\r';
+            line = key + ": " + value + (carriageReturn ? "\r" : "");
+            found = true;
+        }
+        lines.push_back(line);
+    }
+    fileIn.close();
+
+    if(!found) {
+        lines.push_back(key + ": " + value);
+    }
+
+    std::string tempName = m_fileName + ".tmp";
+    std::ofstream fileOut(tempName.c_str(), std::ofstream::out | std::ofstream::trunc);
+    if(!fileOut.is_open()) {
+        return false;
+    }
+    for(const std::string& outLine : lines) {
+        fileOut << outLine << "\n";
+    }
+    fileOut.close();
+    if(fileOut.fail() || rename(tempName.c_str(), m_fileName.c_str()) != 0) {
+        return false;
+    }
+
+    parseLine(key + ":" + value);
+    return true;
 }
 
 // method for parsing lines of the config file
@@ -90,7 +177,16 @@ void ConfigFile::parseLine(std::string line) {
     try {
         std::string key = pair.at(0), value = pair.at(1);
         if(key == "can-interface") {
-            m_canInterfaceName = value;
+            // comma separated list of interfaces (one worker per interface)
+            std::vector<std::string> names = split(value, ',');
+            names.erase(std::remove(names.begin(), names.end(), ""), names.end());
+            if(names.empty()) {
+                std::cerr << "at least one CAN interface must be given!" << std::endl;
+            } else if(names.size() > MAX_CAN_INTERFACES) {
+                std::cerr << "at most " << MAX_CAN_INTERFACES << " CAN interfaces are supported!" << std::endl;
+            } else {
+                m_canInterfaceNames = names;
+            }
         } else if(key == "min-charge-power") {
             m_minChargePower = static_cast<short>(stoi(value));
         } else if(key == "max-charge-power") {
@@ -103,8 +199,175 @@ void ConfigFile::parseLine(std::string line) {
             m_udpListenerPort = static_cast<short>(stoi(value));
         } else if(key == "regulator-idle-time") {
             m_regulatorIdleTime = stoi(value);
+        } else if(key == "regulator-gain") {
+            m_regulatorGain = stof(value);
+            if(m_regulatorGain <= 0.0f || m_regulatorGain > 2.0f) {
+                std::cerr << "regulator gain must be between 0 and 2!" << std::endl;
+                m_regulatorGain = REGULATOR_GAIN;
+            }
+        } else if(key == "adaptive-deadband-enabled") {
+            m_adaptiveDeadbandEnabled = value == "true" ? true : false;
+        } else if(key == "deadband-floor") {
+            m_deadbandFloor = stoi(value);
+            if(m_deadbandFloor < 0) {
+                std::cerr << "deadband floor must not be negative!" << std::endl;
+                m_deadbandFloor = DEADBAND_FLOOR;
+            }
+        } else if(key == "deadband-ceiling") {
+            m_deadbandCeiling = stoi(value);
+        } else if(key == "deadband-sigma-factor") {
+            m_deadbandSigmaFactor = stof(value);
+            if(m_deadbandSigmaFactor <= 0.0f) {
+                std::cerr << "deadband sigma factor must be greater than zero!" << std::endl;
+                m_deadbandSigmaFactor = DEADBAND_SIGMA_FACTOR;
+            }
+        } else if(key == "pulse-mode-enabled") {
+            m_pulseModeEnabled = value == "true" ? true : false;
+        } else if(key == "pulse-threshold") {
+            m_pulseThreshold = static_cast<short>(stoi(value));
+        } else if(key == "pulse-power") {
+            m_pulsePower = static_cast<short>(stoi(value));
+        } else if(key == "pulse-window") {
+            m_pulseWindow = stoi(value);
+            if(m_pulseWindow < 1) {
+                std::cerr << "pulse window must be at least one second!" << std::endl;
+                m_pulseWindow = PULSE_WINDOW;
+            }
+        } else if(key == "inverter-enabled") {
+            m_inverterEnabled = value == "true" ? true : false;
+        } else if(key == "inverter-address") {
+            m_inverterAddress = value;
+        } else if(key == "inverter-port") {
+            m_inverterPort = static_cast<short>(stoi(value));
+        } else if(key == "max-discharge-power") {
+            m_maxDischargePower = static_cast<short>(stoi(value));
+        } else if(key == "min-discharge-power") {
+            m_minDischargePower = static_cast<short>(stoi(value));
+        } else if(key == "mode-hysteresis") {
+            m_modeHysteresis = stoi(value);
+            if(m_modeHysteresis < 0) {
+                std::cerr << "mode hysteresis must not be negative!" << std::endl;
+                m_modeHysteresis = MODE_HYSTERESIS;
+            }
+        } else if(key == "thermal-derating-enabled") {
+            m_thermalDeratingEnabled = value == "true" ? true : false;
+        } else if(key == "thermal-derate-start") {
+            m_thermalDerateStart = stoi(value);
+            if(m_thermalDerateStart < 30 || m_thermalDerateStart > 100) {
+                std::cerr << "thermal derate start must be between 30 and 100 degree celsius!" << std::endl;
+                m_thermalDerateStart = THERMAL_DERATE_START;
+            }
+        } else if(key == "command-monitor-enabled") {
+            m_commandMonitorEnabled = value == "true" ? true : false;
+        } else if(key == "load-profile-enabled") {
+            m_loadProfileEnabled = value == "true" ? true : false;
+        } else if(key == "load-profile-feedforward-enabled") {
+            m_loadProfileFeedForwardEnabled = value == "true" ? true : false;
+        } else if(key == "load-profile-spike-discount") {
+            m_loadProfileSpikeDiscount = stof(value);
+            if(m_loadProfileSpikeDiscount < 0.0f || m_loadProfileSpikeDiscount > 1.0f) {
+                std::cerr << "load profile spike discount must be between 0 and 1!" << std::endl;
+                m_loadProfileSpikeDiscount = LOAD_PROFILE_SPIKE_DISCOUNT;
+            }
         } else if(key == "absorption-voltage") {
             m_chargerAbsorptionVoltage = stof(value);
+        } else if(key == "battery-capacity") {
+            m_batteryCapacity = stof(value);
+            if(m_batteryCapacity <= 0.0f) {
+                std::cerr << "battery capacity must be greater than zero!" << std::endl;
+                m_batteryCapacity = BATTERY_CAPACITY;
+            }
+        } else if(key == "battery-tail-current") {
+            m_batteryTailCurrent = stof(value);
+        } else if(key == "battery-empty-voltage") {
+            m_batteryEmptyVoltage = stof(value);
+        } else if(key == "soc-taper-start") {
+            m_socTaperStart = stoi(value);
+            if(m_socTaperStart < 0 || m_socTaperStart > 100) {
+                std::cerr << "soc taper start must be between 0 and 100 percent!" << std::endl;
+                m_socTaperStart = SOC_TAPER_START;
+            }
+        } else if(key == "charge-stages-enabled") {
+            m_chargeStagesEnabled = value == "true" ? true : false;
+        } else if(key == "float-voltage") {
+            m_chargerFloatVoltage = stof(value);
+        } else if(key == "absorption-time") {
+            m_absorptionTime = stoi(value);
+            if(m_absorptionTime < 1) {
+                std::cerr << "absorption time must be at least one minute!" << std::endl;
+                m_absorptionTime = ABSORPTION_TIME;
+            }
+        } else if(key == "float-max-current") {
+            m_floatMaxCurrent = stof(value);
+            if(m_floatMaxCurrent < 0.0f) {
+                std::cerr << "float max current must not be negative!" << std::endl;
+                m_floatMaxCurrent = FLOAT_MAX_CURRENT;
+            }
+        } else if(key == "equalize-enabled") {
+            m_equalizeEnabled = value == "true" ? true : false;
+        } else if(key == "equalize-voltage") {
+            m_equalizeVoltage = stof(value);
+        } else if(key == "equalize-interval") {
+            m_equalizeInterval = stoi(value);
+            if(m_equalizeInterval < 1) {
+                std::cerr << "equalize interval must be at least one day!" << std::endl;
+                m_equalizeInterval = EQUALIZE_INTERVAL;
+            }
+        } else if(key == "equalize-time") {
+            m_equalizeTime = stoi(value);
+            if(m_equalizeTime < 1) {
+                std::cerr << "equalize time must be at least one minute!" << std::endl;
+                m_equalizeTime = EQUALIZE_TIME;
+            }
+        } else if(key == "charge-temperature-compensation") {
+            m_chargeTempCompensation = stof(value);
+        } else if(key == "meter-resend-time") {
+            m_meterResendTime = stoi(value);
+        } else if(key == "meter-hold-time") {
+            m_meterHoldTime = stoi(value);
+        } else if(key == "meter-rampdown-time") {
+            m_meterRampDownTime = stoi(value);
+        } else if(key == "meter-timeout") {
+            m_meterTimeout = stoi(value);
+        } else if(key == "meter-standby-time") {
+            m_meterStandbyTime = stoi(value);
+        } else if(key == "meter-rampdown-step") {
+            m_meterRampDownStep = static_cast<short>(stoi(value));
+            if(m_meterRampDownStep <= 0) {
+                std::cerr << "meter ramp down step must be greater than zero!" << std::endl;
+                m_meterRampDownStep = METER_RAMP_DOWN_STEP;
+            }
+        } else if(key == "meter-rate-control-enabled") {
+            m_meterRateControlEnabled = value == "true" ? true : false;
+        } else if(key == "meter-interval-fast") {
+            m_meterIntervalFast = stoi(value);
+        } else if(key == "meter-interval-steady") {
+            m_meterIntervalSteady = stoi(value);
+        } else if(key == "meter-interval-standby") {
+            m_meterIntervalStandby = stoi(value);
+        } else if(key == "energy-ledger-enabled") {
+            m_energyLedgerEnabled = value == "true" ? true : false;
+        } else if(key == "meter-log-enabled") {
+            m_meterLogEnabled = value == "true" ? true : false;
+        } else if(key == "trace-enabled") {
+            m_traceEnabled = value == "true" ? true : false;
+        } else if(key == "self-profile-enabled") {
+            m_selfProfileEnabled = value == "true" ? true : false;
+        } else if(key == "self-profile-report-interval") {
+            m_selfProfileReportInterval = stoi(value);
+            // 0 disables the periodic report, otherwise at least one sample interval
+            if(m_selfProfileReportInterval != 0 && m_selfProfileReportInterval < PROFILE_SAMPLE_INTERVAL / 1000) {
+                std::cerr << "self profile report interval must be 0 or at least " << PROFILE_SAMPLE_INTERVAL / 1000 << " seconds!" << std::endl;
+                m_selfProfileReportInterval = SELF_PROFILE_REPORT_INTERVAL;
+            }
+        } else if(key == "io-uring-enabled") {
+            m_ioUringEnabled = value == "true" ? true : false;
+        } else if(key == "hot-restart-enabled") {
+            m_hotRestartEnabled = value == "true" ? true : false;
+        } else if(key == "hot-restart-socket") {
+            m_hotRestartSocket = value;
+        } else if(key == "warm-start-enabled") {
+            m_warmStartEnabled = value == "true" ? true : false;
         } else if(key == "scheduled-exit-enabled") {
             m_scheduledExitEnabled = value == "true" ? true : false;
         } else if(key == "scheduled-exit-hour") {
@@ -136,6 +399,8 @@ void ConfigFile::parseLine(std::string line) {
                 std::cerr << "slot detect keep alive time must be at least 10 seconds!" << std::endl;
                 m_slotDetectKeepAliveTime = SD_KEEP_ALIVE_TIME;
             }
+        } else if(key == "slotdetect-predictive-wake-enabled") {
+            m_predictiveWakeEnabled = value == "true" ? true : false;
         } else {
             std::cerr << "[Config] Invalid config variable named " << key << std::endl;
         }
@@ -144,21 +409,66 @@ void ConfigFile::parseLine(std::string line) {
     }
 }
 
-// helper function for a basic string split operation
-std::vector<std::string> ConfigFile::split(const std::string &text, char sep) {
-    std::vector<std::string> tokens;
-    std::size_t start = 0, end = 0;
-    while ((end = text.find(sep, start)) != std::string::npos) {
-        tokens.push_back(text.substr(start, end - start));
-        start = end + 1;
+// the watchdog stages must escalate in order. fall back to the defaults otherwise
+void ConfigFile::checkMeterTimeouts() {
+    if(m_meterResendTime < 1 || m_meterHoldTime <= m_meterResendTime || m_meterRampDownTime < m_meterHoldTime || 
+        m_meterTimeout < m_meterRampDownTime || m_meterStandbyTime < m_meterTimeout) {
+        std::cerr << "meter watchdog times must be ascending (resend < hold <= rampdown <= timeout <= standby)!" << std::endl;
+        m_meterResendTime = METER_RESEND_TIME;
+        m_meterHoldTime = METER_HOLD_TIME;
+        m_meterRampDownTime = METER_RAMP_DOWN_TIME;
+        m_meterTimeout = METER_TIMEOUT;
+        m_meterStandbyTime = METER_STANDBY_TIME;
+    }
+}
+
+// the wanted meter intervals must be ascending and the slowest one must not trigger the meter watchdog
+void ConfigFile::checkMeterIntervals() {
+    if(m_meterIntervalFast < 100 || m_meterIntervalSteady < m_meterIntervalFast || m_meterIntervalStandby < m_meterIntervalSteady
+        || m_meterIntervalStandby >= m_meterHoldTime * 1000) {
+        std::cerr << "meter intervals must be ascending (100 <= fast <= steady <= standby) and below the meter hold time!" << std::endl;
+        m_meterIntervalFast = METER_INTERVAL_FAST;
+        m_meterIntervalSteady = METER_INTERVAL_STEADY;
+        m_meterIntervalStandby = METER_INTERVAL_STANDBY;
+    }
+}
+
+// pulses must be charged at a higher power than the surplus they replace
+void ConfigFile::checkPulseMode() {
+    if(m_pulseThreshold < 1 || m_pulsePower <= m_pulseThreshold) {
+        std::cerr << "pulse power must be greater than the pulse threshold!" << std::endl;
+        m_pulseThreshold = PULSE_THRESHOLD;
+        m_pulsePower = PULSE_POWER;
+    }
+}
+
+// the discharge power range must not be empty
+void ConfigFile::checkDischargePower() {
+    if(m_minDischargePower < 0 || m_maxDischargePower < m_minDischargePower) {
+        std::cerr << "max discharge power must not be below the min discharge power!" << std::endl;
+        m_minDischargePower = MIN_DISCHARGE_POWER;
+        m_maxDischargePower = MAX_DISCHARGE_POWER;
+    }
+}
+
+// the charge stage voltages must ascend (float < absorption <= equalize) within the PSU output range
+void ConfigFile::checkChargeVoltages() {
+    if(!m_chargeStagesEnabled) {
+        return;
+    }
+    if(m_chargerFloatVoltage < PSU_MIN_VOLTAGE || m_chargerFloatVoltage >= m_chargerAbsorptionVoltage) {
+        std::cerr << "float voltage must be below the absorption voltage (and at least " << PSU_MIN_VOLTAGE << "V)!" << std::endl;
+        m_chargerFloatVoltage = std::max(PSU_MIN_VOLTAGE, m_chargerAbsorptionVoltage - (CHARGER_ABSORPTION_VOLTAGE - CHARGER_FLOAT_VOLTAGE));
+    }
+    if(m_equalizeVoltage < m_chargerAbsorptionVoltage || m_equalizeVoltage > PSU_MAX_VOLTAGE) {
+        std::cerr << "equalize voltage must be between the absorption voltage and " << PSU_MAX_VOLTAGE << "V!" << std::endl;
+        m_equalizeVoltage = m_chargerAbsorptionVoltage;
     }
-    tokens.push_back(text.substr(start));
-    return tokens;
 }
 
 // Getters //
-const char* ConfigFile::getCanInterfaceName() const {
-    return m_canInterfaceName.c_str();
+const std::vector<std::string>& ConfigFile::getCanInterfaceNames() const {
+    return m_canInterfaceNames;
 }
 
 short ConfigFile::getUdpPort() const {
@@ -185,10 +495,222 @@ int ConfigFile::getRegulatorIdleTime() const {
     return m_regulatorIdleTime;
 }
 
+float ConfigFile::getRegulatorGain() const {
+    return m_regulatorGain;
+}
+
+bool ConfigFile::isPulseModeEnabled() const {
+    return m_pulseModeEnabled;
+}
+
+short ConfigFile::getPulseThreshold() const {
+    return m_pulseThreshold;
+}
+
+short ConfigFile::getPulsePower() const {
+    return m_pulsePower;
+}
+
+int ConfigFile::getPulseWindow() const {
+    return m_pulseWindow;
+}
+
+bool ConfigFile::isAdaptiveDeadbandEnabled() const {
+    return m_adaptiveDeadbandEnabled;
+}
+
+int ConfigFile::getDeadbandFloor() const {
+    return m_deadbandFloor;
+}
+
+int ConfigFile::getDeadbandCeiling() const {
+    return m_deadbandCeiling;
+}
+
+float ConfigFile::getDeadbandSigmaFactor() const {
+    return m_deadbandSigmaFactor;
+}
+
+bool ConfigFile::isInverterEnabled() const {
+    return m_inverterEnabled;
+}
+
+const char* ConfigFile::getInverterAddress() const {
+    return m_inverterAddress.c_str();
+}
+
+short ConfigFile::getInverterPort() const {
+    return m_inverterPort;
+}
+
+short ConfigFile::getMaxDischargePower() const {
+    return m_maxDischargePower;
+}
+
+short ConfigFile::getMinDischargePower() const {
+    return m_minDischargePower;
+}
+
+int ConfigFile::getModeHysteresis() const {
+    return m_modeHysteresis;
+}
+
+bool ConfigFile::isThermalDeratingEnabled() const {
+    return m_thermalDeratingEnabled;
+}
+
+int ConfigFile::getThermalDerateStart() const {
+    return m_thermalDerateStart;
+}
+
+bool ConfigFile::isCommandMonitorEnabled() const {
+    return m_commandMonitorEnabled;
+}
+
+bool ConfigFile::isLoadProfileEnabled() const {
+    return m_loadProfileEnabled;
+}
+
+bool ConfigFile::isLoadProfileFeedForwardEnabled() const {
+    return m_loadProfileFeedForwardEnabled;
+}
+
+float ConfigFile::getLoadProfileSpikeDiscount() const {
+    return m_loadProfileSpikeDiscount;
+}
+
 float ConfigFile::getChargerAbsorptionVoltage() const {
     return m_chargerAbsorptionVoltage;
 }
 
+float ConfigFile::getBatteryCapacity() const {
+    return m_batteryCapacity;
+}
+
+float ConfigFile::getBatteryTailCurrent() const {
+    return m_batteryTailCurrent;
+}
+
+float ConfigFile::getBatteryEmptyVoltage() const {
+    return m_batteryEmptyVoltage;
+}
+
+int ConfigFile::getSocTaperStart() const {
+    return m_socTaperStart;
+}
+
+bool ConfigFile::isChargeStagesEnabled() const {
+    return m_chargeStagesEnabled;
+}
+
+float ConfigFile::getChargerFloatVoltage() const {
+    return m_chargerFloatVoltage;
+}
+
+int ConfigFile::getAbsorptionTime() const {
+    return m_absorptionTime;
+}
+
+float ConfigFile::getFloatMaxCurrent() const {
+    return m_floatMaxCurrent;
+}
+
+bool ConfigFile::isEqualizeEnabled() const {
+    return m_equalizeEnabled;
+}
+
+float ConfigFile::getEqualizeVoltage() const {
+    return m_equalizeVoltage;
+}
+
+int ConfigFile::getEqualizeInterval() const {
+    return m_equalizeInterval;
+}
+
+int ConfigFile::getEqualizeTime() const {
+    return m_equalizeTime;
+}
+
+float ConfigFile::getChargeTempCompensation() const {
+    return m_chargeTempCompensation;
+}
+
+int ConfigFile::getMeterResendTime() const {
+    return m_meterResendTime;
+}
+
+int ConfigFile::getMeterHoldTime() const {
+    return m_meterHoldTime;
+}
+
+int ConfigFile::getMeterRampDownTime() const {
+    return m_meterRampDownTime;
+}
+
+int ConfigFile::getMeterTimeout() const {
+    return m_meterTimeout;
+}
+
+int ConfigFile::getMeterStandbyTime() const {
+    return m_meterStandbyTime;
+}
+
+short ConfigFile::getMeterRampDownStep() const {
+    return m_meterRampDownStep;
+}
+
+bool ConfigFile::isMeterRateControlEnabled() const {
+    return m_meterRateControlEnabled;
+}
+
+int ConfigFile::getMeterIntervalFast() const {
+    return m_meterIntervalFast;
+}
+
+int ConfigFile::getMeterIntervalSteady() const {
+    return m_meterIntervalSteady;
+}
+
+int ConfigFile::getMeterIntervalStandby() const {
+    return m_meterIntervalStandby;
+}
+
+bool ConfigFile::isEnergyLedgerEnabled() const {
+    return m_energyLedgerEnabled;
+}
+
+bool ConfigFile::isMeterLogEnabled() const {
+    return m_meterLogEnabled;
+}
+
+bool ConfigFile::isTraceEnabled() const {
+    return m_traceEnabled;
+}
+
+bool ConfigFile::isSelfProfileEnabled() const {
+    return m_selfProfileEnabled;
+}
+
+int ConfigFile::getSelfProfileReportInterval() const {
+    return m_selfProfileReportInterval;
+}
+
+bool ConfigFile::isIoUringEnabled() const {
+    return m_ioUringEnabled;
+}
+
+bool ConfigFile::isHotRestartEnabled() const {
+    return m_hotRestartEnabled;
+}
+
+bool ConfigFile::isWarmStartEnabled() const {
+    return m_warmStartEnabled;
+}
+
+const char* ConfigFile::getHotRestartSocket() const {
+    return m_hotRestartSocket.c_str();
+}
+
 bool ConfigFile::isScheduledExitEnabled() const {
     return m_scheduledExitEnabled;
 }
@@ -207,4 +729,122 @@ bool ConfigFile::isSlotDetectControlEnabled() const {
 
 int ConfigFile::getSlotDetectKeepAliveTime() const {
     return m_slotDetectKeepAliveTime;
-}
\ No newline at end of file
+}
+
+bool ConfigFile::isPredictiveWakeEnabled() const {
+    return m_predictiveWakeEnabled;
+}
+
+#endif
+
+// method for printing all config variables to the console (both for the file and the compiled in config)
+void ConfigFile::printConfig() const {
+    #ifdef _STATIC_CONFIG
+        std::cout << "\nConfig Variables (compiled in):" << std::endl;
+    #else
+        std::cout << "\nConfig Variables:" << std::endl;
+    #endif
+    std::cout << "UDP Listener Port:          " << getUdpPort() << std::endl;
+    std::cout << "CAN interfaces:             ";
+    const std::vector<std::string>& canInterfaceNames = getCanInterfaceNames();
+    for(size_t i = 0; i < canInterfaceNames.size(); i++) {
+        std::cout << (i > 0 ? ", " : "") << canInterfaceNames[i];
+    }
+    std::cout << std::endl;
+    std::cout << "Target grid power:          " << getTargetGridPower() << " W" << std::endl;
+    std::cout << "Min charge power:           " << getMinChargePower() << " W" << std::endl;
+    std::cout << "Max charge power:           " << getMaxChargePower() << " W" << std::endl;
+    std::cout << "Regulator error threshold:  " << getRegulatorErrorThreshold() << " W" << std::endl;
+    std::cout << "Regulator idle time:        " << getRegulatorIdleTime() << " msec" << std::endl;
+    std::cout << "Regulator gain:             " << getRegulatorGain() << std::endl;
+    if(isAdaptiveDeadbandEnabled()) {
+        std::cout << "Adaptive deadband:          " << getDeadbandFloor() << " - " << getDeadbandCeiling() << " W, " 
+                    << getDeadbandSigmaFactor() << " sigma" << std::endl;
+    } else {
+        std::cout << "Adaptive deadband:          disabled" << std::endl;
+    }
+    if(isPulseModeEnabled()) {
+        std::cout << "Pulse mode:                 below " << getPulseThreshold() << " W surplus, pulses of " << getPulsePower() 
+                    << " W, window " << getPulseWindow() << " sec" << std::endl;
+    } else {
+        std::cout << "Pulse mode:                 disabled" << std::endl;
+    }
+    if(isInverterEnabled()) {
+        std::cout << "Discharge inverter:         " << getInverterAddress() << ":" << getInverterPort() << ", " << getMinDischargePower()
+                    << " - " << getMaxDischargePower() << " W, mode hysteresis " << getModeHysteresis() << " W" << std::endl;
+    } else {
+        std::cout << "Discharge inverter:         disabled" << std::endl;
+    }
+    if(isThermalDeratingEnabled()) {
+        std::cout << "Thermal derating:           from " << getThermalDerateStart() << " C" << std::endl;
+    } else {
+        std::cout << "Thermal derating:           disabled" << std::endl;
+    }
+    std::cout << "Command monitor:            " << (isCommandMonitorEnabled() ? "enabled" : "disabled") << std::endl;
+    if(!isLoadProfileEnabled()) {
+        std::cout << "Load profile:               disabled" << std::endl;
+    } else if(isLoadProfileFeedForwardEnabled()) {
+        std::cout << "Load profile:               pre-position steps, spike discount " << getLoadProfileSpikeDiscount() << std::endl;
+    } else {
+        std::cout << "Load profile:               learn only" << std::endl;
+    }
+    std::cout << "Charger absorption voltage: " << getChargerAbsorptionVoltage() << " V" << std::endl;
+    std::cout << "Battery capacity:           " << getBatteryCapacity() << " Ah" << std::endl;
+    std::cout << "Battery tail current:       " << getBatteryTailCurrent() << " A" << std::endl;
+    std::cout << "Battery empty voltage:      " << getBatteryEmptyVoltage() << " V" << std::endl;
+    std::cout << "SOC taper start:            " << getSocTaperStart() << " %" << std::endl;
+    if(isChargeStagesEnabled()) {
+        std::cout << "Charge stages:              absorption max " << getAbsorptionTime() << " min, float " << getChargerFloatVoltage()
+                    << " V (max " << getFloatMaxCurrent() << " A)" << std::endl;
+        if(isEqualizeEnabled()) {
+            std::cout << "Equalisation:               " << getEqualizeVoltage() << " V for " << getEqualizeTime() << " min every "
+                        << getEqualizeInterval() << " days" << std::endl;
+        }
+        if(getChargeTempCompensation() != 0.0f) {
+            std::cout << "Temperature compensation:   " << getChargeTempCompensation() << " mV/C" << std::endl;
+        }
+    } else {
+        std::cout << "Charge stages:              disabled (held at absorption)" << std::endl;
+    }
+    std::cout << "Meter resend time:          " << getMeterResendTime() << "s" << std::endl;
+    std::cout << "Meter watchdog stages:      hold " << getMeterHoldTime() << "s, ramp down " << getMeterRampDownTime() 
+                << "s, zero " << getMeterTimeout() << "s, standby " << getMeterStandbyTime() << "s" << std::endl;
+    std::cout << "Meter ramp down step:       " << getMeterRampDownStep() << " W/s" << std::endl;
+    if(isMeterRateControlEnabled()) {
+        std::cout << "Meter intervals:            fast " << getMeterIntervalFast() << "ms, steady " << getMeterIntervalSteady()
+                    << "ms, standby " << getMeterIntervalStandby() << "ms" << std::endl;
+    } else {
+        std::cout << "Meter intervals:            not controlled" << std::endl;
+    }
+    std::cout << "Energy ledger enabled:      " << (isEnergyLedgerEnabled() ? "yes" : "no") << std::endl;
+    std::cout << "Meter log enabled:          " << (isMeterLogEnabled() ? "yes" : "no") << std::endl;
+    std::cout << "Trace points enabled:       " << (isTraceEnabled() ? "yes" : "no") << std::endl;
+    if(!isSelfProfileEnabled()) {
+        std::cout << "Self profile:               disabled" << std::endl;
+    } else if(getSelfProfileReportInterval() > 0) {
+        std::cout << "Self profile:               report every " << getSelfProfileReportInterval() << " sec" << std::endl;
+    } else {
+        std::cout << "Self profile:               on SIGUSR2 only" << std::endl;
+    }
+    std::cout << "Socket I/O:                 " << (isIoUringEnabled() ? "io_uring" : "classic") << std::endl;
+    std::cout << "Hot restart socket:         " << (isHotRestartEnabled() ? getHotRestartSocket() : "disabled") << std::endl;
+    std::cout << "Warm start enabled:         " << (isWarmStartEnabled() ? "yes" : "no") << std::endl;
+    std::cout << "Scheduled exit enabled:     " << (isScheduledExitEnabled() ? "yes" : "no") << std::endl;
+    std::cout << "Scheduled exit time:        " << getScheduledExitHour() << ":" << getScheduledExitMinute() << std::endl;
+    std::cout << "Slot detect control:        " << (isSlotDetectControlEnabled() ? "active" : "not active") << std::endl;
+    std::cout << "Slot detect keep alive:     " << getSlotDetectKeepAliveTime() << " sec" << std::endl;
+    std::cout << "Predictive wake:            " << (isPredictiveWakeEnabled() ? "yes" : "no") << std::endl;
+    std::cout << std::endl;
+}
+
+// helper function for a basic string split operation
+std::vector<std::string> ConfigFile::split(const std::string &text, char sep) {
+    std::vector<std::string> tokens;
+    std::size_t start = 0, end = 0;
+    while ((end = text.find(sep, start)) != std::string::npos) {
+        tokens.push_back(text.substr(start, end - start));
+        start = end + 1;
+    }
+    tokens.push_back(text.substr(start));
+    return tokens;
+}
@@ -13,21 +13,66 @@
 #include <vector>
 
 #include "default-conf.h"
+#include "SelfProfile.h"
 
+#ifndef _STATIC_CONFIG
+
+// runtime configuration read from the config file (defaults from default-conf.h)
 class ConfigFile
 {
     std::string m_fileName;
 
     // config variables
-    std::string m_canInterfaceName;
+    std::vector<std::string> m_canInterfaceNames;
     short m_udpListenerPort;
     short m_minChargePower, m_maxChargePower, m_targetGridPower;
     int m_regulatorIdleTime,  m_regulatorErrorThreshold;
+    float m_regulatorGain;
+    bool m_adaptiveDeadbandEnabled;
+    int m_deadbandFloor, m_deadbandCeiling;
+    float m_deadbandSigmaFactor;
+    bool m_pulseModeEnabled;
+    short m_pulseThreshold, m_pulsePower;
+    int m_pulseWindow;
+    bool m_inverterEnabled;
+    std::string m_inverterAddress;
+    short m_inverterPort;
+    short m_maxDischargePower, m_minDischargePower;
+    int m_modeHysteresis;
+    bool m_thermalDeratingEnabled;
+    int m_thermalDerateStart;
+    bool m_commandMonitorEnabled;
+    bool m_loadProfileEnabled, m_loadProfileFeedForwardEnabled;
+    float m_loadProfileSpikeDiscount;
     float m_chargerAbsorptionVoltage;
+    float m_batteryCapacity, m_batteryTailCurrent, m_batteryEmptyVoltage;
+    int m_socTaperStart;
+    bool m_chargeStagesEnabled;
+    float m_chargerFloatVoltage;
+    int m_absorptionTime;
+    float m_floatMaxCurrent;
+    bool m_equalizeEnabled;
+    float m_equalizeVoltage;
+    int m_equalizeInterval, m_equalizeTime;
+    float m_chargeTempCompensation;
+    int m_meterResendTime, m_meterHoldTime, m_meterRampDownTime, m_meterTimeout, m_meterStandbyTime;
+    short m_meterRampDownStep;
+    bool m_meterRateControlEnabled;
+    int m_meterIntervalFast, m_meterIntervalSteady, m_meterIntervalStandby;
+    bool m_energyLedgerEnabled;
+    bool m_meterLogEnabled;
+    bool m_traceEnabled;
+    bool m_selfProfileEnabled;
+    int m_selfProfileReportInterval;
+    bool m_ioUringEnabled;
+    bool m_hotRestartEnabled;
+    bool m_warmStartEnabled;
+    std::string m_hotRestartSocket;
     bool m_scheduledExitEnabled;
     int m_scheduledExitHour, m_scheduledExitMinute;
     bool m_slotDetectCtlEnabled;
     int m_slotDetectKeepAliveTime;
+    bool m_predictiveWakeEnabled;
 
 public:
     ConfigFile(std::string);
@@ -35,24 +80,176 @@ public:
 
     bool loadConfig();
     void printConfig() const;
+    bool storeValue(const std::string&, const std::string&);
 
     // Getters // 
-    const char* getCanInterfaceName() const;
+    const std::vector<std::string>& getCanInterfaceNames() const;
     short getUdpPort() const;
     short getMinChargePower() const;
     short getMaxChargePower() const;
     short getTargetGridPower() const;
     int getRegulatorErrorThreshold() const;
     int getRegulatorIdleTime() const;
+    float getRegulatorGain() const;
+    bool isAdaptiveDeadbandEnabled() const;
+    int getDeadbandFloor() const;
+    int getDeadbandCeiling() const;
+    float getDeadbandSigmaFactor() const;
+    bool isPulseModeEnabled() const;
+    short getPulseThreshold() const;
+    short getPulsePower() const;
+    int getPulseWindow() const;
+    bool isInverterEnabled() const;
+    const char* getInverterAddress() const;
+    short getInverterPort() const;
+    short getMaxDischargePower() const;
+    short getMinDischargePower() const;
+    int getModeHysteresis() const;
+    bool isThermalDeratingEnabled() const;
+    int getThermalDerateStart() const;
+    bool isCommandMonitorEnabled() const;
+    bool isLoadProfileEnabled() const;
+    bool isLoadProfileFeedForwardEnabled() const;
+    float getLoadProfileSpikeDiscount() const;
     float getChargerAbsorptionVoltage() const;
+    float getBatteryCapacity() const;
+    float getBatteryTailCurrent() const;
+    float getBatteryEmptyVoltage() const;
+    int getSocTaperStart() const;
+    bool isChargeStagesEnabled() const;
+    float getChargerFloatVoltage() const;
+    int getAbsorptionTime() const;
+    float getFloatMaxCurrent() const;
+    bool isEqualizeEnabled() const;
+    float getEqualizeVoltage() const;
+    int getEqualizeInterval() const;
+    int getEqualizeTime() const;
+    float getChargeTempCompensation() const;
+    int getMeterResendTime() const;
+    int getMeterHoldTime() const;
+    int getMeterRampDownTime() const;
+    int getMeterTimeout() const;
+    int getMeterStandbyTime() const;
+    short getMeterRampDownStep() const;
+    bool isMeterRateControlEnabled() const;
+    int getMeterIntervalFast() const;
+    int getMeterIntervalSteady() const;
+    int getMeterIntervalStandby() const;
+    bool isEnergyLedgerEnabled() const;
+    bool isMeterLogEnabled() const;
+    bool isTraceEnabled() const;
+    bool isSelfProfileEnabled() const;
+    int getSelfProfileReportInterval() const;
+    bool isIoUringEnabled() const;
+    bool isHotRestartEnabled() const;
+    bool isWarmStartEnabled() const;
+    const char* getHotRestartSocket() const;
     bool isScheduledExitEnabled() const;
     int getScheduledExitHour() const;
     int getScheduledExitMinute() const;
     bool isSlotDetectControlEnabled() const;
     int getSlotDetectKeepAliveTime() const;
+    bool isPredictiveWakeEnabled() const;
 
 private:
     void parseLine(std::string);
+    void checkMeterTimeouts();
+    void checkMeterIntervals();
+    void checkPulseMode();
+    void checkDischargePower();
+    void checkChargeVoltages();
     std::vector<std::string> split(const std::string&, char);
 
-};
\ No newline at end of file
+};
+
+#else
+
+// compile time configuration profile (see profiles/), there is no config file and no parser.
+// all getters are constant expressions of the profile values, dead branches are removed by the compiler
+class ConfigFile
+{
+    std::vector<std::string> m_canInterfaceNames;
+
+public:
+    ConfigFile(std::string);
+    ~ConfigFile();
+
+    bool loadConfig();
+    void printConfig() const;
+    bool storeValue(const std::string&, const std::string&);
+
+    // Getters // 
+    const std::vector<std::string>& getCanInterfaceNames() const;
+    constexpr short getUdpPort() const { return UDP_PORT; }
+    constexpr short getMinChargePower() const { return MIN_CHARGE_POWER; }
+    constexpr short getMaxChargePower() const { return MAX_CHARGE_POWER; }
+    constexpr short getTargetGridPower() const { return TARGET_GRID_POWER; }
+    constexpr int getRegulatorErrorThreshold() const { return REGULATOR_ERR_THRESHOLD; }
+    constexpr int getRegulatorIdleTime() const { return REGULATOR_IDLE_TIME; }
+    constexpr float getRegulatorGain() const { return REGULATOR_GAIN; }
+    constexpr bool isAdaptiveDeadbandEnabled() const { return ADAPTIVE_DEADBAND_ENABLED; }
+    constexpr int getDeadbandFloor() const { return DEADBAND_FLOOR; }
+    constexpr int getDeadbandCeiling() const { return DEADBAND_CEILING; }
+    constexpr float getDeadbandSigmaFactor() const { return DEADBAND_SIGMA_FACTOR; }
+    constexpr bool isPulseModeEnabled() const { return PULSE_MODE_ENABLED; }
+    constexpr short getPulseThreshold() const { return PULSE_THRESHOLD; }
+    constexpr short getPulsePower() const { return PULSE_POWER; }
+    constexpr int getPulseWindow() const { return PULSE_WINDOW; }
+    constexpr bool isInverterEnabled() const { return INVERTER_ENABLED; }
+    constexpr const char* getInverterAddress() const { return INVERTER_ADDRESS; }
+    constexpr short getInverterPort() const { return INVERTER_PORT; }
+    constexpr short getMaxDischargePower() const { return MAX_DISCHARGE_POWER; }
+    constexpr short getMinDischargePower() const { return MIN_DISCHARGE_POWER; }
+    constexpr int getModeHysteresis() const { return MODE_HYSTERESIS; }
+    constexpr bool isThermalDeratingEnabled() const { return THERMAL_DERATING_ENABLED; }
+    constexpr int getThermalDerateStart() const { return THERMAL_DERATE_START; }
+    constexpr bool isCommandMonitorEnabled() const { return COMMAND_MONITOR_ENABLED; }
+    constexpr bool isLoadProfileEnabled() const { return LOAD_PROFILE_ENABLED; }
+    constexpr bool isLoadProfileFeedForwardEnabled() const { return LOAD_PROFILE_FEEDFORWARD_ENABLED; }
+    constexpr float getLoadProfileSpikeDiscount() const { return LOAD_PROFILE_SPIKE_DISCOUNT; }
+    constexpr float getChargerAbsorptionVoltage() const { return CHARGER_ABSORPTION_VOLTAGE; }
+    constexpr float getBatteryCapacity() const { return BATTERY_CAPACITY; }
+    constexpr float getBatteryTailCurrent() const { return BATTERY_TAIL_CURRENT; }
+    constexpr float getBatteryEmptyVoltage() const { return BATTERY_EMPTY_VOLTAGE; }
+    constexpr int getSocTaperStart() const { return SOC_TAPER_START; }
+    constexpr bool isChargeStagesEnabled() const { return CHARGE_STAGES_ENABLED; }
+    constexpr float getChargerFloatVoltage() const { return CHARGER_FLOAT_VOLTAGE; }
+    constexpr int getAbsorptionTime() const { return ABSORPTION_TIME; }
+    constexpr float getFloatMaxCurrent() const { return FLOAT_MAX_CURRENT; }
+    constexpr bool isEqualizeEnabled() const { return EQUALIZE_ENABLED; }
+    constexpr float getEqualizeVoltage() const { return EQUALIZE_VOLTAGE; }
+    constexpr int getEqualizeInterval() const { return EQUALIZE_INTERVAL; }
+    constexpr int getEqualizeTime() const { return EQUALIZE_TIME; }
+    constexpr float getChargeTempCompensation() const { return CHARGE_TEMP_COMPENSATION; }
+    constexpr int getMeterResendTime() const { return METER_RESEND_TIME; }
+    constexpr int getMeterHoldTime() const { return METER_HOLD_TIME; }
+    constexpr int getMeterRampDownTime() const { return METER_RAMP_DOWN_TIME; }
+    constexpr int getMeterTimeout() const { return METER_TIMEOUT; }
+    constexpr int getMeterStandbyTime() const { return METER_STANDBY_TIME; }
+    constexpr short getMeterRampDownStep() const { return METER_RAMP_DOWN_STEP; }
+    constexpr bool isMeterRateControlEnabled() const { return METER_RATE_CONTROL_ENABLED; }
+    constexpr int getMeterIntervalFast() const { return METER_INTERVAL_FAST; }
+    constexpr int getMeterIntervalSteady() const { return METER_INTERVAL_STEADY; }
+    constexpr int getMeterIntervalStandby() const { return METER_INTERVAL_STANDBY; }
+    constexpr bool isEnergyLedgerEnabled() const { return ENERGY_LEDGER_ENABLED; }
+    constexpr bool isMeterLogEnabled() const { return METER_LOG_ENABLED; }
+    constexpr bool isTraceEnabled() const { return TRACE_ENABLED; }
+    constexpr bool isSelfProfileEnabled() const { return SELF_PROFILE_ENABLED; }
+    constexpr int getSelfProfileReportInterval() const { return SELF_PROFILE_REPORT_INTERVAL; }
+    constexpr bool isIoUringEnabled() const { return IO_URING_ENABLED; }
+    constexpr bool isHotRestartEnabled() const { return HOT_RESTART_ENABLED; }
+    constexpr bool isWarmStartEnabled() const { return WARM_START_ENABLED; }
+    constexpr const char* getHotRestartSocket() const { return HOT_RESTART_SOCKET; }
+    constexpr bool isScheduledExitEnabled() const { return SCHEDULED_EXIT_ENABLED; }
+    constexpr int getScheduledExitHour() const { return SCHEDULED_EXIT_HOUR; }
+    constexpr int getScheduledExitMinute() const { return SCHEDULED_EXIT_MINUTE; }
+    constexpr bool isSlotDetectControlEnabled() const { return SD_CONTROL_ENABLED; }
+    constexpr int getSlotDetectKeepAliveTime() const { return SD_KEEP_ALIVE_TIME; }
+    constexpr bool isPredictiveWakeEnabled() const { return SD_PREDICTIVE_WAKE_ENABLED; }
+
+private:
+    std::vector<std::string> split(const std::string&, char);
+
+};
+
+#endif
\ No newline at end of file
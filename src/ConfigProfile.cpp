@@ -0,0 +1,66 @@
+/*
+    File: ConfigProfile.cpp
+    Compile time configuration (cmake -DCONFIG_PROFILE=...). The values of the profile
+    are checked by the compiler instead of the config file parser
+
+    written by Elias Geiger
+*/
+
+#include "ConfigFile.h"
+
+#ifdef _STATIC_CONFIG
+
+// same rules as for the config file entries
+static_assert(REGULATOR_GAIN > 0.0f && REGULATOR_GAIN <= 2.0f, "regulator gain must be between 0 and 2");
+static_assert(DEADBAND_FLOOR >= 0, "deadband floor must not be negative");
+static_assert(DEADBAND_SIGMA_FACTOR > 0.0f, "deadband sigma factor must be greater than zero");
+static_assert(PULSE_THRESHOLD >= 1 && PULSE_POWER > PULSE_THRESHOLD, "pulse power must be greater than the pulse threshold");
+static_assert(PULSE_WINDOW >= 1, "pulse window must be at least one second");
+static_assert(MIN_DISCHARGE_POWER >= 0 && MAX_DISCHARGE_POWER >= MIN_DISCHARGE_POWER, "max discharge power must not be below the min discharge power");
+static_assert(MODE_HYSTERESIS >= 0, "mode hysteresis must not be negative");
+static_assert(THERMAL_DERATE_START >= 30 && THERMAL_DERATE_START <= 100, "thermal derate start must be between 30 and 100 degree celsius");
+static_assert(LOAD_PROFILE_SPIKE_DISCOUNT >= 0.0f && LOAD_PROFILE_SPIKE_DISCOUNT <= 1.0f, "load profile spike discount must be between 0 and 1");
+static_assert(BATTERY_CAPACITY > 0.0f, "battery capacity must be greater than zero");
+static_assert(SOC_TAPER_START >= 0 && SOC_TAPER_START <= 100, "soc taper start must be between 0 and 100 percent");
+static_assert(METER_RESEND_TIME >= 1 && METER_HOLD_TIME > METER_RESEND_TIME && METER_RAMP_DOWN_TIME >= METER_HOLD_TIME
+                && METER_TIMEOUT >= METER_RAMP_DOWN_TIME && METER_STANDBY_TIME >= METER_TIMEOUT,
+                "meter watchdog times must be ascending (resend < hold <= rampdown <= timeout <= standby)");
+static_assert(METER_RAMP_DOWN_STEP > 0, "meter ramp down step must be greater than zero");
+static_assert(METER_INTERVAL_FAST >= 100 && METER_INTERVAL_STEADY >= METER_INTERVAL_FAST && METER_INTERVAL_STANDBY >= METER_INTERVAL_STEADY
+                && METER_INTERVAL_STANDBY < METER_HOLD_TIME * 1000, "meter intervals must be ascending (100 <= fast <= steady <= standby) and below the meter hold time");
+static_assert(!CHARGE_STAGES_ENABLED || (CHARGER_FLOAT_VOLTAGE >= PSU_MIN_VOLTAGE && CHARGER_FLOAT_VOLTAGE < CHARGER_ABSORPTION_VOLTAGE),
+                "float voltage must be below the absorption voltage");
+static_assert(!CHARGE_STAGES_ENABLED || (EQUALIZE_VOLTAGE >= CHARGER_ABSORPTION_VOLTAGE && EQUALIZE_VOLTAGE <= PSU_MAX_VOLTAGE),
+                "equalize voltage must be between the absorption voltage and the max PSU voltage");
+static_assert(ABSORPTION_TIME >= 1 && EQUALIZE_TIME >= 1 && EQUALIZE_INTERVAL >= 1, "charge stage times must be at least one minute (one day)");
+static_assert(FLOAT_MAX_CURRENT >= 0.0f, "float max current must not be negative");
+static_assert(SELF_PROFILE_REPORT_INTERVAL == 0 || SELF_PROFILE_REPORT_INTERVAL >= PROFILE_SAMPLE_INTERVAL / 1000,
+                "self profile report interval must be 0 or at least one sample interval");
+static_assert(SCHEDULED_EXIT_HOUR >= 0 && SCHEDULED_EXIT_HOUR <= 23, "scheduled exit hour must be between 0 and 23");
+static_assert(SCHEDULED_EXIT_MINUTE >= 0 && SCHEDULED_EXIT_MINUTE <= 59, "scheduled exit minute must be between 0 and 59");
+static_assert(SD_KEEP_ALIVE_TIME >= 10, "slot detect keep alive time must be at least 10 seconds");
+
+// the file name is ignored, there is nothing to read
+ConfigFile::ConfigFile(std::string) {
+    // comma separated list of interfaces (one worker per interface)
+    m_canInterfaceNames = split(CAN_INTERFACE_NAME, ',');
+}
+
+ConfigFile::~ConfigFile() {}
+
+bool ConfigFile::loadConfig() {
+    std::cout << "[Config] Using the compiled in config profile" << std::endl;
+    return true;
+}
+
+// the compiled in values can't be changed at runtime
+bool ConfigFile::storeValue(const std::string& key, const std::string& value) {
+    std::cerr << "[Config] Config is compiled in --> set " << key << ": " << value << " in the profile and rebuild" << std::endl;
+    return false;
+}
+
+const std::vector<std::string>& ConfigFile::getCanInterfaceNames() const {
+    return m_canInterfaceNames;
+}
+
+#endif
@@ -0,0 +1,231 @@
+/*
+    File: EnergyLedger.cpp
+
+    written by Elias Geiger
+*/
+
+#include "EnergyLedger.h"
+
+// constructor and destructor
+EnergyLedger::EnergyLedger(std::string directory) {
+    m_directory = directory;
+    m_threadRunning = false;
+    memset(&m_currentRecord, 0, sizeof(m_currentRecord));
+    m_currentMinute = 0;
+    m_lastSampleTime = steady_clock::now();
+    m_lastGridPower = m_lastAcInputPower = m_lastDcOutputPower = 0.0f;
+    m_hasLastSample = false;
+    m_pendingHead = 0;
+    m_pendingCount = 0;
+    m_mappedFile = nullptr;
+    m_mappedDate = 0;
+}
+
+EnergyLedger::~EnergyLedger() {}
+
+// method to create the ledger directory and launch the writer thread
+bool EnergyLedger::setup() {
+    // only setup once
+    if(m_threadRunning) {
+        return false;
+    }
+
+    if(mkdir(m_directory.c_str(), 0755) < 0 && errno != EEXIST) {
+        std::cerr << "Failed to create energy ledger directory " << m_directory << std::endl;
+        return false;
+    }
+
+    m_threadRunning = true;
+    m_writerTh = std::thread([] (EnergyLedger* ptr) {
+        std::cout << "[Ledger-thread] writer thread running ..." << std::endl;
+        registerProfileThread("Ledger");
+
+        std::unique_lock<std::mutex> lock(ptr->m_mutex);
+        while(true) {
+            ptr->m_wakeUp.wait_for(lock, milliseconds(1000));
+            countSyscalls();
+
+            // write out all completed records. file I/O is done without holding the lock
+            while(ptr->m_pendingCount > 0) {
+                PendingLedgerRecord pending = ptr->m_pending[ptr->m_pendingHead];
+                ptr->m_pendingHead = (ptr->m_pendingHead + 1) % LEDGER_PENDING_SLOTS;
+                ptr->m_pendingCount--;
+
+                lock.unlock();
+                ptr->writeRecord(pending);
+                lock.lock();
+            }
+
+            if(!ptr->m_threadRunning) {
+                break;
+            }
+        }
+        lock.unlock();
+
+        ptr->unmapDailyFile();
+        unregisterProfileThread();
+        std::cout << "[Ledger-thread] closeup --> finish thread now" << std::endl;
+    }, this);
+
+    return true;
+}
+
+// method to write out the incomplete minute and stop the writer thread
+void EnergyLedger::closeUp() {
+    if(!m_threadRunning) {
+        return;
+    }
+
+    {
+        const std::lock_guard<std::mutex> lock(m_mutex);
+        if(m_currentRecord.sampleCount > 0) {
+            flushCurrentRecord();
+        }
+        m_threadRunning = false;
+    }
+    m_wakeUp.notify_all();
+
+    m_writerTh.join();
+}
+
+// accumulates a new meter reading along with the PSU telemetry. No allocation or file I/O here
+void EnergyLedger::addSample(short gridPower, float acInputPower, float dcOutputPower) {
+    const std::lock_guard<std::mutex> lock(m_mutex);
+    auto currentTime = steady_clock::now();
+    time_t currentMinute = time(NULL) / 60 * 60;
+
+    // integrate the previous values over the time since the last sample (skip meter downtimes)
+    if(m_hasLastSample) {
+        long timeElapsed = duration_cast<milliseconds>(currentTime - m_lastSampleTime).count();
+        if(timeElapsed < LEDGER_MAX_SAMPLE_GAP * 1000L) {
+            float hours = timeElapsed / 3600000.0f;
+            if(m_lastGridPower > 0.0f) {
+                m_currentRecord.gridImportWh += m_lastGridPower * hours;
+            } else {
+                m_currentRecord.gridExportWh += -m_lastGridPower * hours;
+            }
+            m_currentRecord.acInputWh += m_lastAcInputPower * hours;
+            m_currentRecord.dcOutputWh += m_lastDcOutputPower * hours;
+
+            // without the charger the grid power would have been lower by its AC input power
+            float wouldBeGridPower = m_lastGridPower - m_lastAcInputPower;
+            if(wouldBeGridPower < 0.0f) {
+                float capturedPower = -wouldBeGridPower < m_lastAcInputPower ? -wouldBeGridPower : m_lastAcInputPower;
+                m_currentRecord.capturedWh += capturedPower * hours;
+            }
+        }
+    }
+
+    // minute completed --> hand over to the writer thread
+    if(currentMinute != m_currentMinute) {
+        if(m_currentRecord.sampleCount > 0) {
+            flushCurrentRecord();
+        }
+        memset(&m_currentRecord, 0, sizeof(m_currentRecord));
+        m_currentMinute = currentMinute;
+    }
+
+    m_currentRecord.flags |= LEDGER_RECORD_VALID;
+    m_currentRecord.sampleCount++;
+    m_lastGridPower = gridPower;
+    m_lastAcInputPower = acInputPower;
+    m_lastDcOutputPower = dcOutputPower;
+    m_lastSampleTime = currentTime;
+    m_hasLastSample = true;
+}
+
+// moves the current record into the pending ring (called with locked mutex)
+void EnergyLedger::flushCurrentRecord() {
+    // ring is full --> writer thread is stuck, drop the oldest record
+    if(m_pendingCount == LEDGER_PENDING_SLOTS) {
+        m_pendingHead = (m_pendingHead + 1) % LEDGER_PENDING_SLOTS;
+        m_pendingCount--;
+    }
+
+    unsigned int slot = (m_pendingHead + m_pendingCount) % LEDGER_PENDING_SLOTS;
+    m_pending[slot].minuteStart = m_currentMinute;
+    m_pending[slot].record = m_currentRecord;
+    m_pendingCount++;
+    m_wakeUp.notify_all();
+}
+
+// stores a minute record in the daily file and updates the index (writer thread only)
+void EnergyLedger::writeRecord(const PendingLedgerRecord& pending) {
+    struct tm tmLocal;
+    localtime_r(&pending.minuteStart, &tmLocal);
+    uint32_t date = (tmLocal.tm_year + 1900) * 10000 + (tmLocal.tm_mon + 1) * 100 + tmLocal.tm_mday;
+
+    // switch to the file of the day
+    if(date != m_mappedDate) {
+        unmapDailyFile();
+        if(!mapDailyFile(date, tmLocal.tm_year + 1900, tmLocal.tm_mon + 1, tmLocal.tm_mday)) {
+            return;
+        }
+    }
+
+    // a record for this minute may already exist after a restart --> accumulate
+    int minuteOfDay = tmLocal.tm_hour * 60 + tmLocal.tm_min;
+    addLedgerRecord(m_mappedFile->minutes[minuteOfDay], pending.record);
+    addLedgerRecord(m_mappedFile->header.hourTotals[tmLocal.tm_hour], pending.record);
+    addLedgerRecord(m_mappedFile->header.dayTotal, pending.record);
+
+    msync(m_mappedFile, sizeof(LedgerFile), MS_ASYNC);
+}
+
+// opens or creates the file of the given day and maps it into memory
+bool EnergyLedger::mapDailyFile(uint32_t date, int year, int month, int day) {
+    char fileName[256];
+    getLedgerFileName(fileName, sizeof(fileName), m_directory.c_str(), year, month, day);
+
+    int fd = open(fileName, O_RDWR | O_CREAT, 0644);
+    if(fd < 0) {
+        std::cerr << "[Ledger] Failed to open " << fileName << std::endl;
+        return false;
+    }
+
+    // new files are zero filled up to the full size
+    struct stat fileStat;
+    if(fstat(fd, &fileStat) < 0 || (fileStat.st_size == 0 && ftruncate(fd, sizeof(LedgerFile)) < 0)) {
+        std::cerr << "[Ledger] Failed to prepare " << fileName << std::endl;
+        close(fd);
+        return false;
+    }
+    if(fileStat.st_size != 0 && fileStat.st_size != sizeof(LedgerFile)) {
+        std::cerr << "[Ledger] Invalid file size of " << fileName << " (ignore)" << std::endl;
+        close(fd);
+        return false;
+    }
+
+    void* mapping = mmap(NULL, sizeof(LedgerFile), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(mapping == MAP_FAILED) {
+        std::cerr << "[Ledger] Failed to map " << fileName << std::endl;
+        return false;
+    }
+    m_mappedFile = static_cast<LedgerFile*>(mapping);
+
+    // initialize the header of new files
+    if(m_mappedFile->header.magic == 0) {
+        m_mappedFile->header.magic = LEDGER_MAGIC;
+        m_mappedFile->header.version = LEDGER_VERSION;
+        m_mappedFile->header.date = date;
+    } else if(m_mappedFile->header.magic != LEDGER_MAGIC || m_mappedFile->header.version != LEDGER_VERSION) {
+        std::cerr << "[Ledger] Incompatible file " << fileName << " (ignore)" << std::endl;
+        unmapDailyFile();
+        return false;
+    }
+
+    m_mappedDate = date;
+    return true;
+}
+
+void EnergyLedger::unmapDailyFile() {
+    if(m_mappedFile == nullptr) {
+        return;
+    }
+
+    msync(m_mappedFile, sizeof(LedgerFile), MS_SYNC);
+    munmap(m_mappedFile, sizeof(LedgerFile));
+    m_mappedFile = nullptr;
+    m_mappedDate = 0;
+}
@@ -0,0 +1,84 @@
+/*
+    File: EnergyLedger.h
+    The energy ledger integrates grid power, PSU AC input and DC output power per minute 
+    and persists the minute records to memory mapped daily files (see LedgerFormat.h). 
+    Samples are only accumulated in memory, a separate writer thread does all the file I/O
+
+    written by Elias Geiger
+*/
+
+#pragma once
+
+#include <iostream>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstring>
+#include <cerrno>
+#include <ctime>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "LedgerFormat.h"
+#include "SelfProfile.h"
+
+using std::chrono::steady_clock;
+using std::chrono::milliseconds;
+using std::chrono::duration_cast;
+
+// meter readings further apart than this are not integrated (meter downtime) in seconds
+#define LEDGER_MAX_SAMPLE_GAP 60
+
+// number of completed minute records that can wait for the writer thread
+#define LEDGER_PENDING_SLOTS 16
+
+// a completed minute record waiting to be written
+struct PendingLedgerRecord
+{
+    time_t minuteStart;
+    LedgerRecord record;
+};
+
+class EnergyLedger
+{
+    std::string m_directory;
+
+    std::thread m_writerTh;
+    std::atomic<bool> m_threadRunning;
+    std::mutex m_mutex;
+    std::condition_variable m_wakeUp;
+
+    // accumulation of the current minute (protected by mutex)
+    LedgerRecord m_currentRecord;
+    time_t m_currentMinute;
+    steady_clock::time_point m_lastSampleTime;
+    float m_lastGridPower, m_lastAcInputPower, m_lastDcOutputPower;
+    bool m_hasLastSample;
+
+    // fixed ring of completed records (protected by mutex)
+    PendingLedgerRecord m_pending[LEDGER_PENDING_SLOTS];
+    unsigned int m_pendingHead, m_pendingCount;
+
+    // currently mapped daily file (writer thread only)
+    LedgerFile* m_mappedFile;
+    uint32_t m_mappedDate;
+
+public:
+    EnergyLedger(std::string);
+    ~EnergyLedger();
+
+    bool setup();
+    void closeUp();
+    void addSample(short, float, float);
+
+private:
+    void flushCurrentRecord();
+    void writeRecord(const PendingLedgerRecord&);
+    bool mapDailyFile(uint32_t, int, int, int);
+    void unmapDailyFile();
+};
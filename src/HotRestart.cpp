@@ -0,0 +1,191 @@
+/*
+    File: HotRestart.cpp
+
+    written by Elias Geiger
+*/
+
+#include "HotRestart.h"
+
+// constructor and destructor
+HotRestart::HotRestart() {
+    m_listenSocket = -1;
+    m_peerSocket = -1;
+}
+
+HotRestart::~HotRestart() {}
+
+// creates the unix socket a new process can connect to for taking over
+bool HotRestart::listenForTakeover(const char* socketPath) {
+    m_listenSocket = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if(m_listenSocket < 0) {
+        std::cerr << "[HotRestart] Failed to create unix socket!" << std::endl;
+        return false;
+    }
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socketPath, sizeof(addr.sun_path) - 1);
+
+    // remove the socket file of a previous process
+    unlink(socketPath);
+    if(bind(m_listenSocket, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(m_listenSocket, 1) < 0) {
+        std::cerr << "[HotRestart] Failed to listen on " << socketPath << std::endl;
+        close(m_listenSocket);
+        m_listenSocket = -1;
+        return false;
+    }
+
+    return true;
+}
+
+// checks for a connecting process without blocking. returns true if a takeover was requested
+bool HotRestart::pollTakeoverRequest() {
+    if(m_listenSocket < 0) {
+        return false;
+    }
+
+    m_peerSocket = accept(m_listenSocket, NULL, NULL);
+    countSyscalls();
+    return m_peerSocket >= 0;
+}
+
+// sends the sockets and the state to the new process and waits for its confirmation
+bool HotRestart::handOver(const HandoverState& state, const std::vector<int>& fds) {
+    // one socket per CAN interface and the UDP socket
+    if(fds.size() > HOT_RESTART_MAX_BUSES + 1) {
+        std::cerr << "[HotRestart] Too many sockets to hand over (" << fds.size() << ")!" << std::endl;
+        close(m_peerSocket);
+        m_peerSocket = -1;
+        return false;
+    }
+
+    // the ancillary data carries the file descriptors
+    char control[CMSG_SPACE(sizeof(int) * (HOT_RESTART_MAX_BUSES + 1))];
+    memset(control, 0, sizeof(control));
+
+    struct iovec iov;
+    iov.iov_base = (void*)&state;
+    iov.iov_len = sizeof(state);
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = CMSG_SPACE(sizeof(int) * fds.size());
+
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+    memcpy(CMSG_DATA(cmsg), fds.data(), sizeof(int) * fds.size());
+
+    // peer socket was accepted non-blocking --> wait until the message can be written
+    if(!waitForPeer(POLLOUT) || sendmsg(m_peerSocket, &msg, MSG_NOSIGNAL) != sizeof(state)) {
+        std::cerr << "[HotRestart] Failed to send state to the new process!" << std::endl;
+        close(m_peerSocket);
+        m_peerSocket = -1;
+        return false;
+    }
+
+    // the new process confirms after its workers are running
+    char confirmation = 0;
+    bool confirmed = waitForPeer(POLLIN) && read(m_peerSocket, &confirmation, 1) == 1 && confirmation == 'K';
+    close(m_peerSocket);
+    m_peerSocket = -1;
+    if(!confirmed) {
+        std::cerr << "[HotRestart] New process did not confirm the takeover!" << std::endl;
+    }
+
+    return confirmed;
+}
+
+// connects to the running process and receives its sockets and state
+bool HotRestart::takeOver(const char* socketPath, HandoverState& state, std::vector<int>& fds) {
+    m_peerSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(m_peerSocket < 0) {
+        return false;
+    }
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socketPath, sizeof(addr.sun_path) - 1);
+    if(connect(m_peerSocket, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        std::cerr << "[HotRestart] No running process found at " << socketPath << std::endl;
+        closeUp();
+        return false;
+    }
+
+    char control[CMSG_SPACE(sizeof(int) * (HOT_RESTART_MAX_BUSES + 1))];
+    struct iovec iov;
+    iov.iov_base = &state;
+    iov.iov_len = sizeof(state);
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    if(!waitForPeer(POLLIN) || recvmsg(m_peerSocket, &msg, MSG_WAITALL) != sizeof(state) || state.version != HOT_RESTART_VERSION) {
+        std::cerr << "[HotRestart] Failed to receive state from the running process!" << std::endl;
+        closeUp();
+        return false;
+    }
+
+    // extract the received file descriptors
+    fds.clear();
+    for(struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if(cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) {
+            continue;
+        }
+        size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        int* received = (int*)CMSG_DATA(cmsg);
+        fds.insert(fds.end(), received, received + count);
+    }
+
+    // a truncated message or more sockets than interfaces --> close what was received
+    if((msg.msg_flags & MSG_CTRUNC) || fds.size() > HOT_RESTART_MAX_BUSES + 1 || state.canBusCount > HOT_RESTART_MAX_BUSES) {
+        std::cerr << "[HotRestart] Invalid sockets received from the running process!" << std::endl;
+        for(int fd : fds) {
+            close(fd);
+        }
+        fds.clear();
+        closeUp();
+        return false;
+    }
+
+    return fds.size() == state.canBusCount + 1;
+}
+
+// tells the old process that the workers are running and it may exit now
+void HotRestart::confirmTakeover() {
+    const char confirmation = 'K';
+    if(write(m_peerSocket, &confirmation, 1) != 1) {
+        std::cerr << "[HotRestart] Failed to confirm the takeover!" << std::endl;
+    }
+    close(m_peerSocket);
+    m_peerSocket = -1;
+}
+
+void HotRestart::closeUp() {
+    if(m_peerSocket >= 0) {
+        close(m_peerSocket);
+        m_peerSocket = -1;
+    }
+    if(m_listenSocket >= 0) {
+        close(m_listenSocket);
+        m_listenSocket = -1;
+    }
+}
+
+// waits for the peer socket to become readable/writable. returns false on timeout
+bool HotRestart::waitForPeer(short events) {
+    struct pollfd pfd;
+    pfd.fd = m_peerSocket;
+    pfd.events = events;
+    return poll(&pfd, 1, HOT_RESTART_TIMEOUT) > 0 && (pfd.revents & events);
+}
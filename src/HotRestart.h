@@ -0,0 +1,70 @@
+/*
+    File: HotRestart.h
+    Hot restart hands over the control from a running regulator process to a newly started one
+    (e.g. after a binary upgrade) without a gap. The running process listens on a unix socket, 
+    the new process connects to it and receives the open CAN/UDP sockets via SCM_RIGHTS 
+    along with a snapshot of the regulator state
+
+    written by Elias Geiger
+*/
+
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+
+#include <unistd.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <net/if.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "CanBus.h"
+#include "default-conf.h"
+
+#define HOT_RESTART_VERSION 2
+#define HOT_RESTART_MAX_BUSES MAX_CAN_INTERFACES
+#define HOT_RESTART_TIMEOUT 5000            // max wait time for the peer process in milliseconds
+
+// snapshot of the regulator state that is handed over to the new process
+struct HandoverState
+{
+    uint32_t version;
+    uint32_t canBusCount;
+    float lastCurrentCmd;
+    float lastVoltageCmd;
+    uint8_t slotDetectOn;
+    int64_t msSinceLastCharge;              // slot detect keep alive timer
+    int64_t msSinceLastMeterReading;        // meter watchdog timer
+    int16_t dischargePower;                 // setpoint of the discharge inverter
+    char interfaceNames[HOT_RESTART_MAX_BUSES][IFNAMSIZ];
+    RectifierParameters telemetry[HOT_RESTART_MAX_BUSES];
+};
+
+class HotRestart
+{
+    int m_listenSocket;
+    int m_peerSocket;
+
+public:
+    HotRestart();
+    ~HotRestart();
+
+    // running process //
+    bool listenForTakeover(const char*);
+    bool pollTakeoverRequest();
+    bool handOver(const HandoverState&, const std::vector<int>&);
+
+    // new process //
+    bool takeOver(const char*, HandoverState&, std::vector<int>&);
+    void confirmTakeover();
+
+    void closeUp();
+
+private:
+    bool waitForPeer(short);
+};
@@ -0,0 +1,94 @@
+/*
+    File: InverterLink.cpp
+    written by Elias Geiger
+*/
+
+#include "InverterLink.h"
+
+// constructor and destructor
+InverterLink::InverterLink() {
+    m_socket = -1;
+    memset(&m_inverterAddr, 0, sizeof(m_inverterAddr));
+    m_dischargePower = 0;
+    m_lastSendTime = 0;
+}
+
+InverterLink::~InverterLink() {}
+
+// creates the UDP socket towards the inverter
+bool InverterLink::setup(const char* address, short port) {
+    m_inverterAddr.sin_family = AF_INET;
+    m_inverterAddr.sin_port = htons(static_cast<uint16_t>(port));
+    if(inet_pton(AF_INET, address, &m_inverterAddr.sin_addr) != 1) {
+        std::cerr << "[Inverter] Invalid inverter address " << address << std::endl;
+        return false;
+    }
+
+    m_socket = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(m_socket < 0) {
+        std::cerr << "[Inverter] Failed to create udp socket!" << std::endl;
+        return false;
+    }
+
+    std::cout << "[Inverter] Discharge setpoints go to " << address << ":" << port << std::endl;
+    return true;
+}
+
+// sends a new discharge power setpoint (0 = off)
+bool InverterLink::setDischargePower(short power, long long timeMs) {
+    m_dischargePower = power;
+    m_lastSendTime = timeMs;
+    return sendSetpoint();
+}
+
+// repeats the current setpoint so the inverter keeps discharging
+void InverterLink::keepAlive(long long timeMs) {
+    if(m_socket < 0 || timeMs - m_lastSendTime < INVERTER_KEEP_ALIVE_TIME) {
+        return;
+    }
+    m_lastSendTime = timeMs;
+    sendSetpoint();
+}
+
+// continues with the setpoint of the previous process (hot restart)
+void InverterLink::restoreDischargePower(short power) {
+    m_dischargePower = power;
+}
+
+// turns the inverter off and closes the socket
+void InverterLink::closeUp() {
+    if(m_socket < 0) {
+        return;
+    }
+    m_dischargePower = 0;
+    sendSetpoint();
+    close(m_socket);
+    m_socket = -1;
+}
+
+// closes the own socket without touching the inverter (controlled by another process now)
+void InverterLink::detach() {
+    if(m_socket >= 0) {
+        close(m_socket);
+        m_socket = -1;
+    }
+}
+
+short InverterLink::getDischargePower() const {
+    return m_dischargePower;
+}
+
+bool InverterLink::sendSetpoint() {
+    if(m_socket < 0) {
+        return false;
+    }
+
+    char message[16];
+    int length = snprintf(message, sizeof(message), "%d", m_dischargePower);
+    countSyscalls();
+    if(sendto(m_socket, message, length, 0, (const struct sockaddr*)&m_inverterAddr, sizeof(m_inverterAddr)) != length) {
+        printf("[Inverter] Failed to send the discharge setpoint %dW\n", m_dischargePower);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,49 @@
+/*
+    File: InverterLink.h
+    Output channel to a battery discharge inverter. The AC discharge power setpoint is sent
+    as a plain decimal number in watts per UDP datagram (same format as the meter readings).
+    The setpoint is repeated periodically, the inverter falls back to zero without it
+
+    written by Elias Geiger
+*/
+
+#pragma once
+
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#include "default-conf.h"
+#include "SelfProfile.h"
+
+class InverterLink
+{
+    int m_socket;
+    struct sockaddr_in m_inverterAddr;
+
+    short m_dischargePower;
+    long long m_lastSendTime;
+
+public:
+    InverterLink();
+    ~InverterLink();
+
+    bool setup(const char*, short);
+    bool setDischargePower(short, long long);
+    void keepAlive(long long);
+    void restoreDischargePower(short);
+    void closeUp();
+    void detach();
+
+    // getters //
+    short getDischargePower() const;
+
+private:
+    bool sendSetpoint();
+};
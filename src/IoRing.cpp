@@ -0,0 +1,271 @@
+/*
+    File: IoRing.cpp
+    written by Elias Geiger
+*/
+
+#include "IoRing.h"
+
+// constructor and destructor
+IoRing::IoRing() {
+    m_ringFd = -1;
+    m_sqHead = m_sqTail = m_sqMask = m_sqArray = nullptr;
+    m_sqes = nullptr;
+    m_sqEntries = 0;
+    m_sqLocalTail = 0;
+    m_cqHead = m_cqTail = m_cqMask = nullptr;
+    m_cqes = nullptr;
+    m_sqRing = m_cqRing = MAP_FAILED;
+    m_sqRingSize = m_cqRingSize = m_sqesSize = 0;
+    m_enterCalls = 0;
+}
+
+IoRing::~IoRing() {
+    closeUp();
+}
+
+// creates the ring and maps the queues. fails on kernels without io_uring or without
+// the features needed here (timeout on the wait, kernel 5.11) and if it is blocked (seccomp)
+bool IoRing::setup(unsigned entries) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int ringFd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+    if(ringFd < 0) {
+        std::cerr << "[IoRing] Setup failed: " << strerror(errno) << std::endl;
+        return false;
+    }
+    m_ringFd = ringFd;
+    if(!(params.features & IORING_FEAT_EXT_ARG) || !(params.features & IORING_FEAT_NODROP)) {
+        std::cerr << "[IoRing] Kernel too old (wait timeout not supported)" << std::endl;
+        closeUp();
+        return false;
+    }
+
+    // both rings in one mapping if the kernel supports it
+    m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    m_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if(params.features & IORING_FEAT_SINGLE_MMAP) {
+        m_sqRingSize = m_cqRingSize = std::max(m_sqRingSize, m_cqRingSize);
+    }
+    m_sqRing = mmap(nullptr, m_sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringFd, IORING_OFF_SQ_RING);
+    if(m_sqRing == MAP_FAILED) {
+        std::cerr << "[IoRing] Failed to map the submission queue: " << strerror(errno) << std::endl;
+        closeUp();
+        return false;
+    }
+    if(params.features & IORING_FEAT_SINGLE_MMAP) {
+        m_cqRing = m_sqRing;
+    } else {
+        m_cqRing = mmap(nullptr, m_cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringFd, IORING_OFF_CQ_RING);
+        if(m_cqRing == MAP_FAILED) {
+            std::cerr << "[IoRing] Failed to map the completion queue: " << strerror(errno) << std::endl;
+            closeUp();
+            return false;
+        }
+    }
+    m_sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    void* sqes = mmap(nullptr, m_sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringFd, IORING_OFF_SQES);
+    if(sqes == MAP_FAILED) {
+        std::cerr << "[IoRing] Failed to map the submission entries: " << strerror(errno) << std::endl;
+        closeUp();
+        return false;
+    }
+    m_sqes = static_cast<struct io_uring_sqe*>(sqes);
+
+    char* sq = static_cast<char*>(m_sqRing);
+    m_sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    m_sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    m_sqMask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    m_sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    m_sqEntries = params.sq_entries;
+    m_sqLocalTail = *m_sqTail;
+
+    char* cq = static_cast<char*>(m_cqRing);
+    m_cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    m_cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    m_cqMask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    m_cqes = reinterpret_cast<struct io_uring_cqe*>(cq + params.cq_off.cqes);
+    return true;
+}
+
+// unmaps the queues and closes the ring. pending requests are cancelled by the kernel
+void IoRing::closeUp() {
+    if(m_sqes != nullptr) {
+        munmap(m_sqes, m_sqesSize);
+        m_sqes = nullptr;
+    }
+    if(m_cqRing != MAP_FAILED && m_cqRing != m_sqRing) {
+        munmap(m_cqRing, m_cqRingSize);
+    }
+    if(m_sqRing != MAP_FAILED) {
+        munmap(m_sqRing, m_sqRingSize);
+    }
+    m_sqRing = m_cqRing = MAP_FAILED;
+    if(m_ringFd >= 0) {
+        close(m_ringFd);
+        m_ringFd = -1;
+    }
+}
+
+// registers buffers for the fixed writes (pinned once instead of on every write)
+bool IoRing::registerBuffers(const struct iovec* buffers, unsigned count) {
+    if(syscall(__NR_io_uring_register, m_ringFd, IORING_REGISTER_BUFFERS, buffers, count) < 0) {
+        std::cerr << "[IoRing] Failed to register buffers: " << strerror(errno) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// hands a number of equally sized buffers (consecutive ids) to the kernel for the receives of a group
+bool IoRing::provideBuffers(void* buffers, unsigned length, unsigned count, uint16_t group, uint16_t firstId, uint64_t userData) {
+    struct io_uring_sqe* sqe = getSqe();
+    if(sqe == nullptr) {
+        return false;
+    }
+    sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+    sqe->fd = static_cast<int>(count);
+    sqe->addr = reinterpret_cast<uint64_t>(buffers);
+    sqe->len = length;
+    sqe->off = firstId;
+    sqe->buf_group = group;
+    sqe->user_data = userData;
+    return true;
+}
+
+// receives until the socket fails or the buffers of the group run out (kernel 6.0)
+bool IoRing::recvMultishot(int fd, uint16_t group, uint64_t userData) {
+    struct io_uring_sqe* sqe = getSqe();
+    if(sqe == nullptr) {
+        return false;
+    }
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = group;
+    sqe->user_data = userData;
+    return true;
+}
+
+// like recvMultishot, every buffer starts with a struct io_uring_recvmsg_out followed by the sender address
+bool IoRing::recvMsgMultishot(int fd, struct msghdr* msg, uint16_t group, uint64_t userData) {
+    struct io_uring_sqe* sqe = getSqe();
+    if(sqe == nullptr) {
+        return false;
+    }
+    sqe->opcode = IORING_OP_RECVMSG;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(msg);
+    sqe->len = 1;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = group;
+    sqe->user_data = userData;
+    return true;
+}
+
+// writes from a registered buffer (sockets need offset 0)
+bool IoRing::writeFixed(int fd, const void* data, unsigned length, uint16_t bufferIndex, uint64_t userData) {
+    struct io_uring_sqe* sqe = getSqe();
+    if(sqe == nullptr) {
+        return false;
+    }
+    sqe->opcode = IORING_OP_WRITE_FIXED;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(data);
+    sqe->len = length;
+    sqe->buf_index = bufferIndex;
+    sqe->user_data = userData;
+    return true;
+}
+
+bool IoRing::read(int fd, void* data, unsigned length, uint64_t userData) {
+    struct io_uring_sqe* sqe = getSqe();
+    if(sqe == nullptr) {
+        return false;
+    }
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(data);
+    sqe->len = length;
+    sqe->user_data = userData;
+    return true;
+}
+
+// cancels the pending request with the given user data (e.g. a multishot receive on a socket being closed)
+bool IoRing::cancel(uint64_t userData) {
+    struct io_uring_sqe* sqe = getSqe();
+    if(sqe == nullptr) {
+        return false;
+    }
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->addr = userData;
+    sqe->user_data = 0;
+    return true;
+}
+
+// submits the queued requests and waits up to the timeout for a completion (0 = submit only).
+// one syscall at most, none if there is nothing to submit and completions are ready.
+// returns the number of completions ready or the negative error of the syscall
+int IoRing::submitAndWait(int timeoutMs) {
+    __atomic_store_n(m_sqTail, m_sqLocalTail, __ATOMIC_RELEASE);
+    unsigned toSubmit = m_sqLocalTail - __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE);
+    unsigned ready = __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE) - *m_cqHead;
+    bool wait = timeoutMs > 0 && ready == 0;
+
+    if(toSubmit > 0 || wait) {
+        struct __kernel_timespec timeout;
+        timeout.tv_sec = timeoutMs / 1000;
+        timeout.tv_nsec = (timeoutMs % 1000) * 1000000LL;
+        struct io_uring_getevents_arg arg;
+        memset(&arg, 0, sizeof(arg));
+        arg.ts = reinterpret_cast<uint64_t>(&timeout);
+
+        unsigned flags = IORING_ENTER_EXT_ARG | (wait ? IORING_ENTER_GETEVENTS : 0);
+        m_enterCalls++;
+        countSyscalls();
+        if(syscall(__NR_io_uring_enter, m_ringFd, toSubmit, wait ? 1 : 0, flags, &arg, sizeof(arg)) < 0
+                && errno != ETIME && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            return -errno;
+        }
+        ready = __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE) - *m_cqHead;
+    }
+    return static_cast<int>(ready);
+}
+
+// copies the next completion and hands its slot back to the kernel
+bool IoRing::popCompletion(struct io_uring_cqe& cqe) {
+    unsigned head = *m_cqHead;
+    if(head == __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE)) {
+        return false;
+    }
+    cqe = m_cqes[head & *m_cqMask];
+    __atomic_store_n(m_cqHead, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+bool IoRing::isActive() const {
+    return m_ringFd >= 0;
+}
+
+unsigned long IoRing::getEnterCalls() const {
+    return m_enterCalls;
+}
+
+// next free submission entry (cleared). a full queue is submitted first
+struct io_uring_sqe* IoRing::getSqe() {
+    if(m_ringFd < 0) {
+        return nullptr;
+    }
+    if(m_sqLocalTail - __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE) >= m_sqEntries) {
+        submitAndWait(0);
+        if(m_sqLocalTail - __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE) >= m_sqEntries) {
+            return nullptr;
+        }
+    }
+    unsigned index = m_sqLocalTail & *m_sqMask;
+    struct io_uring_sqe* sqe = &m_sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    m_sqArray[index] = index;
+    m_sqLocalTail++;
+    return sqe;
+}
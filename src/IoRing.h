@@ -0,0 +1,73 @@
+/*
+    File: IoRing.h
+    Minimal io_uring wrapper on the raw syscalls (no liburing needed). One ring is used by one
+    thread only. Requests are queued and submitted together with the next wait, so a batch of
+    CAN writes and the wait for new frames cost a single syscall. Receives are multishot with
+    buffers provided to the kernel once, completions carry the id of the used buffer
+
+    written by Elias Geiger
+*/
+
+#pragma once
+
+#include <iostream>
+#include <cstring>
+#include <cstdint>
+#include <cerrno>
+#include <algorithm>
+
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#include "SelfProfile.h"
+
+class IoRing
+{
+    int m_ringFd;
+
+    // submission queue (shared with the kernel)
+    unsigned *m_sqHead, *m_sqTail, *m_sqMask, *m_sqArray;
+    struct io_uring_sqe* m_sqes;
+    unsigned m_sqEntries;
+    unsigned m_sqLocalTail;         // queued, but not yet published to the kernel
+
+    // completion queue (shared with the kernel)
+    unsigned *m_cqHead, *m_cqTail, *m_cqMask;
+    struct io_uring_cqe* m_cqes;
+
+    // mappings
+    void *m_sqRing, *m_cqRing;
+    size_t m_sqRingSize, m_cqRingSize, m_sqesSize;
+
+    unsigned long m_enterCalls;
+
+public:
+    IoRing();
+    ~IoRing();
+
+    bool setup(unsigned);
+    void closeUp();
+    bool registerBuffers(const struct iovec*, unsigned);
+
+    // queue requests (submitted with the next wait) //
+    bool provideBuffers(void*, unsigned, unsigned, uint16_t, uint16_t, uint64_t);
+    bool recvMultishot(int, uint16_t, uint64_t);
+    bool recvMsgMultishot(int, struct msghdr*, uint16_t, uint64_t);
+    bool writeFixed(int, const void*, unsigned, uint16_t, uint64_t);
+    bool read(int, void*, unsigned, uint64_t);
+    bool cancel(uint64_t);
+
+    int submitAndWait(int);
+    bool popCompletion(struct io_uring_cqe&);
+
+    // getters //
+    bool isActive() const;
+    unsigned long getEnterCalls() const;
+
+private:
+    struct io_uring_sqe* getSqe();
+};
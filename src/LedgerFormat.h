@@ -0,0 +1,67 @@
+/*
+    File: LedgerFormat.h
+    Binary file format of the energy ledger. There is one file per day (ledger/YYYY-MM-DD.bin) with 
+    a fixed size record for every minute of the day. The header holds the hourly and daily totals 
+    as a small index, so range queries only need to read the parts they cover
+
+    written by Elias Geiger
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+
+#define LEDGER_MAGIC 0x52474C45             // "ELGR"
+#define LEDGER_VERSION 1
+#define LEDGER_MINUTES_PER_DAY 1440
+#define LEDGER_HOURS_PER_DAY 24
+
+// record flags
+#define LEDGER_RECORD_VALID 0x01
+
+// energy flows within one interval (minute, hour or day) in watt hours
+struct LedgerRecord
+{
+    uint32_t flags;
+    uint32_t sampleCount;
+    float gridImportWh;
+    float gridExportWh;
+    float acInputWh;
+    float dcOutputWh;
+    float capturedWh;           // would-be-exported energy the charger took instead
+    float reserved;
+};
+
+struct LedgerFileHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t date;              // YYYYMMDD
+    uint32_t reserved;
+    LedgerRecord dayTotal;
+    LedgerRecord hourTotals[LEDGER_HOURS_PER_DAY];
+};
+
+// complete memory layout of a daily ledger file
+struct LedgerFile
+{
+    LedgerFileHeader header;
+    LedgerRecord minutes[LEDGER_MINUTES_PER_DAY];
+};
+
+// adds the energy flows of a record to a total
+inline void addLedgerRecord(LedgerRecord& total, const LedgerRecord& record) {
+    total.flags |= record.flags;
+    total.sampleCount += record.sampleCount;
+    total.gridImportWh += record.gridImportWh;
+    total.gridExportWh += record.gridExportWh;
+    total.acInputWh += record.acInputWh;
+    total.dcOutputWh += record.dcOutputWh;
+    total.capturedWh += record.capturedWh;
+}
+
+// builds the file name of a daily ledger file
+inline void getLedgerFileName(char* buffer, size_t size, const char* directory, int year, int month, int day) {
+    snprintf(buffer, size, "%s/%04d-%02d-%02d.bin", directory, year, month, day);
+}
@@ -0,0 +1,391 @@
+/*
+    File: LoadProfile.cpp
+    written by Elias Geiger
+*/
+
+#include "LoadProfile.h"
+
+#include <algorithm>
+
+static const char* const dayNames[LOAD_PROFILE_DAYS] = { "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat" };
+
+// constructor and destructor
+LoadProfile::LoadProfile(std::string fileName) {
+    m_fileName = fileName;
+    m_file = nullptr;
+    m_currentDay = m_currentSlot = -1;
+    for(int i = 0; i < LOAD_PROFILE_SLOT_MINUTES; i++) {
+        m_minuteSums[i] = 0.0f;
+        m_minuteCounts[i] = 0;
+    }
+    m_previousTail = NAN;
+    m_quietLoad = NAN;
+    m_lastSampleTime = 0;
+    m_pendingStep = m_stepFrom = 0.0f;
+    m_pendingUntil = 0;
+    m_confirmCount = 0;
+    m_inSpike = m_spikeExpired = false;
+    m_spikeStart = 0;
+    m_spikeHeight = m_spikeDuration = m_spikeLoad = 0.0f;
+    m_feedForward = false;
+    m_eventOpen = m_eventReference = false;
+    m_eventDay = m_eventSlot = 0;
+    m_eventUntil = 0;
+    m_eventExportWh = 0.0f;
+    m_reportDay = -1;
+    m_steps = m_spikes = 0;
+    m_correctedEvents = m_referenceEvents = 0;
+    m_correctedExportWh = m_expectedExportWh = m_referenceExportWh = 0.0f;
+}
+
+LoadProfile::~LoadProfile() {}
+
+// maps the profile file (created zero filled on the first start). without feed-forward every event
+// is a reference
+bool LoadProfile::setup(bool feedForward) {
+    if(m_file != nullptr) {
+        return false;
+    }
+    m_feedForward = feedForward;
+
+    int fd = open(m_fileName.c_str(), O_RDWR | O_CREAT, 0644);
+    if(fd < 0) {
+        std::cerr << "[Profile] Failed to open " << m_fileName << std::endl;
+        return false;
+    }
+
+    struct stat fileStat;
+    if(fstat(fd, &fileStat) < 0 || (fileStat.st_size == 0 && ftruncate(fd, sizeof(LoadProfileFile)) < 0)) {
+        std::cerr << "[Profile] Failed to prepare " << m_fileName << std::endl;
+        close(fd);
+        return false;
+    }
+    if(fileStat.st_size != 0 && fileStat.st_size != sizeof(LoadProfileFile)) {
+        std::cerr << "[Profile] Invalid file size of " << m_fileName << " (ignore)" << std::endl;
+        close(fd);
+        return false;
+    }
+
+    void* mapping = mmap(NULL, sizeof(LoadProfileFile), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(mapping == MAP_FAILED) {
+        std::cerr << "[Profile] Failed to map " << m_fileName << std::endl;
+        return false;
+    }
+    m_file = static_cast<LoadProfileFile*>(mapping);
+
+    if(m_file->magic == 0) {
+        m_file->magic = LOAD_PROFILE_MAGIC;
+        m_file->version = LOAD_PROFILE_VERSION;
+        m_file->slotMinutes = LOAD_PROFILE_SLOT_MINUTES;
+    } else if(m_file->magic != LOAD_PROFILE_MAGIC || m_file->version != LOAD_PROFILE_VERSION
+                || m_file->slotMinutes != LOAD_PROFILE_SLOT_MINUTES) {
+        std::cerr << "[Profile] Incompatible file " << m_fileName << " (ignore)" << std::endl;
+        munmap(m_file, sizeof(LoadProfileFile));
+        m_file = nullptr;
+        return false;
+    }
+
+    int learned = 0;
+    for(int day = 0; day < LOAD_PROFILE_DAYS; day++) {
+        for(int slot = 0; slot < LOAD_PROFILE_SLOTS_PER_DAY; slot++) {
+            learned += m_file->slots[day][slot].weeks >= LOAD_PROFILE_MIN_WEEKS ? 1 : 0;
+        }
+    }
+    std::cout << "[Profile] Load profile " << m_fileName << ": " << learned << " of " << LOAD_PROFILE_DAYS * LOAD_PROFILE_SLOTS_PER_DAY
+                << " slots learned" << std::endl;
+    return true;
+}
+
+// reports the current day and writes the profile back
+void LoadProfile::closeUp() {
+    if(m_file == nullptr) {
+        return;
+    }
+
+    if(m_reportDay >= 0) {
+        printReport();
+    }
+    msync(m_file, sizeof(LoadProfileFile), MS_SYNC);
+    munmap(m_file, sizeof(LoadProfileFile));
+    m_file = nullptr;
+}
+
+// takes a meter reading (grid power) with the AC charge power at that time (negative while discharging).
+// learns the load of the current slot and tracks the expected events of the learned profile
+void LoadProfile::update(short gridPower, float chargePower, time_t now) {
+    if(m_file == nullptr) {
+        return;
+    }
+
+    float load = gridPower - chargePower;
+    struct tm local;
+    localtime_r(&now, &local);
+    int minuteOfDay = local.tm_hour * 60 + local.tm_min;
+    int day = local.tm_wday;
+    int slot = minuteOfDay / LOAD_PROFILE_SLOT_MINUTES;
+    int minute = minuteOfDay % LOAD_PROFILE_SLOT_MINUTES;
+
+    float seconds = m_lastSampleTime > 0 ? static_cast<float>(difftime(now, m_lastSampleTime)) : 0.0f;
+    if(seconds < 0.0f || seconds > LOAD_PROFILE_MAX_SAMPLE_GAP) {
+        seconds = 0.0f;
+    }
+    m_lastSampleTime = now;
+
+    if(local.tm_yday != m_reportDay) {
+        if(m_reportDay >= 0) {
+            printReport();
+        }
+        m_reportDay = local.tm_yday;
+        m_steps = m_spikes = 0;
+        m_correctedEvents = m_referenceEvents = 0;
+        m_correctedExportWh = m_expectedExportWh = m_referenceExportWh = 0.0f;
+    }
+
+    // the finished slot is learned, the step at the start of the new one is expected right away
+    if(day != m_currentDay || slot != m_currentSlot) {
+        int index = day * LOAD_PROFILE_SLOTS_PER_DAY + slot;
+        int previousIndex = m_currentDay * LOAD_PROFILE_SLOTS_PER_DAY + m_currentSlot;
+        bool consecutive = m_currentDay >= 0 && index == (previousIndex + 1) % (LOAD_PROFILE_DAYS * LOAD_PROFILE_SLOTS_PER_DAY);
+        if(m_currentDay >= 0) {
+            learnSlot();
+        }
+        if(!consecutive) {
+            m_previousTail = NAN;
+        }
+        for(int i = 0; i < LOAD_PROFILE_SLOT_MINUTES; i++) {
+            m_minuteSums[i] = 0.0f;
+            m_minuteCounts[i] = 0;
+        }
+        m_currentDay = day;
+        m_currentSlot = slot;
+        if(consecutive && minute < LOAD_PROFILE_EDGE_MINUTES) {
+            checkSlotStart(m_file->slots[day][slot], load, now);
+        }
+    }
+    m_minuteSums[minute] += load;
+    m_minuteCounts[minute]++;
+
+    // the expected step is over once it shows up in the readings or didn't come in time
+    if(m_pendingStep != 0.0f) {
+        bool seen = (m_pendingStep > 0.0f ? load - m_stepFrom : m_stepFrom - load) >= fabsf(m_pendingStep) / 2.0f;
+        m_confirmCount = seen ? m_confirmCount + 1 : 0;
+        if(m_confirmCount >= LOAD_PROFILE_CONFIRM_SAMPLES) {
+            m_pendingStep = 0.0f;
+        } else if(now >= m_pendingUntil) {
+            printf("[Profile] Expected load step of %+.0fW did not occur\n", m_pendingStep);
+            m_pendingStep = 0.0f;
+        }
+    }
+
+    checkSpike(m_file->slots[day][slot], load, now);
+
+    // the level a spike is measured against is held during the spike
+    if(std::isnan(m_quietLoad)) {
+        m_quietLoad = load;
+    } else if(!m_inSpike) {
+        float alpha = seconds / LOAD_PROFILE_QUIET_TIME;
+        m_quietLoad += (alpha < 1.0f ? alpha : 1.0f) * (load - m_quietLoad);
+    }
+
+    // export while an event is expected and shortly after (what the corrections should reduce)
+    if(isExpectingEvent()) {
+        if(!m_eventOpen) {
+            openEvent(day, slot);
+        }
+        m_eventUntil = now + LOAD_PROFILE_EVENT_TIME;
+    }
+    if(m_eventOpen && now > m_eventUntil) {
+        closeEvent();
+    } else if(m_eventOpen && gridPower < 0) {
+        m_eventExportWh += -gridPower * seconds / 3600.0f;
+    }
+}
+
+// correction of the grid reading in watts: an expected step that is not visible yet is added,
+// the load of an expected short spike is discounted by the given share (0 - 1)
+short LoadProfile::getGridCorrection(float spikeDiscount) const {
+    if(m_eventOpen && m_eventReference) {
+        return 0;
+    }
+    float correction = m_confirmCount == 0 ? m_pendingStep : 0.0f;
+    correction -= spikeDiscount * m_spikeLoad;
+    return static_cast<short>(lroundf(correction));
+}
+
+bool LoadProfile::isExpectingEvent() const {
+    return m_pendingStep != 0.0f || m_inSpike;
+}
+
+// adds the minute means of the finished slot to the profile (median, short spikes and the step at the start)
+void LoadProfile::learnSlot() {
+    float means[LOAD_PROFILE_SLOT_MINUTES];
+    int count = 0;
+    for(int i = 0; i < LOAD_PROFILE_SLOT_MINUTES; i++) {
+        if(m_minuteCounts[i] > 0) {
+            means[count++] = m_minuteSums[i] / m_minuteCounts[i];
+        }
+    }
+    float head = getMinuteMean(0, LOAD_PROFILE_EDGE_MINUTES);
+    float previousTail = m_previousTail;
+    m_previousTail = getMinuteMean(LOAD_PROFILE_SLOT_MINUTES - LOAD_PROFILE_EDGE_MINUTES, LOAD_PROFILE_SLOT_MINUTES);
+    LoadProfileSlot& entry = m_file->slots[m_currentDay][m_currentSlot];
+
+    // step at the slot start (needs the end of the previous slot)
+    if(!std::isnan(head) && !std::isnan(previousTail)) {
+        float edge = head - previousTail;
+        if(entry.edgeWeeks == 0) {
+            entry.edge = edge;
+            entry.edgeSpread = 0.0f;
+        } else {
+            float rate = std::max(1.0f / (entry.edgeWeeks + 1), LOAD_PROFILE_LEARN_RATE);
+            entry.edgeSpread += rate * (fabsf(edge - entry.edge) - entry.edgeSpread);
+            entry.edge += rate * (edge - entry.edge);
+        }
+        entry.edgeWeeks += entry.edgeWeeks < UINT16_MAX ? 1 : 0;
+    }
+
+    if(count < LOAD_PROFILE_MIN_MINUTES) {
+        return;
+    }
+
+    // median of the minute means as baseline, a few minutes far above it are a short spike
+    // (insertion sort, at most one mean per minute of the slot)
+    for(int i = 1; i < count; i++) {
+        float mean = means[i];
+        int j = i;
+        for(; j > 0 && means[j - 1] > mean; j--) {
+            means[j] = means[j - 1];
+        }
+        means[j] = mean;
+    }
+    float median = count % 2 == 1 ? means[count / 2] : (means[count / 2 - 1] + means[count / 2]) / 2.0f;
+    float height = means[count - 1] - median;
+    int spikeMinutes = 0;
+    for(int i = 0; i < count; i++) {
+        spikeMinutes += means[i] > median + height / 2.0f ? 1 : 0;
+    }
+    bool spike = height >= LOAD_PROFILE_SPIKE_MIN && spikeMinutes <= LOAD_PROFILE_SPIKE_MAX_MINUTES;
+
+    float rate = std::max(1.0f / (entry.weeks + 1), LOAD_PROFILE_LEARN_RATE);
+    entry.baseline += rate * (median - entry.baseline);
+    entry.spikeProbability += rate * ((spike ? 1.0f : 0.0f) - entry.spikeProbability);
+    if(spike) {
+        float spikeRate = entry.spikeHeight > 0.0f ? rate : 1.0f;
+        entry.spikeHeight += spikeRate * (height - entry.spikeHeight);
+        entry.spikeMinutes += spikeRate * (spikeMinutes - entry.spikeMinutes);
+    }
+    entry.weeks += entry.weeks < UINT16_MAX ? 1 : 0;
+
+    msync(m_file, sizeof(LoadProfileFile), MS_ASYNC);
+}
+
+// expects the learned step at the start of a slot if it is consistent and has not happened already
+void LoadProfile::checkSlotStart(const LoadProfileSlot& entry, float load, time_t now) {
+    if(entry.edgeWeeks < LOAD_PROFILE_MIN_WEEKS || fabsf(entry.edge) < LOAD_PROFILE_MIN_STEP
+            || entry.edgeSpread * LOAD_PROFILE_SPREAD_FACTOR > fabsf(entry.edge)) {
+        return;
+    }
+    if(!std::isnan(m_quietLoad) && fabsf(load - m_quietLoad) >= fabsf(entry.edge) / 2.0f) {
+        return;
+    }
+
+    m_pendingStep = entry.edge;
+    m_stepFrom = load;
+    m_pendingUntil = now + LOAD_PROFILE_PREPOSITION_TIME;
+    m_confirmCount = 0;
+    m_steps++;
+    printf("[Profile] %s %02d:%02d: expected load step of %+.0fW --> pre-position\n", dayNames[m_currentDay],
+            m_currentSlot * LOAD_PROFILE_SLOT_MINUTES / 60, m_currentSlot * LOAD_PROFILE_SLOT_MINUTES % 60, m_pendingStep);
+}
+
+// a rise of the load like the short spikes learned for the slot is discounted until it ends
+// or lasts longer than the learned spikes (then it is followed like any other load)
+void LoadProfile::checkSpike(const LoadProfileSlot& entry, float load, time_t now) {
+    if(std::isnan(m_quietLoad)) {
+        return;
+    }
+    float rise = load - m_quietLoad;
+
+    if(m_inSpike || m_spikeExpired) {
+        if(rise < m_spikeHeight / 4.0f) {
+            m_inSpike = m_spikeExpired = false;
+            m_spikeLoad = 0.0f;
+        } else if(m_inSpike && difftime(now, m_spikeStart) > m_spikeDuration) {
+            printf("[Profile] Load rise of %.0fW lasts longer than the expected spike --> follow it\n", rise);
+            m_inSpike = false;
+            m_spikeExpired = true;
+            m_spikeLoad = 0.0f;
+        } else if(m_inSpike) {
+            m_spikeLoad = std::min(rise, 1.5f * m_spikeHeight);
+        }
+        return;
+    }
+
+    if(entry.weeks < LOAD_PROFILE_MIN_WEEKS || entry.spikeProbability < LOAD_PROFILE_SPIKE_PROBABILITY
+            || entry.spikeHeight < LOAD_PROFILE_SPIKE_MIN) {
+        return;
+    }
+    if(rise < entry.spikeHeight / 2.0f || rise > 1.5f * entry.spikeHeight) {
+        return;
+    }
+
+    m_inSpike = true;
+    m_spikeStart = now;
+    m_spikeHeight = entry.spikeHeight;
+    m_spikeDuration = (entry.spikeMinutes + 1.0f) * 60.0f;
+    m_spikeLoad = rise;
+    m_spikes++;
+    printf("[Profile] Expected short spike of %.0fW (%.0f min) --> discount it\n", m_spikeHeight, entry.spikeMinutes);
+}
+
+// starts the accounting of an event, every few events of a slot is a reference without the correction
+void LoadProfile::openEvent(int day, int slot) {
+    LoadProfileSlot& entry = m_file->slots[day][slot];
+    m_eventOpen = true;
+    m_eventReference = !m_feedForward || entry.events % LOAD_PROFILE_REFERENCE_INTERVAL == 0;
+    m_eventDay = day;
+    m_eventSlot = slot;
+    m_eventExportWh = 0.0f;
+    entry.events += entry.events < UINT16_MAX ? 1 : 0;
+    if(m_eventReference && m_feedForward) {
+        printf("[Profile] Reference event without correction (export of the slot is measured)\n");
+    }
+}
+
+// learns the export of a reference event, a corrected one is compared with the reference of its slot
+void LoadProfile::closeEvent() {
+    LoadProfileSlot& entry = m_file->slots[m_eventDay][m_eventSlot];
+    if(m_eventReference) {
+        float rate = std::max(1.0f / (entry.referenceEvents + 1), LOAD_PROFILE_LEARN_RATE);
+        entry.referenceExport += rate * (m_eventExportWh - entry.referenceExport);
+        entry.referenceEvents += entry.referenceEvents < UINT16_MAX ? 1 : 0;
+        m_referenceEvents++;
+        m_referenceExportWh += m_eventExportWh;
+    } else if(entry.referenceEvents > 0) {
+        m_correctedEvents++;
+        m_correctedExportWh += m_eventExportWh;
+        m_expectedExportWh += entry.referenceExport;
+    }
+    m_eventOpen = false;
+}
+
+void LoadProfile::printReport() const {
+    printf("[Profile] Day report: %d expected load steps, %d expected spikes, %d reference events without correction (%.1fWh exported)\n",
+            m_steps, m_spikes, m_referenceEvents, m_referenceExportWh);
+    if(m_correctedEvents > 0) {
+        printf("[Profile] Day report: %d corrected events exported %.1fWh, %.1fWh without correction (reference of the same slots) --> %+.1fWh\n",
+                m_correctedEvents, m_correctedExportWh, m_expectedExportWh, m_correctedExportWh - m_expectedExportWh);
+    }
+}
+
+// mean load of a range of minutes of the current slot (NAN without readings)
+float LoadProfile::getMinuteMean(int first, int last) const {
+    float sum = 0.0f;
+    unsigned int count = 0;
+    for(int i = first; i < last; i++) {
+        sum += m_minuteSums[i];
+        count += m_minuteCounts[i];
+    }
+    return count > 0 ? sum / count : NAN;
+}
@@ -0,0 +1,156 @@
+/*
+    File: LoadProfile.h
+    Time-of-day baseline of the household load, learned per weekday and 15 minute slot from the
+    own meter readings. Many loads recur at the same time (pool pump timer, heat pump defrost,
+    dishwasher schedule). The profile stores per slot the typical step of the load at the slot
+    start and the short spikes within the slot. The regulator uses it to pre-position the charge
+    power at a learned step and to discount an expected short spike instead of chasing it (the
+    export after the spike ends is what costs). Every few weeks an event of a slot runs without
+    the correction as a reference, the day report compares the export during the corrected events
+    with the export learned from the references of the same slots. The profile is a small memory
+    mapped file
+
+    written by Elias Geiger
+*/
+
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <cmath>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define LOAD_PROFILE_MAGIC 0x50444C45       // "ELDP"
+#define LOAD_PROFILE_VERSION 2
+#define LOAD_PROFILE_DAYS 7
+#define LOAD_PROFILE_SLOT_MINUTES 15
+#define LOAD_PROFILE_SLOTS_PER_DAY (24 * 60 / LOAD_PROFILE_SLOT_MINUTES)
+
+// a slot is only learned with readings in this many of its minutes (e.g. not the slot of the start)
+#define LOAD_PROFILE_MIN_MINUTES 10
+
+// weight of a new week in the profile (the first weeks are averaged evenly)
+#define LOAD_PROFILE_LEARN_RATE 0.25f
+
+// a slot is only used after this many learned weeks
+#define LOAD_PROFILE_MIN_WEEKS 3
+
+// steps at the slot start: measured between the last and the first minutes around the boundary,
+// pre-positioned if at least this big and consistent (spread below the step divided by the factor)
+#define LOAD_PROFILE_EDGE_MINUTES 2
+#define LOAD_PROFILE_MIN_STEP 100.0f            // in watts
+#define LOAD_PROFILE_SPREAD_FACTOR 2.0f
+#define LOAD_PROFILE_PREPOSITION_TIME 120       // in seconds, the step is expected this long
+#define LOAD_PROFILE_CONFIRM_SAMPLES 2          // readings that have to show the step
+
+// short spikes: minute means at least this much above the slot median for at most this many minutes,
+// discounted in slots where they occurred in most of the weeks
+#define LOAD_PROFILE_SPIKE_MIN 150.0f           // in watts
+#define LOAD_PROFILE_SPIKE_MAX_MINUTES 5
+#define LOAD_PROFILE_SPIKE_PROBABILITY 0.5f
+
+// time constant of the load level a spike is measured against in seconds
+#define LOAD_PROFILE_QUIET_TIME 60.0f
+
+// export is accounted to an expected event until this long after it in seconds
+#define LOAD_PROFILE_EVENT_TIME 300
+
+// every this many events of a slot one runs without the correction (reference export of the slot)
+#define LOAD_PROFILE_REFERENCE_INTERVAL 4
+
+// readings further apart than this are not integrated (meter downtime) in seconds
+#define LOAD_PROFILE_MAX_SAMPLE_GAP 10
+
+// learned load of one weekday slot (load = grid power minus charge power plus discharge power)
+struct LoadProfileSlot
+{
+    float baseline;             // median of the minute means in watts
+    float edge;                 // step of the load at the slot start in watts
+    float edgeSpread;           // mean deviation of the step from week to week
+    float spikeHeight;          // height of the short spikes above the median
+    float spikeProbability;     // share of the weeks with a short spike
+    float spikeMinutes;         // duration of the short spikes
+    float referenceExport;      // export during and after an event without the correction in Wh
+    uint16_t weeks;
+    uint16_t edgeWeeks;
+    uint16_t events;            // expected events (steps and spikes)
+    uint16_t referenceEvents;
+};
+
+// complete memory layout of the profile file
+struct LoadProfileFile
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slotMinutes;
+    uint32_t reserved;
+    LoadProfileSlot slots[LOAD_PROFILE_DAYS][LOAD_PROFILE_SLOTS_PER_DAY];
+};
+
+class LoadProfile
+{
+    std::string m_fileName;
+    LoadProfileFile* m_file;
+
+    // minute means of the current slot
+    int m_currentDay, m_currentSlot;
+    float m_minuteSums[LOAD_PROFILE_SLOT_MINUTES];
+    unsigned int m_minuteCounts[LOAD_PROFILE_SLOT_MINUTES];
+    float m_previousTail;               // load in the last minutes of the previous slot (NAN = unknown)
+
+    // load level without the spikes
+    float m_quietLoad;
+    time_t m_lastSampleTime;
+
+    // expected events
+    float m_pendingStep;                // step expected after the slot start (0 = none)
+    float m_stepFrom;
+    time_t m_pendingUntil;
+    int m_confirmCount;
+    bool m_inSpike, m_spikeExpired;
+    time_t m_spikeStart;
+    float m_spikeHeight, m_spikeDuration;
+    float m_spikeLoad;                  // current load above the quiet level while in a spike
+
+    bool m_feedForward;
+
+    // current event: export until shortly after it, reference events are not corrected
+    bool m_eventOpen, m_eventReference;
+    int m_eventDay, m_eventSlot;
+    time_t m_eventUntil;
+    float m_eventExportWh;
+
+    // daily report: corrected events against the reference export of their slots
+    int m_reportDay;
+    int m_steps, m_spikes;
+    int m_correctedEvents, m_referenceEvents;
+    float m_correctedExportWh, m_expectedExportWh, m_referenceExportWh;
+
+public:
+    LoadProfile(std::string);
+    ~LoadProfile();
+
+    bool setup(bool);
+    void closeUp();
+    void update(short, float, time_t);
+    short getGridCorrection(float) const;
+
+    // getters //
+    bool isExpectingEvent() const;
+
+private:
+    void learnSlot();
+    void checkSlotStart(const LoadProfileSlot&, float, time_t);
+    void checkSpike(const LoadProfileSlot&, float, time_t);
+    void openEvent(int, int);
+    void closeEvent();
+    void printReport() const;
+    float getMinuteMean(int, int) const;
+};
@@ -0,0 +1,25 @@
+/*
+    File: MeterSource.h
+    The source of the grid power readings of a regulator. The readings go into the command queue of
+    the regulator and feed its meter watchdog. UdpReceiver listens for the readings of the energy
+    meter, tests and benchmarks inject simulated readings instead
+
+    written by Elias Geiger
+*/
+
+#pragma once
+
+class MeterSource
+{
+public:
+    virtual ~MeterSource() {}
+
+    virtual bool setup() = 0;
+    virtual void closeUp() = 0;
+
+    // meter rate control: reading interval wanted by the regulator in ms (0 = no request)
+    virtual void requestMeterInterval(int) = 0;
+
+    // battery temperature sent along with the readings in degree celsius (NAN if older than the given seconds)
+    virtual float getBatteryTemperature(long) const = 0;
+};
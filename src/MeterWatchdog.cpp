@@ -0,0 +1,167 @@
+/*
+    File: MeterWatchdog.cpp
+    written by Elias Geiger
+*/
+
+#include "MeterWatchdog.h"
+
+// constructor and destructor
+MeterWatchdog::MeterWatchdog(const ConfigFile& cfg, PsuInterface& psu, Queue<PowerState>& cmdQueue)
+    : m_cfg(cfg), m_psu(psu), m_cmdQueue(cmdQueue) {
+    m_threadRunning = false;
+    m_stage = WD_STAGE_OK;
+    m_lastReadingTime = steady_clock::now();
+}
+
+MeterWatchdog::~MeterWatchdog() {}
+
+// method to launch the watchdog timer thread
+bool MeterWatchdog::setup() {
+    // only setup once
+    if(m_threadRunning) {
+        return false;
+    }
+
+    m_lastReadingTime = steady_clock::now();
+    m_threadRunning = true;
+
+    m_watchdogTh = std::thread([] (MeterWatchdog* ptr) {
+        std::cout << "[Watchdog-thread] meter watchdog running ..." << std::endl;
+        setTraceThreadName("Watchdog");
+        registerProfileThread("Watchdog");
+
+        auto lastActionTime = steady_clock::now();
+
+        std::unique_lock<std::mutex> lock(ptr->m_mutex);
+        while(ptr->m_threadRunning) {
+            // wake up periodically or when stopped
+            ptr->m_wakeUp.wait_for(lock, milliseconds(WATCHDOG_TICK_TIME));
+            countSyscalls();
+            if(!ptr->m_threadRunning) {
+                break;
+            }
+
+            // determine the stage based on the time since the last valid meter reading
+            auto currentTime = steady_clock::now();
+            long silentMs = duration_cast<milliseconds>(currentTime - ptr->m_lastReadingTime).count();
+            WatchdogStage stage = WD_STAGE_OK;
+            if(silentMs > ptr->m_cfg.getMeterStandbyTime() * 1000L) {
+                stage = WD_STAGE_STANDBY;
+            } else if(silentMs > ptr->m_cfg.getMeterTimeout() * 1000L) {
+                stage = WD_STAGE_ZERO;
+            } else if(silentMs > ptr->m_cfg.getMeterRampDownTime() * 1000L) {
+                stage = WD_STAGE_RAMP_DOWN;
+            } else if(silentMs > ptr->m_cfg.getMeterHoldTime() * 1000L) {
+                stage = WD_STAGE_HOLD;
+            }
+
+            // escalate to the next stage
+            if(stage > ptr->m_stage) {
+                ptr->enterStage(stage, silentMs);
+                lastActionTime = currentTime;
+                continue;
+            }
+
+            // repeat the failsafe action of the current stage every second
+            long sinceLastAction = duration_cast<milliseconds>(currentTime - lastActionTime).count();
+            if(sinceLastAction < 1000) {
+                continue;
+            }
+            lastActionTime = currentTime;
+
+            if(ptr->m_stage == WD_STAGE_RAMP_DOWN) {
+                // fake a grid import so the regulator lowers the charge power by one step
+                PowerState pState;
+                pState.tasmotaPowerCmd = ptr->m_cfg.getTargetGridPower() + ptr->m_cfg.getMeterRampDownStep();
+                pState.psuAcInputPower = static_cast<short>(ptr->m_psu.getCurrentInputPower());
+                ptr->m_cmdQueue.push(pState);
+            } else if(ptr->m_stage == WD_STAGE_ZERO) {
+                const PowerState fakePowerState = {30000, 0};
+                ptr->m_cmdQueue.push(fakePowerState);
+            }
+        }
+
+        unregisterProfileThread();
+        std::cout << "[Watchdog-thread] closeup --> finish thread now" << std::endl;
+    }, this);
+
+    return true;
+}
+
+// method to stop the watchdog thread
+void MeterWatchdog::closeUp() {
+    {
+        const std::lock_guard<std::mutex> lock(m_mutex);
+        m_threadRunning = false;
+    }
+    m_wakeUp.notify_all();
+
+    if(m_watchdogTh.joinable()) {
+        m_watchdogTh.join();
+    }
+}
+
+// signals the reception of a valid meter reading. Cancels any failsafe stage immediately
+void MeterWatchdog::feed() {
+    const std::lock_guard<std::mutex> lock(m_mutex);
+    if(m_stage != WD_STAGE_OK) {
+        long silentMs = duration_cast<milliseconds>(steady_clock::now() - m_lastReadingTime).count();
+        std::cout << "[Watchdog] Meter readings resumed after " << silentMs / 1000 << "s --> back to normal operation" << std::endl;
+        m_stage = WD_STAGE_OK;
+    }
+    m_lastReadingTime = steady_clock::now();
+}
+
+WatchdogStage MeterWatchdog::getStage() {
+    const std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stage;
+}
+
+// time since the last valid meter reading in milliseconds
+long MeterWatchdog::getSilentTime() {
+    const std::lock_guard<std::mutex> lock(m_mutex);
+    return duration_cast<milliseconds>(steady_clock::now() - m_lastReadingTime).count();
+}
+
+// continues the timer of the previous process (hot restart)
+void MeterWatchdog::setSilentTime(long silentMs) {
+    const std::lock_guard<std::mutex> lock(m_mutex);
+    m_lastReadingTime = steady_clock::now() - milliseconds(silentMs);
+}
+
+// performs the entry action of a failsafe stage (called with locked mutex)
+void MeterWatchdog::enterStage(WatchdogStage stage, long silentMs) {
+    m_stage = stage;
+    switch(stage) {
+        case WD_STAGE_HOLD:
+        {
+            std::cerr << "[Watchdog] No meter reading for " << silentMs / 1000 << "s --> hold last command" << std::endl;
+            break;
+        }
+
+        case WD_STAGE_RAMP_DOWN:
+        {
+            std::cerr << "[Watchdog] No meter reading for " << silentMs / 1000 << "s --> ramp down charge power" << std::endl;
+            break;
+        }
+
+        case WD_STAGE_ZERO:
+        {
+            // Tasmota smart meter downtime detected --> send faked high power state to set 0W charge power
+            std::cerr << "[Watchdog] Tasmota energy meter downtime detected! (timeout after " << silentMs / 1000 << "s) --> zero charge current" << std::endl;
+            const PowerState fakePowerState = {30000, 0};
+            m_cmdQueue.push(fakePowerState);
+            break;
+        }
+
+        case WD_STAGE_STANDBY:
+        {
+            std::cerr << "[Watchdog] No meter reading for " << silentMs / 1000 << "s --> standby" << std::endl;
+            m_psu.enterStandby();
+            break;
+        }
+
+        default:
+            break;
+    }
+}
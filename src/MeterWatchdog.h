@@ -0,0 +1,67 @@
+/*
+    File: MeterWatchdog.h
+    The meter watchdog supervises the energy meter readings independently of the UDP listener thread.
+    When the meter goes silent it walks through graduated failsafe stages and recovers immediately
+    when valid readings return
+
+    written by Elias Geiger
+*/
+
+#pragma once
+
+#include <iostream>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+#include "Utils.h"
+#include "ConfigFile.h"
+#include "PsuInterface.h"
+#include "Trace.h"
+#include "Queue.h"
+
+using std::chrono::steady_clock;
+using std::chrono::milliseconds;
+using std::chrono::duration_cast;
+
+// failsafe stages in order of escalation
+enum WatchdogStage
+{
+    WD_STAGE_OK,            // meter readings arrive regularly
+    WD_STAGE_HOLD,          // hold the last current command
+    WD_STAGE_RAMP_DOWN,     // ramp down the charge power step by step
+    WD_STAGE_ZERO,          // zero charge current
+    WD_STAGE_STANDBY        // turn off slot detect
+};
+
+class MeterWatchdog
+{
+    const ConfigFile& m_cfg;
+    PsuInterface& m_psu;
+    Queue<PowerState>& m_cmdQueue;
+
+    std::thread m_watchdogTh;
+    std::atomic<bool> m_threadRunning;
+    std::mutex m_mutex;
+    std::condition_variable m_wakeUp;
+
+    steady_clock::time_point m_lastReadingTime;
+    WatchdogStage m_stage;
+
+public:
+    MeterWatchdog(const ConfigFile&, PsuInterface&, Queue<PowerState>&);
+    ~MeterWatchdog();
+
+    bool setup();
+    void closeUp();
+    void feed();
+
+    WatchdogStage getStage();
+    long getSilentTime();
+    void setSilentTime(long);
+
+private:
+    void enterStage(WatchdogStage, long);
+};
@@ -5,249 +5,143 @@
 
 #include "PsuController.h"
 
-extern ConfigFile cfg;
-
 // Constructor
-PsuController::PsuController() {
-	m_threadRunning = false;
+PsuController::PsuController(const ConfigFile& cfg, BatteryMonitor& battery) : m_cfg(cfg), m_battery(battery) {
 	m_lastCurrentCmd = 0.0f;
-	m_cmdAckFlag = false;
-	m_secondsSinceLastCharge = 0;
+	m_lastVoltageCmd = 0.0f;
+	m_slotDetectOn = false;
+	m_lastChargeTime = steady_clock::now();
+	m_lastBatterySaveTime = steady_clock::now();
+	m_wakePending = false;
+	m_wakeTime = SD_WAKE_TIME;
+	m_wakeMeasured = false;
+	m_slotDetectOnTime = steady_clock::now();
 }
 
 // Destructor
 PsuController::~PsuController() {}
 
 // public methods // 
-bool PsuController::setup(const char* interfaceName) {
-	// initialize the slot detect control
-	if(!initSlotDetect()) {
-		std::cerr << "Failed to init slot detect control!" << std::endl;
-		return false;
+bool PsuController::setup(const std::vector<std::string>& interfaceNames) {
+	// the slot detect relay is shared by all regulators and initialized once by main
+	// (off at application startup if the control is enabled)
+	m_slotDetectOn = !m_cfg.isSlotDetectControlEnabled();
+
+	// start one worker per CAN interface
+	for(const std::string& interfaceName : interfaceNames) {
+		std::unique_ptr<CanBus> bus(new CanBus(interfaceName, this));
+		if(!bus->setup(-1, m_cfg.isIoUringEnabled())) {
+			return false;
+		}
+		m_canBuses.push_back(std::move(bus));
 	}
 
-	// create can socket
-	m_canSocket = socket(PF_CAN, SOCK_RAW, CAN_RAW);
-	if(m_canSocket < 0) {
-		std::cerr << "Failed to create CAN socket!" << std::endl;
-		return false;
-	}
+	// send initial volatage command, don't output power by default
+	setMaxVoltage(m_cfg.getChargerAbsorptionVoltage(), false);		// online mode
 
-	// use the specified interface
-	strcpy(m_ifr.ifr_name, interfaceName);
-	ioctl(m_canSocket, SIOCGIFINDEX, &m_ifr);
+	return true;
+}
 
-	// prepare CAN adress
-	memset(&m_addr, 0, sizeof(m_addr));
-	m_addr.can_family = AF_CAN;
-	m_addr.can_ifindex = m_ifr.ifr_ifindex;
+// continues the control of the PSUs with the sockets and state handed over by the previous process
+bool PsuController::takeOver(const std::vector<std::string>& interfaceNames, const std::vector<int>& sockets, const HandoverState& state) {
+	// keep the slot detect state, switching it would reset the PSUs (main initializes the relay in this state)
+	m_slotDetectOn = state.slotDetectOn != 0;
 
-	// bind address to interface
-	if(bind(m_canSocket, (struct sockaddr*)&m_addr, sizeof(m_addr)) < 0) {
-		std::cerr << "Failed to bind CAN Socket!" << std::endl;
+	// the interfaces must be the same as in the previous process
+	if(interfaceNames.size() != state.canBusCount || sockets.size() != state.canBusCount) {
+		std::cerr << "[PSU] CAN interfaces differ from the previous process --> takeover not possible" << std::endl;
 		return false;
 	}
 
-	// spawn worker thread
-	m_workerTh = std::thread([] (PsuController* ptr) {
-		ptr->m_threadRunning = true;
-
-		// Timing variables
-		auto currentTime = steady_clock::now();
-		auto lastStatusRequestTime = currentTime, lastCurrentCommandRepeatTime = currentTime;
-		milliseconds timeElapsed;
-		
-		std::cout << "[PSU-thread] worker thread running ..." << std::endl;
-
-		// send initial volatage and current commands, don't output power by default
-		ptr->setMaxVoltage(cfg.getChargerAbsorptionVoltage(), false);		// online mode
-
-		// send first request for status report
-		ptr->requestStatusData();
-
-		// repeat as long as CAN socket is valid
-		while(ptr->m_threadRunning == true) {
-			struct can_frame receivedCanFrame;
-
-			// read in message from CAN bus
-			int nbytes = read(ptr->m_canSocket, &receivedCanFrame, sizeof(can_frame));
-			if (nbytes < 0) {
-				std::cerr << "[PSU-thread] Problem with reading can message frame" << std::endl;
-				continue;
-			}
-
-			// Detect message type
-			switch (receivedCanFrame.can_id & 0x1FFFFFFF) {
-				// status report message
-				case 0x1081407F:
-					ptr->updateLocalParams((uint8_t*)&receivedCanFrame.data);
-					break;
-
-				// ...
-				case 0x1081D27F:
-					// r4850_description((uint8_t *)&frame.data);
-					// ...
-					break;
-
-				// command acknowledge message
-				case 0x1081807E:
-					// Acknowledgement //
-					ptr->processAckFrame((uint8_t*)&receivedCanFrame.data);
-					break;
-
-				// unknown message type
-				default:
-					// printf("Unknown frame 0x%03X [%d] ", (recvFrame.can_id & 0x1FFFFFFF), recvFrame.can_dlc);
-					break;
-			}
-
-			// every second request status update
-			currentTime = steady_clock::now();
-			timeElapsed = duration_cast<milliseconds>(currentTime - lastStatusRequestTime);
-			if(timeElapsed.count() > 1000) {
-				ptr->requestStatusData();
-				lastStatusRequestTime = steady_clock::now();
-			}
-
-			// every 5 sec repeat last current command to ensure PSU stays in online mode
-			currentTime = steady_clock::now();
-			timeElapsed = duration_cast<milliseconds>(currentTime - lastCurrentCommandRepeatTime);
-			if(timeElapsed.count() > 5000) {
-				ptr->setMaxCurrent(ptr->m_lastCurrentCmd, false);
-				if(ptr->m_lastCurrentCmd == 0.0f) {
-					// tick the slot detect keep alive timer
-					ptr->m_secondsSinceLastCharge += static_cast<unsigned int>(timeElapsed.count() / 1000);
-					if(ptr->m_secondsSinceLastCharge >= cfg.getSlotDetectKeepAliveTime()) {
-						// turn off slot detect to enter stand by mode for power saving
-						#ifdef _TARGET_RASPI
-							if(cfg.isSlotDetectControlEnabled()) {
-								digitalWrite(SD_PIN, LOW);
-								std::cout << "[PSU-thread] Turn off slot detect --> standby mode" << std::endl;
-							}
-						#endif
-						ptr->m_secondsSinceLastCharge = 0;
-					}
-				} else {
-					// reset slot detect keep alive timer when last current command greater than zero
-					ptr->m_secondsSinceLastCharge = 0;
-				}
-
-				lastCurrentCommandRepeatTime = steady_clock::now();
-			}
+	for(size_t i = 0; i < interfaceNames.size(); i++) {
+		if(interfaceNames[i] != state.interfaceNames[i]) {
+			std::cerr << "[PSU] CAN interfaces differ from the previous process --> takeover not possible" << std::endl;
+			return false;
+		}
+		std::unique_ptr<CanBus> bus(new CanBus(interfaceNames[i], this));
+		bus->restoreParams(state.telemetry[i]);
+		if(!bus->setup(sockets[i], m_cfg.isIoUringEnabled())) {
+			return false;
 		}
+		m_canBuses.push_back(std::move(bus));
+	}
 
-		std::cout << "[PSU-thread] closeup --> finish thread now" << std::endl;
-	}, this);
+	// restore the timers and continue with the last setpoints
+	{
+		const std::lock_guard<std::mutex> lock(m_mutex);
+		m_lastChargeTime = steady_clock::now() - milliseconds(state.msSinceLastCharge);
+		m_lastCurrentCmd = state.lastCurrentCmd;
+	}
+	setMaxVoltage(state.lastVoltageCmd, false);
+	setMaxCurrent(state.lastCurrentCmd, false);
 
 	return true;
 }
 
+// the slot detect relay is shared by all regulators --> main disables it after the last one exited
 void PsuController::shutdown() {
-	// disable slot detect (on raspberry pi only)
-	#ifdef _TARGET_RASPI 
-		digitalWrite(SD_PIN, LOW);
-		std::cout << "[PSU] Slot detect disabled before exit" << std::endl;
-	#endif
-
-	// wait for worker thread
-	m_threadRunning = false;
-	m_workerTh.join();
-
-	// close the CAN socket
-	if(close(m_canSocket) < 0) {
-		std::cerr << "Could not close CAN socket! Not created at all?" << std::endl;
+	detach();
+}
+
+// stops the workers without touching the slot detect (other regulators or another process control the PSUs)
+void PsuController::detach() {
+	// wait for the worker threads and close the CAN sockets
+	for(auto& bus : m_canBuses) {
+		bus->shutdown();
 	}
+	m_canBuses.clear();
 }
 
 void PsuController::printParams() const {
-	std::cout << std::endl;
-	printf("Input Voltage %.02fV @ %.02fHz\n", m_rectifierParams.input_voltage, m_rectifierParams.input_frequency);
-	printf("Input Current %.02fA\n", m_rectifierParams.input_current);
-	printf("Input Power %.02fW\n", m_rectifierParams.input_power);
-
-	std::cout << std::endl;
-	printf("Output Voltage %.02fV\n", m_rectifierParams.output_voltage);
-	printf("Output Current %.02fA\n", m_rectifierParams.output_current);
-	printf("Output Power %.02fW\n", m_rectifierParams.output_power);
-
-	std::cout << std::endl;
-	printf("Input Temperature %.01f DegC\n", m_rectifierParams.input_temp);
-	printf("Output Temperature %.01f DegC\n", m_rectifierParams.output_temp);
-	printf("Efficiency %.01f%%\n", m_rectifierParams.efficiency * 100);
+	for(const auto& bus : m_canBuses) {
+		bus->printParams();
+	}
 }
 
 // Does not block
 bool PsuController::setMaxVoltage(float voltage, bool nonvolatile) {
-	struct can_frame dataFrameToSend;
-	uint16_t value = voltage * 1024;		
-	uint8_t volatilityFlag;
-
-	// set volatility flag
-	if (nonvolatile) volatilityFlag = 0x01;	// Off-line mode
-	else		 volatilityFlag = 0x00;	// On-line mode
-
-	// construct CAN message frame
-	dataFrameToSend.can_id = 0x108180FE | CAN_EFF_FLAG;
-	dataFrameToSend.can_dlc = 8;
-	dataFrameToSend.data[0] = 0x01;
-	dataFrameToSend.data[1] = volatilityFlag;
-	dataFrameToSend.data[2] = 0x00;
-	dataFrameToSend.data[3] = 0x00;
-	dataFrameToSend.data[4] = 0x00;
-	dataFrameToSend.data[5] = 0x00;
-	dataFrameToSend.data[6] = (value & 0xFF00) >> 8;		// first the higher byte
-	dataFrameToSend.data[7] = value & 0xFF;				// then the lower one
-
-	// send the message frame
-	if(!sendCanFrame(dataFrameToSend)) {
-		std::cerr << "Failed to send voltage command!" << std::endl;
-		return false;
+	m_lastVoltageCmd = voltage;
+	for(auto& bus : m_canBuses) {
+		bus->setMaxVoltage(voltage, nonvolatile);
 	}
 	return true;
 }
 
-// Does not block
+// Does not block. One PSU per CAN interface --> the current is split evenly between the interfaces whose
+// PSU reports. A failed or silent one gets no share (all of them while waking up from standby)
 bool PsuController::setMaxCurrent(float current, bool nonvolatile) {
-	struct can_frame dataFrameToSend;
-	uint16_t value = current * MAX_CURRENT_MULTIPLIER;
-	uint8_t volatilityFlag;
-
-	// set volatility flag
-	if (nonvolatile) volatilityFlag = 0x04;					// Off-line mode
-	else		 volatilityFlag = 0x03;						// On-line mode
-
-	// construct CAN message frame
-	dataFrameToSend.can_id = 0x108180FE | CAN_EFF_FLAG;
-	dataFrameToSend.can_dlc = 8;
-	dataFrameToSend.data[0] = 0x01;
-	dataFrameToSend.data[1] = volatilityFlag;
-	dataFrameToSend.data[2] = 0x00;
-	dataFrameToSend.data[3] = 0x00;
-	dataFrameToSend.data[4] = 0x00;
-	dataFrameToSend.data[5] = 0x00;
-	dataFrameToSend.data[6] = (value & 0xFF00) >> 8;		// first the higher bytes
-	dataFrameToSend.data[7] = value & 0xFF;					// then the lower one
-
-	// send the message frame
-	if(!sendCanFrame(dataFrameToSend)) {
-		std::cerr << "Failed to send current command!" << std::endl;
+	const std::lock_guard<std::mutex> lock(m_mutex);
+	if(m_canBuses.empty()) {
 		return false;
 	}
 
-	// reset command acknowledgement flag if target current has changed
+	size_t reportingBuses = 0;
+	for(const auto& bus : m_canBuses) {
+		if(bus->isReporting()) {
+			reportingBuses++;
+		}
+	}
+	bool allBuses = reportingBuses == 0;
+	if(allBuses) {
+		reportingBuses = m_canBuses.size();
+	}
+
+	// round down to the resolution of the current command
+	float currentPerBus = static_cast<int>(current / reportingBuses * MAX_CURRENT_MULTIPLIER) / static_cast<float>(MAX_CURRENT_MULTIPLIER);
+	for(auto& bus : m_canBuses) {
+		bus->setMaxCurrent(allBuses || bus->isReporting() ? currentPerBus : 0.0f, nonvolatile);
+	}
+
 	if(current != m_lastCurrentCmd) {
-		m_cmdAckFlag = false;
-		std::cout << "[PSU] sent new current command: " << current << "A" << std::endl;
-
-		// reenable slot detect after standby periods (on raspberry pi only)
-		if(m_lastCurrentCmd == 0.0f && current > 0.0f) {
-			#ifdef _TARGET_RASPI
-				if(cfg.isSlotDetectControlEnabled()) {
-					digitalWrite(SD_PIN, HIGH);
-					std::cout << "[PSU] Slot detect (re)enabled" << std::endl;
-				}
-			#endif
+		printf("[PSU] sent new current command: %gA\n", current);
+	}
+
+	// reenable slot detect after standby periods
+	if(current > 0.0f) {
+		if(!m_slotDetectOn) {
+			setSlotDetect(true);
 		}
+		m_lastChargeTime = steady_clock::now();
 	}
 
 	// save as last current command
@@ -256,211 +150,236 @@ bool PsuController::setMaxCurrent(float current, bool nonvolatile) {
 	return true;
 }
 
-// Does not block
-bool PsuController::requestStatusData() {
-	struct can_frame requestFrame;
-
-	// construct CAN message frame
-	requestFrame.can_id = 0x108040FE | CAN_EFF_FLAG;
-	// 0x108140FE also works 
-	requestFrame.can_dlc = 8;
-	requestFrame.data[0] = 0;
-	requestFrame.data[1] = 0;
-	requestFrame.data[2] = 0;
-	requestFrame.data[3] = 0;
-	requestFrame.data[4] = 0;
-	requestFrame.data[5] = 0;
-	requestFrame.data[6] = 0;
-	requestFrame.data[7] = 0;
-
-	// send the message frame
-	if(!sendCanFrame(requestFrame)) {
-		std::cerr << "Failed to send status request command!" << std::endl;
-		return false;
-	}
+// zero the charge current and turn off slot detect right away (e.g. meter failure)
+void PsuController::enterStandby() {
+	setMaxCurrent(0.0f, false);
 
-	return true;
+	const std::lock_guard<std::mutex> lock(m_mutex);
+	setSlotDetect(false);
 }
 
-float PsuController::getCurrentInputPower() const {
-	return m_rectifierParams.input_power;
+// switches slot detect on ahead of a charge command, so the PSUs boot meanwhile. the keep alive
+// timer restarts, the PSUs go back to standby without a charge command. returns false if already on
+bool PsuController::wakeUp() {
+	const std::lock_guard<std::mutex> lock(m_mutex);
+	if(!m_cfg.isSlotDetectControlEnabled() || m_slotDetectOn) {
+		return false;
+	}
+	setSlotDetect(true);
+	m_lastChargeTime = steady_clock::now();
+	return true;
 }
 
-float PsuController::getCurrentOutputVoltage() const {
-	return m_rectifierParams.output_voltage;
-}
+// slot detect keep alive timer and battery counter persistence. Called periodically by the CAN workers
+void PsuController::periodicTasks() {
+	bool saveBattery = false;
+	{
+		const std::lock_guard<std::mutex> lock(m_mutex);
+		auto currentTime = steady_clock::now();
 
-float PsuController::getCurrentOutputCurrent() const {
-	return m_rectifierParams.output_current;
-}
+		// turn off slot detect to enter stand by mode for power saving
+		long secondsSinceLastCharge = duration_cast<std::chrono::seconds>(currentTime - m_lastChargeTime).count();
+		if(m_lastCurrentCmd == 0.0f && m_slotDetectOn && secondsSinceLastCharge >= m_cfg.getSlotDetectKeepAliveTime()) {
+			setSlotDetect(false);
+		}
 
-// generic helper method for sending out CAN frames
-bool PsuController::sendCanFrame(struct can_frame frame) {
+		// periodically persist the battery counters
+		if(duration_cast<milliseconds>(currentTime - m_lastBatterySaveTime).count() > BATTERY_STATE_SAVE_INTERVAL * 1000) {
+			m_lastBatterySaveTime = currentTime;
+			saveBattery = true;
+		}
+	}
 
-	// write out frame to the can bus
-	if (write(m_canSocket, &frame, sizeof(can_frame)) != sizeof(can_frame)) {
-		return false;
+	if(saveBattery && !m_battery.storeState()) {
+		std::cerr << "[PSU] Failed to store battery state!" << std::endl;
 	}
-	return true;
 }
 
-// processes a received status frame from the PSU
-void PsuController::updateLocalParams(uint8_t *frame) {
-	// decode and store value in payload of message frame
-	uint32_t value = __builtin_bswap32(*(uint32_t *)&frame[4]);
+// counts the charge of one PSU and resyncs the battery state on the combined output of all PSUs.
+// Called after every status report
+void PsuController::updateBatteryState(float ampHours, float wattHours) {
+	m_battery.addCharge(ampHours, wattHours);
+	m_battery.updateState(getCurrentOutputVoltage(), getCurrentOutputCurrent());
+}
 
-	// decode message frame and update local rectifier parameters accordingly
-	switch (frame[1]) {
+// the first status frame after slot detect was switched on ends the wake-up of the PSUs. Called after every status frame
+void PsuController::notifyStatusFrame() {
+	if(!m_wakePending.load(std::memory_order_relaxed)) {
+		return;
+	}
 
-		// input related // 
-		case R48xx_DATA_INPUT_POWER:
-		{
-			m_rectifierParams.input_power = value / 1024.0f;
-			break;
-		}
-			
-		case R48xx_DATA_INPUT_FREQ:
-		{
-			m_rectifierParams.input_frequency = value / 1024.0f;
-			break;	
-		}
+	const std::lock_guard<std::mutex> lock(m_mutex);
+	if(!m_wakePending) {
+		return;
+	}
+	m_wakePending = false;
+	long wakeTime = duration_cast<milliseconds>(steady_clock::now() - m_slotDetectOnTime).count();
+	if(wakeTime > SD_MAX_WAKE_TIME) {
+		return;
+	}
 
-		case R48xx_DATA_INPUT_VOLTAGE:
-		{
-			m_rectifierParams.input_voltage = value / 1024.0f;
-			break;
-		}
+	// smoothed over the wake-ups, the first measurement replaces the default
+	long smoothed = m_wakeMeasured ? m_wakeTime + static_cast<long>(SD_WAKE_TIME_WEIGHT * (wakeTime - m_wakeTime)) : wakeTime;
+	m_wakeTime = smoothed;
+	m_wakeMeasured = true;
+	printf("[PSU] PSU ready %ldms after slot detect on (wake-up time %ldms)\n", wakeTime, smoothed);
+}
 
-		case R48xx_DATA_INPUT_CURRENT:
-		{
-			m_rectifierParams.input_current = value / 1024.0f;
-			break;
-		}
-			
-		case R48xx_DATA_INPUT_TEMPERATURE:
-		{
-			m_rectifierParams.input_temp = value / 1024.0f;
-			break;
-		}
-			
-		// output related //
-		case R48xx_DATA_OUTPUT_POWER:
-		{
-			m_rectifierParams.output_power = value / 1024.0f;
-			break;
+// getters are summed up over the CAN interfaces with recent telemetry //
+float PsuController::getCurrentInputPower() const {
+	float sum = 0.0f;
+	for(const auto& bus : m_canBuses) {
+		if(bus->isReporting()) {
+			sum += bus->getParams().input_power;
 		}
+	}
+	return sum;
+}
 
-		case R48xx_DATA_EFFICIENCY:
-		{
-			m_rectifierParams.efficiency = value / 1024.0f;
-			break;
+float PsuController::getCurrentOutputPower() const {
+	float sum = 0.0f;
+	for(const auto& bus : m_canBuses) {
+		if(bus->isReporting()) {
+			sum += bus->getParams().output_power;
 		}
+	}
+	return sum;
+}
 
-		case R48xx_DATA_OUTPUT_VOLTAGE:
-		{
-			m_rectifierParams.output_voltage = value / 1024.0f;
-			break;
+// all PSUs charge the same battery --> average over the ones that already reported
+float PsuController::getCurrentOutputVoltage() const {
+	float sum = 0.0f;
+	int count = 0;
+	for(const auto& bus : m_canBuses) {
+		float voltage = bus->getParams().output_voltage;
+		if(voltage > 0.0f && bus->isReporting()) {
+			sum += voltage;
+			count++;
 		}
+	}
+	return count > 0 ? sum / count : 0.0f;
+}
 
-		case R48xx_DATA_OUTPUT_CURRENT1:		// --> alternative current measurement
-		{
-			// printf("Output Current(1) %.02fA\r\n", value / 1024.0);
-			// rp->output_current = value / 1024.0;
-			break;
+float PsuController::getCurrentOutputCurrent() const {
+	float sum = 0.0f;
+	for(const auto& bus : m_canBuses) {
+		if(bus->isReporting()) {
+			sum += bus->getParams().output_current;
 		}
+	}
+	return sum;
+}
 
-		case R48xx_DATA_OUTPUT_CURRENT:			// --> usually received at last
-		{
-			m_rectifierParams.output_current = value / 1024.0f;
-			#ifdef _VERBOSE_OUTPUT
-				this->printParams();
-			#endif
-			break;
-		}
+float PsuController::getLastCurrentCmd() {
+	const std::lock_guard<std::mutex> lock(m_mutex);
+	return m_lastCurrentCmd;
+}
 
-		case R48xx_DATA_OUTPUT_CURRENT_MAX:
-		{
-			m_rectifierParams.max_output_current = value / static_cast<float>(MAX_CURRENT_MULTIPLIER);
-			break;
-		}
+// only set by the regulator thread
+float PsuController::getLastVoltageCmd() const {
+	return m_lastVoltageCmd;
+}
 
-		case R48xx_DATA_OUTPUT_TEMPERATURE:
-		{
-			m_rectifierParams.output_temp = value / 1024.0f;
-			break;
+// hottest sensor (input or output side) of all PSUs
+float PsuController::getMaxTemperature() const {
+	float maxTemperature = 0.0f;
+	for(const auto& bus : m_canBuses) {
+		if(!bus->isReporting()) {
+			continue;
 		}
+		RectifierParameters params = bus->getParams();
+		maxTemperature = std::max(maxTemperature, std::max(params.input_temp, params.output_temp));
+	}
+	return maxTemperature;
+}
 
-		default:
-		{
-			// printf("Unknown parameter 0x%02X, 0x%04X\r\n",frame[1], value);
-			break;
-		}
-			
+float PsuController::getChargedAmpHours() const {
+	float sum = 0.0f;
+	for(const auto& bus : m_canBuses) {
+		sum += bus->getParams().amp_hour;
 	}
+	return sum;
 }
 
-// process an acknowledge frame from the PSU
-void PsuController::processAckFrame(uint8_t *frame) {
-	// decode error flag and 
-	bool error = frame[0] & 0x20;
-	uint32_t value = __builtin_bswap32(*(uint32_t*)&frame[4]);
+bool PsuController::isSlotDetectOn() {
+	const std::lock_guard<std::mutex> lock(m_mutex);
+	return m_slotDetectOn;
+}
 
-	switch (frame[1]) {
-		case 0x00:
-		{
-			printf("%s setting online voltage to %.02fV\n", error ? "Error" : "Success", value / 1024.0);
-			break;
-		}
-			
-		case 0x01:
-		{
-			printf("%s setting non-volatile (offline) voltage to %.02fV\n", error ? "Error" : "Success", value / 1024.0);
-			break;
-		}
-			
-		case 0x02:
-		{
-			printf("%s setting overvoltage protection to %.02fV\n", error ? "Error" : "Success", value / 1024.0);
-			break;
-		}
-			
-		case 0x03:
-		{
-			float currentAck = static_cast<float>(value) / MAX_CURRENT_MULTIPLIER;
-			if(m_cmdAckFlag == false && currentAck == m_lastCurrentCmd) {
-				printf("%s setting online current to %.02fA\n", error ? "Error" : "Success", currentAck);
-				m_cmdAckFlag = true;
-			}
-			break;
-		}
-			
-		case 0x04:
-		{
-			printf("%s setting non-volatile (offline) current to %.02fA\n", error ? "Error" : "Success", static_cast<float>(value) / MAX_CURRENT_MULTIPLIER);
+// measured wake-up time of the PSUs in ms (default until the first measurement)
+long PsuController::getWakeTime() const {
+	return m_wakeTime;
+}
+
+// measured wake-up time in ms for the warm start (0 = not measured yet)
+long PsuController::getMeasuredWakeTime() {
+	const std::lock_guard<std::mutex> lock(m_mutex);
+	return m_wakeMeasured ? m_wakeTime.load() : 0;
+}
+
+void PsuController::restoreWakeTime(long wakeTime) {
+	const std::lock_guard<std::mutex> lock(m_mutex);
+	if(wakeTime > 0 && wakeTime <= SD_MAX_WAKE_TIME) {
+		m_wakeTime = wakeTime;
+		m_wakeMeasured = true;
+	}
+}
+
+// snapshot of the state for handing over the control to a new process (hot restart)
+void PsuController::getHandoverState(HandoverState& state) {
+	const std::lock_guard<std::mutex> lock(m_mutex);
+	state.lastCurrentCmd = m_lastCurrentCmd;
+	state.lastVoltageCmd = m_lastVoltageCmd;
+	state.slotDetectOn = m_slotDetectOn ? 1 : 0;
+	state.msSinceLastCharge = duration_cast<milliseconds>(steady_clock::now() - m_lastChargeTime).count();
+	state.canBusCount = 0;
+	for(const auto& bus : m_canBuses) {
+		if(state.canBusCount >= HOT_RESTART_MAX_BUSES) {
 			break;
 		}
-			
-		default:
-		{
-			printf("%s setting unknown parameter (0x%02X)\n", error ? "Error" : "Success", frame[1]);
-		}
+		strncpy(state.interfaceNames[state.canBusCount], bus->getInterfaceName(), IFNAMSIZ - 1);
+		state.telemetry[state.canBusCount] = bus->getParams();
+		state.canBusCount++;
 	}
 }
 
+std::vector<int> PsuController::getSockets() const {
+	std::vector<int> sockets;
+	for(const auto& bus : m_canBuses) {
+		sockets.push_back(bus->getSocket());
+	}
+	return sockets;
+}
+
+size_t PsuController::getBusCount() const {
+	return m_canBuses.size();
+}
+
+CanBusMetrics PsuController::getBusMetrics(size_t index) const {
+	return m_canBuses[index]->getMetrics();
+}
+
 // setup wiringpi for direct GPIO interfacing (on raspberry pi only)
-bool PsuController::initSlotDetect() {
-	#ifdef _TARGET_RASPI
-		wiringPiSetupGpio();
-		pinMode(SD_PIN, OUTPUT);
-
-		// turn off slot detect at application startup if feature is enabled
-		if(cfg.isSlotDetectControlEnabled()) {
-			digitalWrite(SD_PIN, LOW);
+// when sd control is disabled slot detect is just turned on once
+// switches the slot detect relay if the control is enabled (called with locked mutex)
+void PsuController::setSlotDetect(bool on) {
+	if(!m_cfg.isSlotDetectControlEnabled()) {
+		return;
+	}
+
+	SlotDetect::write(on);
+	if(on && !m_slotDetectOn) {
+		m_slotDetectOnTime = steady_clock::now();
+		m_wakePending = true;
+	} else if(!on) {
+		m_wakePending = false;
+	}
+	if(SlotDetect::available) {
+		if(on) {
+			std::cout << "[PSU] Slot detect (re)enabled" << std::endl;
 		} else {
-			digitalWrite(SD_PIN, HIGH);		// when sd control disabled just turn on once 
+			std::cout << "[PSU] Turn off slot detect --> standby mode" << std::endl;
 		}
-		std::cout << "[PSU] Slot detect initialized" << std::endl;
-	#endif
-
-	return true;
-}
\ No newline at end of file
+	}
+	m_slotDetectOn = on;
+}
@@ -1,6 +1,7 @@
 /*
     File: PsuController.h
-    This class handles CAN communication with the Huawei R4850G2 power supply
+    This class controls the Huawei R4850G2 power supplies on one or more CAN interfaces
+    (see CanBus) and the slot detect relay
 
 	Code from original repository: https://github.com/craigpeacock/Huawei_R4850G2_CAN
 	Edited by Elias Geiger
@@ -14,99 +15,79 @@
 #include <cstdlib>
 #include <atomic>
 #include <thread>
+#include <mutex>
 #include <chrono>
-
-#include <unistd.h>
-#include <signal.h>
-#include <net/if.h>
-#include <sys/ioctl.h>
-#include <sys/socket.h>
-
-#include <linux/can.h>
-#include <linux/can/raw.h>
+#include <memory>
+#include <vector>
 
 #include "ConfigFile.h"
-
-#ifdef _TARGET_RASPI
-	#include <wiringPi.h>
-#endif
+#include "PsuInterface.h"
+#include "BatteryMonitor.h"
+#include "CanBus.h"
+#include "HotRestart.h"
+#include "SlotDetect.h"
 
 using std::chrono::steady_clock;
 using std::chrono::milliseconds;
 using std::chrono::duration_cast;
 
-// GPIO pin that controls the slot detect relay (active high)
-#define SD_PIN 17
-
-// config variables ---------------------
-#define MAX_CURRENT_MULTIPLIER		20
-#define R48xx_DATA_INPUT_POWER		0x70
-#define R48xx_DATA_INPUT_FREQ		0x71
-#define R48xx_DATA_INPUT_CURRENT	0x72
-#define R48xx_DATA_OUTPUT_POWER		0x73
-#define R48xx_DATA_EFFICIENCY		0x74
-#define R48xx_DATA_OUTPUT_VOLTAGE	0x75
-#define R48xx_DATA_OUTPUT_CURRENT_MAX	0x76
-#define R48xx_DATA_INPUT_VOLTAGE	0x78
-#define R48xx_DATA_OUTPUT_TEMPERATURE	0x7F
-#define R48xx_DATA_INPUT_TEMPERATURE	0x80
-#define R48xx_DATA_OUTPUT_CURRENT	0x81
-#define R48xx_DATA_OUTPUT_CURRENT1	0x82
-// ---------------------------------------
-
-// struct represents a state including all parameters of the PSU
-struct RectifierParameters
+class PsuController : public PsuInterface
 {
-	float input_voltage;
-	float input_frequency;
-	float input_current;
-	float input_power;
-	float input_temp;
-	float efficiency;
-	float output_voltage;
-	float output_current;
-	float max_output_current;
-	float output_power;
-	float output_temp;
-	float amp_hour;
-};
+	const ConfigFile& m_cfg;
+	BatteryMonitor& m_battery;
 
-class PsuController 
-{
-    // stores latest state of the PSU params
-	struct RectifierParameters m_rectifierParams;
+	// one worker per CAN interface
+	std::vector<std::unique_ptr<CanBus>> m_canBuses;
 
-	// CAN related 
-	struct sockaddr_can m_addr;
-	int m_canSocket;
-	struct ifreq m_ifr;
+	std::mutex m_mutex;
+	float m_lastCurrentCmd, m_lastVoltageCmd;
+	bool m_slotDetectOn;
+	steady_clock::time_point m_lastChargeTime, m_lastBatterySaveTime;
 
-	std::thread m_workerTh;
-	std::atomic<bool> m_threadRunning;
-	float m_lastCurrentCmd;
-	bool m_cmdAckFlag;
-	unsigned int m_secondsSinceLastCharge;
+	// wake-up time of the PSUs: slot detect on until the first status frame
+	std::atomic<bool> m_wakePending;
+	std::atomic<long> m_wakeTime;
+	bool m_wakeMeasured;
+	steady_clock::time_point m_slotDetectOnTime;
 
 public:
-    PsuController();
+    PsuController(const ConfigFile&, BatteryMonitor&);
     ~PsuController();
 
-    bool setup(const char*);
-    void shutdown();
+    bool setup(const std::vector<std::string>&) override;
+    bool takeOver(const std::vector<std::string>&, const std::vector<int>&, const HandoverState&);
+    void shutdown() override;
+    void detach() override;
     void printParams() const;
-    bool setMaxVoltage(float, bool);
-    bool setMaxCurrent(float, bool);
-    bool requestStatusData();
+    bool setMaxVoltage(float, bool) override;
+    bool setMaxCurrent(float, bool) override;
+    void enterStandby() override;
+    bool wakeUp() override;
+
+    // called by the CAN workers //
+    void periodicTasks();
+    void updateBatteryState(float, float);
+    void notifyStatusFrame();
 
     // getters //
-    float getCurrentInputPower() const;
-    float getCurrentOutputVoltage() const;
-    float getCurrentOutputCurrent() const;
+    float getCurrentInputPower() const override;
+    float getCurrentOutputPower() const override;
+    float getCurrentOutputVoltage() const override;
+    float getCurrentOutputCurrent() const override;
+    float getLastCurrentCmd() override;
+    float getLastVoltageCmd() const override;
+    float getMaxTemperature() const override;
+    float getChargedAmpHours() const;
+    bool isSlotDetectOn() override;
+    long getWakeTime() const override;
+    long getMeasuredWakeTime() override;
+    void restoreWakeTime(long) override;
+    void getHandoverState(HandoverState&);
+    std::vector<int> getSockets() const;
+    size_t getBusCount() const;
+    CanBusMetrics getBusMetrics(size_t) const;
 
 private:
     // helper methods //
-    bool sendCanFrame(struct can_frame);
-    void updateLocalParams(uint8_t*);
-    void processAckFrame(uint8_t*);
-	bool initSlotDetect();
+	void setSlotDetect(bool);
 };
\ No newline at end of file
@@ -0,0 +1,45 @@
+/*
+    File: PsuInterface.h
+    The PSU side of a regulator as seen by the regulation: setpoints, telemetry and the slot detect
+    wake-up. PsuController drives the real rectifiers on the CAN bus, tests and benchmarks inject a
+    simulated PSU instead
+
+    written by Elias Geiger
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+class PsuInterface
+{
+public:
+    virtual ~PsuInterface() {}
+
+    // lifecycle (the arguments are the configured CAN interfaces)
+    virtual bool setup(const std::vector<std::string>&) = 0;
+    virtual void shutdown() = 0;
+    virtual void detach() = 0;
+
+    // setpoints, do not block
+    virtual bool setMaxVoltage(float, bool) = 0;
+    virtual bool setMaxCurrent(float, bool) = 0;
+    virtual void enterStandby() = 0;
+    virtual bool wakeUp() = 0;
+
+    // telemetry summed up over all PSUs
+    virtual float getCurrentInputPower() const = 0;
+    virtual float getCurrentOutputPower() const = 0;
+    virtual float getCurrentOutputVoltage() const = 0;
+    virtual float getCurrentOutputCurrent() const = 0;
+    virtual float getMaxTemperature() const = 0;
+
+    // last setpoints and wake-up timing
+    virtual float getLastCurrentCmd() = 0;
+    virtual float getLastVoltageCmd() const = 0;
+    virtual bool isSlotDetectOn() = 0;
+    virtual long getWakeTime() const = 0;
+    virtual long getMeasuredWakeTime() = 0;
+    virtual void restoreWakeTime(long) = 0;
+};
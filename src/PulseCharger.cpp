@@ -0,0 +1,164 @@
+/*
+    File: PulseCharger.cpp
+    written by Elias Geiger
+*/
+
+#include "PulseCharger.h"
+
+// constructor
+PulseCharger::PulseCharger(short pulsePower, short threshold, int window) {
+    m_pulsePower = pulsePower;
+    m_threshold = threshold;
+    m_window = window > 0 ? window : 1;
+    m_active = false;
+    m_pulseOn = false;
+    m_initialized = false;
+    m_lastUpdateTime = 0;
+    m_averageSurplus = 0.0f;
+    m_credit = 0.0f;
+    memset(m_efficiency, 0, sizeof(m_efficiency));
+    memset(m_efficiencyValid, 0, sizeof(m_efficiencyValid));
+    m_acEnergy = 0.0;
+    m_dcEnergy = 0.0;
+    m_activeHours = 0.0;
+}
+
+// decides on the charge power for the current surplus (the power continuous charging would command).
+// returns false if the surplus is high enough for the normal regulation
+bool PulseCharger::update(short surplus, long long timeMs, short maxChargePower, short& powerCmd) {
+    float seconds = m_initialized ? (timeMs - m_lastUpdateTime) / 1000.0f : 0.0f;
+    if(seconds < 0.0f || seconds > PULSE_MAX_UPDATE_GAP) {
+        seconds = 0.0f;
+    }
+    m_lastUpdateTime = timeMs;
+
+    // average the surplus over the window (first order lag)
+    if(!m_initialized) {
+        m_averageSurplus = surplus;
+        m_initialized = true;
+    } else {
+        float alpha = seconds / m_window;
+        m_averageSurplus += (alpha < 1.0f ? alpha : 1.0f) * (surplus - m_averageSurplus);
+    }
+
+    // pulses need to be possible at the max charge power (e.g. tapered near full)
+    short pulsePower = m_pulsePower < maxChargePower ? m_pulsePower : maxChargePower;
+
+    if(!m_active) {
+        if(m_averageSurplus >= m_threshold || pulsePower <= m_threshold) {
+            return false;
+        }
+        printf("[Pulse] Average surplus %.0fW --> enter pulse mode\n", m_averageSurplus);
+        m_active = true;
+        m_pulseOn = false;
+        m_credit = 0.0f;
+    } else if(m_averageSurplus > PULSE_HYSTERESIS * m_threshold || surplus >= pulsePower) {
+        printf("[Pulse] Average surplus %.0fW --> leave pulse mode\n", m_averageSurplus);
+        m_active = false;
+        m_pulseOn = false;
+        return false;
+    }
+
+    // collect the surplus that was not charged. bounded to one window of pulses
+    float chargePower = m_pulseOn ? pulsePower : 0.0f;
+    m_credit += (surplus - chargePower) * seconds;
+    float maxCredit = static_cast<float>(pulsePower) * m_window;
+    float minCredit = -static_cast<float>(pulsePower) * PULSE_MIN_ON_TIME;
+    m_credit = m_credit > maxCredit ? maxCredit : (m_credit < minCredit ? minCredit : m_credit);
+
+    // start a pulse once it can last the min on time, stop when the collected surplus is used up
+    if(!m_pulseOn && m_credit >= static_cast<float>(pulsePower) * PULSE_MIN_ON_TIME) {
+        m_pulseOn = true;
+        printf("[Pulse] Pulse on (%dW)\n", pulsePower);
+    } else if(m_pulseOn && m_credit <= 0.0f) {
+        m_pulseOn = false;
+        printf("[Pulse] Pulse off\n");
+    }
+
+    powerCmd = m_pulseOn ? pulsePower : 0;
+    return true;
+}
+
+// accounts the PSU telemetry for the efficiency map and the energy balance of the pulse mode
+void PulseCharger::addTelemetry(float inputPower, float outputPower, float seconds) {
+    if(inputPower > PULSE_EFFICIENCY_BIN / 2 && outputPower > 0.0f && outputPower < inputPower) {
+        int bin = static_cast<int>(inputPower / PULSE_EFFICIENCY_BIN);
+        if(bin < PULSE_EFFICIENCY_BINS) {
+            float efficiency = outputPower / inputPower;
+            if(m_efficiencyValid[bin]) {
+                m_efficiency[bin] += PULSE_EFFICIENCY_SMOOTHING * (efficiency - m_efficiency[bin]);
+            } else {
+                m_efficiency[bin] = efficiency;
+                m_efficiencyValid[bin] = true;
+            }
+        }
+    }
+
+    // the idle consumption between the pulses counts as well
+    if(m_active && seconds > 0.0f && seconds <= PULSE_MAX_UPDATE_GAP) {
+        double hours = seconds / 3600.0;
+        m_acEnergy += inputPower * hours;
+        m_dcEnergy += outputPower * hours;
+        m_activeHours += hours;
+    }
+}
+
+// prints the energy balance of the pulse mode compared to continuous charging
+void PulseCharger::printReport() const {
+    if(m_activeHours <= 0.0 || m_dcEnergy <= 0.0) {
+        return;
+    }
+
+    double averagePower = m_acEnergy / m_activeHours;
+    printf("[Pulse] Pulse mode %.1fh: AC %.1fWh, DC %.1fWh (%.1f%%), continuous at %.0fW would be %.1f%% --> net gain %.1fWh\n",
+            m_activeHours, m_acEnergy, m_dcEnergy, m_dcEnergy / m_acEnergy * 100.0, averagePower,
+            getEfficiency(averagePower) * 100.0f, getNetGain());
+}
+
+// measured efficiency per AC input power bin for the warm start (PULSE_EFFICIENCY_BINS entries)
+void PulseCharger::getEfficiencyMap(float* efficiency, uint8_t* valid) const {
+    for(int bin = 0; bin < PULSE_EFFICIENCY_BINS; bin++) {
+        efficiency[bin] = m_efficiency[bin];
+        valid[bin] = m_efficiencyValid[bin] ? 1 : 0;
+    }
+}
+
+void PulseCharger::restoreEfficiencyMap(const float* efficiency, const uint8_t* valid) {
+    for(int bin = 0; bin < PULSE_EFFICIENCY_BINS; bin++) {
+        m_efficiency[bin] = efficiency[bin];
+        m_efficiencyValid[bin] = valid[bin] != 0 && efficiency[bin] > 0.0f && efficiency[bin] < 1.0f;
+    }
+}
+
+bool PulseCharger::isActive() const {
+    return m_active;
+}
+
+bool PulseCharger::isPulseOn() const {
+    return m_pulseOn;
+}
+
+float PulseCharger::getAverageSurplus() const {
+    return m_averageSurplus;
+}
+
+// measured efficiency at an AC input power. falls back to the expected efficiency of the regulator
+float PulseCharger::getEfficiency(float inputPower) const {
+    int bin = static_cast<int>(inputPower / PULSE_EFFICIENCY_BIN);
+    if(bin >= 0 && bin < PULSE_EFFICIENCY_BINS && m_efficiencyValid[bin]) {
+        return m_efficiency[bin];
+    }
+    return getExpectedEfficiency(inputPower);
+}
+
+// AC energy continuous charging at the average power would have needed for the same DC energy, minus the actual AC energy
+double PulseCharger::getNetGain() const {
+    if(m_activeHours <= 0.0) {
+        return 0.0;
+    }
+    float continuousEfficiency = getEfficiency(static_cast<float>(m_acEnergy / m_activeHours));
+    if(continuousEfficiency <= 0.0f) {
+        return 0.0;
+    }
+    return m_dcEnergy / continuousEfficiency - m_acEnergy;
+}
@@ -0,0 +1,72 @@
+/*
+    File: PulseCharger.h
+    Efficiency optimised charging at low PV surplus. Instead of running the PSU at a poor efficiency
+    operating point the surplus is collected over a window and charged in pulses at a high efficiency
+    operating point. The PSU idles in between (slot detect is dropped by the keep alive timer).
+    The net energy gain versus continuous charging is estimated from the measured efficiency
+
+    written by Elias Geiger
+*/
+
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+
+#include "Regulation.h"
+
+// resolution and range of the measured efficiency map (AC input power)
+#define PULSE_EFFICIENCY_BIN 50             // in watts
+#define PULSE_EFFICIENCY_BINS 60
+
+// weight of a new measurement in the efficiency map
+#define PULSE_EFFICIENCY_SMOOTHING 0.05f
+
+// a pulse lasts at least this long (PSU ramp up and meter latency are amortized) in seconds
+#define PULSE_MIN_ON_TIME 20
+
+// pulse mode is left when the average surplus exceeds the threshold by this factor
+#define PULSE_HYSTERESIS 1.2f
+
+// updates further apart than this are not integrated (meter downtime) in seconds
+#define PULSE_MAX_UPDATE_GAP 10
+
+// period of the net gain report in seconds
+#define PULSE_REPORT_INTERVAL 900
+
+class PulseCharger
+{
+    short m_pulsePower, m_threshold;
+    int m_window;
+
+    // operating state
+    bool m_active, m_pulseOn;
+    bool m_initialized;
+    long long m_lastUpdateTime;
+    float m_averageSurplus;
+    float m_credit;                 // collected surplus energy not charged yet in Ws
+
+    // measured efficiency per AC input power bin
+    float m_efficiency[PULSE_EFFICIENCY_BINS];
+    bool m_efficiencyValid[PULSE_EFFICIENCY_BINS];
+
+    // energy flows while the pulse mode was active in Wh
+    double m_acEnergy, m_dcEnergy, m_activeHours;
+
+public:
+    PulseCharger(short, short, int);
+
+    bool update(short, long long, short, short&);
+    void addTelemetry(float, float, float);
+    void printReport() const;
+    void getEfficiencyMap(float*, uint8_t*) const;
+    void restoreEfficiencyMap(const float*, const uint8_t*);
+
+    // getters //
+    bool isActive() const;
+    bool isPulseOn() const;
+    float getAverageSurplus() const;
+    float getEfficiency(float) const;
+    double getNetGain() const;
+};
@@ -0,0 +1,96 @@
+/*
+    File: Queue.h
+    Queue is a template class for a simple thread safe processing queue
+    in a typical scenario with one producer and at least one consumer thread
+
+    written by Elias Geiger
+*/
+
+#pragma once
+
+#include <mutex>
+#include <cstddef>
+
+// default number of elements the queue can hold. the oldest element is dropped when it is full
+#define QUEUE_CAPACITY 32
+
+// fixed ring buffer --> pushing and popping never allocates memory
+template<class T, size_t N = QUEUE_CAPACITY> class Queue {
+
+    T m_buffer[N];
+    size_t m_head, m_count;
+    unsigned long m_dropCount;
+    std::mutex m_mutex;
+
+public:
+    Queue() : m_head(0), m_count(0), m_dropCount(0) {}
+
+    // Pushes new element into queue. Drops the oldest element if the queue is full
+    // function blocks as long as mutex is locked by someone else
+    void push(T elem) 
+    {
+        // apply lock guard for thread safe access to the queue
+        const std::lock_guard<std::mutex> lock(m_mutex);
+        if(m_count == N) {
+            m_head = (m_head + 1) % N;
+            m_count--;
+            m_dropCount++;
+        }
+        m_buffer[(m_head + m_count) % N] = elem;
+        m_count++;
+    }
+
+    // Attempts to fetch and pop elements from the queue and stores the latest element. returns false if queue was empty from the start
+    // return by reference, blocks as longs as locked by someone else, doesn't wait for queue to be filled when empty
+    bool tryPop(T& elem) 
+    {
+        // apply lock guard for thread safe access to the queue
+        const std::lock_guard<std::mutex> lock(m_mutex);
+        
+        // check and abort if queue is already/still empty
+        if(m_count == 0) {
+            return false;
+        }
+
+        // pop all elements, return the last via reference
+        elem = m_buffer[(m_head + m_count - 1) % N];
+        m_head = 0;
+        m_count = 0;
+
+        return true;
+    }
+
+    // Pops all elements in the order they were pushed into the given array (room for N elements). returns the count
+    size_t popAll(T* elems)
+    {
+        const std::lock_guard<std::mutex> lock(m_mutex);
+        size_t count = m_count;
+        for(size_t i = 0; i < count; i++) {
+            elems[i] = m_buffer[(m_head + i) % N];
+        }
+        m_head = 0;
+        m_count = 0;
+
+        return count;
+    }
+
+    // Pops all elements in the queue until empty
+    void clear() {
+        // apply lock guard for thread safe access to the queue
+        const std::lock_guard<std::mutex> lock(m_mutex);
+        m_head = 0;
+        m_count = 0;
+    }
+
+    // number of elements waiting
+    size_t getSize() {
+        const std::lock_guard<std::mutex> lock(m_mutex);
+        return m_count;
+    }
+
+    // number of elements dropped because the queue was full
+    unsigned long getDropCount() {
+        const std::lock_guard<std::mutex> lock(m_mutex);
+        return m_dropCount;
+    }
+};
@@ -0,0 +1,197 @@
+/*
+    File: Regulation.cpp
+
+    written by Elias Geiger
+*/
+
+#include "Regulation.h"
+
+// calculates the new AC charge power for a received power state. 
+// returns false if the deviation or the change to the last command is too small to be compensated
+bool calculatePowerCommand(const PowerState& state, const RegulatorSettings& settings, short lastPowerCmd, short& powerCmd) {
+    // calculate error (absolute difference from target value)
+    // don't try to compensate for very small errors
+    short error = settings.targetGridPower - state.tasmotaPowerCmd;
+    if(abs(error) < settings.errorThreshold) {
+        return false;
+    }
+    powerCmd = state.psuAcInputPower + static_cast<short>(settings.gain * error);
+
+    // set bounds for allowed power commands (min and max)
+    if(powerCmd > settings.maxChargePower) {
+        powerCmd = settings.maxChargePower;
+    }
+
+    if(powerCmd < settings.minChargePower) {
+        powerCmd = 0;
+    }
+
+    // skip tiny corrections of the last command. turning the charger off always goes through
+    if(powerCmd != 0 && abs(powerCmd - lastPowerCmd) < settings.minCommandStep) {
+        return false;
+    }
+
+    return true;
+}
+
+// calculates the combined setpoint of charger and discharge inverter (positive = AC charge power,
+// negative = AC discharge power) for a received power state and the current discharge power.
+// The direction only changes once the active device was turned off and the deviation exceeds the
+// hysteresis. returns false if the deviation or the change to the last command is too small
+bool calculateCombinedCommand(const PowerState& state, short dischargePower, const RegulatorSettings& settings,
+                                const DischargeSettings& discharge, PowerMode& mode, short lastCombinedCmd, short& combinedCmd) {
+    short error = settings.targetGridPower - state.tasmotaPowerCmd;
+    if(abs(error) < settings.errorThreshold) {
+        return false;
+    }
+    int desired = state.psuAcInputPower - dischargePower + static_cast<int>(settings.gain * error);
+
+    // change the direction (mutual exclusion: the last command turned the active device off)
+    if(mode == POWER_MODE_CHARGE && lastCombinedCmd <= 0 && desired < -discharge.modeHysteresis) {
+        mode = POWER_MODE_DISCHARGE;
+    } else if(mode == POWER_MODE_DISCHARGE && lastCombinedCmd >= 0 && desired > discharge.modeHysteresis) {
+        mode = POWER_MODE_CHARGE;
+    }
+
+    // set bounds for allowed power commands of the active direction (min and max)
+    if(mode == POWER_MODE_CHARGE) {
+        desired = desired > settings.maxChargePower ? settings.maxChargePower : desired;
+        desired = desired < settings.minChargePower ? 0 : desired;
+    } else {
+        desired = desired < -discharge.maxDischargePower ? -discharge.maxDischargePower : desired;
+        desired = desired > -discharge.minDischargePower ? 0 : desired;
+    }
+    combinedCmd = static_cast<short>(desired);
+
+    // skip tiny corrections of the last command. turning a device off always goes through
+    if(combinedCmd != 0 && abs(combinedCmd - lastCombinedCmd) < settings.minCommandStep) {
+        return false;
+    }
+
+    return true;
+}
+
+// adaptive deadband //
+AdaptiveDeadband::AdaptiveDeadband(int floor, int ceiling, float sigmaFactor) {
+    m_floor = floor;
+    m_ceiling = ceiling > floor ? ceiling : floor;
+    m_sigmaFactor = sigmaFactor;
+    m_initialized = false;
+    m_lastDisturbance = 0.0f;
+    m_noiseVariance = 0.0f;
+    m_residualMean = 0.0f;
+    m_residualVariance = 0.0f;
+}
+
+// updates the noise statistics with a new meter reading
+void AdaptiveDeadband::addSample(const PowerState& state, short targetGridPower) {
+    // grid power without the charger --> the disturbance the regulator has to follow
+    float disturbance = static_cast<float>(state.tasmotaPowerCmd - state.psuAcInputPower);
+    // deviation that remains after the PSU responded
+    float residual = static_cast<float>(targetGridPower - state.tasmotaPowerCmd);
+
+    if(!m_initialized) {
+        m_lastDisturbance = disturbance;
+        m_residualMean = residual;
+        m_initialized = true;
+        return;
+    }
+
+    // the variance of the sample to sample change is twice the variance of white sensor noise,
+    // while slow load trends hardly contribute. load steps are clipped to keep them from dominating
+    float change = disturbance - m_lastDisturbance;
+    float maxChange = 2.0f * m_ceiling;
+    change = change > maxChange ? maxChange : (change < -maxChange ? -maxChange : change);
+    m_lastDisturbance = disturbance;
+    m_noiseVariance += DEADBAND_SMOOTHING * (change * change / 2.0f - m_noiseVariance);
+
+    // running mean and variance of the residual
+    float deviation = residual - m_residualMean;
+    m_residualMean += DEADBAND_SMOOTHING * deviation;
+    m_residualVariance += DEADBAND_SMOOTHING * (deviation * deviation - m_residualVariance);
+}
+
+// deviations within the meter noise band are not compensated
+int AdaptiveDeadband::getErrorThreshold() const {
+    return clamp(m_sigmaFactor * getNoiseLevel());
+}
+
+// command changes smaller than the typical residual can't be told apart from noise after the PSU responded
+int AdaptiveDeadband::getMinCommandStep() const {
+    return clamp(getResidualLevel());
+}
+
+// standard deviation of the meter noise in W
+float AdaptiveDeadband::getNoiseLevel() const {
+    return std::sqrt(m_noiseVariance);
+}
+
+// standard deviation of the residual in W
+float AdaptiveDeadband::getResidualLevel() const {
+    return std::sqrt(m_residualVariance);
+}
+
+// learned statistics for the warm start. returns false if there are none yet
+bool AdaptiveDeadband::getState(DeadbandState& state) const {
+    state.lastDisturbance = m_lastDisturbance;
+    state.noiseVariance = m_noiseVariance;
+    state.residualMean = m_residualMean;
+    state.residualVariance = m_residualVariance;
+    return m_initialized;
+}
+
+void AdaptiveDeadband::restoreState(const DeadbandState& state) {
+    m_lastDisturbance = state.lastDisturbance;
+    m_noiseVariance = state.noiseVariance;
+    m_residualMean = state.residualMean;
+    m_residualVariance = state.residualVariance;
+    m_initialized = true;
+}
+
+int AdaptiveDeadband::clamp(float value) const {
+    int result = static_cast<int>(value + 0.5f);
+    if(result < m_floor) {
+        return m_floor;
+    }
+    if(result > m_ceiling) {
+        return m_ceiling;
+    }
+    return result;
+}
+
+// Helper function to round float values on decimals
+float round(float var)
+{
+    float value = (int)(var * 100 + .5);
+    return static_cast<float>(value) / 100;
+}
+
+// expected AC/DC conversion efficiency of the PSU at an AC power
+float getExpectedEfficiency(float power) {
+    float eff = 0.0f;
+    if(power >= 1 && power < 461) {
+        eff = 0.88f;
+    } else if(power >= 461 && power < 704) {
+        eff = 0.937f;
+    } else if(power >= 704 && power < 1050) {
+        eff = 0.952f;
+    } else if(power >= 1050) {
+        eff = 0.96f;
+    }
+    return eff;
+}
+
+float calculateCurrentBasedOnPower(float power, float batteryVoltage) {
+    // no status report received yet
+    if(batteryVoltage <= 0.0f) {
+        return 0.0f;
+    }
+
+    // Determine expected AC/DC conversion efficiency based on power command
+    float eff = getExpectedEfficiency(power);
+
+    // calculate and round the current 
+    float result = round(0.9876f * eff * power / batteryVoltage);
+
+    return result;
+}
@@ -0,0 +1,84 @@
+/*
+    File: Regulation.h
+    Contains the decision logic of the power regulator. It is free of any I/O and global state
+    so it can be shared between the regulator app and the offline tuning tool
+
+    written by Elias Geiger
+*/
+
+#pragma once
+
+#include <cstdlib>
+#include <cmath>
+
+#include "Utils.h"
+
+// bounds and thresholds the regulator decision is based on
+struct RegulatorSettings
+{
+    short targetGridPower;
+    short minChargePower;
+    short maxChargePower;
+    int errorThreshold;
+    int minCommandStep;         // min change compared to the last power command (0 = no limit)
+    float gain;                 // share of the deviation corrected with one command
+};
+
+// direction of the power flow of the battery. charger and discharge inverter are never active together
+enum PowerMode
+{
+    POWER_MODE_CHARGE,
+    POWER_MODE_DISCHARGE
+};
+
+// bounds of the discharge direction of the combined setpoint (positive = charge, negative = discharge)
+struct DischargeSettings
+{
+    short minDischargePower;
+    short maxDischargePower;
+    int modeHysteresis;         // deviation beyond zero in watts before the direction changes
+};
+
+// learned noise statistics of the adaptive deadband (warm start)
+struct DeadbandState
+{
+    float lastDisturbance;
+    float noiseVariance;
+    float residualMean, residualVariance;
+};
+
+// weight of a new sample in the running noise statistics (about the last 20 meter readings count)
+#define DEADBAND_SMOOTHING 0.05f
+
+// derives the error threshold and the min command step from the measured noise of the meter signal
+// and of the remaining deviation after the PSU responded, clamped to the configured floor and ceiling
+class AdaptiveDeadband
+{
+    int m_floor, m_ceiling;
+    float m_sigmaFactor;
+
+    bool m_initialized;
+    float m_lastDisturbance;
+    float m_noiseVariance;
+    float m_residualMean, m_residualVariance;
+
+public:
+    AdaptiveDeadband(int, int, float);
+
+    void addSample(const PowerState&, short);
+    int getErrorThreshold() const;
+    int getMinCommandStep() const;
+    float getNoiseLevel() const;
+    float getResidualLevel() const;
+    bool getState(DeadbandState&) const;
+    void restoreState(const DeadbandState&);
+
+private:
+    int clamp(float) const;
+};
+
+// function prototypes
+bool calculatePowerCommand(const PowerState&, const RegulatorSettings&, short, short&);
+bool calculateCombinedCommand(const PowerState&, short, const RegulatorSettings&, const DischargeSettings&, PowerMode&, short, short&);
+float getExpectedEfficiency(float);
+float calculateCurrentBasedOnPower(float, float);
@@ -0,0 +1,587 @@
+/*
+    File: Regulator.cpp
+    written by Elias Geiger
+*/
+
+#include "Regulator.h"
+
+// constructor and destructor
+// with a name the state files of the instance get it as prefix (several instances in one directory)
+// regulator of the PSUs on the configured CAN interfaces and the meter readings on the configured UDP port
+Regulator::Regulator(const std::string& configFile, const std::string& name, RegulatorClock clock, RegulatorWallClock wallClock)
+    : Regulator(new ConfigFile(configFile), nullptr, nullptr, nullptr, name, clock, wallClock) {}
+
+// regulator with an injected config, PSU and meter source (e.g. simulated ones in tests and benchmarks).
+// the meter source pushes its readings into getQueue() and feeds getWatchdog(). no hot restart
+Regulator::Regulator(ConfigFile& cfg, PsuInterface& psu, MeterSource& meter, const std::string& name,
+                        RegulatorClock clock, RegulatorWallClock wallClock)
+    : Regulator(nullptr, &cfg, &psu, &meter, name, clock, wallClock) {}
+
+// the components not injected are created here (null pointers)
+Regulator::Regulator(ConfigFile* ownedCfg, ConfigFile* cfg, PsuInterface* psu, MeterSource* meter, const std::string& name,
+                        RegulatorClock clock, RegulatorWallClock wallClock)
+    : m_name(name),
+      m_clock(clock),
+      m_wallClock(wallClock),
+      m_ownedCfg(ownedCfg),
+      m_cfg(cfg ? *cfg : *m_ownedCfg),
+      m_battery(m_cfg, getFileName(BATTERY_STATE_FILE)),
+      m_canPsu(psu ? nullptr : new PsuController(m_cfg, m_battery)),
+      m_psu(psu ? *psu : *m_canPsu),
+      m_watchdog(m_cfg, m_psu, m_cmdQueue),
+      m_ledger(getFileName(LEDGER_DIRECTORY)),
+      m_udpReceiver(meter ? nullptr : new UdpReceiver(m_cfg, m_psu, m_watchdog, m_ledger, m_cmdQueue, getFileName(METER_LOG_FILE))),
+      m_meter(meter ? *meter : *m_udpReceiver),
+      m_profile(getFileName(LOAD_PROFILE_FILE)),
+      m_warmStart(getFileName(WARM_START_FILE)),
+      m_deadband(DEADBAND_FLOOR, DEADBAND_CEILING, DEADBAND_SIGMA_FACTOR),
+      m_pulseCharger(PULSE_POWER, PULSE_THRESHOLD, PULSE_WINDOW),
+      m_thermal(THERMAL_DERATE_START, CHARGER_ABSORPTION_VOLTAGE),
+      m_cmdMonitor(CHARGER_ABSORPTION_VOLTAGE),
+      m_chargeStages(ChargeStageSettings()) {
+    if(m_name.empty()) {
+        snprintf(m_logTag, sizeof(m_logTag), "[Regulator]");
+    } else {
+        snprintf(m_logTag, sizeof(m_logTag), "[Regulator:%s]", m_name.c_str());
+    }
+    m_lastPowerCmd = 0;
+    m_powerMode = POWER_MODE_CHARGE;
+    m_nextCommandTime = 0;
+    m_lastTelemetryTime = m_clock();
+    m_lastPulseReportTime = m_lastTelemetryTime;
+    m_lastCommandTime = m_lastTelemetryTime;
+    m_lastActiveTime = m_lastTelemetryTime;
+    m_lastWarmStartTime = m_lastTelemetryTime;
+    m_resumeUntil = 0;
+    m_meterInterval = 0;
+}
+
+Regulator::~Regulator() {}
+
+// reads the config file and prepares the regulation with it. returns false if the defaults are used
+bool Regulator::loadConfig() {
+    bool status = m_cfg.loadConfig();
+    m_deadband = AdaptiveDeadband(m_cfg.getDeadbandFloor(), m_cfg.getDeadbandCeiling(), m_cfg.getDeadbandSigmaFactor());
+    m_pulseCharger = PulseCharger(m_cfg.getPulsePower(), m_cfg.getPulseThreshold(), m_cfg.getPulseWindow());
+    m_thermal = ThermalDerating(m_cfg.getThermalDerateStart(), m_cfg.getChargerAbsorptionVoltage());
+    m_cmdMonitor = CommandMonitor(m_cfg.getChargerAbsorptionVoltage());
+
+    ChargeStageSettings stages;
+    stages.absorptionVoltage = m_cfg.getChargerAbsorptionVoltage();
+    stages.floatVoltage = m_cfg.getChargerFloatVoltage();
+    stages.equalizeVoltage = m_cfg.getEqualizeVoltage();
+    stages.tailCurrent = m_cfg.getBatteryTailCurrent();
+    stages.absorptionTime = m_cfg.getAbsorptionTime() * 60.0f;
+    stages.floatMaxCurrent = m_cfg.getFloatMaxCurrent();
+    stages.equalizeEnabled = m_cfg.isEqualizeEnabled();
+    stages.equalizeTime = m_cfg.getEqualizeTime() * 60.0f;
+    stages.equalizeInterval = m_cfg.getEqualizeInterval() * 86400L;
+    stages.equalizeMaxCurrent = m_cfg.getBatteryCapacity() * CHARGE_EQUALIZE_CURRENT_RATE;
+    stages.temperatureCompensation = m_cfg.getChargeTempCompensation() / 1000.0f;
+    m_chargeStages = ChargeStages(stages);
+    return status;
+}
+
+// restores the battery counters and starts the PSU control and the meter source
+bool Regulator::setup() {
+    // restore the battery counters from the last run
+    if(!m_battery.loadState()) {
+        std::cout << "[Battery] No battery state file found --> start counting from zero" << std::endl;
+    }
+    m_battery.printState();
+
+    // start the energy ledger before any meter readings arrive
+    if(m_cfg.isEnergyLedgerEnabled() && !m_ledger.setup()) {
+        std::cerr << "[Ledger] Failed to start energy ledger --> continue without" << std::endl;
+    }
+    if(m_cfg.isLoadProfileEnabled() && !m_profile.setup(m_cfg.isLoadProfileFeedForwardEnabled())) {
+        std::cerr << "[Profile] Failed to load the load profile --> continue without" << std::endl;
+    }
+
+    // attempt to start the PSU controller 
+    if(!m_psu.setup(m_cfg.getCanInterfaceNames())) {
+        return false;
+    }
+
+    // output channel to the discharge inverter
+    if(m_cfg.isInverterEnabled() && !m_inverter.setup(m_cfg.getInverterAddress(), m_cfg.getInverterPort())) {
+        return false;
+    }
+
+    // resume from the state of the last run
+    if(m_cfg.isWarmStartEnabled()) {
+        restoreWarmStart(m_clock());
+    }
+
+    // attempt to start udp receiver to listen for power change messages
+    if(!m_meter.setup()) {
+        return false;
+    }
+
+    // start supervising the meter readings
+    return m_watchdog.setup();
+}
+
+// continues with the sockets and state received from the running process
+// (first descriptor is the UDP socket, the CAN sockets follow)
+bool Regulator::takeOver(const HandoverState& state, const std::vector<int>& fds) {
+    // the sockets can only be taken over by the own CAN and UDP components
+    if(!m_canPsu || !m_udpReceiver) {
+        std::cerr << m_logTag << " Injected PSU or meter source --> takeover not possible" << std::endl;
+        return false;
+    }
+
+    // the running process stored the battery counters right before the handover
+    m_battery.loadState();
+    m_battery.printState();
+
+    if(m_cfg.isEnergyLedgerEnabled() && !m_ledger.setup()) {
+        std::cerr << "[Ledger] Failed to start energy ledger --> continue without" << std::endl;
+    }
+    if(m_cfg.isLoadProfileEnabled() && !m_profile.setup(m_cfg.isLoadProfileFeedForwardEnabled())) {
+        std::cerr << "[Profile] Failed to load the load profile --> continue without" << std::endl;
+    }
+
+    std::vector<int> canSockets(fds.begin() + 1, fds.end());
+    if(!m_canPsu->takeOver(m_cfg.getCanInterfaceNames(), canSockets, state)) {
+        return false;
+    }
+
+    // continue discharging with the setpoint of the previous process
+    if(m_cfg.isInverterEnabled()) {
+        if(!m_inverter.setup(m_cfg.getInverterAddress(), m_cfg.getInverterPort())) {
+            return false;
+        }
+        m_inverter.restoreDischargePower(state.dischargePower);
+        if(state.dischargePower > 0) {
+            m_powerMode = POWER_MODE_DISCHARGE;
+            m_lastPowerCmd = -state.dischargePower;
+        }
+    }
+
+    if(!m_udpReceiver->takeOver(fds[0])) {
+        return false;
+    }
+
+    // continue in the charge stage of the previous process (snapshot written with the handover)
+    WarmStartState snapshot;
+    if(m_cfg.isChargeStagesEnabled() && m_cfg.isWarmStartEnabled() && m_warmStart.load(snapshot)) {
+        m_chargeStages.restoreState(snapshot.chargeStage, true);
+    }
+
+    if(!m_watchdog.setup()) {
+        return false;
+    }
+    m_watchdog.setSilentTime(static_cast<long>(state.msSinceLastMeterReading));
+    return true;
+}
+
+// collects the sockets and state for a new process (hot restart)
+void Regulator::getHandoverState(HandoverState& state, std::vector<int>& fds) {
+    if(!m_battery.storeState()) {
+        std::cerr << "[Battery] Failed to store battery state!" << std::endl;
+    }
+    if(m_cfg.isWarmStartEnabled()) {
+        storeWarmStart();
+    }
+
+    memset(&state, 0, sizeof(state));
+    state.version = HOT_RESTART_VERSION;
+    fds.clear();
+    if(!m_canPsu || !m_udpReceiver) {
+        return;
+    }
+    m_canPsu->getHandoverState(state);
+    state.msSinceLastMeterReading = m_watchdog.getSilentTime();
+    state.dischargePower = m_inverter.getDischargePower();
+
+    fds.push_back(m_udpReceiver->getSocket());
+    std::vector<int> canSockets = m_canPsu->getSockets();
+    fds.insert(fds.end(), canSockets.begin(), canSockets.end());
+}
+
+// one pass of the regulation without blocking: processes the latest meter reading once the idle
+// time after the last command has elapsed. returns true if a reading was processed
+bool Regulator::step() {
+    long long currentTime = m_clock();
+    if(m_cfg.isInverterEnabled()) {
+        m_inverter.keepAlive(currentTime);
+    }
+    updateMeterInterval(currentTime);
+    if(m_cfg.isWarmStartEnabled() && currentTime - m_lastWarmStartTime >= WARM_START_SAVE_INTERVAL * 1000LL) {
+        m_lastWarmStartTime = currentTime;
+        storeWarmStart();
+    }
+    if(currentTime < m_nextCommandTime) {
+        return false;
+    }
+
+    // resumed setpoint: no decision before the PSUs reported (the charge current needs the battery voltage)
+    if(currentTime < m_resumeUntil && m_psu.getCurrentOutputVoltage() <= 0.0f) {
+        return false;
+    }
+
+    // check for new readings on the queue (all of them arrived during the idle time)
+    PowerState readings[QUEUE_CAPACITY];
+    size_t readingCount = m_cmdQueue.popAll(readings);
+    if(readingCount == 0) {
+        return false;
+    }
+    PowerState latestPowerState = readings[readingCount - 1];
+    TraceScope span("regulator_decision");
+
+    // max charge power is tapered down as the battery approaches full
+    RegulatorSettings settings;
+    settings.targetGridPower = m_cfg.getTargetGridPower();
+    settings.minChargePower = m_cfg.getMinChargePower();
+    settings.maxChargePower = m_battery.getChargePowerLimit();
+    settings.errorThreshold = m_cfg.getRegulatorErrorThreshold();
+    settings.minCommandStep = 0;
+    settings.gain = m_cfg.getRegulatorGain();
+
+    // voltage of the charge stage, the current is capped in float and equalisation
+    if(m_cfg.isChargeStagesEnabled()) {
+        updateChargeStage(settings, currentTime);
+    }
+
+    // derated before the PSUs limit the current on their own when they get too hot
+    if(m_cfg.isThermalDeratingEnabled()) {
+        m_thermal.update(m_psu.getMaxTemperature(), m_psu.getLastCurrentCmd(), m_psu.getCurrentOutputCurrent(),
+                            m_psu.getCurrentInputPower(), m_psu.getCurrentOutputVoltage(), settings.maxChargePower, currentTime);
+        settings.maxChargePower = m_thermal.getPowerLimit(settings.maxChargePower, settings.minChargePower);
+    }
+
+    // no wind-up while the PSU doesn't follow the last charge command: held just above the delivered power
+    if(m_cfg.isCommandMonitorEnabled()) {
+        m_cmdMonitor.update(m_lastPowerCmd, m_psu.getCurrentInputPower(), m_psu.getCurrentOutputVoltage(), currentTime);
+        settings.maxChargePower = m_cmdMonitor.getPowerLimit(settings.maxChargePower, settings.minChargePower);
+    }
+
+    // deadband follows the measured meter noise of every reading, like in regulator_tune
+    // (not the fake readings of the watchdog)
+    if(m_cfg.isAdaptiveDeadbandEnabled()) {
+        if(m_watchdog.getStage() == WD_STAGE_OK) {
+            for(size_t i = 0; i < readingCount; i++) {
+                m_deadband.addSample(readings[i], settings.targetGridPower);
+            }
+        }
+        settings.errorThreshold = m_deadband.getErrorThreshold();
+        settings.minCommandStep = m_deadband.getMinCommandStep();
+    }
+
+    // recurring load events of the learned profile (not learned from the fake readings of the watchdog)
+    short gridCorrection = 0;
+    if(m_cfg.isLoadProfileEnabled() && m_watchdog.getStage() == WD_STAGE_OK) {
+        m_profile.update(latestPowerState.tasmotaPowerCmd, latestPowerState.psuAcInputPower - m_inverter.getDischargePower(), m_wallClock());
+        if(m_cfg.isLoadProfileFeedForwardEnabled()) {
+            gridCorrection = m_profile.getGridCorrection(m_cfg.getLoadProfileSpikeDiscount());
+            latestPowerState.tasmotaPowerCmd += gridCorrection;
+        }
+    }
+
+    printf("%s Processing received power state: grid-load = %dW, deviation = %dW, AC-charge = %dW, deadband = %dW\n",
+            m_logTag, latestPowerState.tasmotaPowerCmd, settings.targetGridPower - latestPowerState.tasmotaPowerCmd,
+            latestPowerState.psuAcInputPower, settings.errorThreshold);
+    if(gridCorrection != 0) {
+        printf("%s Grid reading corrected by %+dW (load profile)\n", m_logTag, gridCorrection);
+    }
+
+    // charging and discharging are combined in one setpoint. the failsafe stages of the meter watchdog
+    // fake a grid import to lower the charge power --> stop discharging and only follow them
+    bool combined = m_cfg.isInverterEnabled();
+    if(combined && m_watchdog.getStage() >= WD_STAGE_RAMP_DOWN) {
+        if(m_inverter.getDischargePower() != 0) {
+            printf("%s Meter readings missing --> stop discharging\n", m_logTag);
+            m_inverter.setDischargePower(0, currentTime);
+        }
+        m_powerMode = POWER_MODE_CHARGE;
+        combined = false;
+    }
+    DischargeSettings discharge;
+    discharge.minDischargePower = m_cfg.getMinDischargePower();
+    discharge.maxDischargePower = m_cfg.getMaxDischargePower();
+    discharge.modeHysteresis = m_cfg.getModeHysteresis();
+
+    // low surplus is charged in pulses. the surplus is what the continuous regulation would command
+    short powerCmd = 0;
+    bool pulseMode = false;
+    short surplus = latestPowerState.psuAcInputPower - m_inverter.getDischargePower() + settings.targetGridPower - latestPowerState.tasmotaPowerCmd;
+
+    // PSUs in standby: wake them ahead of a rising surplus, they need some seconds to boot
+    if(m_cfg.isSlotDetectControlEnabled() && m_cfg.isPredictiveWakeEnabled() && m_watchdog.getStage() == WD_STAGE_OK
+        && !m_psu.isSlotDetectOn()) {
+        m_wakePredictor.standbyEntered();
+        if(m_wakePredictor.update(surplus, settings.minChargePower, m_psu.getWakeTime() + m_meterInterval, currentTime)) {
+            m_psu.wakeUp();
+        }
+    }
+    if(m_cfg.isPulseModeEnabled() && m_powerMode == POWER_MODE_CHARGE && (!combined || surplus > -discharge.modeHysteresis)) {
+        float seconds = (currentTime - m_lastTelemetryTime) / 1000.0f;
+        m_lastTelemetryTime = currentTime;
+        m_pulseCharger.addTelemetry(m_psu.getCurrentInputPower(), m_psu.getCurrentOutputPower(), seconds);
+
+        pulseMode = m_pulseCharger.update(surplus, currentTime, settings.maxChargePower, powerCmd);
+
+        if(currentTime - m_lastPulseReportTime >= PULSE_REPORT_INTERVAL * 1000LL) {
+            m_pulseCharger.printReport();
+            m_lastPulseReportTime = currentTime;
+        }
+    }
+
+    if(pulseMode) {
+        // only send a command when a pulse starts or ends
+        if(powerCmd == m_lastPowerCmd) {
+            return true;
+        }
+    } else if(combined) {
+        if(!calculateCombinedCommand(latestPowerState, m_inverter.getDischargePower(), settings, discharge, m_powerMode, m_lastPowerCmd, powerCmd)) {
+            return true;
+        }
+    } else if(!calculatePowerCommand(latestPowerState, settings, m_lastPowerCmd, powerCmd)) {
+        return true;
+    }
+    m_lastPowerCmd = powerCmd;
+
+    // send the commands and idle a short time (longer while saturated)
+    applyPowerCommand(powerCmd, currentTime);
+
+    span.end(powerCmd);
+    m_nextCommandTime = currentTime + m_cmdMonitor.getIdleTime(m_cfg.getRegulatorIdleTime());
+    return true;
+}
+
+// sends a combined setpoint (positive = charge, negative = discharge). the device that is
+// turned off is always commanded first, so charger and inverter are never active together
+void Regulator::applyPowerCommand(short powerCmd, long long currentTime) {
+    short chargePower = powerCmd > 0 ? powerCmd : 0;
+    short dischargePower = powerCmd < 0 ? -powerCmd : 0;
+    m_lastCommandTime = currentTime;
+
+    // translate power command into max current command. use current output voltage for calculation
+    float maxCurrentCmd = calculateCurrentBasedOnPower(static_cast<float>(chargePower), m_psu.getCurrentOutputVoltage());
+    bool inverterChanged = m_cfg.isInverterEnabled() && dischargePower != m_inverter.getDischargePower();
+
+    if(chargePower > 0) {
+        m_wakePredictor.chargeStarted(currentTime);
+        if(inverterChanged) {
+            m_inverter.setDischargePower(0, currentTime);
+        }
+        m_psu.setMaxCurrent(maxCurrentCmd, false);
+        printf("%s Target AC charger power --> %dW\n", m_logTag, chargePower);
+    } else {
+        m_psu.setMaxCurrent(maxCurrentCmd, false);
+        if(inverterChanged) {
+            m_inverter.setDischargePower(dischargePower, currentTime);
+        }
+        if(dischargePower > 0) {
+            printf("%s Target AC discharge power --> %dW\n", m_logTag, dischargePower);
+        } else {
+            printf("%s Target AC charger power --> %dW\n", m_logTag, chargePower);
+        }
+    }
+}
+
+// picks the meter reading interval: fast while the loop settles after a command, slow when there was
+// nothing to charge or discharge for a while. the receiver replies it to the meter
+void Regulator::updateMeterInterval(long long currentTime) {
+    if(!m_cfg.isMeterRateControlEnabled()) {
+        if(m_meterInterval != 0) {
+            m_meterInterval = 0;
+            m_meter.requestMeterInterval(0);
+        }
+        return;
+    }
+    if(m_lastPowerCmd != 0) {
+        m_lastActiveTime = currentTime;
+    }
+
+    int interval = m_cfg.getMeterIntervalSteady();
+    if(currentTime - m_lastCommandTime < METER_RATE_SETTLE_TIME) {
+        interval = m_cfg.getMeterIntervalFast();
+    } else if(currentTime - m_lastActiveTime >= METER_RATE_STANDBY_DELAY) {
+        interval = m_cfg.getMeterIntervalStandby();
+    }
+
+    if(interval != m_meterInterval) {
+        printf("%s Meter interval --> %dms\n", m_logTag, interval);
+        m_meterInterval = interval;
+        m_meter.requestMeterInterval(interval);
+    }
+}
+
+// moves the charge stages on with the latest PSU telemetry and sends the voltage of the stage on changes
+void Regulator::updateChargeStage(RegulatorSettings& settings, long long currentTime) {
+    float outputVoltage = m_psu.getCurrentOutputVoltage();
+    m_chargeStages.update(outputVoltage, m_psu.getCurrentOutputCurrent(), m_psu.getLastCurrentCmd(),
+                            m_meter.getBatteryTemperature(CHARGE_TEMP_MAX_AGE), currentTime);
+
+    float voltage = m_chargeStages.getTargetVoltage();
+    if(fabsf(voltage - m_psu.getLastVoltageCmd()) >= CHARGE_VOLTAGE_STEP) {
+        printf("%s Charge voltage --> %.2fV (%s)\n", m_logTag, voltage, getChargeStageName(m_chargeStages.getStage()));
+        m_psu.setMaxVoltage(voltage, false);
+        m_thermal.setChargeVoltage(voltage);
+        m_cmdMonitor.setChargeVoltage(voltage);
+    }
+    settings.maxChargePower = m_chargeStages.getPowerLimit(settings.maxChargePower, settings.minChargePower, outputVoltage);
+}
+
+// stops the meter source and the PSU control (slot detect off) and persists the battery counters
+void Regulator::shutdown() {
+    if(m_cfg.isWarmStartEnabled()) {
+        storeWarmStart();
+    }
+    m_watchdog.closeUp();
+    m_meter.closeUp();
+    m_inverter.closeUp();
+    m_psu.shutdown();
+    m_cmdQueue.clear();
+    m_ledger.closeUp();
+    m_profile.closeUp();
+    m_wakePredictor.printReport();
+    if(m_cfg.isCommandMonitorEnabled()) {
+        m_cmdMonitor.printReport();
+    }
+
+    if(!m_battery.storeState()) {
+        std::cerr << "[Battery] Failed to store battery state!" << std::endl;
+    }
+}
+
+// stops all threads and closes the own socket copies without touching the PSU
+void Regulator::detach() {
+    m_watchdog.closeUp();
+    m_meter.closeUp();
+    m_inverter.detach();
+    m_psu.detach();
+    m_cmdQueue.clear();
+    m_ledger.closeUp();
+    m_profile.closeUp();
+}
+
+// writes the snapshot for the warm start (operating point, learned parameters and counters)
+void Regulator::storeWarmStart() {
+    WarmStartState state;
+    memset(&state, 0, sizeof(state));
+    state.lastPowerCmd = m_lastPowerCmd;
+    state.dischargePower = m_inverter.getDischargePower();
+    state.lastCurrentCmd = m_psu.getLastCurrentCmd();
+    m_chargeStages.getState(state.chargeStage);
+    if(!m_deadband.getState(state.deadband)) {
+        memset(&state.deadband, 0, sizeof(state.deadband));
+    }
+    state.wakeTime = static_cast<int32_t>(m_psu.getMeasuredWakeTime());
+    m_pulseCharger.getEfficiencyMap(state.efficiency, state.efficiencyValid);
+    state.saturationEvents = static_cast<uint32_t>(m_cmdMonitor.getMetrics().events);
+    state.saturatedSeconds = m_cmdMonitor.getMetrics().saturatedSeconds;
+
+    if(!m_warmStart.store(state)) {
+        std::cerr << m_logTag << " Failed to store the warm start snapshot!" << std::endl;
+    }
+}
+
+// restores the learned parameters of the last run and resumes from its setpoint if the snapshot is fresh
+void Regulator::restoreWarmStart(long long currentTime) {
+    WarmStartState state;
+    if(!m_warmStart.load(state)) {
+        printf("%s No warm start snapshot found --> start from zero\n", m_logTag);
+        return;
+    }
+
+    if(state.deadband.noiseVariance > 0.0f) {
+        m_deadband.restoreState(state.deadband);
+    }
+    m_psu.restoreWakeTime(state.wakeTime);
+    m_pulseCharger.restoreEfficiencyMap(state.efficiency, state.efficiencyValid);
+    m_cmdMonitor.restoreMetrics(state.saturationEvents, state.saturatedSeconds);
+
+    // the charge stage is only continued if the battery can't have been discharged meanwhile
+    long age = static_cast<long>(difftime(m_wallClock(), static_cast<time_t>(state.savedTime)));
+    bool fresh = age >= 0 && age <= WARM_START_MAX_AGE;
+    if(m_cfg.isChargeStagesEnabled()) {
+        m_chargeStages.restoreState(state.chargeStage, fresh);
+    }
+    if(!fresh) {
+        printf("%s Warm start snapshot of %lds ago --> learned parameters restored, start from zero\n", m_logTag, age);
+        return;
+    }
+
+    // the setpoint of the last run (within the current limits), the next decision after the PSU ramped up
+    if(state.dischargePower > 0 && m_cfg.isInverterEnabled()) {
+        short dischargePower = std::min(state.dischargePower, m_cfg.getMaxDischargePower());
+        m_inverter.setDischargePower(dischargePower, currentTime);
+        m_powerMode = POWER_MODE_DISCHARGE;
+        m_lastPowerCmd = -dischargePower;
+    } else if(state.lastPowerCmd > 0 && state.lastCurrentCmd > 0.0f) {
+        short chargePower = std::min(state.lastPowerCmd, m_cfg.getMaxChargePower());
+        m_psu.setMaxCurrent(state.lastCurrentCmd * chargePower / state.lastPowerCmd, false);
+        m_lastPowerCmd = chargePower;
+    }
+    m_lastCommandTime = currentTime;
+    m_nextCommandTime = currentTime + m_cfg.getRegulatorIdleTime();
+    m_resumeUntil = currentTime + WARM_START_RESUME_TIMEOUT;
+    printf("%s Warm start snapshot of %lds ago --> resume at %dW\n", m_logTag, age, m_lastPowerCmd);
+}
+
+// file name of a state file of this instance
+std::string Regulator::getFileName(const char* baseName) const {
+    if(m_name.empty()) {
+        return baseName;
+    }
+    return m_name + "-" + baseName;
+}
+
+// Getters //
+const std::string& Regulator::getName() const {
+    return m_name;
+}
+
+bool Regulator::isScheduledExit() const {
+    return scheduledClose(m_cfg);
+}
+
+long long Regulator::getNextCommandTime() const {
+    return m_nextCommandTime;
+}
+
+const ConfigFile& Regulator::getConfig() const {
+    return m_cfg;
+}
+
+ConfigFile& Regulator::getConfig() {
+    return m_cfg;
+}
+
+PsuInterface& Regulator::getPsu() {
+    return m_psu;
+}
+
+// CAN PSU controller (null if a PSU was injected)
+PsuController* Regulator::getCanPsu() {
+    return m_canPsu.get();
+}
+
+BatteryMonitor& Regulator::getBattery() {
+    return m_battery;
+}
+
+MeterWatchdog& Regulator::getWatchdog() {
+    return m_watchdog;
+}
+
+Queue<PowerState>& Regulator::getQueue() {
+    return m_cmdQueue;
+}
+
+// UDP meter source (null if a meter source was injected)
+UdpReceiver* Regulator::getUdpReceiver() {
+    return m_udpReceiver.get();
+}
+
+// default clock of the regulators
+long long steadyClockMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+time_t systemTime() {
+    return time(NULL);
+}
@@ -0,0 +1,129 @@
+/*
+    File: Regulator.h
+    One charger/meter pair: owns the config, the PSU controller, the meter source (UDP receiver
+    and watchdog feeding the command queue), the battery and ledger bookkeeping and the state of
+    the regulation. The components get their collaborators injected instead of reaching for
+    globals, so several regulators can run side by side in one process (shared main loop).
+    Tests and benchmarks inject the config, a simulated PSU and meter source and the clocks
+
+    written by Elias Geiger
+*/
+
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <memory>
+
+#include "ConfigFile.h"
+#include "BatteryMonitor.h"
+#include "PsuInterface.h"
+#include "MeterSource.h"
+#include "PsuController.h"
+#include "MeterWatchdog.h"
+#include "EnergyLedger.h"
+#include "UdpReceiver.h"
+#include "HotRestart.h"
+#include "WarmStart.h"
+#include "Regulation.h"
+#include "PulseCharger.h"
+#include "InverterLink.h"
+#include "ThermalDerating.h"
+#include "CommandMonitor.h"
+#include "LoadProfile.h"
+#include "WakePredictor.h"
+#include "ChargeStages.h"
+#include "Trace.h"
+#include "Queue.h"
+#include "Utils.h"
+
+// monotonic time in milliseconds and wall clock time (injected, e.g. simulated time in benchmarks)
+typedef long long (*RegulatorClock)();
+typedef time_t (*RegulatorWallClock)();
+time_t systemTime();
+
+#define REGULATOR_LOG_TAG_LENGTH 48
+
+class Regulator
+{
+    std::string m_name;
+    char m_logTag[REGULATOR_LOG_TAG_LENGTH];
+    RegulatorClock m_clock;
+    RegulatorWallClock m_wallClock;
+
+    // components (declared in the order they depend on each other). the config, the PSU and the
+    // meter source are owned unless injected, the CAN and UDP ones are needed for a hot restart
+    std::unique_ptr<ConfigFile> m_ownedCfg;
+    ConfigFile& m_cfg;
+    BatteryMonitor m_battery;
+    std::unique_ptr<PsuController> m_canPsu;
+    PsuInterface& m_psu;
+    Queue<PowerState> m_cmdQueue;
+    MeterWatchdog m_watchdog;
+    EnergyLedger m_ledger;
+    std::unique_ptr<UdpReceiver> m_udpReceiver;
+    MeterSource& m_meter;
+    InverterLink m_inverter;
+    LoadProfile m_profile;
+    WarmStart m_warmStart;
+
+    // regulation state (the last command is the combined setpoint with a discharge inverter)
+    short m_lastPowerCmd;
+    PowerMode m_powerMode;
+    long long m_nextCommandTime;
+    long long m_lastTelemetryTime, m_lastPulseReportTime;
+    long long m_lastCommandTime, m_lastActiveTime;
+    long long m_lastWarmStartTime, m_resumeUntil;
+    int m_meterInterval;
+    AdaptiveDeadband m_deadband;
+    PulseCharger m_pulseCharger;
+    ThermalDerating m_thermal;
+    CommandMonitor m_cmdMonitor;
+    WakePredictor m_wakePredictor;
+    ChargeStages m_chargeStages;
+
+public:
+    Regulator(const std::string&, const std::string&, RegulatorClock, RegulatorWallClock = systemTime);
+    Regulator(ConfigFile&, PsuInterface&, MeterSource&, const std::string&, RegulatorClock, RegulatorWallClock);
+    ~Regulator();
+
+    bool loadConfig();
+    bool setup();
+    bool takeOver(const HandoverState&, const std::vector<int>&);
+    void getHandoverState(HandoverState&, std::vector<int>&);
+    bool step();
+    void shutdown();
+    void detach();
+
+    // getters //
+    const std::string& getName() const;
+    bool isScheduledExit() const;
+    long long getNextCommandTime() const;
+    const ConfigFile& getConfig() const;
+    ConfigFile& getConfig();
+    PsuInterface& getPsu();
+    PsuController* getCanPsu();
+    BatteryMonitor& getBattery();
+    MeterWatchdog& getWatchdog();
+    Queue<PowerState>& getQueue();
+    UdpReceiver* getUdpReceiver();
+
+private:
+    Regulator(ConfigFile*, ConfigFile*, PsuInterface*, MeterSource*, const std::string&, RegulatorClock, RegulatorWallClock);
+
+    void applyPowerCommand(short, long long);
+    void updateMeterInterval(long long);
+    void updateChargeStage(RegulatorSettings&, long long);
+    void storeWarmStart();
+    void restoreWarmStart(long long);
+    std::string getFileName(const char*) const;
+};
+
+// function prototypes
+long long steadyClockMs();
@@ -0,0 +1,193 @@
+/*
+    File: SelfProfile.cpp
+    written by Elias Geiger
+*/
+
+#include "SelfProfile.h"
+
+// statically allocated slots, a finished thread frees its slot for the next one (restarted workers)
+static ProfileThread profileThreads[PROFILE_MAX_THREADS];
+static std::mutex profileMutex;
+static bool profileFullWarned = false;
+static std::atomic<bool> profileEnabled(false);
+
+thread_local ProfileThread* profileThread = NULL;
+
+// sampler state (regulator loop only)
+static long long lastSampleTime = 0, lastReportTime = 0, startTime = 0;
+static int reportInterval = 0;
+static double lastProcessCpuMs = 0.0, processCpuShare = 0.0;
+
+static double getCpuMs(clockid_t clockId) {
+    struct timespec time;
+    if(clock_gettime(clockId, &time) < 0) {
+        return -1.0;
+    }
+    return time.tv_sec * 1000.0 + time.tv_nsec / 1000000.0;
+}
+
+// reads the context switch counters of a thread from /proc (stack buffer, no allocation)
+static bool readContextSwitches(pid_t tid, unsigned long& voluntary, unsigned long& involuntary) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/self/task/%d/status", static_cast<int>(tid));
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if(fd < 0) {
+        return false;
+    }
+    char buffer[4096];
+    ssize_t length = read(fd, buffer, sizeof(buffer) - 1);
+    close(fd);
+    if(length <= 0) {
+        return false;
+    }
+    buffer[length] = '\0';
+
+    const char* voluntaryLine = strstr(buffer, "\nvoluntary_ctxt_switches:");
+    const char* involuntaryLine = strstr(buffer, "\nnonvoluntary_ctxt_switches:");
+    return voluntaryLine != NULL && involuntaryLine != NULL &&
+            sscanf(voluntaryLine, "\nvoluntary_ctxt_switches: %lu", &voluntary) == 1 &&
+            sscanf(involuntaryLine, "\nnonvoluntary_ctxt_switches: %lu", &involuntary) == 1;
+}
+
+static bool readCounters(ProfileThread& thread, ProfileCounters& counters) {
+    counters.cpuMs = getCpuMs(thread.clockId);
+    counters.syscalls = thread.syscalls.load(std::memory_order_relaxed);
+    return counters.cpuMs >= 0.0 && readContextSwitches(thread.tid, counters.voluntarySwitches, counters.involuntarySwitches);
+}
+
+// report interval in seconds (0 = only on SIGUSR2)
+void setSelfProfileEnabled(bool enabled, int interval) {
+    profileEnabled = enabled;
+    reportInterval = interval;
+}
+
+bool isSelfProfileEnabled() {
+    return profileEnabled.load(std::memory_order_relaxed);
+}
+
+// registers the calling thread under the given name (at the start of the thread)
+void registerProfileThread(const char* name) {
+    if(profileThread != NULL) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(profileMutex);
+    int index = 0;
+    while(index < PROFILE_MAX_THREADS && profileThreads[index].active) {
+        index++;
+    }
+    if(index >= PROFILE_MAX_THREADS) {
+        if(!profileFullWarned) {
+            printf("[SelfProfile] More than %d threads --> %s is not profiled\n", PROFILE_MAX_THREADS, name);
+            profileFullWarned = true;
+        }
+        return;
+    }
+
+    ProfileThread& thread = profileThreads[index];
+    snprintf(thread.threadName, sizeof(thread.threadName), "%s", name);
+    thread.tid = static_cast<pid_t>(syscall(SYS_gettid));
+    if(pthread_getcpuclockid(pthread_self(), &thread.clockId) != 0) {
+        thread.clockId = CLOCK_THREAD_CPUTIME_ID;
+    }
+    thread.syscalls = 0;
+    thread.sampled = false;
+    thread.busy = false;
+    profileThread = &thread;
+    thread.active = true;
+}
+
+// the thread is finishing, its clock and /proc entry are gone afterwards --> free the slot
+void unregisterProfileThread() {
+    if(profileThread != NULL) {
+        std::lock_guard<std::mutex> lock(profileMutex);
+        profileThread->active = false;
+        profileThread = NULL;
+    }
+}
+
+// samples all threads once per sample interval and reports busy threads (regulator loop only)
+void sampleSelfProfile(long long currentTime) {
+    if(!isSelfProfileEnabled()) {
+        return;
+    }
+    if(startTime == 0) {
+        startTime = lastReportTime = currentTime;
+    }
+    if(lastSampleTime != 0 && currentTime - lastSampleTime < PROFILE_SAMPLE_INTERVAL) {
+        return;
+    }
+
+    float seconds = (currentTime - lastSampleTime) / 1000.0f;
+    double processCpuMs = getCpuMs(CLOCK_PROCESS_CPUTIME_ID);
+    if(lastSampleTime != 0) {
+        processCpuShare = (processCpuMs - lastProcessCpuMs) / 1000.0 / seconds;
+    }
+    lastProcessCpuMs = processCpuMs;
+
+    std::unique_lock<std::mutex> lock(profileMutex);
+    for(int i = 0; i < PROFILE_MAX_THREADS; i++) {
+        ProfileThread& thread = profileThreads[i];
+        ProfileCounters counters;
+        if(!thread.active || !readCounters(thread, counters)) {
+            continue;
+        }
+
+        if(thread.sampled && lastSampleTime != 0) {
+            thread.rate.cpuMs = (counters.cpuMs - thread.last.cpuMs) / seconds;
+            thread.rate.voluntarySwitches = (counters.voluntarySwitches - thread.last.voluntarySwitches) / seconds;
+            thread.rate.involuntarySwitches = (counters.involuntarySwitches - thread.last.involuntarySwitches) / seconds;
+            thread.rate.syscalls = (counters.syscalls - thread.last.syscalls) / seconds;
+
+            // report once when the thread becomes busy and once when it calms down again
+            bool busy = thread.rate.cpuMs > PROFILE_BUSY_CPU_SHARE * 1000.0f ||
+                        thread.rate.voluntarySwitches > PROFILE_BUSY_WAKEUPS ||
+                        thread.rate.syscalls > PROFILE_BUSY_SYSCALLS;
+            if(busy && !thread.busy) {
+                printf("[SelfProfile] Thread %s is busy: %.1f%% CPU, %lu wakeups/s, %lu syscalls/s\n", thread.threadName,
+                        thread.rate.cpuMs / 10.0, thread.rate.voluntarySwitches, thread.rate.syscalls);
+            } else if(!busy && thread.busy) {
+                printf("[SelfProfile] Thread %s is idle again\n", thread.threadName);
+            }
+            thread.busy = busy;
+        }
+        thread.last = counters;
+        thread.sampled = true;
+    }
+    lock.unlock();
+    lastSampleTime = currentTime;
+
+    if(reportInterval > 0 && currentTime - lastReportTime >= reportInterval * 1000LL) {
+        lastReportTime = currentTime;
+        printSelfProfile();
+    }
+}
+
+// prints the rates of the last sample interval and the totals since the start of every thread
+void printSelfProfile() {
+    if(!isSelfProfileEnabled()) {
+        printf("[SelfProfile] Self profiling is disabled (self-profile-enabled)\n");
+        return;
+    }
+    if(lastSampleTime == startTime) {
+        printf("[SelfProfile] No sample interval completed yet\n");
+        return;
+    }
+
+    printf("[SelfProfile] Process %.2f%% CPU over the last %ds, %.0fms CPU in total\n", processCpuShare * 100.0,
+            PROFILE_SAMPLE_INTERVAL / 1000, lastProcessCpuMs);
+    printf("[SelfProfile] %-12s %7s %6s %10s %10s %10s %10s %12s %10s\n", "thread", "tid", "cpu-%", "wakeups/s",
+            "preempt/s", "syscalls/s", "cpu-ms", "wakeups", "syscalls");
+
+    std::lock_guard<std::mutex> lock(profileMutex);
+    for(int i = 0; i < PROFILE_MAX_THREADS; i++) {
+        const ProfileThread& thread = profileThreads[i];
+        if(!thread.sampled || !thread.active) {
+            continue;
+        }
+        printf("[SelfProfile] %-12s %7d %6.2f %10lu %10lu %10lu %10.0f %12lu %10lu%s\n", thread.threadName, static_cast<int>(thread.tid),
+                thread.rate.cpuMs / 10.0, thread.rate.voluntarySwitches, thread.rate.involuntarySwitches, thread.rate.syscalls,
+                thread.last.cpuMs, thread.last.voluntarySwitches, thread.last.syscalls, thread.busy ? "  busy" : "");
+    }
+    fflush(stdout);
+}
@@ -0,0 +1,77 @@
+/*
+    File: SelfProfile.h
+    Built-in profiling of the own threads for running the app on a shared machine. The threads
+    register once, the regulator loop samples their CPU time (thread CPU clock), context switches
+    (voluntary = wakeups after blocking, involuntary = preempted) and the syscalls counted at the
+    I/O call sites. Rates are printed periodically and on SIGUSR2, a thread that spins or wakes up
+    far more often than the meter readings require is reported right away
+
+    written by Elias Geiger
+*/
+
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+
+// max number of threads that can be profiled at the same time (the slot of a finished thread is reused)
+#define PROFILE_MAX_THREADS 16
+
+#define PROFILE_THREAD_NAME_LENGTH 32
+
+// the threads are sampled this often in milliseconds
+#define PROFILE_SAMPLE_INTERVAL 10000
+
+// a thread above one of these rates over a sample interval is reported as busy
+#define PROFILE_BUSY_CPU_SHARE 0.25f            // share of one core
+#define PROFILE_BUSY_WAKEUPS 500.0f             // per second
+#define PROFILE_BUSY_SYSCALLS 2000.0f           // per second
+
+// counters of a thread at a sample
+struct ProfileCounters
+{
+    double cpuMs;                       // thread CPU time (user + system)
+    unsigned long voluntarySwitches;    // blocked and woken up again
+    unsigned long involuntarySwitches;  // preempted
+    unsigned long syscalls;             // counted at the I/O call sites
+};
+
+// profiled thread. the syscall counter is written by the owning thread, the rest under the mutex
+// of the slots (registration and the sampler)
+struct ProfileThread
+{
+    char threadName[PROFILE_THREAD_NAME_LENGTH];
+    pid_t tid;
+    clockid_t clockId;
+    bool active;
+    std::atomic<unsigned long> syscalls;
+
+    ProfileCounters last;               // at the previous sample
+    ProfileCounters rate;               // per second over the last sample interval
+    bool sampled, busy;
+};
+
+// counts syscalls of the calling thread (no-op for threads that are not registered)
+extern thread_local ProfileThread* profileThread;
+
+inline void countSyscalls(unsigned long count = 1) {
+    if(profileThread != NULL) {
+        profileThread->syscalls.fetch_add(count, std::memory_order_relaxed);
+    }
+}
+
+// function prototypes
+void setSelfProfileEnabled(bool, int);
+bool isSelfProfileEnabled();
+void registerProfileThread(const char*);
+void unregisterProfileThread();
+void sampleSelfProfile(long long);
+void printSelfProfile();
@@ -0,0 +1,97 @@
+/*
+    File: SlotDetect.h
+    GPIO access for the slot detect relay, specialised on the GPIO backend of the target:
+    wiringPi on the raspberry pi (_TARGET_RASPI), a simulated relay for testing the slot detect
+    control off the pi (_GPIO_MOCK) or none (all calls are empty and compiled away)
+
+    written by Elias Geiger
+*/
+
+#pragma once
+
+#include <cstdio>
+#include <atomic>
+
+// GPIO pin that controls the slot detect relay (active high)
+#define SD_PIN 17
+
+enum GpioBackend
+{
+    GPIO_BACKEND_NONE,
+    GPIO_BACKEND_WIRINGPI,
+    GPIO_BACKEND_MOCK
+};
+
+template<GpioBackend Backend>
+struct SlotDetectPin;
+
+#if defined(_TARGET_RASPI)
+#include <wiringPi.h>
+#define TARGET_GPIO_BACKEND GPIO_BACKEND_WIRINGPI
+
+// relay driven via wiringPi (raspberry pi)
+template<>
+struct SlotDetectPin<GPIO_BACKEND_WIRINGPI>
+{
+    static constexpr bool available = true;
+
+    static void init(bool on) {
+        wiringPiSetupGpio();
+        pinMode(SD_PIN, OUTPUT);
+        digitalWrite(SD_PIN, on ? HIGH : LOW);
+    }
+
+    static void write(bool on) {
+        digitalWrite(SD_PIN, on ? HIGH : LOW);
+    }
+
+    static bool read() {
+        return digitalRead(SD_PIN) == HIGH;
+    }
+};
+
+#elif defined(_GPIO_MOCK)
+#define TARGET_GPIO_BACKEND GPIO_BACKEND_MOCK
+
+// simulated relay (cmake -DGPIO_MOCK=ON): the pin state is only kept in memory and every switch
+// is printed, the slot detect control runs like on the pi (e.g. against vcan or the stress harness)
+template<>
+struct SlotDetectPin<GPIO_BACKEND_MOCK>
+{
+    static constexpr bool available = true;
+    static inline std::atomic<bool> state{false};
+    static inline std::atomic<unsigned long> switchCount{0};
+
+    static void init(bool on) {
+        state = on;
+        printf("[GPIO-mock] Pin %d initialized %s\n", SD_PIN, on ? "high" : "low");
+    }
+
+    static void write(bool on) {
+        if(state.exchange(on) != on) {
+            switchCount++;
+            printf("[GPIO-mock] Pin %d --> %s\n", SD_PIN, on ? "high" : "low");
+        }
+    }
+
+    static bool read() {
+        return state;
+    }
+};
+
+#else
+#define TARGET_GPIO_BACKEND GPIO_BACKEND_NONE
+#endif
+
+// no relay, the PSUs need slot detect wired permanently
+template<>
+struct SlotDetectPin<GPIO_BACKEND_NONE>
+{
+    static constexpr bool available = false;
+
+    static void init(bool) {}
+    static void write(bool) {}
+    static bool read() { return true; }
+};
+
+using SlotDetect = SlotDetectPin<TARGET_GPIO_BACKEND>;
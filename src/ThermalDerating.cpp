@@ -0,0 +1,127 @@
+/*
+    File: ThermalDerating.cpp
+    written by Elias Geiger
+*/
+
+#include "ThermalDerating.h"
+
+// constructor
+ThermalDerating::ThermalDerating(float derateStart, float chargeVoltage) {
+    m_derateStart = derateStart;
+    m_chargeVoltage = chargeVoltage;
+    m_initialized = false;
+    m_lastUpdateTime = 0;
+    m_temperature = 0.0f;
+    m_trend = 0.0f;
+    m_gapTime = 0.0f;
+    m_powerCap = 0.0f;
+    m_limit = 0.0f;
+}
+
+// takes the latest PSU telemetry (hottest sensor, commanded and delivered current, AC input power, output voltage)
+// and moves the limit towards the derated max charge power
+void ThermalDerating::update(float temperature, float currentCmd, float outputCurrent, float inputPower, float outputVoltage,
+                                short maxChargePower, long long timeMs) {
+    // no telemetry yet
+    if(temperature <= 0.0f) {
+        return;
+    }
+
+    float seconds = m_initialized ? (timeMs - m_lastUpdateTime) / 1000.0f : 0.0f;
+    if(seconds < 0.0f || seconds > THERMAL_MAX_UPDATE_GAP) {
+        seconds = 0.0f;
+    }
+    m_lastUpdateTime = timeMs;
+
+    // smoothed temperature and its trend in degree per second (first order lags)
+    if(!m_initialized) {
+        m_temperature = temperature;
+        m_trend = 0.0f;
+        m_initialized = true;
+    } else if(seconds > 0.0f) {
+        float lastTemperature = m_temperature;
+        float alpha = seconds / THERMAL_TEMPERATURE_TIME;
+        m_temperature += (alpha < 1.0f ? alpha : 1.0f) * (temperature - m_temperature);
+        float beta = seconds / THERMAL_TREND_TIME;
+        m_trend += (beta < 1.0f ? beta : 1.0f) * ((m_temperature - lastTemperature) / seconds - m_trend);
+    }
+
+    // a warm PSU delivering persistently less than commanded limits on its own (not in the constant voltage phase)
+    bool gap = currentCmd >= THERMAL_GAP_MIN_CURRENT && outputCurrent < THERMAL_GAP_RATIO * currentCmd
+                && m_temperature >= m_derateStart - THERMAL_GAP_TEMPERATURE_MARGIN
+                && outputVoltage < m_chargeVoltage - THERMAL_GAP_VOLTAGE_MARGIN;
+    m_gapTime = gap ? m_gapTime + seconds : 0.0f;
+    if(m_gapTime >= THERMAL_GAP_TIME && (m_powerCap <= 0.0f || inputPower < m_powerCap)) {
+        if(m_powerCap <= 0.0f) {
+            printf("[Thermal] PSU delivers %.1fA of %.1fA at %.1fC --> cap max charge power at %.0fW\n",
+                    outputCurrent, currentCmd, m_temperature, inputPower);
+        }
+        m_powerCap = inputPower;
+    }
+
+    // the factor follows the predicted temperature, the cap is lifted again as the PSU cools down
+    float predicted = getPredictedTemperature();
+    float factor = 1.0f - (1.0f - THERMAL_MIN_FACTOR) * (predicted - m_derateStart) / THERMAL_DERATE_RANGE;
+    factor = factor > 1.0f ? 1.0f : (factor < THERMAL_MIN_FACTOR ? THERMAL_MIN_FACTOR : factor);
+    float target = factor * maxChargePower;
+    if(m_powerCap > 0.0f) {
+        if(m_temperature < m_derateStart - THERMAL_GAP_TEMPERATURE_MARGIN) {
+            m_powerCap = 0.0f;
+        } else if(!gap) {
+            m_powerCap += THERMAL_LIMIT_SLEW * seconds;
+        }
+        if(m_powerCap > 0.0f && m_powerCap < target) {
+            target = m_powerCap;
+        }
+    }
+
+    // the limit moves smoothly, it ends when it is back at the max charge power
+    bool wasDerating = isDerating();
+    float current = m_limit > 0.0f ? m_limit : maxChargePower;
+    float step = THERMAL_LIMIT_SLEW * seconds;
+    if(target < current) {
+        current = current - step > target ? current - step : target;
+    } else {
+        current = current + step < target ? current + step : target;
+    }
+    m_limit = current < maxChargePower ? current : 0.0f;
+
+    if(!wasDerating && isDerating()) {
+        printf("[Thermal] PSU at %.1fC (trend %+.1fC/min, predicted %.1fC) --> derate max charge power\n",
+                m_temperature, m_trend * 60.0f, predicted);
+    } else if(wasDerating && !isDerating()) {
+        printf("[Thermal] PSU at %.1fC --> derating ended\n", m_temperature);
+    }
+}
+
+// the derated max charge power, never below the min charge power (the charger is not turned off)
+short ThermalDerating::getPowerLimit(short maxChargePower, short minChargePower) const {
+    if(!isDerating() || m_limit >= maxChargePower) {
+        return maxChargePower;
+    }
+    short limit = static_cast<short>(m_limit);
+    return limit > minChargePower ? limit : minChargePower;
+}
+
+// the PSU voltage changed (charge stages)
+void ThermalDerating::setChargeVoltage(float chargeVoltage) {
+    m_chargeVoltage = chargeVoltage;
+}
+
+bool ThermalDerating::isDerating() const {
+    return m_limit > 0.0f;
+}
+
+float ThermalDerating::getTemperature() const {
+    return m_temperature;
+}
+
+// in degree celsius per second
+float ThermalDerating::getTrend() const {
+    return m_trend;
+}
+
+// a falling trend doesn't lift the derating earlier
+float ThermalDerating::getPredictedTemperature() const {
+    return m_temperature + (m_trend > 0.0f ? m_trend * THERMAL_LOOKAHEAD : 0.0f);
+}
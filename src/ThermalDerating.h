@@ -0,0 +1,66 @@
+/*
+    File: ThermalDerating.h
+    Predictive thermal derating of the max charge power. The PSUs limit their output current on
+    their own when they get too hot (e.g. in the attic in summer). The regulator would keep on
+    commanding current that is not delivered. Instead the temperature trend is tracked and the max
+    charge power is reduced smoothly before the PSU limit is reached. A persistent gap between the
+    commanded and the delivered current of a warm PSU caps the max charge power at the delivered power
+
+    written by Elias Geiger
+*/
+
+#pragma once
+
+#include <cstdio>
+
+// smoothing time constants of the temperature and of its trend in seconds
+#define THERMAL_TEMPERATURE_TIME 30.0f
+#define THERMAL_TREND_TIME 120.0f
+
+// the temperature is predicted this far ahead with the current trend in seconds
+#define THERMAL_LOOKAHEAD 180.0f
+
+// the max charge power is reduced linearly over this range above the derate start temperature
+// down to the min factor (in degree celsius)
+#define THERMAL_DERATE_RANGE 15.0f
+#define THERMAL_MIN_FACTOR 0.3f
+
+// current gap: below this share of the commanded current (min 2A commanded) the PSU limits on its own.
+// only regarded within this margin below the derate start temperature and below the charge voltage
+#define THERMAL_GAP_RATIO 0.85f
+#define THERMAL_GAP_MIN_CURRENT 2.0f
+#define THERMAL_GAP_TEMPERATURE_MARGIN 10.0f
+#define THERMAL_GAP_VOLTAGE_MARGIN 0.5f
+#define THERMAL_GAP_TIME 20.0f                  // in seconds
+
+// the limit follows its target by at most this much per second (in watts)
+#define THERMAL_LIMIT_SLEW 10.0f
+
+// updates further apart than this are not integrated (meter downtime) in seconds
+#define THERMAL_MAX_UPDATE_GAP 10.0f
+
+class ThermalDerating
+{
+    float m_derateStart;
+    float m_chargeVoltage;              // voltage the PSU is set to (absorption or the voltage of the charge stage)
+
+    bool m_initialized;
+    long long m_lastUpdateTime;
+    float m_temperature, m_trend;
+    float m_gapTime;                    // time the delivered current is persistently too low in seconds
+    float m_powerCap;                   // AC power the PSU delivered while limiting on its own (0 = none)
+    float m_limit;                      // current max charge power limit (0 = not derated)
+
+public:
+    ThermalDerating(float, float);
+
+    void update(float, float, float, float, float, short, long long);
+    short getPowerLimit(short, short) const;
+    void setChargeVoltage(float);
+
+    // getters //
+    bool isDerating() const;
+    float getTemperature() const;
+    float getTrend() const;
+    float getPredictedTemperature() const;
+};
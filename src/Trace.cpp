@@ -0,0 +1,182 @@
+/*
+    File: Trace.cpp
+    written by Elias Geiger
+*/
+
+#include "Trace.h"
+
+// statically allocated rings, handed out to the threads on their first event
+static TraceRing traceRings[TRACE_MAX_THREADS];
+static std::atomic<int> traceRingCount(0);
+static std::atomic<bool> traceEnabled(false);
+
+static thread_local TraceRing* threadRing = NULL;
+static thread_local bool threadRingFailed = false;
+static thread_local const char* threadName = NULL;
+
+// assigns a ring to the calling thread. returns NULL if all rings are taken
+static TraceRing* getThreadRing() {
+    if(threadRing != NULL || threadRingFailed) {
+        return threadRing;
+    }
+
+    int index = traceRingCount.fetch_add(1);
+    if(index >= TRACE_MAX_THREADS) {
+        threadRingFailed = true;
+        return NULL;
+    }
+
+    TraceRing* ring = &traceRings[index];
+    snprintf(ring->threadName, sizeof(ring->threadName), "%s", threadName != NULL ? threadName : "unnamed");
+    ring->threadId = index + 1;
+    ring->writeIndex = 0;
+    threadRing = ring;
+    return ring;
+}
+
+void setTraceEnabled(bool enabled) {
+    traceEnabled = enabled;
+}
+
+bool isTraceEnabled() {
+    return traceEnabled.load(std::memory_order_relaxed);
+}
+
+// name shown for the calling thread in the timeline (must be set before its first event)
+void setTraceThreadName(const char* name) {
+    threadName = name;
+    if(threadRing != NULL) {
+        snprintf(threadRing->threadName, sizeof(threadRing->threadName), "%s", name);
+    }
+}
+
+// records an event into the ring of the calling thread
+void traceEvent(char phase, const char* name, int value) {
+    if(!isTraceEnabled()) {
+        return;
+    }
+    TraceRing* ring = getThreadRing();
+    if(ring == NULL) {
+        return;
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    uint64_t index = ring->writeIndex.load(std::memory_order_relaxed);
+    TraceEvent& event = ring->events[index % TRACE_RING_SIZE];
+    event.timestamp = static_cast<uint64_t>(now.tv_sec) * 1000000000ULL + now.tv_nsec;
+    event.name = name;
+    event.value = value;
+    event.phase = phase;
+    ring->writeIndex.store(index + 1, std::memory_order_release);
+}
+
+void traceInstant(const char* name, int value) {
+    traceEvent('i', name, value);
+}
+
+// trace scope //
+TraceScope::TraceScope(const char* name) {
+    m_name = name;
+    m_open = true;
+    traceEvent('B', m_name, 0);
+}
+
+TraceScope::~TraceScope() {
+    end();
+}
+
+void TraceScope::end(int value) {
+    if(m_open) {
+        traceEvent('E', m_name, value);
+        m_open = false;
+    }
+}
+
+// helper for writing formatted text through a stack buffer
+struct TraceWriter
+{
+    int fd;
+    char buffer[4096];
+    size_t length;
+    bool failed;
+
+    void append(const char* format, ...) __attribute__((format(printf, 2, 3)));
+    void flush();
+};
+
+void TraceWriter::append(const char* format, ...) {
+    char line[256];
+    va_list args;
+    va_start(args, format);
+    int lineLength = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    if(lineLength < 0) {
+        return;
+    }
+    if(static_cast<size_t>(lineLength) >= sizeof(line)) {
+        lineLength = sizeof(line) - 1;
+    }
+
+    if(length + lineLength > sizeof(buffer)) {
+        flush();
+    }
+    memcpy(buffer + length, line, lineLength);
+    length += lineLength;
+}
+
+void TraceWriter::flush() {
+    if(length > 0 && write(fd, buffer, length) != static_cast<ssize_t>(length)) {
+        failed = true;
+    }
+    length = 0;
+}
+
+// writes the content of all rings as Chrome Trace Event JSON (timestamps in microseconds).
+// events that may be overwritten while copying are skipped
+bool writeTrace(const char* fileName) {
+    TraceWriter writer;
+    writer.fd = open(fileName, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    writer.length = 0;
+    writer.failed = false;
+    if(writer.fd < 0) {
+        return false;
+    }
+
+    writer.append("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first = true;
+    int ringCount = traceRingCount.load();
+    if(ringCount > TRACE_MAX_THREADS) {
+        ringCount = TRACE_MAX_THREADS;
+    }
+
+    for(int r = 0; r < ringCount; r++) {
+        TraceRing& ring = traceRings[r];
+        writer.append("%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                        first ? "" : ",\n", ring.threadId, ring.threadName);
+        first = false;
+
+        uint64_t endIndex = ring.writeIndex.load(std::memory_order_acquire);
+        uint64_t startIndex = endIndex > TRACE_RING_SIZE ? endIndex - TRACE_RING_SIZE : 0;
+        for(uint64_t i = startIndex; i < endIndex; i++) {
+            TraceEvent event = ring.events[i % TRACE_RING_SIZE];
+
+            // the writer may have wrapped around meanwhile
+            if(ring.writeIndex.load(std::memory_order_acquire) >= i + TRACE_RING_SIZE) {
+                continue;
+            }
+
+            writer.append(",\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%llu.%03llu,\"pid\":1,\"tid\":%d%s,\"args\":{\"value\":%d}}",
+                            event.name, event.phase, static_cast<unsigned long long>(event.timestamp / 1000),
+                            static_cast<unsigned long long>(event.timestamp % 1000), ring.threadId,
+                            event.phase == 'i' ? ",\"s\":\"t\"" : "", event.value);
+        }
+    }
+
+    writer.append("\n]}\n");
+    writer.flush();
+    close(writer.fd);
+
+    return !writer.failed;
+}
@@ -0,0 +1,74 @@
+/*
+    File: Trace.h
+    Low overhead trace points for analysing how the threads interleave. Every thread records
+    into its own fixed ring buffer (no locks, no allocation), the rings are written as
+    Chrome Trace Event JSON on demand (open in chrome://tracing or ui.perfetto.dev)
+
+    written by Elias Geiger
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <cstdarg>
+#include <ctime>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "default-conf.h"
+
+// number of events kept per thread (the oldest are overwritten).
+// a compiled in profile without trace points doesn't reserve the rings
+#if defined(_STATIC_CONFIG) && !TRACE_ENABLED
+    #define TRACE_RING_SIZE 1
+#else
+    #define TRACE_RING_SIZE 4096
+#endif
+
+// max number of threads that can record
+#define TRACE_MAX_THREADS 16
+
+#define TRACE_THREAD_NAME_LENGTH 32
+
+// one recorded event. the name must be a string literal
+struct TraceEvent
+{
+    uint64_t timestamp;         // CLOCK_MONOTONIC in ns
+    const char* name;
+    int32_t value;
+    char phase;                 // 'B' begin, 'E' end, 'i' instant
+};
+
+// ring buffer of one thread. only the owning thread writes
+struct TraceRing
+{
+    char threadName[TRACE_THREAD_NAME_LENGTH];
+    int threadId;
+    std::atomic<uint64_t> writeIndex;
+    TraceEvent events[TRACE_RING_SIZE];
+};
+
+// marks a span for the lifetime of the object (or until end() is called)
+class TraceScope
+{
+    const char* m_name;
+    bool m_open;
+
+public:
+    TraceScope(const char*);
+    ~TraceScope();
+
+    void end(int value = 0);
+};
+
+// function prototypes
+void setTraceEnabled(bool);
+bool isTraceEnabled();
+void setTraceThreadName(const char*);
+void traceEvent(char, const char*, int);
+void traceInstant(const char*, int);
+bool writeTrace(const char*);
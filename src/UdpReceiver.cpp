@@ -5,12 +5,20 @@
 
 #include "UdpReceiver.h"
 
-extern Queue<PowerState> cmdQueue;
-extern PsuController psu;
-
 // constructor and destructor
-UdpReceiver::UdpReceiver() {
+UdpReceiver::UdpReceiver(const ConfigFile& cfg, PsuInterface& psu, MeterWatchdog& watchdog, EnergyLedger& ledger,
+                            Queue<PowerState>& cmdQueue, std::string meterLogFile)
+    : m_cfg(cfg), m_psu(psu), m_watchdog(watchdog), m_ledger(ledger), m_cmdQueue(cmdQueue) {
+    m_meterLogFileName = meterLogFile;
     m_threadRunning = false;
+    memset(&m_ringMsg, 0, sizeof(m_ringMsg));
+    m_ringRecvArmed = false;
+    m_requestedInterval = 0;
+    m_repliedInterval = 0;
+    m_lastIntervalReplyTime = steady_clock::now();
+    m_datagramCount = 0;
+    m_batteryTemperature = NAN;
+    m_batteryTemperatureTime = 0;
     // std::cout << "[UDP] receiver constructed" << std::endl;
 }
 
@@ -18,8 +26,8 @@ UdpReceiver::~UdpReceiver() {
     // std::cout << "[UDP] receiver destructed" << std::endl;
 }
 
-// method to setup receiver and start listening
-bool UdpReceiver::setup(short udpPort) {
+// method to setup receiver and start listening on the configured port
+bool UdpReceiver::setup() {
     // only setup once
     if(m_threadRunning) {
         return false;
@@ -36,7 +44,7 @@ bool UdpReceiver::setup(short udpPort) {
     memset(&m_serverAddr, 0, sizeof(m_serverAddr));
     m_serverAddr.sin_family = AF_INET;
     m_serverAddr.sin_addr.s_addr = INADDR_ANY;
-    m_serverAddr.sin_port = htons(static_cast<uint16_t>(udpPort));
+    m_serverAddr.sin_port = htons(static_cast<uint16_t>(m_cfg.getUdpPort()));
 
     // bind socket to address and port 
     if(bind(m_socket, (const struct sockaddr*)&m_serverAddr, sizeof(m_serverAddr)) < 0) {
@@ -44,6 +52,45 @@ bool UdpReceiver::setup(short udpPort) {
         return false;
     }
 
+    return startListener();
+}
+
+// method to continue listening on the socket handed over by the previous process (hot restart)
+bool UdpReceiver::takeOver(int existingSocket) {
+    // only setup once
+    if(m_threadRunning) {
+        return false;
+    }
+
+    m_socket = existingSocket;
+    return startListener();
+}
+
+int UdpReceiver::getSocket() const {
+    return m_socket;
+}
+
+// sets the reading interval the meter is asked for (0 = no replies). called by the regulator
+void UdpReceiver::requestMeterInterval(int intervalMs) {
+    m_requestedInterval = intervalMs;
+}
+
+// number of datagrams processed by the listener so far (stress harness)
+unsigned long UdpReceiver::getDatagramCount() const {
+    return m_datagramCount.load(std::memory_order_relaxed);
+}
+
+// last received battery temperature, NAN if none was received within the max age in seconds
+float UdpReceiver::getBatteryTemperature(long maxAge) const {
+    long receiveTime = m_batteryTemperatureTime.load();
+    if(receiveTime == 0 || time(NULL) - receiveTime > maxAge) {
+        return NAN;
+    }
+    return m_batteryTemperature.load();
+}
+
+// launches the listener thread on the bound socket
+bool UdpReceiver::startListener() {
     // make socket non-blocking
     unsigned long setting = 1;
     if(ioctl(m_socket, FIONBIO, &setting) < 0) {
@@ -51,10 +98,27 @@ bool UdpReceiver::setup(short udpPort) {
         return false;
     }
 
+    // open the meter log for appending if recording is enabled
+    if(m_cfg.isMeterLogEnabled()) {
+        // own buffer, the stream would allocate it lazily on the first reading
+        m_meterLog.rdbuf()->pubsetbuf(m_meterLogBuffer, sizeof(m_meterLogBuffer));
+        m_meterLog.open(m_meterLogFileName.c_str(), std::ofstream::out | std::ofstream::app);
+        if(!m_meterLog.is_open()) {
+            std::cerr << "Failed to open meter log file " << m_meterLogFileName << std::endl;
+        }
+    }
+
+    // optional io_uring backend, the classic poll/recvfrom path is the fallback
+    if(m_cfg.isIoUringEnabled()) {
+        setupRing();
+    }
+
     // launch listener thread 
+    m_threadRunning = true;
     m_listenerThread = std::thread([] (UdpReceiver* ptr) {
-        ptr->m_threadRunning = true;
         std::cout << "[UDP-thread] listener thread running ..." << std::endl;
+        setTraceThreadName("UDP");
+        registerProfileThread("UDP");
     
         // construct client address
         struct sockaddr_in clientAddr;
@@ -63,64 +127,212 @@ bool UdpReceiver::setup(short udpPort) {
         socklen_t len;
         len = sizeof(clientAddr);
 
-        auto lastMsgTime = steady_clock::now();
-		auto currentTime = steady_clock::now();
-        const PowerState fakePowerState = {30000, 0};
+        // wait for incoming messages with a timeout to check the stop signal regularly
+        struct pollfd pfd;
+        pfd.fd = ptr->m_socket;
+        pfd.events = POLLIN;
 
         // read and queue incoming messages until external stop signal
+        // meter downtime is handled by the watchdog independently of this thread
         char recvBuffer[MSGLEN];
         int bytesRead = 0;
         while(ptr->m_threadRunning) {
-            bytesRead = recvfrom(ptr->m_socket, (char*)recvBuffer, MSGLEN, 0, (sockaddr*) &clientAddr, &len);
-            if(bytesRead <= 0) {
-                // check the time passed since the last message was received
-                currentTime = steady_clock::now();
-                seconds timeElapsed = duration_cast<seconds>(currentTime - lastMsgTime);
-                if(timeElapsed.count() > 60) {
-                    // Tasmota smart meter downtime detected --> send faked high power state to set 0W charge power
-                    std::cerr << "[UDP-thread] Tasmota energy meter downtime detected! (timeout after 60s)" << std::endl;
-                    cmdQueue.push(fakePowerState);
-                    sleep_for(seconds(5));
-                }
+            if(ptr->m_ring.isActive()) {
+                ptr->receiveRing();
                 continue;
             }
-            recvBuffer[bytesRead] = '\0';     // String nulltermination
 
-            // string to short conversion 
-            short powerVal = static_cast<short>(atoi(recvBuffer));
-            
-            // filter out invalid unrealistic value (likely corrupted during transmission)
-            if(powerVal < -30000 || powerVal > 20000) {
-                std::cerr << "[UDP-thread] Received invalid power state value: " << powerVal << " (ignore)" << std::endl;
+            countSyscalls();
+            if(poll(&pfd, 1, UDP_POLL_TIMEOUT) <= 0) {
                 continue;
             }
-            
-            // compose a power state object out of the new command and the current AC input power of the PSU
-            PowerState pState;
-            pState.tasmotaPowerCmd = powerVal;
-            pState.psuAcInputPower = static_cast<short>(psu.getCurrentInputPower());
 
-            // Put new value on the command queue for processing
-            cmdQueue.push(pState);
-
-            // save timestamp of last received message for downtime detection 
-            lastMsgTime = steady_clock::now();
+            len = sizeof(clientAddr);
+            bytesRead = recvfrom(ptr->m_socket, (char*)recvBuffer, MSGLEN - 1, 0, (sockaddr*) &clientAddr, &len);
+            countSyscalls();
+            if(bytesRead <= 0) {
+                continue;
+            }
+            recvBuffer[bytesRead] = '\0';     // String nulltermination
+            ptr->processDatagram(recvBuffer, clientAddr);
         }
                 
+        unregisterProfileThread();
         std::cout << "[UDP-thread] closeup --> finish thread now" << std::endl;
     }, this);
 
     return true;
 }
 
+// sets up the io_uring backend with a multishot receive into buffers provided to the kernel
+bool UdpReceiver::setupRing() {
+    if(!m_ring.setup(UDP_RING_ENTRIES)) {
+        std::cerr << "[UDP] io_uring not available --> classic I/O" << std::endl;
+        return false;
+    }
+
+    // only the sender address is received along with the payload
+    m_ringMsg.msg_namelen = sizeof(struct sockaddr_in);
+    m_ring.provideBuffers(m_ringBuffers, UDP_RING_BUFFER_SIZE, UDP_RING_BUFFERS, UDP_RING_BUFFER_GROUP, 0, UDP_RING_BUFFERS_PROVIDED);
+    m_ringRecvArmed = false;
+
+    std::cout << "[UDP] Using io_uring I/O" << std::endl;
+    return true;
+}
+
+// waits for datagrams via io_uring and processes all of them (listener thread only)
+void UdpReceiver::receiveRing() {
+    if(!m_ringRecvArmed) {
+        m_ring.recvMsgMultishot(m_socket, &m_ringMsg, UDP_RING_BUFFER_GROUP, UDP_RING_RECV);
+        m_ringRecvArmed = true;
+    }
+
+    int ready = m_ring.submitAndWait(UDP_POLL_TIMEOUT);
+    if(ready < 0) {
+        std::cerr << "[UDP-thread] io_uring failed: " << strerror(-ready) << " --> classic I/O" << std::endl;
+        m_ring.closeUp();
+        return;
+    }
+
+    char recvBuffer[MSGLEN];
+    struct sockaddr_in sender;
+    struct io_uring_cqe cqe;
+    while(m_ring.popCompletion(cqe)) {
+        if(cqe.user_data != UDP_RING_RECV) {
+            continue;
+        }
+        if(!(cqe.flags & IORING_CQE_F_MORE)) {
+            m_ringRecvArmed = false;
+        }
+
+        // multishot receive not supported (kernel < 6.0)
+        if(cqe.res == -EINVAL) {
+            std::cerr << "[UDP-thread] io_uring multishot receive not supported --> classic I/O" << std::endl;
+            m_ring.closeUp();
+            return;
+        }
+        if(!(cqe.flags & IORING_CQE_F_BUFFER)) {
+            continue;
+        }
+
+        // copy the payload out and give the buffer back right away
+        unsigned bufferId = cqe.flags >> IORING_CQE_BUFFER_SHIFT;
+        const char* buffer = m_ringBuffers[bufferId];
+        struct io_uring_recvmsg_out header;
+        memcpy(&header, buffer, sizeof(header));
+        int bytesRead = 0;
+        if(cqe.res > 0 && !(header.flags & MSG_TRUNC)) {
+            memset(&sender, 0, sizeof(sender));
+            memcpy(&sender, buffer + sizeof(header), std::min(static_cast<size_t>(header.namelen), sizeof(sender)));
+            bytesRead = std::min(static_cast<int>(header.payloadlen), MSGLEN - 1);
+            memcpy(recvBuffer, buffer + sizeof(header) + m_ringMsg.msg_namelen + m_ringMsg.msg_controllen, bytesRead);
+        }
+        m_ring.provideBuffers(m_ringBuffers[bufferId], UDP_RING_BUFFER_SIZE, 1, UDP_RING_BUFFER_GROUP, bufferId, UDP_RING_BUFFERS_PROVIDED);
+
+        if(bytesRead <= 0) {
+            continue;
+        }
+        recvBuffer[bytesRead] = '\0';     // String nulltermination
+        processDatagram(recvBuffer, sender);
+    }
+}
+
+// turns a received meter reading into a power state for the regulator (listener thread only)
+void UdpReceiver::processDatagram(const char* recvBuffer, const struct sockaddr_in& sender) {
+    TraceScope span("udp_receive");
+    m_datagramCount.fetch_add(1, std::memory_order_relaxed);
+
+    // battery temperature from a sensor (no meter reading, doesn't feed the watchdog)
+    if(strncmp(recvBuffer, "temp ", 5) == 0) {
+        float temperature = strtof(recvBuffer + 5, NULL);
+        if(temperature < -40.0f || temperature > 85.0f) {
+            std::cerr << "[UDP-thread] Received invalid battery temperature: " << temperature << " (ignore)" << std::endl;
+            return;
+        }
+        m_batteryTemperature = temperature;
+        m_batteryTemperatureTime = static_cast<long>(time(NULL));
+        return;
+    }
+
+    // string to short conversion 
+    short powerVal = static_cast<short>(atoi(recvBuffer));
+    
+    // filter out invalid unrealistic value (likely corrupted during transmission)
+    if(powerVal < -30000 || powerVal > 20000) {
+        std::cerr << "[UDP-thread] Received invalid power state value: " << powerVal << " (ignore)" << std::endl;
+        return;
+    }
+    
+    // compose a power state object out of the new command and the current AC input power of the PSU
+    PowerState pState;
+    pState.tasmotaPowerCmd = powerVal;
+    pState.psuAcInputPower = static_cast<short>(m_psu.getCurrentInputPower());
+
+    // Put new value on the command queue for processing
+    m_cmdQueue.push(pState);
+    traceInstant("enqueue", powerVal);
+    logMeterReading(pState);
+
+    // account the energy flows (only accumulated in memory)
+    if(m_cfg.isEnergyLedgerEnabled()) {
+        m_ledger.addSample(powerVal, m_psu.getCurrentInputPower(), m_psu.getCurrentOutputPower());
+    }
+
+    // valid reading received --> feed the meter watchdog
+    m_watchdog.feed();
+
+    replyMeterInterval(sender);
+}
+
+// tells the meter the wanted reading interval ("interval <ms>"). only sent on changes and repeated now and
+// then, so a restarted meter picks it up (listener thread only)
+void UdpReceiver::replyMeterInterval(const struct sockaddr_in& sender) {
+    int interval = m_requestedInterval;
+    if(interval <= 0) {
+        return;
+    }
+    steady_clock::time_point now = steady_clock::now();
+    if(interval == m_repliedInterval && now - m_lastIntervalReplyTime < std::chrono::milliseconds(METER_RATE_REPEAT_TIME)) {
+        return;
+    }
+
+    char reply[32];
+    int length = snprintf(reply, sizeof(reply), "interval %d", interval);
+    countSyscalls();
+    if(sendto(m_socket, reply, length, MSG_DONTWAIT, (const struct sockaddr*)&sender, sizeof(sender)) < 0) {
+        return;
+    }
+    m_repliedInterval = interval;
+    m_lastIntervalReplyTime = now;
+}
+
 // method to close the udp receiver along with it's resources
 void UdpReceiver::closeUp() {
     // signal listener thread to stop
     m_threadRunning = false;
 
     // wait for thread finish
-    m_listenerThread.join();
+    if(m_listenerThread.joinable()) {
+        m_listenerThread.join();
+    }
+    m_ring.closeUp();
 
     // close the udp server socket
     close(m_socket);
+
+    if(m_meterLog.is_open()) {
+        m_meterLog.close();
+    }
+}
+
+// appends a meter reading along with the PSU telemetry to the meter log (format: unix-time-ms,grid-power,ac-input-power,output-voltage)
+void UdpReceiver::logMeterReading(const PowerState& pState) {
+    if(!m_meterLog.is_open()) {
+        return;
+    }
+
+    long long timestampMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+                                std::chrono::system_clock::now().time_since_epoch()).count();
+    m_meterLog << timestampMs << "," << pState.tasmotaPowerCmd << "," << pState.psuAcInputPower << "," 
+                << m_psu.getCurrentOutputVoltage() << "\n";
 }
@@ -15,13 +15,26 @@
 #include <sys/types.h>
 #include <sys/ioctl.h>
 #include <unistd.h>
-#include <bits/stdc++.h>
+#include <poll.h>
 #include <iostream>
+#include <fstream>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+#include <ctime>
+#include <atomic>
+#include <thread>
 #include <chrono>
 
 #include "Utils.h"
-#include "PsuController.h"
-#include "Queue.cpp"
+#include "PsuInterface.h"
+#include "MeterSource.h"
+#include "MeterWatchdog.h"
+#include "EnergyLedger.h"
+#include "Trace.h"
+#include "SelfProfile.h"
+#include "IoRing.h"
+#include "Queue.h"
 
 using std::chrono::steady_clock;
 using std::chrono::seconds;
@@ -29,19 +42,75 @@ using std::chrono::duration_cast;
 using std::this_thread::sleep_for;
 
 #define MSGLEN 1024
+#define UDP_POLL_TIMEOUT 100        // in milliseconds
+#define METER_LOG_BUFFER_SIZE 4096
 
-class UdpReceiver 
+// io_uring backend: receive buffers (header and sender address in front of the payload)
+#define UDP_RING_ENTRIES 16
+#define UDP_RING_BUFFERS 8
+#define UDP_RING_BUFFER_SIZE (sizeof(struct io_uring_recvmsg_out) + sizeof(struct sockaddr_in) + MSGLEN)
+#define UDP_RING_BUFFER_GROUP 1
+
+// request types of the io_uring backend
+enum UdpRingRequest
+{
+    UDP_RING_RECV = 1,
+    UDP_RING_BUFFERS_PROVIDED
+};
+
+class UdpReceiver : public MeterSource
 {
+    const ConfigFile& m_cfg;
+    PsuInterface& m_psu;
+    MeterWatchdog& m_watchdog;
+    EnergyLedger& m_ledger;
+    Queue<PowerState>& m_cmdQueue;
+
     int m_socket;
     struct sockaddr_in m_serverAddr;
 
     std::thread m_listenerThread;
     std::atomic<bool> m_threadRunning;
 
+    // optional recording of meter readings and PSU telemetry for offline tuning
+    std::string m_meterLogFileName;
+    std::ofstream m_meterLog;
+    char m_meterLogBuffer[METER_LOG_BUFFER_SIZE];
+
+    // optional io_uring backend (listener thread only)
+    IoRing m_ring;
+    struct msghdr m_ringMsg;
+    char m_ringBuffers[UDP_RING_BUFFERS][UDP_RING_BUFFER_SIZE];
+    bool m_ringRecvArmed;
+
+    // meter rate control: interval wanted by the regulator, replied to the sender of the readings
+    std::atomic<int> m_requestedInterval;
+    int m_repliedInterval;
+    steady_clock::time_point m_lastIntervalReplyTime;
+
+    std::atomic<unsigned long> m_datagramCount;
+
+    // battery temperature sent along with the readings ("temp <degree celsius>") for the charge stages
+    std::atomic<float> m_batteryTemperature;
+    std::atomic<long> m_batteryTemperatureTime;
+
 public:
-    UdpReceiver();
+    UdpReceiver(const ConfigFile&, PsuInterface&, MeterWatchdog&, EnergyLedger&, Queue<PowerState>&, std::string);
     ~UdpReceiver();
 
-    bool setup(short);
-    void closeUp();
+    bool setup() override;
+    bool takeOver(int);
+    void closeUp() override;
+    int getSocket() const;
+    void requestMeterInterval(int) override;
+    unsigned long getDatagramCount() const;
+    float getBatteryTemperature(long) const override;
+
+private:
+    bool startListener();
+    bool setupRing();
+    void receiveRing();
+    void processDatagram(const char*, const struct sockaddr_in&);
+    void replyMeterInterval(const struct sockaddr_in&);
+    void logMeterReading(const PowerState&);
 };
\ No newline at end of file
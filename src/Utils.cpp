@@ -7,7 +7,7 @@
 #include "Utils.h"
 
 // helper function for detecting a scheduled exit event to close the application
-bool scheduledClose() {
+bool scheduledClose(const ConfigFile& cfg) {
     if(cfg.isScheduledExitEnabled()) {
         // get current system time
         time_t currTime = time(NULL);
@@ -21,3 +21,22 @@ bool scheduledClose() {
 
     return false;
 }
+
+// max resident set size of the process in kB (memory footprint on low RAM targets).
+// read from /proc, getrusage also counts the parent before the exec
+long getPeakRss() {
+    FILE* status = fopen("/proc/self/status", "r");
+    if(status == NULL) {
+        return -1;
+    }
+
+    char line[128];
+    long peakRss = -1;
+    while(fgets(line, sizeof(line), status) != NULL) {
+        if(sscanf(line, "VmHWM: %ld kB", &peakRss) == 1) {
+            break;
+        }
+    }
+    fclose(status);
+    return peakRss;
+}
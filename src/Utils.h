@@ -7,12 +7,12 @@
 #pragma once
 
 #include <ctime>
+#include <cstdio>
 #include "ConfigFile.h"
 
-extern ConfigFile cfg;
-
 // function prototypes
-bool scheduledClose();
+bool scheduledClose(const ConfigFile&);
+long getPeakRss();
 
 struct PowerState
 {
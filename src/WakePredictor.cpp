@@ -0,0 +1,108 @@
+/*
+    File: WakePredictor.cpp
+    written by Elias Geiger
+*/
+
+#include "WakePredictor.h"
+
+// constructor
+WakePredictor::WakePredictor() {
+    reset();
+    m_wakeTime = 0;
+    m_wakes = 0;
+    m_hits = 0;
+    m_misses = 0;
+    m_leadSum = 0.0f;
+}
+
+// forgets the surplus history (the PSUs are on, the surplus is regulated)
+void WakePredictor::reset() {
+    m_initialized = false;
+    m_samples = 0;
+    m_lastUpdateTime = 0;
+    m_surplus = 0.0f;
+    m_trend = 0.0f;
+}
+
+// takes the surplus of a meter reading while the PSUs are off. returns true if they should be woken now:
+// the surplus is rising and expected to reach the threshold (min charge power) within the lead time in ms
+bool WakePredictor::update(float surplus, float threshold, long long leadTime, long long timeMs) {
+    float seconds = m_initialized ? (timeMs - m_lastUpdateTime) / 1000.0f : 0.0f;
+    if(seconds < 0.0f || seconds > WAKE_MAX_UPDATE_GAP) {
+        reset();
+        seconds = 0.0f;
+    }
+    m_lastUpdateTime = timeMs;
+
+    // smoothed surplus and its trend in watts per second (first order lags)
+    if(!m_initialized) {
+        m_surplus = surplus;
+        m_trend = 0.0f;
+        m_initialized = true;
+    } else if(seconds > 0.0f) {
+        float lastSurplus = m_surplus;
+        float alpha = seconds / WAKE_SURPLUS_TIME;
+        m_surplus += (alpha < 1.0f ? alpha : 1.0f) * (surplus - m_surplus);
+        float beta = seconds / WAKE_TREND_TIME;
+        m_trend += (beta < 1.0f ? beta : 1.0f) * ((m_surplus - lastSurplus) / seconds - m_trend);
+    }
+    m_samples++;
+
+    // enough surplus already --> the charge command wakes the PSUs anyway
+    if(m_wakeTime != 0 || m_samples < WAKE_MIN_SAMPLES || m_trend < WAKE_MIN_TREND || surplus >= threshold) {
+        return false;
+    }
+
+    // the smoothed surplus lags a ramp by the smoothing time constant
+    float predicted = m_surplus + m_trend * (leadTime / 1000.0f + WAKE_SURPLUS_TIME);
+    if(predicted < threshold) {
+        return false;
+    }
+
+    printf("[Wake] Surplus %.0fW rising %.1fW/s, expected above %.0fW within %.1fs --> wake the PSU ahead\n",
+            m_surplus, m_trend, threshold, leadTime / 1000.0f);
+    m_wakeTime = timeMs;
+    m_wakes++;
+    return true;
+}
+
+// the first charge command after a predictive wake (the PSU had this long to boot)
+void WakePredictor::chargeStarted(long long timeMs) {
+    if(m_wakeTime == 0) {
+        return;
+    }
+    float lead = (timeMs - m_wakeTime) / 1000.0f;
+    printf("[Wake] Charging %.1fs after the predictive wake\n", lead);
+    m_leadSum += lead;
+    m_hits++;
+    m_wakeTime = 0;
+    reset();
+}
+
+// slot detect went off again without charging --> the wake was for nothing
+void WakePredictor::standbyEntered() {
+    if(m_wakeTime == 0) {
+        return;
+    }
+    printf("[Wake] No charging after the predictive wake\n");
+    m_misses++;
+    m_wakeTime = 0;
+    reset();
+}
+
+void WakePredictor::printReport() const {
+    if(m_wakes == 0) {
+        return;
+    }
+    printf("[Wake] %u predictive wakes: %u followed by charging (%.1fs ahead on average), %u without\n",
+            m_wakes, m_hits, m_hits > 0 ? m_leadSum / m_hits : 0.0f, m_misses);
+}
+
+// getters //
+float WakePredictor::getSurplus() const {
+    return m_surplus;
+}
+
+float WakePredictor::getTrend() const {
+    return m_trend;
+}
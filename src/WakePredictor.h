@@ -0,0 +1,51 @@
+/*
+    File: WakePredictor.h
+    Predictive slot detect wake-up. In standby (slot detect off) the PSUs need several seconds to boot
+    after the first charge command re-enabled slot detect, the surplus goes to the grid meanwhile.
+    The predictor tracks the surplus and its trend while the PSUs are off and wakes them ahead of time
+    when the surplus is expected to reach the min charge power within the measured wake-up time
+    (slot detect on until the first status frame). Wakes without a following charge command are counted
+
+    written by Elias Geiger
+*/
+
+#pragma once
+
+#include <cstdio>
+
+// smoothing time constants of the surplus and of its trend in seconds
+#define WAKE_SURPLUS_TIME 5.0f
+#define WAKE_TREND_TIME 15.0f
+
+// a wake needs this many readings and a rising surplus of at least this much per second
+#define WAKE_MIN_SAMPLES 3
+#define WAKE_MIN_TREND 1.0f
+
+// updates further apart than this are not integrated (meter downtime) in seconds
+#define WAKE_MAX_UPDATE_GAP 30.0f
+
+class WakePredictor
+{
+    bool m_initialized;
+    int m_samples;
+    long long m_lastUpdateTime;
+    float m_surplus, m_trend;           // smoothed surplus in watts and its trend in watts per second
+    long long m_wakeTime;               // time of the last predictive wake (0 = no wake pending)
+
+    // statistics
+    unsigned int m_wakes, m_hits, m_misses;
+    float m_leadSum;                    // seconds from the wake to the charge command (hits)
+
+public:
+    WakePredictor();
+
+    void reset();
+    bool update(float, float, long long, long long);
+    void chargeStarted(long long);
+    void standbyEntered();
+    void printReport() const;
+
+    // getters //
+    float getSurplus() const;
+    float getTrend() const;
+};
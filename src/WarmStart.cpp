@@ -0,0 +1,43 @@
+/*
+    File: WarmStart.cpp
+    written by Elias Geiger
+*/
+
+#include "WarmStart.h"
+
+// constructor
+WarmStart::WarmStart(std::string fileName) : m_fileName(fileName), m_tempFileName(fileName + ".tmp") {}
+
+// writes the snapshot to a temporary file and renames it over the last one. returns false on failure
+// (no heap allocation, called periodically by the regulator)
+bool WarmStart::store(WarmStartState& state) const {
+    state.magic = WARM_START_MAGIC;
+    state.version = WARM_START_VERSION;
+    state.savedTime = static_cast<int64_t>(time(NULL));
+
+    int fd = open(m_tempFileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0) {
+        return false;
+    }
+    bool success = write(fd, &state, sizeof(state)) == static_cast<ssize_t>(sizeof(state));
+    success = fsync(fd) == 0 && success;
+    close(fd);
+
+    if(!success || rename(m_tempFileName.c_str(), m_fileName.c_str()) < 0) {
+        unlink(m_tempFileName.c_str());
+        return false;
+    }
+    return true;
+}
+
+// reads the snapshot. returns false if there is none or it was written by another version
+bool WarmStart::load(WarmStartState& state) const {
+    int fd = open(m_fileName.c_str(), O_RDONLY);
+    if(fd < 0) {
+        return false;
+    }
+    bool success = read(fd, &state, sizeof(state)) == static_cast<ssize_t>(sizeof(state));
+    close(fd);
+
+    return success && state.magic == WARM_START_MAGIC && state.version == WARM_START_VERSION;
+}
@@ -0,0 +1,65 @@
+/*
+    File: WarmStart.h
+    Warm start after a restart of the app (update, crash, reboot). A small versioned snapshot of the
+    regulator state is written periodically: the operating point (last charge or discharge setpoint),
+    the learned parameters (meter noise, PSU wake-up time, efficiency map) and counters. On startup the
+    learned parameters are restored, the operating point only if the snapshot is fresh, so the
+    regulator resumes from it instead of ramping up from zero. The file is replaced atomically
+    (written to a temporary file and renamed), a crash while writing leaves the last snapshot intact
+
+    written by Elias Geiger
+*/
+
+#pragma once
+
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <ctime>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "Regulation.h"
+#include "PulseCharger.h"
+#include "ChargeStages.h"
+
+#define WARM_START_MAGIC 0x54535745         // "EWST"
+#define WARM_START_VERSION 2
+
+// complete file layout of the snapshot
+struct WarmStartState
+{
+    uint32_t magic;
+    uint32_t version;
+    int64_t savedTime;                      // unix time
+
+    // operating point (only restored if fresh)
+    int16_t lastPowerCmd;                   // combined setpoint (positive = charge, negative = discharge)
+    int16_t dischargePower;
+    float lastCurrentCmd;
+    ChargeStageState chargeStage;           // (the time of the last equalisation is always restored)
+
+    // learned parameters
+    DeadbandState deadband;
+    int32_t wakeTime;                       // measured PSU wake-up time in ms (0 = not measured)
+    float efficiency[PULSE_EFFICIENCY_BINS];
+    uint8_t efficiencyValid[PULSE_EFFICIENCY_BINS];
+
+    // counters
+    uint32_t saturationEvents;
+    float saturatedSeconds;
+};
+
+class WarmStart
+{
+    std::string m_fileName;
+    std::string m_tempFileName;
+
+public:
+    WarmStart(std::string);
+
+    bool store(WarmStartState&) const;
+    bool load(WarmStartState&) const;
+};
@@ -10,8 +10,9 @@
 // for debugging purposes
 // #define _VERBOSE_OUTPUT
 
-// compile flag for raspberry pi exclusive functionality
-#define _TARGET_RASPI
+// compile flag for raspberry pi exclusive functionality (_TARGET_RASPI) is set by cmake,
+// on by default if wiringPi is installed (cmake -DTARGET_RASPI=OFF to build without GPIO).
+// cmake -DGPIO_MOCK=ON (_GPIO_MOCK) simulates the slot detect relay off the pi
 
 /*
     These are the default fallback values for all config variables.
@@ -31,9 +32,20 @@
 // recommendation: between 5 and 15
 #define REGULATOR_ERR_THRESHOLD 7
 
+// adaptive deadband: error threshold and min command step follow the measured meter noise
+// (threshold = sigma factor * noise level) within floor and ceiling. replaces the static threshold
+#define ADAPTIVE_DEADBAND_ENABLED false
+#define DEADBAND_FLOOR 5
+#define DEADBAND_CEILING 40
+#define DEADBAND_SIGMA_FACTOR 2.0f
+
 // enforced wait time until which elapses before next power command is processed in milliseconds
 #define REGULATOR_IDLE_TIME 1200
 
+// share of the grid power deviation that is corrected with one command (1.0 = full correction)
+// recommendation: determine with ./regulatorApp --autotune
+#define REGULATOR_GAIN 1.0f
+
 // bounds for min and max DC ouput power of the charger PSU
 #define MAX_CHARGE_POWER 700
 #define MIN_CHARGE_POWER 50
@@ -42,14 +54,210 @@
 // recommendation: go lower to spare battery lifetime if you don't need the capacity
 #define CHARGER_ABSORPTION_VOLTAGE 52.5f
 
+// usable capacity of the battery in ampere hours
+#define BATTERY_CAPACITY 100.0f
+
+// battery is considered full when the charge current tails off below this value at absorption voltage
+#define BATTERY_TAIL_CURRENT 2.0f
+
+// resting voltage at which the battery is considered empty
+#define BATTERY_EMPTY_VOLTAGE 48.0f
+
+// state of charge in percent above which the max charge power is tapered down towards min charge power
+#define SOC_TAPER_START 90
+
+// charge stages: bulk --> absorption (until the current tails off at the absorption voltage, at most the absorption
+// time) --> float at a lower voltage with the current capped. optionally an equalisation at a higher voltage every
+// few days before the float. without the charge stages the PSU is held at the absorption voltage
+#define CHARGE_STAGES_ENABLED false
+#define CHARGER_FLOAT_VOLTAGE 51.5f
+#define ABSORPTION_TIME 120                 // in minutes
+#define FLOAT_MAX_CURRENT 10.0f             // in ampere
+#define EQUALIZE_ENABLED false
+#define EQUALIZE_VOLTAGE 54.0f
+#define EQUALIZE_INTERVAL 30                // in days
+#define EQUALIZE_TIME 60                    // in minutes
+
+// temperature compensation of the charge voltages in millivolts per degree celsius above 25 degree celsius
+// (0 = off, e.g. -72 for a 48V lead acid battery). the battery temperature is sent to the UDP port ("temp 21.5")
+#define CHARGE_TEMP_COMPENSATION 0.0f
+
+// meter watchdog: failsafe stages after the energy meter went silent (in seconds)
+// hold the last command --> ramp down the charge power --> zero current --> standby (slot detect off)
+// the meter only sends on a power change or after its forced resend time (50s in autoexec.be) --> a steady
+// grid is silent that long, the hold time must be longer
+#define METER_RESEND_TIME 50
+#define METER_HOLD_TIME 55
+#define METER_RAMP_DOWN_TIME 60
+#define METER_TIMEOUT 90
+#define METER_STANDBY_TIME 180
+
+// charge power reduction per second during the ramp down stage in watts
+#define METER_RAMP_DOWN_STEP 50
+
+// meter rate control: the regulator replies the wanted reading interval to the meter (in milliseconds)
+// fast while the loop settles after a command, slow in standby (no charging or discharging)
+#define METER_RATE_CONTROL_ENABLED false
+#define METER_INTERVAL_FAST 250
+#define METER_INTERVAL_STEADY 1000
+#define METER_INTERVAL_STANDBY 5000
+
 /// advanced features ------------------------------------------------------------------------------
 
+// pulse mode: below this average surplus the charge power is collected and charged in pulses
+// at the pulse power (better efficiency than continuous low power charging)
+#define PULSE_MODE_ENABLED false
+#define PULSE_THRESHOLD 200                 // in watts
+#define PULSE_POWER 500                     // in watts
+#define PULSE_WINDOW 120                    // averaging window in seconds
+
+// discharge inverter: the regulator also drives a battery inverter (UDP setpoint) to keep the grid power
+// at the target in both directions. charging and discharging never overlap, the direction only changes
+// when the deviation exceeds the mode hysteresis with the active device already off
+#define INVERTER_ENABLED false
+#define INVERTER_ADDRESS "127.0.0.1"
+#define INVERTER_PORT 2002
+#define MAX_DISCHARGE_POWER 600             // in watts
+#define MIN_DISCHARGE_POWER 50              // in watts
+#define MODE_HYSTERESIS 30                  // in watts
+
+// thermal derating: the max charge power is reduced smoothly when the hottest PSU sensor is predicted
+// (temperature trend) to exceed the derate start temperature, before the PSU limits the current on its own
+#define THERMAL_DERATING_ENABLED false
+#define THERMAL_DERATE_START 65             // in degree celsius
+
+// command monitor: the delivered AC power is compared with the charge command. while the PSU persistently
+// doesn't follow (constant voltage phase, BMS current limit, no response) the command is held just above
+// the delivered power and sent less often
+#define COMMAND_MONITOR_ENABLED false
+
+// load profile: the load is learned per weekday and 15 minute slot. recurring steps at a slot start are
+// pre-positioned and expected short spikes are discounted by the spike discount share (0 - 1, 0 = followed fully)
+#define LOAD_PROFILE_ENABLED false
+#define LOAD_PROFILE_FEEDFORWARD_ENABLED false
+#define LOAD_PROFILE_SPIKE_DISCOUNT 0.5f
+
+// energy ledger with per minute records of grid, charger and captured energy (see regulator_ledger tool)
+#define ENERGY_LEDGER_ENABLED false
+
+// recording of meter readings and PSU telemetry for the offline tuning tool (regulator_tune)
+#define METER_LOG_ENABLED false
+
+// hot restart: a new process started with --takeover takes over the control via this unix socket
+#define HOT_RESTART_ENABLED false
+#define HOT_RESTART_SOCKET "/tmp/regulatorApp.sock"
+
+// warm start: a snapshot of the regulator state is written periodically, after a restart the learned parameters
+// are restored and the regulator resumes from the last setpoint (if the snapshot is fresh)
+#define WARM_START_ENABLED false
+
+// trace points of the control cycle, written to TRACE_FILE on SIGUSR1 (Chrome Trace Event JSON)
+#define TRACE_ENABLED false
+
+// self profiling: CPU time, wakeups and syscalls of the own threads, printed every SELF_PROFILE_REPORT_INTERVAL
+// seconds (0 = only on SIGUSR2). busy threads are reported right away
+#define SELF_PROFILE_ENABLED false
+#define SELF_PROFILE_REPORT_INTERVAL 3600
+
+// io_uring I/O for the CAN and UDP sockets (multishot receives, batched CAN writes). falls back to
+// the classic poll/read/write path if the kernel doesn't support it
+#define IO_URING_ENABLED false
+
 // automatic close up in at given time (e.g. in the evening right after sunset)
 #define SCHEDULED_EXIT_ENABLED false
 #define SCHEDULED_EXIT_HOUR 18          // --> at 18:20 local time
 #define SCHEDULED_EXIT_MINUTE 22
 
-// automatic slot detect control via GPIO pins (on raspberry pi only)
+// automatic slot detect control via GPIO pins (on raspberry pi only). the predictive wake switches
+// slot detect on ahead of time when the surplus trend reaches the min charge power within the PSU wake-up time
 #define SD_CONTROL_ENABLED false
 #define SD_KEEP_ALIVE_TIME 60
+#define SD_PREDICTIVE_WAKE_ENABLED false
+
+/// internal constants (not configurable) -----------------------------------------------------------
+
+// file for persisting the battery counters across restarts
+#define BATTERY_STATE_FILE "battery-state.txt"
+#define BATTERY_STATE_SAVE_INTERVAL 300             // in seconds
+
+// persisted state of charge older than this is discarded (battery may have been discharged meanwhile)
+#define SOC_MAX_STATE_AGE 7200                      // in seconds
+
+// tolerance for detecting the absorption voltage and max charge current regarded as resting
+#define SOC_FULL_VOLTAGE_MARGIN 0.1f
+#define SOC_REST_CURRENT 0.2f
+
+// the counted charge only goes up (the loads discharge unseen) --> the state of charge is re-estimated from
+// the resting voltage after the battery rested this long (also counted while the PSUs are in standby)
+#define SOC_REST_TIME 900                           // in seconds
+
+// file the meter readings are recorded to
+#define METER_LOG_FILE "meter-log.csv"
+
+// meter rate control: fast readings for this long after a command, standby interval after this long without
+// charging or discharging, the wanted interval is repeated this often (meter restarted meanwhile)
+#define METER_RATE_SETTLE_TIME 5000                 // in milliseconds
+#define METER_RATE_STANDBY_DELAY 60000              // in milliseconds
+#define METER_RATE_REPEAT_TIME 30000                // in milliseconds
+
+// directory of the daily energy ledger files
+#define LEDGER_DIRECTORY "ledger"
+
+// file of the learned load profile
+#define LOAD_PROFILE_FILE "load-profile.bin"
+
+// file of the warm start snapshot, written this often and the setpoint in it resumed up to this age.
+// after resuming the regulator waits for the first status report of the PSUs
+#define WARM_START_FILE "warm-start.bin"
+#define WARM_START_SAVE_INTERVAL 60                 // in seconds
+#define WARM_START_MAX_AGE 300                      // in seconds
+#define WARM_START_RESUME_TIMEOUT 10000             // in milliseconds, max wait for the first status report
+
+// file the trace points are written to (open in chrome://tracing or ui.perfetto.dev)
+#define TRACE_FILE "regulator-trace.json"
+
+// the discharge setpoint is repeated this often, the inverter falls back to zero without it (see inverter_stub)
+#define INVERTER_KEEP_ALIVE_TIME 5000               // in milliseconds
+
+// PSU wake-up time (slot detect on until the first status frame) until it is measured, longer ones are
+// not measured (no PSU answered). new measurements are weighted with this share
+#define SD_WAKE_TIME 8000                           // in milliseconds
+#define SD_MAX_WAKE_TIME 60000                      // in milliseconds
+#define SD_WAKE_TIME_WEIGHT 0.3f
+
+// max CAN interfaces of one regulator (all of their sockets must fit into one hot restart handover)
+#define MAX_CAN_INTERFACES 8
+
+// output voltage range of the PSUs, the voltages of the charge stages are kept within it
+#define PSU_MIN_VOLTAGE 42.0f
+#define PSU_MAX_VOLTAGE 58.5f
+
+// period of the meter watchdog timer in milliseconds
+#define WATCHDOG_TICK_TIME 250
+
+// status reports further apart than this are not integrated (e.g. CAN bus outage)
+#define MAX_INTEGRATION_GAP 10                      // in seconds
+
+// auto-tune: size and number of the injected charge power steps
+#define AUTOTUNE_STEP_POWER 100                     // in watts, on top of the min charge power
+#define AUTOTUNE_REPETITIONS 3                      // pairs of up and down steps
+#define AUTOTUNE_SETTLE_TIME 10                     // in seconds, at the base power before the first step
+#define AUTOTUNE_BASELINE_TIME 2                    // in seconds, averaged right before a step
+#define AUTOTUNE_RECORD_TIME 15                     // in seconds, recorded after a step
+#define AUTOTUNE_FINAL_TIME 3                       // in seconds, end of the recording taken as final value
+#define AUTOTUNE_SAMPLE_TIME 20                     // in milliseconds
+#define AUTOTUNE_MIN_RESPONSE 0.3f                  // min response relative to the step, else disturbed
+
+// auto-tune: bounds of the recommended parameters
+#define AUTOTUNE_MIN_IDLE_TIME 300                  // in milliseconds
+#define AUTOTUNE_MAX_IDLE_TIME 5000                 // in milliseconds
+#define AUTOTUNE_MIN_GAIN 0.5f
+#define AUTOTUNE_MAX_GAIN 1.5f
+
+/// compile time config profile ----------------------------------------------------------------------
 
+// a profile (cmake -DCONFIG_PROFILE=profiles/<name>.h) overrides the values above
+// and replaces the config file (see ConfigProfile.cpp)
+#ifdef _CONFIG_PROFILE
+    #include _CONFIG_PROFILE
+#endif
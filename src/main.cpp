@@ -1,29 +1,54 @@
 /*
     File: main.cpp
-    The main file contains the algorithm for the actual power regualtion
+    The main file sets up the regulators (one per charger/meter pair) and runs them on a shared loop
 
     written by Elias Geiger
 */
 
 // Includes
-#include "UdpReceiver.h"
-#include "PsuController.h"
-#include "ConfigFile.h"
+#include "Regulator.h"
+#include "HotRestart.h"
+#include "AutoTune.h"
+#include "AllocAudit.h"
+#include "Trace.h"
+#include "SelfProfile.h"
 #include "Utils.h"
 
+#include <sys/signalfd.h>
+#include <csignal>
+#include <memory>
+#include <algorithm>
+
 using std::this_thread::sleep_for;
 
-// global instances
-PsuController psu;
-Queue<PowerState> cmdQueue;
-UdpReceiver receiver;
-ConfigFile cfg("config.txt");
+// max idle time of the main loop when no regulator has a meter reading to process in milliseconds
+#define MAIN_LOOP_IDLE_TIME 100
+
+// reasons for leaving the regulation loop
+enum RegulatorExit
+{
+    REGULATOR_EXIT_SCHEDULED,
+    REGULATOR_EXIT_SIGNAL,
+    REGULATOR_EXIT_HANDOVER
+};
+
+// process wide resources, everything else is owned by the regulators
+static std::vector<std::unique_ptr<Regulator>> regulators;
+static HotRestart hotRestart;
+static int signalFd = -1;
+static bool slotDetectInitialized = false;
 
 // function prototypes
-void terminateSignalHandler(int);
-void powerRegulation();
-float calculateCurrentBasedOnPower(float, float);
-bool scheduledClose();
+bool setupSignalHandling();
+bool terminationRequested();
+void shutdownApplication(int);
+void detachApplication();
+bool takeOverControl();
+bool handOverControl();
+void initSlotDetect(bool);
+void releaseSlotDetect();
+RegulatorExit runRegulators();
+std::string getInstanceName(const std::string&);
 
 // ----- Main Function ----- //
 int main(int argc, char **argv) 
@@ -32,128 +57,324 @@ int main(int argc, char **argv)
     tm* tm_local = localtime(&currTime);
     std::cout << "[" << tm_local->tm_hour << ":" << tm_local->tm_min << "] Huawei-PSU-Regulator application launched \n" << std::endl;
 
-    // create signal handler for clean Ctrl+C close up
-    struct sigaction sigIntHandler;
-    sigIntHandler.sa_handler = terminateSignalHandler;
-    sigemptyset(&sigIntHandler.sa_mask);
-    sigIntHandler.sa_flags = 0;
-    sigaction(SIGINT, &sigIntHandler, NULL);
+    // start with --takeover to take over the control from a running process (hot restart)
+    bool takeover = argc > 1 && strcmp(argv[1], "--takeover") == 0;
+    // start with --autotune to identify the control loop and store recommended regulator parameters
+    bool autotune = argc > 1 && strcmp(argv[1], "--autotune") == 0;
+    // start with --print-config to check the config (or the compiled in profile) without touching the PSU
+    bool printOnly = argc > 1 && strcmp(argv[1], "--print-config") == 0;
+
+    // the remaining arguments are config files, one regulator (charger/meter pair) per file
+    std::vector<std::string> configFiles;
+    for(int i = (takeover || autotune || printOnly) ? 2 : 1; i < argc; i++) {
+        configFiles.push_back(argv[i]);
+    }
+    if(configFiles.empty()) {
+        configFiles.push_back("config.txt");
+    }
+
+    // several regulators are told apart by the name of their config file (prefix of their state files)
+    for(const std::string& configFile : configFiles) {
+        std::string name = configFiles.size() > 1 ? getInstanceName(configFile) : "";
+        for(const auto& regulator : regulators) {
+            if(regulator->getName() == name) {
+                std::cerr << "[Main] Config files need distinct names (" << configFile << ")" << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+        regulators.emplace_back(new Regulator(configFile, name, steadyClockMs));
+    }
 
-    // read config variables from config file
-    bool status = cfg.loadConfig();
-    if(!status) {
-        std::cerr << "[Config] Failed to open config.txt file!" << std::endl;
-        std::cout << " --> using default settings" << std::endl;
+    // handle signals for clean Ctrl+C close up (before any thread is spawned)
+    if(!setupSignalHandling()) {
+        std::cerr << "[Main] Failed to setup signal handling!" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // read config variables from the config files and print out the overview
+    bool traceEnabled = false, selfProfileEnabled = false;
+    for(size_t i = 0; i < regulators.size(); i++) {
+        Regulator& regulator = *regulators[i];
+        if(!regulator.loadConfig()) {
+            std::cerr << "[Config] Failed to open " << configFiles[i] << " file!" << std::endl;
+            std::cout << " --> using default settings" << std::endl;
+        }
+        if(!regulator.getName().empty()) {
+            std::cout << "\n[Main] Regulator " << regulator.getName() << " (" << configFiles[i] << ")";
+        }
+        regulator.getConfig().printConfig();
+        traceEnabled = traceEnabled || regulator.getConfig().isTraceEnabled();
+        selfProfileEnabled = selfProfileEnabled || regulator.getConfig().isSelfProfileEnabled();
+    }
+
+    if(printOnly) {
+        std::cout << "[Main] Peak RSS: " << getPeakRss() << " kB" << std::endl;
+        return EXIT_SUCCESS;
+    }
+    setTraceEnabled(traceEnabled);
+    setTraceThreadName("Regulator");
+    setSelfProfileEnabled(selfProfileEnabled, regulators[0]->getConfig().getSelfProfileReportInterval());
+    registerProfileThread("Regulator");
+
+    // the hot restart hands over the sockets of a single regulator, there is only one slot detect relay
+    bool hotRestartEnabled = regulators[0]->getConfig().isHotRestartEnabled();
+    if(regulators.size() > 1) {
+        hotRestartEnabled = false;
+        std::cout << "[Main] Hot restart is only available with a single regulator" << std::endl;
+        for(const auto& regulator : regulators) {
+            if(regulator->getConfig().isSlotDetectControlEnabled()) {
+                std::cerr << "[Main] Slot detect control is only available with a single regulator!" << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
     }
 
-    // print out the config variable overview
-    cfg.printConfig();
+    bool status = true;
+    if(takeover) {
+        // continue with the sockets and state of the running process without a gap
+        status = regulators.size() == 1 && takeOverControl();
+        if(!status) {
+            std::cerr << "[Main] Failed to take over the control!" << std::endl;
+            shutdownApplication(EXIT_FAILURE);
+        }
+    } else {
+        // one slot detect relay for all regulators (with several regulators the control is disabled)
+        initSlotDetect(!regulators[0]->getConfig().isSlotDetectControlEnabled());
+
+        // start the PSU control and the meter source of every regulator
+        for(const auto& regulator : regulators) {
+            if(!regulator->setup()) {
+                shutdownApplication(EXIT_FAILURE);
+            }
+        }
 
-    // attempt to start the PSU controller 
-    status = psu.setup(cfg.getCanInterfaceName());
-    if(!status) {
-        terminateSignalHandler(EXIT_FAILURE);
+        // don't continue immediately
+        sleep_for(milliseconds(2200));          // wait a little bit 
     }
 
-    // attempt to start udp receiver to listen for power change messages
-    status = receiver.setup(cfg.getUdpPort());
-    if(!status) {
-        terminateSignalHandler(EXIT_FAILURE);
+    // identification instead of regulation (one regulator after the other)
+    if(autotune) {
+        for(const auto& regulator : regulators) {
+            AutoTune tuner(*regulator, terminationRequested);
+            status = tuner.run() && status;
+        }
+        shutdownApplication(status ? EXIT_SUCCESS : EXIT_FAILURE);
     }
 
-    // don't continue immediately
-    sleep_for(milliseconds(2200));          // wait a little bit 
-    std::cout << "[Main] Setup completed" << std::endl;
+    // allow a future process to take over
+    if(hotRestartEnabled && !hotRestart.listenForTakeover(regulators[0]->getConfig().getHotRestartSocket())) {
+        std::cerr << "[Main] Hot restart not available" << std::endl;
+    }
+    std::cout << "[Main] Setup completed (" << regulators.size() << " regulator" << (regulators.size() > 1 ? "s" : "")
+                << ", peak RSS " << getPeakRss() << " kB)" << std::endl;
+
+    // the steady state must not allocate (counted in builds with ALLOC_AUDIT)
+    armAllocAudit();
+
+    // enter the main application loop, the regulators
+    RegulatorExit reason = runRegulators();
+    if(reason == REGULATOR_EXIT_HANDOVER) {
+        // the new process controls the PSU now --> leave without touching it
+        std::cout << "[Main] --> Control handed over, exit now" << std::endl;
+        detachApplication();
+        return EXIT_SUCCESS;
+    }
 
-    // enter the main application loop, the regulator
-    powerRegulation();
-    std::cout << "[Main] --> Scheduled Application Exit now" << std::endl;
+    if(reason == REGULATOR_EXIT_SCHEDULED) {
+        std::cout << "[Main] --> Scheduled Application Exit now" << std::endl;
+    }
+
+    int exitCode = EXIT_SUCCESS;
+    #ifdef _ALLOC_AUDIT
+        long allocations = getAllocAuditCount();
+        std::cout << "[AllocAudit] " << allocations << " heap allocations in the steady state" << std::endl;
+        if(allocations > 0) {
+            exitCode = EXIT_FAILURE;
+        }
+    #endif
 
     // close up
-    terminateSignalHandler(EXIT_SUCCESS);
+    shutdownApplication(exitCode);
 
     return EXIT_SUCCESS;
 }
 
-void terminateSignalHandler(int code) {
-    // shutdown sockets, threads and queue
-    receiver.closeUp();
-    psu.shutdown();
-    cmdQueue.clear();
-    exit(code);
-}
+// blocks the termination signals in all threads and creates a signalfd to handle them in the regulator loop
+bool setupSignalHandling() {
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    sigaddset(&mask, SIGUSR1);
+    sigaddset(&mask, SIGUSR2);
+    if(pthread_sigmask(SIG_BLOCK, &mask, NULL) != 0) {
+        return false;
+    }
 
-void powerRegulation() {
-    PowerState latestPowerState;
-    short error = 0;
+    signalFd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    return signalFd >= 0;
+}
 
-    // main loop of the power regulator
-    while(!scheduledClose()) 
-    {
-        // check for new command on the queue
-        if(!cmdQueue.tryPop(latestPowerState)) {
-            sleep_for(milliseconds(100));       // avoid buisy waiting with small idle
-            continue;
+// checks for pending signals without blocking. returns true if the application should close up
+// SIGUSR1 writes the recorded trace points, SIGUSR2 prints the self profile
+bool terminationRequested() {
+    struct signalfd_siginfo info;
+    bool terminate = false;
+    countSyscalls();
+    while(read(signalFd, &info, sizeof(info)) == sizeof(info)) {
+        countSyscalls();
+        // dump the trace points on demand
+        if(info.ssi_signo == SIGUSR1) {
+            if(!isTraceEnabled()) {
+                std::cout << "[Main] Trace points are disabled (trace-enabled)" << std::endl;
+            } else if(writeTrace(TRACE_FILE)) {
+                std::cout << "[Main] Trace written to " << TRACE_FILE << std::endl;
+            } else {
+                std::cerr << "[Main] Failed to write trace to " << TRACE_FILE << std::endl;
+            }
         }
-
-        // calculate error (absolute difference from target value)
-        // don't try to compensate for very small errors
-        error = cfg.getTargetGridPower() - latestPowerState.tasmotaPowerCmd;
-        std::cout << "[Regulator] Processing received power state: grid-load = " 
-                    << latestPowerState.tasmotaPowerCmd << "W, deviation = " 
-                    << error << "W, AC-charge = "
-                    << latestPowerState.psuAcInputPower << "W" << std::endl;
-
-        if(abs(error) < cfg.getRegulatorErrorThreshold()) {
-            continue;
+        // costs of the own threads on demand
+        if(info.ssi_signo == SIGUSR2) {
+            printSelfProfile();
         }
-        short powerCmd = latestPowerState.psuAcInputPower + error;
-
-        // set bounds for allowed power commands (min and max)
-        if(powerCmd > cfg.getMaxChargePower()) {
-            powerCmd = cfg.getMaxChargePower();
+        if(info.ssi_signo == SIGINT || info.ssi_signo == SIGTERM) {
+            std::cout << "[Main] Received signal " << info.ssi_signo << " --> close up" << std::endl;
+            terminate = true;
         }
+    }
+    return terminate;
+}
 
-        if(powerCmd < cfg.getMinChargePower()) {
-            powerCmd = 0;
-        }
+// continues the control with the sockets and state received from the running process
+bool takeOverControl() {
+    Regulator& regulator = *regulators[0];
+    HandoverState state;
+    std::vector<int> fds;
+    if(!hotRestart.takeOver(regulator.getConfig().getHotRestartSocket(), state, fds)) {
+        return false;
+    }
 
-        // translate power command into max current command. use current output voltage for calculation
-        float maxCurrentCmd = calculateCurrentBasedOnPower(static_cast<float>(powerCmd), psu.getCurrentOutputVoltage());
+    if(!regulator.takeOver(state, fds)) {
+        return false;
+    }
+    initSlotDetect(state.slotDetectOn != 0);
+
+    // workers are running --> let the previous process exit
+    hotRestart.confirmTakeover();
+    std::cout << "[Main] Took over control from the previous process (current command " << state.lastCurrentCmd << "A)" << std::endl;
+
+    return true;
+}
 
-        // send max current command to the PSU and idle a short time 
-        psu.setMaxCurrent(maxCurrentCmd, false);
+// sends the sockets and state to a new process. returns false if the new process did not take over
+bool handOverControl() {
+    std::cout << "[Main] Takeover requested by a new process" << std::endl;
 
-        std::cout << "[Regulator] Target AC charger power --> " << powerCmd << "W" << std::endl;
+    HandoverState state;
+    std::vector<int> fds;
+    regulators[0]->getHandoverState(state, fds);
 
-        sleep_for(milliseconds(cfg.getRegulatorIdleTime()));
+    // keep on regulating if the new process failed
+    if(!hotRestart.handOver(state, fds)) {
+        std::cerr << "[Main] Handover failed --> continue" << std::endl;
+        return false;
     }
+
+    return true;
 }
 
-// Helper function to round float values on decimals
-float round(float var)
-{
-    float value = (int)(var * 100 + .5);
-    return static_cast<float>(value) / 100;
+// stops all threads and closes the own socket copies without touching the PSU
+void detachApplication() {
+    hotRestart.closeUp();
+    for(const auto& regulator : regulators) {
+        regulator->detach();
+    }
 }
 
-float calculateCurrentBasedOnPower(float power, float batteryVoltage) {
-    // Determine expected AC/DC conversion efficiency based on power command
-    float eff = 0.0f;
-    if(power >= 1 && power < 461) {
-        eff = 0.88f;
-    } else if(power >= 461 && power < 704) {
-        eff = 0.937f;
-    } else if(power >= 704 && power < 1050) {
-        eff = 0.952f;
-    } else if(power >= 1050) {
-        eff = 0.96f;
+void shutdownApplication(int code) {
+    hotRestart.closeUp();
+
+    // shutdown sockets, threads and queues and persist the battery counters for the next run
+    for(const auto& regulator : regulators) {
+        regulator->shutdown();
     }
+    releaseSlotDetect();
+    std::cout << "[Main] Peak RSS: " << getPeakRss() << " kB" << std::endl;
+    exit(code);
+}
 
-    // calculate and round the current 
-    float result = round(0.9876f * eff * power / batteryVoltage);
+// initializes the slot detect relay shared by all regulators (on raspberry pi only)
+void initSlotDetect(bool on) {
+    if(SlotDetect::available) {
+        SlotDetect::init(on);
+        std::cout << "[Main] Slot detect initialized" << std::endl;
+    }
+    slotDetectInitialized = true;
+}
 
-    return result;
+// disables slot detect after the last regulator exited (not if the relay was never initialized, e.g. failed takeover)
+void releaseSlotDetect() {
+    if(SlotDetect::available && slotDetectInitialized) {
+        SlotDetect::write(false);
+        std::cout << "[Main] Slot detect disabled before exit" << std::endl;
+    }
 }
 
+// shared loop of all regulators. sleeps until the next regulator is ready for a command
+RegulatorExit runRegulators() {
+    while(true) 
+    {
+        // a regulator with a scheduled exit closes up on its own, the application exits with the last one
+        for(size_t i = 0; i < regulators.size(); ) {
+            if(!regulators[i]->isScheduledExit()) {
+                i++;
+                continue;
+            }
+            if(regulators.size() == 1) {
+                return REGULATOR_EXIT_SCHEDULED;
+            }
+            // only stops its own PSUs, the slot detect relay stays on for the other regulators
+            std::cout << "[Main] --> Scheduled exit of regulator " << regulators[i]->getName() << std::endl;
+            regulators[i]->shutdown();
+            regulators.erase(regulators.begin() + i);
+        }
+
+        if(terminationRequested()) {
+            return REGULATOR_EXIT_SIGNAL;
+        }
 
+        if(hotRestart.pollTakeoverRequest() && handOverControl()) {
+            return REGULATOR_EXIT_HANDOVER;
+        }
+
+        // CPU time, wakeups and syscalls of the own threads
+        sampleSelfProfile(steadyClockMs());
+
+        // process the latest meter reading of every regulator that is not idling after a command
+        bool processed = false;
+        for(const auto& regulator : regulators) {
+            processed = regulator->step() || processed;
+        }
+        if(processed) {
+            continue;
+        }
+
+        // avoid buisy waiting: idle until the next regulator is ready, at most MAIN_LOOP_IDLE_TIME
+        long long currentTime = steadyClockMs();
+        long long wakeUpTime = currentTime + MAIN_LOOP_IDLE_TIME;
+        for(const auto& regulator : regulators) {
+            long long readyTime = regulator->getNextCommandTime();
+            if(readyTime > currentTime) {
+                wakeUpTime = std::min(wakeUpTime, readyTime);
+            }
+        }
+        sleep_for(milliseconds(wakeUpTime - currentTime));
+        countSyscalls();
+    }
+}
+
+// name of a regulator derived from its config file (e.g. garage.txt --> garage)
+std::string getInstanceName(const std::string& configFile) {
+    std::string name = configFile.substr(configFile.find_last_of('/') + 1);
+    return name.substr(0, name.find_last_of('.'));
+}
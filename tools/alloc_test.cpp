@@ -0,0 +1,279 @@
+/*
+    File: alloc_test.cpp
+    Allocation test of the regulation steady state (ctest: alloc_test). A regulator runs with a
+    simulated PSU and meter on the injected clocks for a simulated hour. The household load and the
+    solar surplus vary, so the regulator goes through fast and slow reading intervals, small and large
+    commands, max and min power and the charge stages. After a warm-up every heap allocation is
+    counted by the allocation audit hooks, the test fails if there was any
+
+    usage: alloc_test [-m <simulated minutes>] [-v]
+           -v keeps the log of the regulator on stdout
+
+    written by Elias Geiger
+*/
+
+#include <iostream>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <ctime>
+
+#include <unistd.h>
+#include <ftw.h>
+
+#include "Regulator.h"
+#include "AllocAudit.h"
+
+// simulation step and the time before the audit is armed (first commands, lazy buffers of the log)
+#define SIM_TICK 10                     // in milliseconds
+#define SIM_WARMUP_TIME 120000          // in milliseconds
+#define SIM_DEFAULT_MINUTES 60
+
+// simulated PSU response: dead time and first order lag of the AC input power
+#define SIM_PSU_DELAY 500               // in milliseconds
+#define SIM_PSU_TAU 800                 // in milliseconds
+#define SIM_PSU_EFFICIENCY 0.93f
+#define SIM_BATTERY_VOLTAGE 51.0f
+
+// simulated clocks
+static long long simTime = 0;
+static time_t simWallStart = 0;
+
+long long simClockMs() {
+    return simTime;
+}
+
+time_t simWallTime() {
+    return simWallStart + static_cast<time_t>(simTime / 1000);
+}
+
+// PSU with a fixed battery voltage, the AC input follows the current command after the dead time
+class SimPsu : public PsuInterface
+{
+    float m_voltageCmd, m_currentCmd, m_pendingCurrent;
+    long long m_pendingTime;
+    float m_inputPower;
+    bool m_slotDetectOn;
+    unsigned long m_commandCount;
+
+public:
+    SimPsu() : m_voltageCmd(0.0f), m_currentCmd(0.0f), m_pendingCurrent(0.0f), m_pendingTime(-1),
+                m_inputPower(0.0f), m_slotDetectOn(true), m_commandCount(0) {}
+
+    bool setup(const std::vector<std::string>&) override { return true; }
+    void shutdown() override {}
+    void detach() override {}
+
+    bool setMaxVoltage(float voltage, bool) override {
+        m_voltageCmd = voltage;
+        return true;
+    }
+
+    bool setMaxCurrent(float current, bool) override {
+        m_pendingCurrent = current;
+        m_pendingTime = simTime + SIM_PSU_DELAY;
+        m_commandCount++;
+        return true;
+    }
+
+    void enterStandby() override {
+        setMaxCurrent(0.0f, false);
+        m_slotDetectOn = false;
+    }
+
+    bool wakeUp() override {
+        bool wasOff = !m_slotDetectOn;
+        m_slotDetectOn = true;
+        return wasOff;
+    }
+
+    // advances the response by one simulation tick
+    void advance() {
+        if(m_pendingTime >= 0 && simTime >= m_pendingTime) {
+            m_currentCmd = m_pendingCurrent;
+            m_pendingTime = -1;
+        }
+        float target = m_currentCmd * SIM_BATTERY_VOLTAGE / SIM_PSU_EFFICIENCY;
+        m_inputPower += (target - m_inputPower) * (1.0f - std::exp(-static_cast<float>(SIM_TICK) / SIM_PSU_TAU));
+    }
+
+    float getCurrentInputPower() const override { return m_inputPower; }
+    float getCurrentOutputPower() const override { return m_inputPower * SIM_PSU_EFFICIENCY; }
+    float getCurrentOutputVoltage() const override { return SIM_BATTERY_VOLTAGE; }
+    float getCurrentOutputCurrent() const override { return getCurrentOutputPower() / SIM_BATTERY_VOLTAGE; }
+    float getMaxTemperature() const override { return 40.0f; }
+    float getLastCurrentCmd() override { return m_pendingTime >= 0 ? m_pendingCurrent : m_currentCmd; }
+    float getLastVoltageCmd() const override { return m_voltageCmd; }
+    bool isSlotDetectOn() override { return m_slotDetectOn; }
+    long getWakeTime() const override { return SD_WAKE_TIME; }
+    long getMeasuredWakeTime() override { return 0; }
+    void restoreWakeTime(long) override {}
+
+    unsigned long getCommandCount() const { return m_commandCount; }
+};
+
+// meter that is read at the interval the regulator asks for
+class SimMeter : public MeterSource
+{
+    int m_interval;
+
+public:
+    SimMeter() : m_interval(0) {}
+
+    bool setup() override { return true; }
+    void closeUp() override {}
+    void requestMeterInterval(int interval) override { m_interval = interval; }
+    float getBatteryTemperature(long) const override { return 25.0f; }
+
+    int getInterval() const { return m_interval > 0 ? m_interval : 1000; }
+};
+
+// function prototypes
+bool writeConfig(const char*);
+float getHouseholdPower(long long, unsigned int&);
+int removeEntry(const char*, const struct stat*, int, struct FTW*);
+void printUsage();
+
+// ----- Main Function ----- //
+int main(int argc, char **argv)
+{
+    long minutes = SIM_DEFAULT_MINUTES;
+    bool verbose = false;
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+            minutes = atol(argv[++i]);
+        } else if(strcmp(argv[i], "-v") == 0) {
+            verbose = true;
+        } else {
+            printUsage();
+            return EXIT_FAILURE;
+        }
+    }
+    if(minutes <= 0) {
+        printUsage();
+        return EXIT_FAILURE;
+    }
+
+    // the state files of the regulator go into a temporary directory
+    char directory[] = "/tmp/alloc-test-XXXXXX";
+    if(mkdtemp(directory) == nullptr || chdir(directory) < 0 || !writeConfig("alloc-test.txt")) {
+        std::cerr << "[AllocTest] Failed to prepare " << directory << std::endl;
+        return EXIT_FAILURE;
+    }
+    if(!verbose && freopen("/dev/null", "w", stdout) == nullptr) {
+        return EXIT_FAILURE;
+    }
+
+    // simulated wall clock on a fixed monday morning (same load profile slots in every run)
+    struct tm start;
+    memset(&start, 0, sizeof(start));
+    start.tm_year = 2024 - 1900;
+    start.tm_mon = 5;
+    start.tm_mday = 3;
+    start.tm_hour = 10;
+    start.tm_isdst = -1;
+    simWallStart = mktime(&start);
+
+    ConfigFile cfg("alloc-test.txt");
+    cfg.loadConfig();
+    SimPsu psu;
+    SimMeter meter;
+    Regulator regulator(cfg, psu, meter, "alloc", simClockMs, simWallTime);
+    regulator.loadConfig();
+    if(!regulator.setup()) {
+        std::cerr << "[AllocTest] Failed to set up the regulator" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    long long endTime = SIM_WARMUP_TIME + minutes * 60000LL;
+    long long nextReadingTime = 0;
+    unsigned int noiseState = 12345;
+    unsigned long readings = 0, decisions = 0, commandsAtArm = 0;
+    bool armed = false;
+    for(simTime = 0; simTime < endTime; simTime += SIM_TICK) {
+        psu.advance();
+
+        // the meter sees the household, the solar surplus and the charger
+        if(simTime >= nextReadingTime) {
+            PowerState reading;
+            reading.tasmotaPowerCmd = static_cast<short>(std::lround(getHouseholdPower(simTime, noiseState) + psu.getCurrentInputPower()));
+            reading.psuAcInputPower = static_cast<short>(std::lround(psu.getCurrentInputPower()));
+            regulator.getQueue().push(reading);
+            regulator.getWatchdog().feed();
+            nextReadingTime = simTime + meter.getInterval();
+            readings++;
+        }
+
+        if(regulator.step()) {
+            decisions++;
+        }
+
+        // everything allocated until here belongs to the startup
+        if(!armed && simTime >= SIM_WARMUP_TIME) {
+            fflush(stdout);
+            armAllocAudit();
+            armed = true;
+            commandsAtArm = psu.getCommandCount();
+        }
+    }
+    long allocations = getAllocAuditCount();
+    disarmAllocAudit();
+
+    regulator.shutdown();
+    fprintf(stderr, "[AllocTest] %ld simulated minutes: %lu readings, %lu decisions, %lu commands, %ld heap allocations\n",
+            minutes, readings, decisions, psu.getCommandCount() - commandsAtArm, allocations);
+
+    // remove the state files
+    if(chdir("/") == 0) {
+        nftw(directory, removeEntry, 8, FTW_DEPTH | FTW_PHYS);
+    }
+
+    return allocations == 0 && decisions > 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// config of the regulator: defaults with the charge stages, without the threads that need a real meter
+bool writeConfig(const char* fileName) {
+    FILE* file = fopen(fileName, "w");
+    if(file == nullptr) {
+        return false;
+    }
+    fprintf(file, "can-interface: sim0\n");
+    fprintf(file, "charge-stages-enabled: true\n");
+    fprintf(file, "energy-ledger-enabled: false\n");
+    fprintf(file, "hot-restart-enabled: false\n");
+    fprintf(file, "self-profile-enabled: false\n");
+    fclose(file);
+    return true;
+}
+
+// grid power without the charger: a slowly varying surplus with noise and recurring load steps
+float getHouseholdPower(long long timeMs, unsigned int& noiseState) {
+    float seconds = timeMs / 1000.0f;
+    float surplus = 450.0f + 350.0f * std::sin(seconds * 2.0f * static_cast<float>(M_PI) / 900.0f);
+    float load = 250.0f;
+
+    // a kettle for two minutes every seven minutes, a short spike every 50 seconds
+    long long minute = timeMs / 60000;
+    if(minute % 7 == 3 || minute % 7 == 4) {
+        load += 1800.0f;
+    }
+    if(timeMs % 50000 < 3000) {
+        load += 400.0f;
+    }
+
+    // meter noise
+    noiseState = noiseState * 1103515245u + 12345u;
+    float noise = static_cast<float>((noiseState >> 16) % 21) - 10.0f;
+
+    return load - surplus + noise;
+}
+
+int removeEntry(const char* path, const struct stat*, int, struct FTW*) {
+    return remove(path);
+}
+
+void printUsage() {
+    std::cout << "usage: alloc_test [-m <simulated minutes>] [-v]" << std::endl;
+}
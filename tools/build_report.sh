@@ -0,0 +1,54 @@
+#!/bin/sh
+# File: build_report.sh
+# Builds the regulator with the runtime config file and with every compile time profile
+# in profiles/ and reports the binary size and the peak RSS of each build variant.
+#
+# usage: tools/build_report.sh [run-seconds]
+#   without run-seconds the RSS is measured with --print-config (startup footprint, no PSU needed)
+#   with run-seconds the app runs that long on the target (CAN and meter connected) before it is stopped
+#
+# written by Elias Geiger
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+OUT="$ROOT/_report"
+RUN_SECONDS=$1
+
+mkdir -p "$OUT"
+printf "%-20s %10s %10s %10s %10s %12s\n" "variant" "file" "text" "data" "bss" "peak-rss-kB"
+
+report() {
+    variant=$1
+    profile=$2
+    build="$OUT/$variant"
+
+    if ! cmake -S "$ROOT" -B "$build" -DCONFIG_PROFILE="$profile" > "$build.log" 2>&1 ||
+       ! cmake --build "$build" --target regulatorApp -j"$(nproc)" >> "$build.log" 2>&1; then
+        echo "$variant: build failed (see $build.log)"
+        return
+    fi
+    binary="$build/bin/regulatorApp"
+
+    # measure in a scratch directory with the config file (ignored by the profiles)
+    run="$build/run"
+    mkdir -p "$run"
+    cp "$ROOT/bin/config.txt" "$run/"
+    if [ -z "$RUN_SECONDS" ]; then
+        rss=$(cd "$run" && "$binary" --print-config 2>/dev/null | sed -n 's/^\[Main\] Peak RSS: \([0-9]*\) kB/\1/p')
+    else
+        (cd "$run" && exec "$binary" > "$run/app.log" 2>&1) &
+        pid=$!
+        sleep "$RUN_SECONDS"
+        rss=$(sed -n 's/^VmHWM:[[:space:]]*\([0-9]*\) kB/\1/p' "/proc/$pid/status" 2>/dev/null)
+        kill -INT "$pid" 2>/dev/null
+        wait "$pid"
+    fi
+
+    fileSize=$(stat -c %s "$binary")
+    set -- $(size "$binary" | tail -n 1)
+    printf "%-20s %10s %10s %10s %10s %12s\n" "$variant" "$fileSize" "$1" "$2" "$3" "${rss:-n/a}"
+}
+
+report "config-file" ""
+for profile in "$ROOT"/profiles/*.h; do
+    report "profile-$(basename "$profile" .h)" "$profile"
+done
@@ -0,0 +1,142 @@
+/*
+    File: inverter_stub.cpp
+    Local stand-in for a battery discharge inverter to test the discharge channel of the regulator app.
+    Receives the setpoints, prints every change and falls back to zero without keep alive.
+    Optionally simulates the energy meter: the grid power (household load minus discharge power)
+    is sent to the UDP port of the regulator app in the interval the regulator replies (like the meter script)
+
+    usage: inverter_stub [-p <inverter-port>] [-m <meter-port> <household-load>]
+
+    written by Elias Geiger
+*/
+
+#include <iostream>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <unistd.h>
+#include <poll.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#include "default-conf.h"
+
+// the setpoint falls back to zero after this many missing keep alive periods
+#define STUB_KEEP_ALIVE_MISSES 3
+
+// period of the simulated meter readings until the regulator replies another one in ms
+#define STUB_METER_INTERVAL 1000
+
+// function prototypes
+long long nowMs();
+void printUsage();
+
+// ----- Main Function ----- //
+int main(int argc, char **argv)
+{
+    int inverterPort = INVERTER_PORT;
+    int meterPort = 0, householdLoad = 0;
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            inverterPort = atoi(argv[++i]);
+        } else if(strcmp(argv[i], "-m") == 0 && i + 2 < argc) {
+            meterPort = atoi(argv[++i]);
+            householdLoad = atoi(argv[++i]);
+        } else {
+            printUsage();
+            return EXIT_FAILURE;
+        }
+    }
+
+    // socket for the setpoints (the meter readings are sent from it as well)
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if(sock < 0) {
+        std::cerr << "Failed to create udp socket!" << std::endl;
+        return EXIT_FAILURE;
+    }
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(static_cast<uint16_t>(inverterPort));
+    if(bind(sock, (const struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        std::cerr << "Failed to bind UDP socket to port " << inverterPort << "!" << std::endl;
+        close(sock);
+        return EXIT_FAILURE;
+    }
+
+    struct sockaddr_in meterAddr;
+    memset(&meterAddr, 0, sizeof(meterAddr));
+    meterAddr.sin_family = AF_INET;
+    meterAddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    meterAddr.sin_port = htons(static_cast<uint16_t>(meterPort));
+
+    std::cout << "[Stub] Inverter listening on port " << inverterPort;
+    if(meterPort > 0) {
+        std::cout << ", meter readings to port " << meterPort << " (household load " << householdLoad << "W)";
+    }
+    std::cout << std::endl;
+
+    struct pollfd pfd;
+    pfd.fd = sock;
+    pfd.events = POLLIN;
+
+    int dischargePower = 0;
+    long long lastReceiveTime = nowMs();
+    long long lastMeterTime = 0;
+    int meterInterval = STUB_METER_INTERVAL;
+    char buffer[32];
+    while(true) {
+        if(poll(&pfd, 1, 50) > 0) {
+            ssize_t bytesRead = recv(sock, buffer, sizeof(buffer) - 1, 0);
+            if(bytesRead > 0) {
+                buffer[bytesRead] = '\0';
+
+                // reply of the regulator to a meter reading
+                if(strncmp(buffer, "interval ", 9) == 0) {
+                    int interval = atoi(buffer + 9);
+                    if(interval >= 100 && interval != meterInterval) {
+                        printf("[Stub] Meter interval %dms --> %dms\n", meterInterval, interval);
+                        meterInterval = interval;
+                    }
+                    continue;
+                }
+
+                int setpoint = atoi(buffer);
+                setpoint = setpoint < 0 ? 0 : setpoint;
+                if(setpoint != dischargePower) {
+                    printf("[Stub] Discharge power %dW --> %dW\n", dischargePower, setpoint);
+                    dischargePower = setpoint;
+                }
+                lastReceiveTime = nowMs();
+            }
+        }
+
+        // like a real inverter: no discharge without a controller
+        long long currentTime = nowMs();
+        if(dischargePower != 0 && currentTime - lastReceiveTime > STUB_KEEP_ALIVE_MISSES * INVERTER_KEEP_ALIVE_TIME) {
+            printf("[Stub] Setpoint not refreshed for %lldms --> fall back to 0W\n", currentTime - lastReceiveTime);
+            dischargePower = 0;
+        }
+
+        if(meterPort > 0 && currentTime - lastMeterTime >= meterInterval) {
+            lastMeterTime = currentTime;
+            int len = snprintf(buffer, sizeof(buffer), "%d", householdLoad - dischargePower);
+            sendto(sock, buffer, len, 0, (const struct sockaddr*)&meterAddr, sizeof(meterAddr));
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
+
+long long nowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void printUsage() {
+    std::cout << "usage: inverter_stub [-p <inverter-port>] [-m <meter-port> <household-load>]" << std::endl;
+}
@@ -0,0 +1,266 @@
+/*
+    File: io_bench.cpp
+    Micro-benchmark of the socket I/O paths of the regulator app. Frames of CAN size are sent in
+    bursts and received again, once with the classic calls (write, poll + read per frame as the CAN
+    worker does) and once with io_uring (batched fixed writes, multishot receive). Prints the
+    syscalls and the CPU time (user + system) per thousand frames
+
+    usage: io_bench [-n <frames>] [-b <burst>] [-i <can-interface>]
+           without an interface two UDP sockets on loopback are used, with one (e.g. vcan0) two CAN sockets
+
+    written by Elias Geiger
+*/
+
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+#include <unistd.h>
+#include <poll.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <linux/can.h>
+#include <linux/can/raw.h>
+
+#include "IoRing.h"
+
+#define BENCH_MAX_BURST 16
+#define BENCH_RX_BUFFERS 64
+#define BENCH_WAIT_TIMEOUT 1000     // in milliseconds
+
+enum BenchRequest
+{
+    BENCH_RECV = 1,
+    BENCH_WRITE,
+    BENCH_BUFFERS
+};
+
+// result of one run
+struct BenchResult
+{
+    unsigned long syscalls;
+    double cpuMs;
+    double wallMs;
+};
+
+// function prototypes
+bool openUdpPair(int&, int&);
+bool openCanPair(const char*, int&, int&);
+bool runClassic(int, int, int, int, BenchResult&);
+bool runRing(int, int, int, int, BenchResult&);
+double clockMs(clockid_t);
+void printResult(const char*, int, const BenchResult&);
+void printUsage();
+
+// ----- Main Function ----- //
+int main(int argc, char **argv)
+{
+    int frames = 100000, burst = 4;
+    const char* interfaceName = nullptr;
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            frames = atoi(argv[++i]);
+        } else if(strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+            burst = atoi(argv[++i]);
+        } else if(strcmp(argv[i], "-i") == 0 && i + 1 < argc) {
+            interfaceName = argv[++i];
+        } else {
+            printUsage();
+            return EXIT_FAILURE;
+        }
+    }
+    if(frames <= 0 || burst <= 0 || burst > BENCH_MAX_BURST) {
+        std::cerr << "Frames must be positive, burst between 1 and " << BENCH_MAX_BURST << std::endl;
+        return EXIT_FAILURE;
+    }
+    frames -= frames % burst;
+
+    int txSocket = -1, rxSocket = -1;
+    bool opened = interfaceName != nullptr ? openCanPair(interfaceName, txSocket, rxSocket) : openUdpPair(txSocket, rxSocket);
+    if(!opened) {
+        return EXIT_FAILURE;
+    }
+
+    printf("%d frames in bursts of %d via %s\n\n", frames, burst, interfaceName != nullptr ? interfaceName : "UDP loopback");
+    printf("%-10s %16s %16s %12s\n", "backend", "syscalls/1000", "cpu-ms/1000", "wall-ms");
+
+    BenchResult result;
+    if(runClassic(txSocket, rxSocket, frames, burst, result)) {
+        printResult("classic", frames, result);
+    }
+    if(runRing(txSocket, rxSocket, frames, burst, result)) {
+        printResult("io_uring", frames, result);
+    }
+
+    close(txSocket);
+    close(rxSocket);
+    return EXIT_SUCCESS;
+}
+
+// two connected UDP sockets on loopback
+bool openUdpPair(int& txSocket, int& rxSocket) {
+    txSocket = socket(AF_INET, SOCK_DGRAM, 0);
+    rxSocket = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(addr);
+    if(txSocket < 0 || rxSocket < 0 || bind(rxSocket, (struct sockaddr*)&addr, sizeof(addr)) < 0
+            || getsockname(rxSocket, (struct sockaddr*)&addr, &length) < 0
+            || connect(txSocket, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        std::cerr << "Failed to open the UDP sockets: " << strerror(errno) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// two raw sockets on the same CAN interface (frames are looped back to the other socket)
+bool openCanPair(const char* interfaceName, int& txSocket, int& rxSocket) {
+    txSocket = socket(PF_CAN, SOCK_RAW, CAN_RAW);
+    rxSocket = socket(PF_CAN, SOCK_RAW | SOCK_NONBLOCK, CAN_RAW);
+    struct ifreq ifr;
+    memset(&ifr, 0, sizeof(ifr));
+    strncpy(ifr.ifr_name, interfaceName, IFNAMSIZ - 1);
+    if(txSocket < 0 || rxSocket < 0 || ioctl(txSocket, SIOCGIFINDEX, &ifr) < 0) {
+        std::cerr << "CAN interface " << interfaceName << " not found!" << std::endl;
+        return false;
+    }
+    struct sockaddr_can addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.can_family = AF_CAN;
+    addr.can_ifindex = ifr.ifr_ifindex;
+    if(bind(txSocket, (struct sockaddr*)&addr, sizeof(addr)) < 0 || bind(rxSocket, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        std::cerr << "Failed to bind the CAN sockets to " << interfaceName << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// one write per frame, poll + read per received frame
+bool runClassic(int txSocket, int rxSocket, int frames, int burst, BenchResult& result) {
+    struct can_frame frame;
+    memset(&frame, 0, sizeof(frame));
+    frame.can_id = 0x108180FE | CAN_EFF_FLAG;
+    frame.can_dlc = 8;
+    struct pollfd pfd;
+    pfd.fd = rxSocket;
+    pfd.events = POLLIN;
+
+    unsigned long syscalls = 0;
+    double cpuStart = clockMs(CLOCK_PROCESS_CPUTIME_ID), wallStart = clockMs(CLOCK_MONOTONIC);
+    for(int sent = 0; sent < frames; sent += burst) {
+        for(int i = 0; i < burst; i++) {
+            frame.data[7] = static_cast<uint8_t>(sent + i);
+            syscalls++;
+            if(write(txSocket, &frame, sizeof(frame)) != sizeof(frame)) {
+                std::cerr << "[classic] Write failed: " << strerror(errno) << std::endl;
+                return false;
+            }
+        }
+        for(int received = 0; received < burst; ) {
+            syscalls += 2;
+            if(poll(&pfd, 1, BENCH_WAIT_TIMEOUT) <= 0) {
+                std::cerr << "[classic] Frames lost" << std::endl;
+                return false;
+            }
+            struct can_frame receivedFrame;
+            if(read(rxSocket, &receivedFrame, sizeof(receivedFrame)) == sizeof(receivedFrame)) {
+                received++;
+            }
+        }
+    }
+    result.syscalls = syscalls;
+    result.cpuMs = clockMs(CLOCK_PROCESS_CPUTIME_ID) - cpuStart;
+    result.wallMs = clockMs(CLOCK_MONOTONIC) - wallStart;
+    return true;
+}
+
+// writes of a burst submitted together, receives reaped from the multishot receive
+bool runRing(int txSocket, int rxSocket, int frames, int burst, BenchResult& result) {
+    static struct can_frame txFrames[BENCH_MAX_BURST];
+    static struct can_frame rxFrames[BENCH_RX_BUFFERS];
+    IoRing ring;
+    if(!ring.setup(2 * BENCH_RX_BUFFERS)) {
+        return false;
+    }
+    struct iovec txBuffers;
+    txBuffers.iov_base = txFrames;
+    txBuffers.iov_len = sizeof(txFrames);
+    if(!ring.registerBuffers(&txBuffers, 1)) {
+        return false;
+    }
+    ring.provideBuffers(rxFrames, sizeof(struct can_frame), BENCH_RX_BUFFERS, 1, 0, BENCH_BUFFERS);
+    ring.recvMultishot(rxSocket, 1, BENCH_RECV);
+    ring.submitAndWait(0);
+
+    for(int i = 0; i < BENCH_MAX_BURST; i++) {
+        memset(&txFrames[i], 0, sizeof(struct can_frame));
+        txFrames[i].can_id = 0x108180FE | CAN_EFF_FLAG;
+        txFrames[i].can_dlc = 8;
+    }
+
+    unsigned long startCalls = ring.getEnterCalls();
+    double cpuStart = clockMs(CLOCK_PROCESS_CPUTIME_ID), wallStart = clockMs(CLOCK_MONOTONIC);
+    for(int sent = 0; sent < frames; sent += burst) {
+        for(int i = 0; i < burst; i++) {
+            txFrames[i].data[7] = static_cast<uint8_t>(sent + i);
+            ring.writeFixed(txSocket, &txFrames[i], sizeof(struct can_frame), 0, BENCH_WRITE);
+        }
+
+        int received = 0, written = 0;
+        while(received < burst || written < burst) {
+            if(ring.submitAndWait(BENCH_WAIT_TIMEOUT) <= 0) {
+                std::cerr << "[io_uring] Frames lost" << std::endl;
+                return false;
+            }
+            struct io_uring_cqe cqe;
+            while(ring.popCompletion(cqe)) {
+                if(cqe.user_data == BENCH_WRITE) {
+                    if(cqe.res != sizeof(struct can_frame)) {
+                        std::cerr << "[io_uring] Write failed: " << strerror(-cqe.res) << std::endl;
+                        return false;
+                    }
+                    written++;
+                } else if(cqe.user_data == BENCH_RECV) {
+                    if(cqe.res == -EINVAL) {
+                        std::cerr << "[io_uring] Multishot receive not supported (kernel < 6.0)" << std::endl;
+                        return false;
+                    }
+                    if(cqe.flags & IORING_CQE_F_BUFFER) {
+                        unsigned bufferId = cqe.flags >> IORING_CQE_BUFFER_SHIFT;
+                        ring.provideBuffers(&rxFrames[bufferId], sizeof(struct can_frame), 1, 1, bufferId, BENCH_BUFFERS);
+                        received++;
+                    }
+                    if(!(cqe.flags & IORING_CQE_F_MORE)) {
+                        ring.recvMultishot(rxSocket, 1, BENCH_RECV);
+                    }
+                }
+            }
+        }
+    }
+    result.syscalls = ring.getEnterCalls() - startCalls;
+    result.cpuMs = clockMs(CLOCK_PROCESS_CPUTIME_ID) - cpuStart;
+    result.wallMs = clockMs(CLOCK_MONOTONIC) - wallStart;
+    return true;
+}
+
+double clockMs(clockid_t clock) {
+    struct timespec time;
+    clock_gettime(clock, &time);
+    return time.tv_sec * 1000.0 + time.tv_nsec / 1000000.0;
+}
+
+void printResult(const char* backend, int frames, const BenchResult& result) {
+    double perThousand = 1000.0 / frames;
+    printf("%-10s %16.0f %16.2f %12.0f\n", backend, result.syscalls * perThousand, result.cpuMs * perThousand, result.wallMs);
+}
+
+void printUsage() {
+    std::cout << "usage: io_bench [-n <frames>] [-b <burst>] [-i <can-interface>]" << std::endl;
+}
@@ -0,0 +1,146 @@
+/*
+    File: regulator_ledger.cpp
+    Command line tool for summarising the energy ledger files written by the regulator app
+
+    usage: regulator_ledger [-d <ledger-dir>] day <YYYY-MM-DD> [<from-hour> <to-hour>]
+           regulator_ledger [-d <ledger-dir>] month <YYYY-MM>
+
+    written by Elias Geiger
+*/
+
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "LedgerFormat.h"
+#include "default-conf.h"
+
+// function prototypes
+bool readHeader(const char*, int, int, int, LedgerFileHeader&);
+int summariseDay(const char*, int, int, int, int, int);
+int summariseMonth(const char*, int, int);
+void printTableHead(const char*);
+void printRecord(const char*, const LedgerRecord&);
+void printUsage();
+
+// ----- Main Function ----- //
+int main(int argc, char **argv)
+{
+    const char* directory = LEDGER_DIRECTORY;
+    int argIndex = 1;
+    if(argc > 2 && strcmp(argv[1], "-d") == 0) {
+        directory = argv[2];
+        argIndex = 3;
+    }
+
+    if(argc - argIndex < 2) {
+        printUsage();
+        return EXIT_FAILURE;
+    }
+
+    int year = 0, month = 0, day = 0;
+    if(strcmp(argv[argIndex], "day") == 0 && sscanf(argv[argIndex + 1], "%d-%d-%d", &year, &month, &day) == 3) {
+        int fromHour = 0, toHour = LEDGER_HOURS_PER_DAY - 1;
+        if(argc - argIndex >= 4) {
+            fromHour = atoi(argv[argIndex + 2]);
+            toHour = atoi(argv[argIndex + 3]);
+        }
+        if(fromHour < 0 || toHour >= LEDGER_HOURS_PER_DAY || fromHour > toHour) {
+            std::cerr << "Invalid hour range" << std::endl;
+            return EXIT_FAILURE;
+        }
+        return summariseDay(directory, year, month, day, fromHour, toHour);
+    }
+
+    if(strcmp(argv[argIndex], "month") == 0 && sscanf(argv[argIndex + 1], "%d-%d", &year, &month) == 2) {
+        return summariseMonth(directory, year, month);
+    }
+
+    printUsage();
+    return EXIT_FAILURE;
+}
+
+// reads only the header (index) of a daily file. returns false if there is no valid file
+bool readHeader(const char* directory, int year, int month, int day, LedgerFileHeader& header) {
+    char fileName[256];
+    getLedgerFileName(fileName, sizeof(fileName), directory, year, month, day);
+
+    int fd = open(fileName, O_RDONLY);
+    if(fd < 0) {
+        return false;
+    }
+    ssize_t bytesRead = pread(fd, &header, sizeof(header), 0);
+    close(fd);
+
+    return bytesRead == sizeof(header) && header.magic == LEDGER_MAGIC && header.version == LEDGER_VERSION;
+}
+
+// prints the hourly totals of a day within the given hour range
+int summariseDay(const char* directory, int year, int month, int day, int fromHour, int toHour) {
+    LedgerFileHeader header;
+    if(!readHeader(directory, year, month, day, header)) {
+        std::cerr << "No ledger data for " << year << "-" << month << "-" << day << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    LedgerRecord total;
+    memset(&total, 0, sizeof(total));
+
+    printTableHead("hour");
+    char label[16];
+    for(int hour = fromHour; hour <= toHour; hour++) {
+        const LedgerRecord& record = header.hourTotals[hour];
+        if(!(record.flags & LEDGER_RECORD_VALID)) {
+            continue;
+        }
+        snprintf(label, sizeof(label), "%02d:00", hour);
+        printRecord(label, record);
+        addLedgerRecord(total, record);
+    }
+    printRecord("total", total);
+
+    return EXIT_SUCCESS;
+}
+
+// prints the daily totals of a month
+int summariseMonth(const char* directory, int year, int month) {
+    LedgerRecord total;
+    memset(&total, 0, sizeof(total));
+
+    printTableHead("day");
+    char label[16];
+    for(int day = 1; day <= 31; day++) {
+        LedgerFileHeader header;
+        if(!readHeader(directory, year, month, day, header)) {
+            continue;
+        }
+        snprintf(label, sizeof(label), "%04d-%02d-%02d", year, month, day);
+        printRecord(label, header.dayTotal);
+        addLedgerRecord(total, header.dayTotal);
+    }
+    printRecord("total", total);
+
+    return EXIT_SUCCESS;
+}
+
+void printTableHead(const char* label) {
+    printf("%-10s %10s %10s %10s %10s %10s %10s %9s\n", label, "import-Wh", "export-Wh", "ac-in-Wh", "dc-out-Wh", "losses-Wh", "capt-Wh", "captured");
+}
+
+void printRecord(const char* label, const LedgerRecord& record) {
+    // share of the would-be-exported energy the charger captured
+    float wouldBeExported = record.capturedWh + record.gridExportWh;
+    float capturedShare = wouldBeExported > 0.0f ? record.capturedWh / wouldBeExported * 100.0f : 0.0f;
+
+    printf("%-10s %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f %8.1f%%\n", label, record.gridImportWh, record.gridExportWh, record.acInputWh,
+            record.dcOutputWh, record.acInputWh - record.dcOutputWh, record.capturedWh, capturedShare);
+}
+
+void printUsage() {
+    std::cout << "usage: regulator_ledger [-d <ledger-dir>] day <YYYY-MM-DD> [<from-hour> <to-hour>]" << std::endl;
+    std::cout << "       regulator_ledger [-d <ledger-dir>] month <YYYY-MM>" << std::endl;
+}
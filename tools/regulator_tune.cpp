@@ -0,0 +1,341 @@
+/*
+    File: regulator_tune.cpp
+    Offline tuning tool for the power regulator. Replays a recorded meter log (meter-log.csv)
+    through the regulator decision logic with a simple PSU response model and sweeps a grid
+    of regulator parameters in parallel on all CPU cores
+
+    usage: regulator_tune <meter-log.csv> [options]
+        --threshold <from:to:step>   regulator-error-threshold in W      (default 3:15:2)
+                                     (deadband-floor with --adaptive)
+        --idle <from:to:step>        regulator-idle-time in msec         (default 400:2000:200)
+        --min <from:to:step>         min-charge-power in W               (default 20:80:10)
+        --max-power <W>              max-charge-power                    (default 700)
+        --target <W>                 target-grid-power                   (default 0)
+        --psu-delay <msec>           dead time of the PSU response       (default 500)
+        --psu-tau <msec>             time constant of the PSU response   (default 800)
+        --adaptive <W>               adaptive deadband with this ceiling (default off)
+        --sigma <factor>             deadband-sigma-factor               (default 2.0)
+        --threads <n>                number of worker threads            (default all cores)
+        --top <n>                    number of ranked results to print   (default 20)
+
+    written by Elias Geiger
+*/
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include "Regulation.h"
+
+// recorded samples further apart than this start a new simulation segment (e.g. next day)
+#define SEGMENT_GAP_MS 60000
+
+// one recorded line of the meter log
+struct LogSample
+{
+    long long timeMs;
+    short gridPower;
+    short acInputPower;
+    float outputVoltage;
+};
+
+// a range of parameter values to sweep
+struct SweepRange
+{
+    int from, to, step;
+};
+
+// parameters of a single simulation run
+struct SimParams
+{
+    RegulatorSettings settings;
+    int idleTime;
+    int deadbandCeiling;        // 0 = static error threshold
+    float sigmaFactor;
+};
+
+// outcome of a single simulation run
+struct SimResult
+{
+    SimParams params;
+    double exportedWh;          // energy fed into the grid
+    double chargeImportWh;      // grid import caused by the charger
+    double chargedWh;           // AC energy drawn by the charger
+    long commandCount;
+};
+
+// PSU response model: dead time followed by a first order lag towards the commanded AC power
+struct PsuModel
+{
+    int delayMs, tauMs;
+};
+
+// command sent to the simulated PSU, effective after the dead time
+struct PendingCommand
+{
+    long long applyTime;
+    float target;
+};
+
+// function prototypes
+bool loadMeterLog(const char*, std::vector<LogSample>&);
+bool parseRange(const char*, SweepRange&);
+SimResult simulate(const std::vector<LogSample>&, const SimParams&, const PsuModel&);
+void printUsage();
+
+// ----- Main Function ----- //
+int main(int argc, char **argv)
+{
+    if(argc < 2) {
+        printUsage();
+        return EXIT_FAILURE;
+    }
+
+    // default sweep grid and model
+    SweepRange thresholdRange = {3, 15, 2}, idleRange = {400, 2000, 200}, minPowerRange = {20, 80, 10};
+    short maxChargePower = 700, targetGridPower = 0;
+    PsuModel model = {500, 800};
+    unsigned int threadCount = std::thread::hardware_concurrency();
+    size_t topCount = 20;
+    int deadbandCeiling = 0;
+    float sigmaFactor = 2.0f;
+
+    // parse command line options
+    for(int i = 2; i < argc; i++) {
+        bool valid = true;
+        if(i + 1 >= argc) {
+            valid = false;
+        } else if(strcmp(argv[i], "--threshold") == 0) {
+            valid = parseRange(argv[++i], thresholdRange);
+        } else if(strcmp(argv[i], "--idle") == 0) {
+            valid = parseRange(argv[++i], idleRange);
+        } else if(strcmp(argv[i], "--min") == 0) {
+            valid = parseRange(argv[++i], minPowerRange);
+        } else if(strcmp(argv[i], "--max-power") == 0) {
+            maxChargePower = static_cast<short>(atoi(argv[++i]));
+        } else if(strcmp(argv[i], "--target") == 0) {
+            targetGridPower = static_cast<short>(atoi(argv[++i]));
+        } else if(strcmp(argv[i], "--psu-delay") == 0) {
+            model.delayMs = atoi(argv[++i]);
+        } else if(strcmp(argv[i], "--psu-tau") == 0) {
+            model.tauMs = atoi(argv[++i]);
+        } else if(strcmp(argv[i], "--adaptive") == 0) {
+            deadbandCeiling = atoi(argv[++i]);
+            valid = deadbandCeiling > 0;
+        } else if(strcmp(argv[i], "--sigma") == 0) {
+            sigmaFactor = static_cast<float>(atof(argv[++i]));
+            valid = sigmaFactor > 0.0f;
+        } else if(strcmp(argv[i], "--threads") == 0) {
+            threadCount = static_cast<unsigned int>(atoi(argv[++i]));
+        } else if(strcmp(argv[i], "--top") == 0) {
+            topCount = static_cast<size_t>(atoi(argv[++i]));
+        } else {
+            valid = false;
+        }
+
+        if(!valid) {
+            std::cerr << "Invalid option " << argv[i] << std::endl;
+            printUsage();
+            return EXIT_FAILURE;
+        }
+    }
+    if(threadCount == 0) {
+        threadCount = 1;
+    }
+
+    // load the recorded data
+    std::vector<LogSample> samples;
+    if(!loadMeterLog(argv[1], samples)) {
+        std::cerr << "Failed to read meter log " << argv[1] << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "Loaded " << samples.size() << " samples from " << argv[1] << std::endl;
+
+    // build the parameter grid
+    std::vector<SimParams> grid;
+    for(int threshold = thresholdRange.from; threshold <= thresholdRange.to; threshold += thresholdRange.step) {
+        for(int idle = idleRange.from; idle <= idleRange.to; idle += idleRange.step) {
+            for(int minPower = minPowerRange.from; minPower <= minPowerRange.to; minPower += minPowerRange.step) {
+                SimParams params;
+                params.settings.targetGridPower = targetGridPower;
+                params.settings.minChargePower = static_cast<short>(minPower);
+                params.settings.maxChargePower = maxChargePower;
+                params.settings.errorThreshold = threshold;
+                params.settings.minCommandStep = 0;
+                params.settings.gain = 1.0f;
+                params.idleTime = idle;
+                params.deadbandCeiling = deadbandCeiling;
+                params.sigmaFactor = sigmaFactor;
+                grid.push_back(params);
+            }
+        }
+    }
+    std::cout << "Sweeping " << grid.size() << " parameter sets on " << threadCount << " threads ..." << std::endl;
+
+    // run one simulation per task. every task writes only its own result slot
+    std::vector<SimResult> results(grid.size());
+    std::atomic<size_t> nextTask(0);
+    std::vector<std::thread> workers;
+    for(unsigned int t = 0; t < threadCount; t++) {
+        workers.push_back(std::thread([&] () {
+            size_t task;
+            while((task = nextTask.fetch_add(1)) < grid.size()) {
+                results[task] = simulate(samples, grid[task], model);
+            }
+        }));
+    }
+    for(auto& worker : workers) {
+        worker.join();
+    }
+
+    // rank by wasted energy (export + charger import), then by number of commands
+    std::sort(results.begin(), results.end(), [] (const SimResult& a, const SimResult& b) {
+        double wasteA = a.exportedWh + a.chargeImportWh, wasteB = b.exportedWh + b.chargeImportWh;
+        if(wasteA != wasteB) {
+            return wasteA < wasteB;
+        }
+        return a.commandCount < b.commandCount;
+    });
+
+    // print the ranked table
+    printf("\n%4s %9s %9s %9s %12s %12s %12s %10s\n", "rank", "threshold", "idle-ms", "min-W", "export-Wh", "import-Wh", "charged-Wh", "commands");
+    for(size_t i = 0; i < results.size() && i < topCount; i++) {
+        const SimResult& r = results[i];
+        printf("%4zu %9d %9d %9d %12.1f %12.1f %12.1f %10ld\n", i + 1, r.params.settings.errorThreshold, r.params.idleTime,
+                r.params.settings.minChargePower, r.exportedWh, r.chargeImportWh, r.chargedWh, r.commandCount);
+    }
+
+    return EXIT_SUCCESS;
+}
+
+// reads the meter log written by the regulator app (format: unix-time-ms,grid-power,ac-input-power,output-voltage)
+bool loadMeterLog(const char* fileName, std::vector<LogSample>& samples) {
+    std::ifstream fileIn(fileName, std::ifstream::in);
+    if(!fileIn.is_open()) {
+        return false;
+    }
+
+    std::string line;
+    while(std::getline(fileIn, line)) {
+        LogSample sample;
+        if(sscanf(line.c_str(), "%lld,%hd,%hd,%f", &sample.timeMs, &sample.gridPower, &sample.acInputPower, &sample.outputVoltage) != 4) {
+            continue;
+        }
+        samples.push_back(sample);
+    }
+    fileIn.close();
+
+    // logs may be concatenated from several days
+    std::stable_sort(samples.begin(), samples.end(), [] (const LogSample& a, const LogSample& b) {
+        return a.timeMs < b.timeMs;
+    });
+
+    return !samples.empty();
+}
+
+// parses a range in the format from:to:step
+bool parseRange(const char* text, SweepRange& range) {
+    if(sscanf(text, "%d:%d:%d", &range.from, &range.to, &range.step) != 3) {
+        return false;
+    }
+    return range.step > 0 && range.from <= range.to;
+}
+
+// replays the recorded samples through the regulator decision logic
+SimResult simulate(const std::vector<LogSample>& samples, const SimParams& params, const PsuModel& model) {
+    SimResult result;
+    result.params = params;
+    result.exportedWh = 0.0;
+    result.chargeImportWh = 0.0;
+    result.chargedWh = 0.0;
+    result.commandCount = 0;
+
+    // commands still in the dead time of the PSU. a new command does not replace one in flight
+    // (idle time shorter than the PSU delay), each takes effect after the delay in order
+    std::deque<PendingCommand> pending;
+    float psuPower = 0.0f, psuTarget = 0.0f, lastCommand = 0.0f;
+    long long nextDecisionTime = 0;
+    RegulatorSettings settings = params.settings;
+    AdaptiveDeadband deadband(params.settings.errorThreshold, params.deadbandCeiling, params.sigmaFactor);
+
+    for(size_t i = 0; i < samples.size(); i++) {
+        const LogSample& sample = samples[i];
+
+        // start of a new segment --> take over the recorded PSU state
+        if(i == 0 || sample.timeMs - samples[i - 1].timeMs > SEGMENT_GAP_MS) {
+            psuPower = psuTarget = lastCommand = sample.acInputPower;
+            pending.clear();
+            nextDecisionTime = sample.timeMs;
+        } else {
+            // advance the PSU model until this sample
+            long long lastTime = samples[i - 1].timeMs;
+            while(!pending.empty() && pending.front().applyTime <= sample.timeMs) {
+                // command takes effect in between --> split the interval
+                float alpha = 1.0f - std::exp(-static_cast<float>(pending.front().applyTime - lastTime) / model.tauMs);
+                psuPower += (psuTarget - psuPower) * alpha;
+                psuTarget = pending.front().target;
+                lastTime = pending.front().applyTime;
+                pending.pop_front();
+            }
+            float alpha = 1.0f - std::exp(-static_cast<float>(sample.timeMs - lastTime) / model.tauMs);
+            psuPower += (psuTarget - psuPower) * alpha;
+        }
+
+        // the household load without the charger stays as recorded, the charger power is simulated
+        float baseLoad = static_cast<float>(sample.gridPower - sample.acInputPower);
+        float gridPower = baseLoad + psuPower;
+
+        // integrate the energy flows until the next sample (hold the current values)
+        if(i + 1 < samples.size() && samples[i + 1].timeMs - sample.timeMs <= SEGMENT_GAP_MS) {
+            double hours = (samples[i + 1].timeMs - sample.timeMs) / 3600000.0;
+            if(gridPower < 0.0f) {
+                result.exportedWh += -gridPower * hours;
+            } else {
+                result.chargeImportWh += std::min(gridPower, psuPower) * hours;
+            }
+            result.chargedWh += psuPower * hours;
+        }
+
+        PowerState state;
+        state.tasmotaPowerCmd = static_cast<short>(std::lround(gridPower));
+        state.psuAcInputPower = static_cast<short>(std::lround(psuPower));
+
+        // the noise statistics see every meter reading
+        if(params.deadbandCeiling > 0) {
+            deadband.addSample(state, settings.targetGridPower);
+            settings.errorThreshold = deadband.getErrorThreshold();
+            settings.minCommandStep = deadband.getMinCommandStep();
+        }
+
+        // the regulator idles after every command
+        if(sample.timeMs < nextDecisionTime) {
+            continue;
+        }
+
+        short powerCmd = 0;
+        if(!calculatePowerCommand(state, settings, static_cast<short>(lastCommand), powerCmd)) {
+            continue;
+        }
+
+        lastCommand = static_cast<float>(powerCmd);
+        pending.push_back({sample.timeMs + model.delayMs, lastCommand});
+        nextDecisionTime = sample.timeMs + params.idleTime;
+        result.commandCount++;
+    }
+
+    return result;
+}
+
+void printUsage() {
+    std::cout << "usage: regulator_tune <meter-log.csv> [--threshold from:to:step] [--idle from:to:step] [--min from:to:step]" << std::endl;
+    std::cout << "                      [--max-power W] [--target W] [--psu-delay msec] [--psu-tau msec] [--adaptive W] [--sigma factor]" << std::endl;
+    std::cout << "                      [--threads n] [--top n]" << std::endl;
+}
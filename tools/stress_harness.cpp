@@ -0,0 +1,510 @@
+/*
+    File: stress_harness.cpp
+    Load test of the ingestion paths of the regulator app. A regulator instance takes over a UDP
+    socket and a CAN socket from the harness (like a hot restart) and runs its own threads unchanged.
+    The harness blasts meter readings at the UDP listener and floods the CAN worker with frames of
+    mixed ids (status reports, acknowledgements, foreign devices) at increasing rates. Without a CAN
+    interface the bus is an in-memory socket pair, with -i a real (v)can interface is used.
+    Per rate it prints the sustained throughput, the drops, the depth of the command queue and of
+    the socket backlog and the latency until a reading is on the queue or a status frame is applied
+
+    usage: stress_harness [-d <seconds>] [-r <rate,rate,...>] [-c <poll-us>] [-p <udp-port>] [-i <can-interface>] [-u]
+           rates are per second, 0 = as fast as possible. -u uses the io_uring backend
+
+    written by Elias Geiger
+*/
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <ctime>
+
+#include <unistd.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <linux/can.h>
+#include <linux/can/raw.h>
+
+#include "Regulator.h"
+
+// the meter readings carry a sequence number (valid power values) to find their send time
+#define HARNESS_UDP_SEQUENCE_RANGE 20000
+
+// every n-th CAN frame is a probe: an input power report that carries a sequence number
+#define HARNESS_CAN_PROBE_INTERVAL 64
+#define HARNESS_CAN_PROBE_RANGE 1024
+#define HARNESS_CAN_PROBE_POWER 1000        // in watts, the sequence number is added in 1/1024 W
+
+// pacing of the generators and time the app gets to catch up after a phase
+#define HARNESS_PACING_PERIOD 1000000       // in nanoseconds
+#define HARNESS_DRAIN_TIME 300              // in milliseconds
+
+// measurements of one phase (one path at one rate)
+struct PhaseResult
+{
+    unsigned long sent;
+    unsigned long rejected;                 // CAN frames not accepted by the full socket
+    unsigned long processed;
+    unsigned long queueDrops;
+    unsigned long maxQueueDepth;
+    unsigned long maxBacklog;               // sent, but not yet processed
+    std::vector<long> latencies;            // in microseconds
+    double seconds;
+    double cpuMs;
+};
+
+// state shared with the monitor thread
+struct HarnessState
+{
+    Regulator* regulator;
+    std::atomic<bool> running;
+    std::atomic<bool> measuring;
+    std::atomic<int> path;                  // 0 = UDP, 1 = CAN
+    std::atomic<unsigned long> sent;
+    std::atomic<long long> udpSendTimes[HARNESS_UDP_SEQUENCE_RANGE];
+    std::atomic<long long> canProbeTimes[HARNESS_CAN_PROBE_RANGE];
+    long pollPeriodUs;
+
+    // written by the monitor thread while measuring
+    std::vector<long> latencies;
+    unsigned long maxQueueDepth, maxBacklog;
+};
+
+static HarnessState harness;
+
+// function prototypes
+bool writeConfig(char*, const char*, int, bool);
+bool openUdpSocket(int, int&);
+bool openCanSockets(const char*, int&, int&);
+void runMonitor();
+void drainCanFrames(int);
+bool runUdpPhase(int, int, double, PhaseResult&);
+bool runCanPhase(int, int, double, PhaseResult&);
+void fillCanFrame(struct can_frame&, unsigned long);
+void printResult(const char*, int, PhaseResult&);
+long long nowNs();
+double cpuMs();
+void printUsage();
+
+// ----- Main Function ----- //
+int main(int argc, char **argv)
+{
+    double duration = 2.0;
+    std::vector<int> rates = {1000, 10000, 50000, 100000, 0};
+    int udpPort = 2100;
+    const char* interfaceName = nullptr;
+    bool useIoRing = false;
+    harness.pollPeriodUs = 100;
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            duration = atof(argv[++i]);
+        } else if(strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            rates.clear();
+            for(char* rate = strtok(argv[++i], ","); rate != nullptr; rate = strtok(nullptr, ",")) {
+                rates.push_back(atoi(rate));
+            }
+        } else if(strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            harness.pollPeriodUs = atol(argv[++i]);
+        } else if(strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            udpPort = atoi(argv[++i]);
+        } else if(strcmp(argv[i], "-i") == 0 && i + 1 < argc) {
+            interfaceName = argv[++i];
+        } else if(strcmp(argv[i], "-u") == 0) {
+            useIoRing = true;
+        } else {
+            printUsage();
+            return EXIT_FAILURE;
+        }
+    }
+    if(duration <= 0.0 || rates.empty() || harness.pollPeriodUs <= 0) {
+        printUsage();
+        return EXIT_FAILURE;
+    }
+
+    // the app reads its settings from a temporary config file (no ledger, profile or meter replies)
+    char configFile[] = "/tmp/stress-harness-XXXXXX";
+    const char* busName = interfaceName != nullptr ? interfaceName : "stress0";
+    if(!writeConfig(configFile, busName, udpPort, useIoRing)) {
+        return EXIT_FAILURE;
+    }
+
+    int udpSocket = -1, appCanSocket = -1, canSocket = -1;
+    if(!openUdpSocket(udpPort, udpSocket) || !openCanSockets(interfaceName, appCanSocket, canSocket)) {
+        unlink(configFile);
+        return EXIT_FAILURE;
+    }
+
+    // the regulator takes over the sockets like after a hot restart
+    Regulator regulator(configFile, "stress", steadyClockMs);
+    regulator.loadConfig();
+    unlink(configFile);
+    HandoverState state;
+    memset(&state, 0, sizeof(state));
+    state.version = HOT_RESTART_VERSION;
+    state.canBusCount = 1;
+    state.slotDetectOn = 1;
+    strncpy(state.interfaceNames[0], busName, IFNAMSIZ - 1);
+    std::vector<int> fds = {udpSocket, appCanSocket};
+    if(!regulator.takeOver(state, fds)) {
+        std::cerr << "[Harness] Regulator failed to take over the sockets" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    harness.regulator = &regulator;
+    harness.running = true;
+    harness.measuring = false;
+    std::thread monitorTh(runMonitor);
+    std::thread drainTh(drainCanFrames, canSocket);
+
+    // let the threads start up
+    std::this_thread::sleep_for(milliseconds(500));
+    printf("\n%.1f seconds per rate, %s CAN bus, %s I/O, queue polled every %ldus\n\n", duration,
+            interfaceName != nullptr ? interfaceName : "in-memory", useIoRing ? "io_uring" : "classic", harness.pollPeriodUs);
+    printf("%-5s %9s %10s %8s %8s %10s %10s %9s %9s %9s %10s\n", "path", "rate/s", "done/s", "drop-%", "q-drop", "max-depth",
+            "max-backlog", "p50-us", "p99-us", "max-us", "cpu-ms/s");
+
+    PhaseResult result;
+    for(int rate : rates) {
+        if(runUdpPhase(udpPort, rate, duration, result)) {
+            printResult("udp", rate, result);
+        }
+    }
+    for(int rate : rates) {
+        if(runCanPhase(canSocket, rate, duration, result)) {
+            printResult("can", rate, result);
+        }
+    }
+
+    harness.running = false;
+    monitorTh.join();
+    drainTh.join();
+    regulator.detach();
+    close(canSocket);
+    return EXIT_SUCCESS;
+}
+
+bool writeConfig(char* fileName, const char* busName, int udpPort, bool useIoRing) {
+    int fd = mkstemp(fileName);
+    if(fd < 0) {
+        std::cerr << "[Harness] Failed to create the config file" << std::endl;
+        return false;
+    }
+    char content[512];
+    int length = snprintf(content, sizeof(content),
+                            "can-interface: %s\nudp-listener-port: %d\nio-uring-enabled: %s\nenergy-ledger-enabled: false\n"
+                            "load-profile-enabled: false\nmeter-log-enabled: false\nmeter-rate-control-enabled: false\n"
+                            "inverter-enabled: false\nhot-restart-enabled: false\nslotdetect-control-enabled: false\n",
+                            busName, udpPort, useIoRing ? "true" : "false");
+    bool success = write(fd, content, length) == length;
+    close(fd);
+    return success;
+}
+
+// the listener socket of the app (bound to loopback)
+bool openUdpSocket(int port, int& udpSocket) {
+    udpSocket = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(static_cast<uint16_t>(port));
+    if(udpSocket < 0 || bind(udpSocket, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        std::cerr << "[Harness] Failed to bind UDP port " << port << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// socket of the app and of the harness: an in-memory pair (frames as datagrams) or two sockets on a CAN interface
+bool openCanSockets(const char* interfaceName, int& appSocket, int& harnessSocket) {
+    if(interfaceName == nullptr) {
+        int pair[2];
+        if(socketpair(AF_UNIX, SOCK_DGRAM, 0, pair) < 0) {
+            std::cerr << "[Harness] Failed to create the socket pair: " << strerror(errno) << std::endl;
+            return false;
+        }
+        appSocket = pair[0];
+        harnessSocket = pair[1];
+        fcntl(harnessSocket, F_SETFL, O_NONBLOCK);
+        return true;
+    }
+
+    appSocket = socket(PF_CAN, SOCK_RAW, CAN_RAW);
+    harnessSocket = socket(PF_CAN, SOCK_RAW | SOCK_NONBLOCK, CAN_RAW);
+    struct ifreq ifr;
+    memset(&ifr, 0, sizeof(ifr));
+    strncpy(ifr.ifr_name, interfaceName, IFNAMSIZ - 1);
+    if(appSocket < 0 || harnessSocket < 0 || ioctl(appSocket, SIOCGIFINDEX, &ifr) < 0) {
+        std::cerr << "[Harness] CAN interface " << interfaceName << " not found!" << std::endl;
+        return false;
+    }
+    struct sockaddr_can addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.can_family = AF_CAN;
+    addr.can_ifindex = ifr.ifr_ifindex;
+    if(bind(appSocket, (struct sockaddr*)&addr, sizeof(addr)) < 0 || bind(harnessSocket, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        std::cerr << "[Harness] Failed to bind the CAN sockets to " << interfaceName << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// polls the command queue (like the regulator, but much more often) and the applied telemetry of the PSU.
+// records the latency of every reading and probe seen and the max depth of the queue and of the backlog
+void runMonitor() {
+    Regulator& regulator = *harness.regulator;
+    Queue<PowerState>& queue = regulator.getQueue();
+    long lastProbe = -1;
+    while(harness.running) {
+        std::this_thread::sleep_for(std::chrono::microseconds(harness.pollPeriodUs));
+        if(!harness.measuring) {
+            PowerState discarded;
+            queue.tryPop(discarded);
+            continue;
+        }
+        long long now = nowNs();
+
+        if(harness.path == 0) {
+            unsigned long depth = queue.getSize();
+            harness.maxQueueDepth = std::max(harness.maxQueueDepth, depth);
+            PowerState powerState;
+            if(queue.tryPop(powerState) && powerState.tasmotaPowerCmd >= 0 && powerState.tasmotaPowerCmd < HARNESS_UDP_SEQUENCE_RANGE) {
+                harness.latencies.push_back((now - harness.udpSendTimes[powerState.tasmotaPowerCmd]) / 1000);
+            }
+        } else {
+            unsigned long processed = regulator.getCanPsu()->getBusMetrics(0).rxFrames;
+            unsigned long sent = harness.sent;
+            harness.maxBacklog = std::max(harness.maxBacklog, sent > processed ? sent - processed : 0);
+            long probe = lroundf((regulator.getPsu().getCurrentInputPower() - HARNESS_CAN_PROBE_POWER) * 1024.0f);
+            if(probe >= 0 && probe < HARNESS_CAN_PROBE_RANGE && probe != lastProbe) {
+                harness.latencies.push_back((now - harness.canProbeTimes[probe]) / 1000);
+                lastProbe = probe;
+            }
+        }
+    }
+}
+
+// reads the frames the CAN worker sends (status requests, setpoints), a real bus would take them away
+void drainCanFrames(int canSocket) {
+    struct pollfd pfd;
+    pfd.fd = canSocket;
+    pfd.events = POLLIN;
+    struct can_frame frame;
+    while(harness.running) {
+        if(poll(&pfd, 1, 100) > 0) {
+            while(recv(canSocket, &frame, sizeof(frame), MSG_DONTWAIT) > 0) {}
+        }
+    }
+}
+
+// sends meter readings at the given rate (paced in 1ms steps, 0 = as fast as the socket takes them)
+bool runUdpPhase(int port, int rate, double duration, PhaseResult& result) {
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(static_cast<uint16_t>(port));
+    if(sock < 0 || connect(sock, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        std::cerr << "[Harness] Failed to open the UDP sender: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    Regulator& regulator = *harness.regulator;
+    unsigned long receivedStart = regulator.getUdpReceiver()->getDatagramCount();
+    unsigned long dropsStart = regulator.getQueue().getDropCount();
+    harness.path = 0;
+    harness.latencies.clear();
+    harness.latencies.reserve(static_cast<size_t>(duration * 1000000.0 / harness.pollPeriodUs) + 1);
+    harness.maxQueueDepth = harness.maxBacklog = 0;
+    harness.measuring = true;
+
+    unsigned long sent = 0;
+    char payload[16];
+    long long start = nowNs(), end = start + static_cast<long long>(duration * 1e9);
+    double cpuStart = cpuMs();
+    for(long long period = start; period < end; period += HARNESS_PACING_PERIOD) {
+        unsigned long due = rate > 0 ? static_cast<unsigned long>((period - start + HARNESS_PACING_PERIOD) * 1e-9 * rate) : sent + 64;
+        while(sent < due) {
+            int value = static_cast<int>(sent % HARNESS_UDP_SEQUENCE_RANGE);
+            int length = snprintf(payload, sizeof(payload), "%d", value);
+            harness.udpSendTimes[value].store(nowNs(), std::memory_order_relaxed);
+            if(send(sock, payload, length, 0) == length) {
+                sent++;
+            }
+        }
+        if(rate > 0) {
+            struct timespec next;
+            next.tv_sec = (period + HARNESS_PACING_PERIOD) / 1000000000LL;
+            next.tv_nsec = (period + HARNESS_PACING_PERIOD) % 1000000000LL;
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, nullptr);
+        } else {
+            period = nowNs() - HARNESS_PACING_PERIOD;
+        }
+    }
+    result.seconds = (nowNs() - start) / 1e9;
+    std::this_thread::sleep_for(milliseconds(HARNESS_DRAIN_TIME));
+    result.cpuMs = cpuMs() - cpuStart;
+    harness.measuring = false;
+    close(sock);
+
+    result.sent = sent;
+    result.rejected = 0;
+    result.processed = regulator.getUdpReceiver()->getDatagramCount() - receivedStart;
+    result.queueDrops = regulator.getQueue().getDropCount() - dropsStart;
+    result.maxQueueDepth = harness.maxQueueDepth;
+    result.maxBacklog = 0;
+    result.latencies.swap(harness.latencies);
+    return true;
+}
+
+// floods the CAN worker with frames of mixed ids at the given rate. frames the full socket doesn't
+// accept are counted as rejected (dropped on a real bus), without pacing the flooder waits for space
+bool runCanPhase(int canSocket, int rate, double duration, PhaseResult& result) {
+    Regulator& regulator = *harness.regulator;
+    unsigned long processedStart = regulator.getCanPsu()->getBusMetrics(0).rxFrames;
+    harness.path = 1;
+    harness.sent = 0;
+    harness.latencies.clear();
+    harness.latencies.reserve(static_cast<size_t>(duration * 1000000.0 / harness.pollPeriodUs) + 1);
+    harness.maxQueueDepth = harness.maxBacklog = 0;
+    harness.measuring = true;
+
+    unsigned long sent = 0, rejected = 0, sequence = 0;
+    struct can_frame frame;
+    struct pollfd pfd;
+    pfd.fd = canSocket;
+    pfd.events = POLLOUT;
+    long long start = nowNs(), end = start + static_cast<long long>(duration * 1e9);
+    double cpuStart = cpuMs();
+    for(long long period = start; period < end; period += HARNESS_PACING_PERIOD) {
+        unsigned long due = rate > 0 ? static_cast<unsigned long>((period - start + HARNESS_PACING_PERIOD) * 1e-9 * rate) : sequence + 64;
+        while(sequence < due) {
+            fillCanFrame(frame, sequence);
+            if(sequence % HARNESS_CAN_PROBE_INTERVAL == 0) {
+                harness.canProbeTimes[(sequence / HARNESS_CAN_PROBE_INTERVAL) % HARNESS_CAN_PROBE_RANGE].store(nowNs(), std::memory_order_relaxed);
+            }
+            if(send(canSocket, &frame, sizeof(frame), MSG_DONTWAIT) == sizeof(frame)) {
+                sent++;
+                harness.sent.store(sent, std::memory_order_relaxed);
+            } else if(rate > 0) {
+                rejected++;
+            } else {
+                poll(&pfd, 1, 10);
+                continue;
+            }
+            sequence++;
+        }
+        if(rate > 0) {
+            struct timespec next;
+            next.tv_sec = (period + HARNESS_PACING_PERIOD) / 1000000000LL;
+            next.tv_nsec = (period + HARNESS_PACING_PERIOD) % 1000000000LL;
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, nullptr);
+        } else {
+            period = nowNs() - HARNESS_PACING_PERIOD;
+        }
+    }
+    result.seconds = (nowNs() - start) / 1e9;
+    std::this_thread::sleep_for(milliseconds(HARNESS_DRAIN_TIME));
+    result.cpuMs = cpuMs() - cpuStart;
+    harness.measuring = false;
+
+    result.sent = sent;
+    result.rejected = rejected;
+    result.processed = regulator.getCanPsu()->getBusMetrics(0).rxFrames - processedStart;
+    result.queueDrops = 0;
+    result.maxQueueDepth = 0;
+    result.maxBacklog = harness.maxBacklog;
+    result.latencies.swap(harness.latencies);
+    return true;
+}
+
+// mix of the traffic on a busy bus: status reports of all values, acknowledgements,
+// descriptions and frames of other devices. every n-th frame is a probe (input power)
+void fillCanFrame(struct can_frame& frame, unsigned long sequence) {
+    static const uint8_t statusIds[] = { R48xx_DATA_INPUT_FREQ, R48xx_DATA_INPUT_CURRENT, R48xx_DATA_OUTPUT_POWER,
+                                            R48xx_DATA_EFFICIENCY, R48xx_DATA_OUTPUT_VOLTAGE, R48xx_DATA_INPUT_VOLTAGE,
+                                            R48xx_DATA_OUTPUT_TEMPERATURE, R48xx_DATA_INPUT_TEMPERATURE, R48xx_DATA_OUTPUT_CURRENT };
+    static const uint32_t statusValues[] = { 50 * 1024, 2 * 1024, 500 * 1024, 973, 52 * 1024, 230 * 1024, 40 * 1024, 35 * 1024, 9 * 1024 };
+    memset(&frame, 0, sizeof(frame));
+    frame.can_dlc = 8;
+
+    uint32_t value = 0;
+    if(sequence % HARNESS_CAN_PROBE_INTERVAL == 0) {
+        frame.can_id = 0x1081407F | CAN_EFF_FLAG;
+        frame.data[1] = R48xx_DATA_INPUT_POWER;
+        value = HARNESS_CAN_PROBE_POWER * 1024 + (sequence / HARNESS_CAN_PROBE_INTERVAL) % HARNESS_CAN_PROBE_RANGE;
+    } else {
+        switch(sequence % 16) {
+            case 13:
+                frame.can_id = 0x1081807E | CAN_EFF_FLAG;      // acknowledge of another current setpoint
+                frame.data[1] = 0x03;
+                value = 0x7FFF;
+                break;
+            case 14:
+                frame.can_id = 0x1081D27F | CAN_EFF_FLAG;      // description
+                break;
+            case 15:
+                frame.can_id = (sequence % 32 == 15 ? 0x18FF50E5 | CAN_EFF_FLAG : 0x123);     // other devices
+                break;
+            default:
+            {
+                size_t index = sequence % (sizeof(statusIds) / sizeof(statusIds[0]));
+                frame.can_id = 0x1081407F | CAN_EFF_FLAG;
+                frame.data[1] = statusIds[index];
+                value = statusValues[index];
+                break;
+            }
+        }
+    }
+    uint32_t bigEndian = __builtin_bswap32(value);
+    memcpy(&frame.data[4], &bigEndian, sizeof(bigEndian));
+}
+
+void printResult(const char* path, int rate, PhaseResult& result) {
+    std::vector<long>& latencies = result.latencies;
+    std::sort(latencies.begin(), latencies.end());
+    long p50 = latencies.empty() ? 0 : latencies[latencies.size() / 2];
+    long p99 = latencies.empty() ? 0 : latencies[latencies.size() * 99 / 100];
+    long max = latencies.empty() ? 0 : latencies.back();
+    unsigned long offered = result.sent + result.rejected;
+    double dropShare = offered > 0 ? 100.0 * (offered - std::min(result.processed, offered)) / offered : 0.0;
+    char rateText[16];
+    if(rate > 0) {
+        snprintf(rateText, sizeof(rateText), "%d", rate);
+    } else {
+        snprintf(rateText, sizeof(rateText), "max");
+    }
+    printf("%-5s %9s %10.0f %8.2f %8lu %10lu %10lu %9ld %9ld %9ld %10.1f\n", path, rateText, result.processed / result.seconds,
+            dropShare, result.queueDrops, result.maxQueueDepth, result.maxBacklog, p50, p99, max, result.cpuMs / result.seconds);
+}
+
+long long nowNs() {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec * 1000000000LL + time.tv_nsec;
+}
+
+// CPU time of the whole process (harness and app threads)
+double cpuMs() {
+    struct timespec time;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time);
+    return time.tv_sec * 1000.0 + time.tv_nsec / 1000000.0;
+}
+
+void printUsage() {
+    std::cout << "usage: stress_harness [-d <seconds>] [-r <rate,rate,...>] [-c <poll-us>] [-p <udp-port>] [-i <can-interface>] [-u]" << std::endl;
+}